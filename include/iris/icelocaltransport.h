@@ -0,0 +1 @@
+#include "irisnet/noncore/icelocaltransport.h"
@@ -0,0 +1 @@
+#include "xmpp/xmpp-core/xmpp_atoms.h"
@@ -21,8 +21,147 @@
 
 #include <QByteArray>
 
+#include <deque>
+
 // CS_NAMESPACE_BEGIN
 
+// A queue of implicitly shared chunks.  Appending never copies, and taking
+// from the front either hands out whole chunks or copies just the taken part
+// and moves an offset, so nothing gets memmoved however far the consumer lags.
+class ChunkBuffer {
+public:
+    qint64 size() const
+    {
+        sync();
+        return total;
+    }
+
+    void clear()
+    {
+        chunks.clear();
+        offset  = 0;
+        total   = 0;
+        exposed = false;
+    }
+
+    void append(const QByteArray &block)
+    {
+        sync();
+        if (block.isEmpty())
+            return;
+        chunks.push_back(block);
+        total += block.size();
+    }
+
+    // copies up to maxSize bytes to data, optionally removing them
+    qint64 read(char *data, qint64 maxSize, bool del = true)
+    {
+        sync();
+        qint64 done = 0;
+        size_t i    = 0;
+        int    off  = offset;
+        while (done < maxSize && i < chunks.size()) {
+            const QByteArray &c = chunks[i];
+            int               n = int(qMin<qint64>(c.size() - off, maxSize - done));
+            memcpy(data + done, c.constData() + off, size_t(n));
+            done += n;
+            off += n;
+            if (off == c.size()) {
+                ++i;
+                off = 0;
+            }
+        }
+        if (del)
+            drop(done);
+        return done;
+    }
+
+    QByteArray take(qint64 size, bool del = true)
+    {
+        sync();
+        if (size <= 0 || size > total)
+            size = total;
+        if (!offset && !chunks.empty() && chunks.front().size() == size) {
+            QByteArray ret = chunks.front();
+            if (del) {
+                chunks.pop_front();
+                total -= size;
+            }
+            return ret;
+        }
+        QByteArray ret(int(size), Qt::Uninitialized);
+        read(ret.data(), size, del);
+        return ret;
+    }
+
+    QList<QByteArray> takeChunks(qint64 maxSize)
+    {
+        sync();
+        if (maxSize <= 0 || maxSize > total)
+            maxSize = total;
+        QList<QByteArray> ret;
+        while (maxSize > 0) {
+            QByteArray &front = chunks.front();
+            int         avail = front.size() - offset;
+            if (avail <= maxSize) {
+                ret += offset ? front.mid(offset) : front;
+                maxSize -= avail;
+                total -= avail;
+                offset = 0;
+                chunks.pop_front();
+            } else {
+                ret += front.mid(offset, int(maxSize));
+                drop(maxSize);
+                maxSize = 0;
+            }
+        }
+        return ret;
+    }
+
+    // merges everything into one chunk for the legacy QByteArray& accessors
+    QByteArray &linearize()
+    {
+        sync();
+        if (chunks.size() != 1 || offset) {
+            QByteArray all = take(total, true);
+            clear();
+            chunks.push_back(all);
+            total = all.size();
+        }
+        exposed = true; // the caller may modify it
+        return chunks.front();
+    }
+
+private:
+    std::deque<QByteArray> chunks;
+    int                    offset  = 0; // consumed part of chunks.front()
+    mutable qint64         total   = 0;
+    mutable bool           exposed = false;
+
+    void sync() const
+    {
+        if (exposed) {
+            total   = chunks.front().size();
+            exposed = false;
+        }
+    }
+
+    void drop(qint64 size)
+    {
+        total -= size;
+        while (size > 0) {
+            int avail = chunks.front().size() - offset;
+            if (avail > size) {
+                offset += int(size);
+                return;
+            }
+            size -= avail;
+            offset = 0;
+            chunks.pop_front();
+        }
+    }
+};
+
 //! \class ByteStream bytestream.h
 //! \brief Base class for "bytestreams"
 //!
@@ -59,9 +198,9 @@ class ByteStream::Private {
 public:
     Private() { }
 
-    QByteArray readBuf, writeBuf;
-    int        errorCode;
-    QString    errorText;
+    ChunkBuffer readBuf, writeBuf;
+    int         errorCode;
+    QString     errorText;
 };
 
 //!
@@ -80,7 +219,7 @@ qint64 ByteStream::writeData(const char *data, qint64 maxSize)
         return -1;
 
     bool doWrite = bytesToWrite() == 0;
-    d->writeBuf.append(data, int(maxSize));
+    d->writeBuf.append(QByteArray(data, int(maxSize)));
     if (doWrite)
         tryWrite();
     return maxSize;
@@ -91,10 +230,7 @@ qint64 ByteStream::writeData(const char *data, qint64 maxSize)
 //! \a read will return all available data.
 qint64 ByteStream::readData(char *data, qint64 maxSize)
 {
-    maxSize = maxSize > d->readBuf.size() ? d->readBuf.size() : maxSize;
-    memcpy(data, d->readBuf.constData(), size_t(maxSize));
-    d->readBuf.remove(0, int(maxSize));
-    return maxSize;
+    return d->readBuf.read(data, maxSize);
 }
 
 //!
@@ -107,39 +243,60 @@ qint64 ByteStream::bytesToWrite() const { return d->writeBuf.size(); }
 
 //!
 //! Clears the read buffer.
-void ByteStream::clearReadBuffer() { d->readBuf.resize(0); }
+void ByteStream::clearReadBuffer() { d->readBuf.clear(); }
 
 //!
 //! Clears the write buffer.
-void ByteStream::clearWriteBuffer() { d->writeBuf.resize(0); }
+void ByteStream::clearWriteBuffer() { d->writeBuf.clear(); }
 
 //!
 //! Appends \a block to the end of the read buffer.
-void ByteStream::appendRead(const QByteArray &block) { d->readBuf += block; }
+//! The block is not copied, so it must not be a QByteArray::fromRawData() one.
+void ByteStream::appendRead(const QByteArray &block) { d->readBuf.append(block); }
 
 //!
 //! Appends \a block to the end of the write buffer.
-void ByteStream::appendWrite(const QByteArray &block) { d->writeBuf += block; }
+//! The block is not copied, so it must not be a QByteArray::fromRawData() one.
+void ByteStream::appendWrite(const QByteArray &block) { d->writeBuf.append(block); }
 
 //!
 //! Returns \a size bytes from the start of the read buffer.
 //! If \a size is 0, then all available data will be returned.
 //! If \a del is TRUE, then the bytes are also removed.
-QByteArray ByteStream::takeRead(int size, bool del) { return takeArray(d->readBuf, size, del); }
+QByteArray ByteStream::takeRead(int size, bool del) { return d->readBuf.take(size, del); }
 
 //!
 //! Returns \a size bytes from the start of the write buffer.
 //! If \a size is 0, then all available data will be returned.
 //! If \a del is TRUE, then the bytes are also removed.
-QByteArray ByteStream::takeWrite(int size, bool del) { return takeArray(d->writeBuf, size, del); }
+QByteArray ByteStream::takeWrite(int size, bool del) { return d->writeBuf.take(size, del); }
 
 //!
 //! Returns a reference to the read buffer.
-QByteArray &ByteStream::readBuf() { return d->readBuf; }
+//! This merges the buffered chunks, prefer takeReadChunks() and peekRead().
+QByteArray &ByteStream::readBuf() { return d->readBuf.linearize(); }
 
 //!
 //! Returns a reference to the write buffer.
-QByteArray &ByteStream::writeBuf() { return d->writeBuf; }
+//! This merges the buffered chunks, prefer takeWriteChunks() and peekWrite().
+QByteArray &ByteStream::writeBuf() { return d->writeBuf.linearize(); }
+
+//!
+//! Removes up to \a maxSize bytes (all if 0) from the start of the read buffer
+//! and returns them as the chunks they were appended with, without copying.
+QList<QByteArray> ByteStream::takeReadChunks(qint64 maxSize) { return d->readBuf.takeChunks(maxSize); }
+
+//!
+//! Same as takeReadChunks() but for the write buffer.
+QList<QByteArray> ByteStream::takeWriteChunks(qint64 maxSize) { return d->writeBuf.takeChunks(maxSize); }
+
+//!
+//! Returns \a size bytes (all if 0) from the start of the read buffer without removing them.
+QByteArray ByteStream::peekRead(int size) const { return d->readBuf.take(size, false); }
+
+//!
+//! Returns \a size bytes (all if 0) from the start of the write buffer without removing them.
+QByteArray ByteStream::peekWrite(int size) const { return d->writeBuf.take(size, false); }
 
 //!
 //! Attempts to try and write some bytes from the write buffer, and returns the number
@@ -22,6 +22,7 @@
 
 #include <QByteArray>
 #include <QIODevice>
+#include <QList>
 #include <QObject>
 
 class QAbstractSocket;
@@ -66,6 +67,12 @@ protected:
     QByteArray &writeBuf();
     virtual int tryWrite();
 
+    // zero-copy access to the buffers
+    QList<QByteArray> takeReadChunks(qint64 maxSize = 0);
+    QList<QByteArray> takeWriteChunks(qint64 maxSize = 0);
+    QByteArray        peekRead(int size = 0) const;
+    QByteArray        peekWrite(int size = 0) const;
+
 private:
     //! \if _hide_doc_
     class Private;
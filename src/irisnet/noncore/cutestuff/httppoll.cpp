@@ -268,7 +268,7 @@ void HttpPoll::http_result()
         if (!d->out.isEmpty()) {
             int x = d->out.size();
             d->out.resize(0);
-            takeWrite(x);
+            takeWriteChunks(x);
             emit bytesWritten(x);
         }
     }
@@ -325,7 +325,7 @@ void HttpPoll::do_sync()
         return;
 
     d->t->stop();
-    d->out = takeWrite(0, false);
+    d->out = peekWrite();
 
     bool    last;
     QString key = getKey(&last);
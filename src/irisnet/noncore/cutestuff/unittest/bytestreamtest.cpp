@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "bytestream.h"
+#include "qttestutil/qttestutil.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class TestByteStream : public ByteStream {
+public:
+    TestByteStream() { open(QIODevice::ReadWrite | QIODevice::Unbuffered); }
+
+    using ByteStream::appendRead;
+    using ByteStream::peekRead;
+    using ByteStream::readBuf;
+    using ByteStream::takeRead;
+    using ByteStream::takeReadChunks;
+};
+
+class ByteStreamTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testTakeAcrossChunks()
+    {
+        TestByteStream bs;
+        bs.appendRead("hello ");
+        bs.appendRead("chunked ");
+        bs.appendRead("world");
+        QCOMPARE(bs.bytesAvailable(), qint64(19));
+        QCOMPARE(bs.peekRead(3), QByteArray("hel"));
+        QCOMPARE(bs.takeRead(3), QByteArray("hel"));
+        QCOMPARE(bs.takeRead(7), QByteArray("lo chun"));
+        QCOMPARE(bs.read(4), QByteArray("ked "));
+        QCOMPARE(bs.takeRead(), QByteArray("world"));
+        QCOMPARE(bs.bytesAvailable(), qint64(0));
+    }
+
+    void testTakeChunks()
+    {
+        TestByteStream bs;
+        bs.appendRead("abc");
+        bs.appendRead("defgh");
+        bs.takeRead(1);
+        QCOMPARE(bs.takeReadChunks(4), QList<QByteArray>() << "bc" << "de");
+        QCOMPARE(bs.takeReadChunks(), QList<QByteArray>() << "fgh");
+    }
+
+    void testLegacyBufferAccess()
+    {
+        TestByteStream bs;
+        bs.appendRead("abc");
+        bs.appendRead("def");
+        bs.takeRead(1);
+        QCOMPARE(bs.readBuf(), QByteArray("bcdef"));
+        QCOMPARE(bs.bytesAvailable(), qint64(5));
+        bs.readBuf() += "gh";
+        QCOMPARE(bs.bytesAvailable(), qint64(7));
+        bs.appendRead("ij");
+        QCOMPARE(bs.readBuf(), QByteArray("bcdefghij"));
+        QCOMPARE(bs.bytesAvailable(), qint64(9));
+        QCOMPARE(bs.takeRead(), QByteArray("bcdefghij"));
+    }
+
+    // Moves 64 MB through the stream while the consumer lags behind by
+    // "lag" bytes. The cost per byte must not depend on the lag.
+    void benchmarkLaggingConsumer_data()
+    {
+        QTest::addColumn<int>("lag");
+        QTest::newRow("0") << 0;
+        QTest::newRow("1M") << (1 << 20);
+        QTest::newRow("16M") << (16 << 20);
+    }
+    void benchmarkLaggingConsumer()
+    {
+        QFETCH(int, lag);
+        const int  blockSize = 64 * 1024;
+        QByteArray block(blockSize, 'x');
+        QBENCHMARK
+        {
+            TestByteStream bs;
+            for (int i = 0; i < lag / blockSize; ++i)
+                bs.appendRead(block);
+            for (int i = 0; i < 1024; ++i) {
+                bs.appendRead(block);
+                bs.takeRead(blockSize / 2);
+                bs.takeRead(blockSize / 2);
+            }
+        }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(ByteStreamTest);
+#include "bytestreamtest.moc"
@@ -0,0 +1,2 @@
+SOURCES += \
+    $$PWD/bytestreamtest.cpp
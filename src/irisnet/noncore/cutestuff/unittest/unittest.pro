@@ -0,0 +1,12 @@
+include(../../../../xmpp/modules.pri)
+include($$IRIS_XMPP_QA_UNITTEST_MODULE)
+include(unittest.pri)
+
+INCLUDEPATH *= $$PWD/..
+DEPENDPATH *= $$PWD/..
+
+HEADERS += \
+    $$PWD/../bytestream.h
+
+SOURCES += \
+    $$PWD/../bytestream.cpp
@@ -21,6 +21,7 @@
 
 #include "iceabstractstundisco.h"
 #include "iceagent.h"
+#include "icechecklist.h"
 #include "icecomponent.h"
 #include "icelocaltransport.h"
 #include "iceturntransport.h"
@@ -28,6 +29,7 @@
 #include "stunmessage.h"
 #include "stuntransaction.h"
 #include "stuntypes.h"
+#include "timerwheel.h"
 #include "udpportreserver.h"
 
 #include <QDeadlineTimer>
@@ -36,7 +38,6 @@
 #include <QPointer>
 #include <QQueue>
 #include <QSet>
-#include <QTimer>
 #include <QUdpSocket>
 #include <QtCrypto>
 
@@ -152,9 +153,6 @@ public:
         bool isTriggered             = false; // last scheduled check was a triggered check
         bool isTriggeredForNominated = false;
         bool finalNomination         = false;
-#ifdef ICE_DEBUG
-        bool logNew = false;
-#endif
 
         CandidatePairState state = CandidatePairState::PFrozen;
 
@@ -180,24 +178,24 @@ public:
 
     class CheckList {
     public:
-        QList<QSharedPointer<CandidatePair>> pairs;
-        QQueue<QWeakPointer<CandidatePair>>  triggeredPairs;
-        QList<QSharedPointer<CandidatePair>> validPairs; // highest priority and nominated come first
-        CheckListState                       state;
+        IceCheckList<CandidatePair, PFrozen + 1> pairs; // states of the pairs on it are changed with pairs.setState()
+        QQueue<QWeakPointer<CandidatePair>>      triggeredPairs;
+        QList<QSharedPointer<CandidatePair>>     validPairs; // highest priority and nominated come first
+        CheckListState                           state;
     };
 
     class Component {
     public:
-        int                     id              = 0;
-        IceComponent *          ic              = nullptr;
-        std::unique_ptr<QTimer> nominationTimer = std::unique_ptr<QTimer>();
-        CandidatePair::Ptr      selectedPair; // final selected pair. won't be changed
-        CandidatePair::Ptr      highestPair;  // current highest priority pair to send data
-        bool                    localFinished     = false;
-        bool                    hasValidPairs     = false;
-        bool                    hasNominatedPairs = false;
-        bool                    stopped           = false;
-        bool                    lowOverhead       = false;
+        int                                id              = 0;
+        IceComponent *                     ic              = nullptr;
+        std::unique_ptr<TimerWheel::Timer> nominationTimer = std::unique_ptr<TimerWheel::Timer>();
+        CandidatePair::Ptr                 selectedPair; // final selected pair. won't be changed
+        CandidatePair::Ptr                 highestPair;  // current highest priority pair to send data
+        bool                               localFinished     = false;
+        bool                               hasValidPairs     = false;
+        bool                               hasNominatedPairs = false;
+        bool                               stopped           = false;
+        bool                               lowOverhead       = false;
 
         // initiator is nominating the final pair (will be set as `selectePair` when ready)
         bool nominating = false; // with aggressive nomination it's always false
@@ -206,10 +204,10 @@ public:
     Ice176 *                                q;
     Ice176::Mode                            mode;
     State                                   state = Stopped;
-    QTimer                                  checkTimer;
+    TimerWheel::Timer                       checkTimer; // Ta. all the timers here are on the wheel of the thread
     TurnClient::Proxy                       proxy;
     UdpPortReserver *                       portReserver = nullptr;
-    std::unique_ptr<QTimer>                 pacTimer;
+    TimerWheel::Timer                       pacTimer;
     int                                     nominationTimeout = 3000; // 3s
     int                                     pacTimeout = 30000; // 30s todo: compute from rto. see draft-ietf-ice-pac-06
     int                                     componentCount = 0;
@@ -225,6 +223,7 @@ public:
     QPointer<AbstractStunDisco>             stunDiscoverer;
     QString                                 localUser, localPass;
     QString                                 peerUser, peerPass;
+    StunMessage::IntegrityKey               localKey, peerKey; // of the passwords above
     std::vector<Component>                  components;
     QList<IceComponent::Candidate>          localCandidates;
     QList<IceComponent::CandidateInfo::Ptr> remoteCandidates;
@@ -246,15 +245,20 @@ public:
 
     Private(Ice176 *_q) : QObject(_q), q(_q)
     {
-        connect(&checkTimer, &QTimer::timeout, this, [this]() {
+        checkTimer.setCallback([this]() {
             auto pair = selectNextPairToCheck();
             if (pair)
                 checkPair(pair);
             else
                 checkTimer.stop();
         });
+        checkTimer.setContext(this);
         checkTimer.setInterval(20);
         checkTimer.setSingleShot(false);
+
+        pacTimer.setCallback([this]() { onPacTimeout(); });
+        pacTimer.setContext(this);
+        pacTimer.setSingleShot(true);
     }
 
     ~Private()
@@ -322,6 +326,7 @@ public:
 
         localUser = IceAgent::randomCredential(4);
         localPass = IceAgent::randomCredential(22);
+        localKey  = StunMessage::IntegrityKey(localPass.toUtf8());
 
         if (!useLocal)
             useStunBind = false;
@@ -379,13 +384,9 @@ public:
 
     void startChecks()
     {
-        pacTimer.reset(new QTimer(this));
-        pacTimer->setSingleShot(true);
-        pacTimer->setInterval(pacTimeout);
-        connect(pacTimer.get(), &QTimer::timeout, this, &Ice176::Private::onPacTimeout);
         iceDebug("Start Patiently Awaiting Connectivity timer");
         canStartChecks = true;
-        pacTimer->start();
+        pacTimer.start(pacTimeout);
         checkTimer.start();
     }
 
@@ -396,7 +397,7 @@ public:
 
         canStartChecks = false;
         state          = Stopping;
-        pacTimer.reset();
+        pacTimer.stop();
         checkTimer.stop();
 
         // will trigger candidateRemoved events and result pairs cleanup.
@@ -504,58 +505,23 @@ public:
         return pair;
     }
 
-    // adds new pairs, sorts, prunes
+    // adds new pairs in priority order, pruning redundant ones
     void addChecklistPairs(const QList<QSharedPointer<CandidatePair>> &pairs)
     {
-#ifdef ICE_DEBUG
         iceDebug("%d new pairs", pairs.count());
-        for (auto &p : pairs)
-            p->logNew = true;
-#endif
         if (!pairs.count())
             return;
 
-        // combine pairs with existing, and sort
-        checkList.pairs += pairs;
-        std::sort(checkList.pairs.begin(), checkList.pairs.end(),
-                  [&](const QSharedPointer<CandidatePair> &a, const QSharedPointer<CandidatePair> &b) {
-                      return a->priority == b->priority ? a->local->componentId < b->local->componentId
-                                                        : a->priority > b->priority;
-                  });
-
-        // pruning
-        for (int n = 0; n < checkList.pairs.count(); ++n) {
-            auto &pair = checkList.pairs[n];
-#ifdef ICE_DEBUG
-            if (pair->logNew)
-                iceDebug("C%d, %s", pair->local->componentId, qPrintable(*pair));
-#endif
-
-            for (int i = n - 1; i >= 0; --i) {
-                // RFC8445 says to use base only for reflexive. but base is set properly for host and relayed too.
-                if (pair->local->componentId == checkList.pairs[i]->local->componentId
-                    && pair->local->base == checkList.pairs[i]->local->base
-                    && pair->remote->addr == checkList.pairs[i]->remote->addr) {
-
-                    checkList.pairs.removeAt(n);
-                    --n; // adjust position
-                    break;
-                }
-            }
+        // RFC8445 says to use base only for reflexive. but base is set properly for host and relayed too.
+        for (auto &pair : pairs) {
+            bool added = checkList.pairs.add(pair);
+            iceDebug("C%d, %s%s", pair->local->componentId, qPrintable(*pair), added ? "" : " (redundant)");
+            Q_UNUSED(added)
         }
 
         // max pairs is 100 * number of components
-        int max_pairs = 100 * int(components.size());
-        while (checkList.pairs.count() > max_pairs)
-            checkList.pairs.removeLast();
-#ifdef ICE_DEBUG
-        iceDebug("%d after pruning (just new below):", checkList.pairs.count());
-        for (auto &p : checkList.pairs) {
-            if (p->logNew)
-                iceDebug("C%d, %s", p->local->componentId, qPrintable(*p));
-            p->logNew = false;
-        }
-#endif
+        checkList.pairs.truncate(100 * int(components.size()));
+        iceDebug("%d after pruning", checkList.pairs.count());
     }
 
     QSharedPointer<CandidatePair> selectNextPairToCheck()
@@ -572,18 +538,15 @@ public:
             return pair;
         }
 
-        auto it = std::find_if(checkList.pairs.begin(), checkList.pairs.end(), [&](const auto &p) mutable {
-            if (p->state == PFrozen && !pair)
-                pair = p;
-            return p->state == PWaiting;
-        });
-        if (it != checkList.pairs.end()) { // found waiting
-            // the list was sorted already by priority and componentId. So first one is Ok
-            iceDebug("next check for already waiting: %s", qPrintable(**it));
-            (*it)->isTriggered = false;
-            return *it;
+        pair = checkList.pairs.firstIn(PWaiting);
+        if (pair) {
+            // the list is sorted by priority and componentId. So first one is Ok
+            iceDebug("next check for already waiting: %s", qPrintable(*pair));
+            pair->isTriggered = false;
+            return pair;
         }
 
+        pair = checkList.pairs.firstIn(PFrozen);
         if (pair) { // now it's frozen highest-priority pair
             pair->isTriggered = false;
             iceDebug("next check for a frozen pair: %s", qPrintable(*pair));
@@ -600,7 +563,7 @@ public:
     void checkPair(QSharedPointer<CandidatePair> pair)
     {
         pair->foundation = pair->local->foundation + pair->remote->foundation;
-        pair->state      = PInProgress;
+        checkList.pairs.setState(pair, PInProgress);
 
         int at = findLocalCandidate(pair->local->addr);
         Q_ASSERT(at != -1);
@@ -690,7 +653,8 @@ public:
             checkTimer.start();
     }
 
-    void write(int componentIndex, const QByteArray &datagram)
+    // where datagrams of the component go to. nullptr if nowhere yet
+    IceComponent::Candidate *writeTarget(int componentIndex, TransportAddress &to)
     {
         auto cIt = findComponent(componentIndex + 1);
         Q_ASSERT(cIt != components.end());
@@ -700,7 +664,7 @@ public:
             pair = cIt->highestPair;
             if (!pair) {
                 iceDebug("An attempt to write to an ICE component w/o valid sockets");
-                return;
+                return nullptr;
             }
         }
 
@@ -708,20 +672,41 @@ public:
         if (at == -1) { // FIXME: assert?
             iceDebug("FIXME! Failed to find local candidate for componentId=%d, addr=%s", componentIndex + 1,
                      qPrintable(pair->local->addr));
-            return;
+            return nullptr;
         }
 
-        IceComponent::Candidate &lc = localCandidates[at];
+        to = pair->remote->addr;
+        return &localCandidates[at];
+    }
 
-        int path = lc.path;
+    void write(int componentIndex, const QByteArray &datagram)
+    {
+        TransportAddress         to;
+        IceComponent::Candidate *lc = writeTarget(componentIndex, to);
+        if (!lc)
+            return;
 
-        lc.iceTransport->writeDatagram(path, datagram, pair->remote->addr);
+        lc->iceTransport->writeDatagram(lc->path, datagram, to);
 
         // DOR-SR?
         QMetaObject::invokeMethod(q, "datagramsWritten", Qt::QueuedConnection, Q_ARG(int, componentIndex),
                                   Q_ARG(int, 1));
     }
 
+    void write(int componentIndex, const QList<QByteArray> &datagrams)
+    {
+        TransportAddress         to;
+        IceComponent::Candidate *lc = writeTarget(componentIndex, to);
+        if (!lc || datagrams.isEmpty())
+            return;
+
+        lc->iceTransport->writeDatagrams(lc->path, datagrams, to);
+
+        // DOR-SR?
+        QMetaObject::invokeMethod(q, "datagramsWritten", Qt::QueuedConnection, Q_ARG(int, componentIndex),
+                                  Q_ARG(int, datagrams.count()));
+    }
+
     void flagComponentAsLowOverhead(int componentIndex)
     {
         Q_ASSERT(size_t(componentIndex) < components.size());
@@ -753,10 +738,10 @@ public:
             if (!p || p->local->componentId == componentId)
                 it.remove();
         }
-        for (auto &p : checkList.pairs) {
-            if (p->local->componentId == componentId && p->state == PInProgress) {
+        for (auto &p : checkList.pairs.in(PInProgress)) {
+            if (p->local->componentId == componentId) {
                 p->binding->cancel();
-                p->state = PFailed;
+                checkList.pairs.setState(p, PFailed);
                 iceDebug("Cancel %s setting it to failed state", qPrintable(*p));
             }
         }
@@ -802,19 +787,19 @@ public:
         Q_ASSERT(it != components.end() && it->highestPair);
 
         auto minPriority = it->highestPair->priority;
-        for (auto &p : checkList.pairs) {
-            bool toStop = p->local->componentId == componentId && (p->state == PFrozen || p->state == PWaiting)
-                && p->priority < minPriority;
-            if (toStop) {
-                iceDebug("Disable check for %s since we already have better valid pairs", qPrintable(*p));
-                p->state = PFailed;
+        for (auto state : { PFrozen, PWaiting }) {
+            for (auto &p : checkList.pairs.in(state, minPriority)) {
+                if (p->local->componentId == componentId) {
+                    iceDebug("Disable check for %s since we already have better valid pairs", qPrintable(*p));
+                    checkList.pairs.setState(p, PFailed);
+                }
             }
         }
         for (auto &pWeak : checkList.triggeredPairs) {
             auto p = pWeak.toStrongRef();
             if (p->local->componentId == componentId && p->priority < minPriority) {
                 iceDebug("Disable triggered check for %s since we already have better valid pairs", qPrintable(*p));
-                p->state = PFailed;
+                checkList.pairs.setState(p, PFailed);
             }
         }
     }
@@ -877,7 +862,7 @@ public:
         }
         iceDebug("Signalling iceFinished now");
 #endif
-        pacTimer.reset();
+        pacTimer.stop();
         state = Active;
         emit q->iceFinished();
     }
@@ -891,14 +876,10 @@ public:
         if (!agrNom && mode == Responder)
             return; // responder will wait for nominated pairs till very end
 
-        auto timer = new QTimer();
-        c.nominationTimer.reset(timer);
-        timer->setSingleShot(true);
-        timer->setInterval(nominationTimeout);
-        connect(timer, &QTimer::timeout, this, [this, componentId, agrNom]() {
+        auto timer = new TimerWheel::Timer([this, componentId, agrNom]() {
             Q_ASSERT(state == Started);
             Component &c = *findComponent(componentId);
-            c.nominationTimer.release()->deleteLater();
+            c.nominationTimer.reset();
             if (c.stopped)
                 return; // already queue signal likely
             if (agrNom)
@@ -906,20 +887,23 @@ public:
             else if (!c.nominating && !c.selectedPair)
                 nominateSelectedPair(componentId);
         });
-        timer->start();
+        c.nominationTimer.reset(timer);
+        timer->setContext(this);
+        timer->setSingleShot(true);
+        timer->start(nominationTimeout);
     }
 
     // nominated - out side=responder. and remote request had USE_CANDIDATE
     void doTriggeredCheck(const IceComponent::Candidate &locCand, IceComponent::CandidateInfo::Ptr remCand,
                           bool nominated)
     {
-        // let's figure out if this pair already in the check list
-        auto it = std::find_if(checkList.pairs.begin(), checkList.pairs.end(),
-                               [&](auto const &p) { return *(p->local) == locCand.info && *(p->remote) == remCand; });
+        // let's figure out if this pair already in the check list. a redundant one may be there instead
+        CandidatePair::Ptr pair = checkList.pairs.find(locCand.info->componentId, locCand.info->base, remCand->addr);
+        if (pair && !(*(pair->local) == locCand.info && *(pair->remote) == remCand))
+            pair.reset();
 
-        CandidatePair::Ptr pair        = (it == checkList.pairs.end()) ? CandidatePair::Ptr() : *it;
-        Component &        component   = *findComponent(locCand.info->componentId);
-        qint64             minPriority = component.highestPair ? component.highestPair->priority : 0;
+        Component &component   = *findComponent(locCand.info->componentId);
+        qint64     minPriority = component.highestPair ? component.highestPair->priority : 0;
         if (pair) {
             if (pair->priority < minPriority) {
                 iceDebug(
@@ -964,7 +948,7 @@ public:
             addChecklistPairs(QList<CandidatePair::Ptr>() << pair);
         }
 
-        pair->state                   = PWaiting;
+        checkList.pairs.setState(pair, PWaiting);
         pair->isTriggeredForNominated = nominated;
         checkList.triggeredPairs.enqueue(pair);
 
@@ -975,7 +959,6 @@ public:
     void onPacTimeout()
     {
         Q_ASSERT(state == Starting || state == Started);
-        pacTimer.release()->deleteLater();
         iceDebug("Patiently Awaiting Connectivity timeout");
         stop();
         emit q->error(ErrorGeneric);
@@ -1167,14 +1150,14 @@ private:
         auto &component          = *findComponent(pair->local->componentId);
         bool  alreadyInValidList = pair->isValid;
         pair->isValid            = true;
-        pair->state              = PSucceeded; // what if it was in progress?
+        checkList.pairs.setState(pair, PSucceeded); // what if it was in progress?
 
         component.hasValidPairs = true;
 
         // mark all with same foundation as Waiting to prioritize them (see RFC8445 7.2.5.3.3)
-        for (auto &p : checkList.pairs)
-            if (p->state == PFrozen && p->foundation == pair->foundation)
-                p->state = PWaiting;
+        for (auto &p : checkList.pairs.in(PFrozen))
+            if (p->foundation == pair->foundation)
+                checkList.pairs.setState(p, PWaiting);
 
         if (!alreadyInValidList)
             insertIntoValidList(component.id, pair);
@@ -1211,7 +1194,7 @@ private:
 
         StunBinding *binding = pair->binding;
         // pair->isValid = true;
-        pair->state                   = CandidatePairState::PSucceeded;
+        checkList.pairs.setState(pair, PSucceeded);
         bool  isTriggeredForNominated = pair->isTriggeredForNominated;
         bool  isNominatedByInitiator  = mode == Initiator && binding->useCandidate();
         bool  finalNomination         = pair->finalNomination;
@@ -1243,15 +1226,12 @@ private:
             } else {
                 // local candidate found. If it's a part of a pair on checklist, we have to add this pair to valid list,
                 // otherwise we have to create a new pair and add it to valid list
-                auto it = std::find_if(checkList.pairs.begin(), checkList.pairs.end(), [&](auto const &p) {
-                    return p->local->base == locIt->info->base && p->remote->addr == pair->remote->addr
-                        && p->local->componentId == locIt->info->componentId;
-                });
-                if (it == checkList.pairs.end()) {
+                auto found = checkList.pairs.find(locIt->info->componentId, locIt->info->base, pair->remote->addr);
+                if (!found) {
                     // allow v4/v6 proto mismatch in case NAT does magic
                     pair = makeCandidatesPair(locIt->info, pair->remote);
                 } else {
-                    pair = *it;
+                    pair = found;
                     iceDebug("mapped address belongs to another pair on checklist %s", qPrintable(QString(*pair)));
                 }
             }
@@ -1280,8 +1260,8 @@ private:
         }
 
         iceDebug("check failed for %s", qPrintable(*pair));
-        auto &c     = *findComponent(pair->local->componentId);
-        pair->state = CandidatePairState::PFailed;
+        auto &c = *findComponent(pair->local->componentId);
+        checkList.pairs.setState(pair, PFailed);
         if (pair->isValid) { // RFC8445 7.2.5.3.4.  Updating the Nominated Flag /  about failure
             checkList.validPairs.removeOne(pair);
             pair->isValid = false;
@@ -1380,16 +1360,16 @@ private slots:
         }
 
         for (int n = 0; n < checkList.pairs.count(); ++n) {
-            if (idList.contains(checkList.pairs[n]->local->id)) {
-                StunBinding *binding = checkList.pairs[n]->binding;
-                auto         pool    = checkList.pairs[n]->pool;
+            if (idList.contains(checkList.pairs.at(n)->local->id)) {
+                StunBinding *binding = checkList.pairs.at(n)->binding;
+                auto         pool    = checkList.pairs.at(n)->pool;
 
                 delete binding;
 
                 if (pool) {
                     pool->disconnect(this);
                 }
-                checkList.pairs[n]->pool.reset();
+                checkList.pairs.at(n)->pool.reset();
 
                 checkList.pairs.removeAt(n);
                 --n; // adjust position
@@ -1483,28 +1463,34 @@ private slots:
 
         IceTransport *sock = it;
 
-        while (sock->hasPendingDatagrams(path)) {
-            TransportAddress fromAddr;
-            QByteArray       buf = sock->readDatagram(path, fromAddr);
+        // the whole burst at once. readyRead() is emitted per datagram as before and
+        //   readyReadBurst() once per component afterwards
+        QList<IceTransport::Datagram> datagrams;
+        QList<int>                    readyComponents;
+        sock->readDatagrams(path, datagrams);
+        for (const IceTransport::Datagram &dg : qAsConst(datagrams)) {
+            const TransportAddress &fromAddr = dg.addr;
+            const QByteArray       &buf      = dg.buf;
 
             // iceDebug("port %d: received packet (%d bytes)", lt->sock->localPort(), buf.size());
 
-            QString    requser = localUser + ':' + peerUser;
-            QByteArray reqkey  = localPass.toUtf8();
-
-            StunMessage::ConvertResult result;
-            StunMessage                msg = StunMessage::fromBinary(buf, &result,
-                                                      StunMessage::MessageIntegrity | StunMessage::Fingerprint, reqkey);
-            if (!msg.isNull() && (msg.mclass() == StunMessage::Request || msg.mclass() == StunMessage::Indication)) {
+            // requests are checked with our key and responses with the peer's. only the class is looked at first
+            StunMessageView view(buf);
+            bool            request = view.isValid()
+                && (view.mclass() == StunMessage::Request || view.mclass() == StunMessage::Indication);
+            int flags = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
+            if (request && view.validate(flags, localKey) == StunMessage::ConvertGood) {
                 iceDebug("received validated request or indication from %s", qPrintable(fromAddr));
-                QString user = QString::fromUtf8(msg.attribute(StunTypes::USERNAME));
+                QString requser = localUser + ':' + peerUser;
+                QString user;
+                view.username(&user);
                 if (requser != user) {
                     iceDebug("user [%s] is wrong.  it should be [%s].  skipping", qPrintable(user),
                              qPrintable(requser));
                     continue;
                 }
 
-                if (msg.method() != StunTypes::Binding) {
+                if (view.method() != StunTypes::Binding) {
                     iceDebug("not a binding request.  skipping");
                     continue;
                 }
@@ -1512,7 +1498,7 @@ private slots:
                 StunMessage response;
                 response.setClass(StunMessage::SuccessResponse);
                 response.setMethod(StunTypes::Binding);
-                response.setId(msg.id());
+                response.setId(view.id());
 
                 QList<StunMessage::Attribute> list;
                 StunMessage::Attribute        attr;
@@ -1522,11 +1508,12 @@ private slots:
 
                 response.setAttributes(list);
 
-                QByteArray packet = response.toBinary(StunMessage::MessageIntegrity | StunMessage::Fingerprint, reqkey);
+                QByteArray packet
+                    = response.toBinary(StunMessage::MessageIntegrity | StunMessage::Fingerprint, localKey);
                 sock->writeDatagram(path, packet, fromAddr);
 
                 if (state != Started) // only in started state we do triggered checks
-                    return;
+                    continue;
 
                 auto it = std::find_if(
                     remoteCandidates.begin(), remoteCandidates.end(), [&](IceComponent::CandidateInfo::Ptr remCand) {
@@ -1534,12 +1521,12 @@ private slots:
                     });
                 bool nominated = false;
                 if (mode == Responder)
-                    nominated = msg.hasAttribute(StunTypes::USE_CANDIDATE);
+                    nominated = view.hasAttribute(StunTypes::USE_CANDIDATE);
                 if (it == remoteCandidates.end()) {
                     // RFC8445 7.3.1.3.  Learning Peer-Reflexive Candidates
                     iceDebug("found NEW remote prflx! %s", qPrintable(fromAddr));
-                    quint32 priority;
-                    StunTypes::parsePriority(msg.attribute(StunTypes::PRIORITY), &priority);
+                    quint32 priority = 0;
+                    view.priority(&priority);
                     auto remCand
                         = IceComponent::CandidateInfo::makeRemotePrflx(locCand.info->componentId, fromAddr, priority);
                     remoteCandidates += remCand;
@@ -1548,17 +1535,14 @@ private slots:
                     doTriggeredCheck(locCand, *it, nominated);
                 }
             } else {
-                QByteArray  reskey = peerPass.toUtf8();
-                StunMessage msg    = StunMessage::fromBinary(
-                    buf, &result, StunMessage::MessageIntegrity | StunMessage::Fingerprint, reskey);
-                if (!msg.isNull()
-                    && (msg.mclass() == StunMessage::SuccessResponse || msg.mclass() == StunMessage::ErrorResponse)) {
+                if (view.isValid() && !request && view.validate(flags, peerKey) == StunMessage::ConvertGood) {
+                    StunMessage msg = view.toMessage();
                     iceDebug("received validated response from %s to %s", qPrintable(fromAddr),
                              qPrintable(locCand.info->addr));
 
                     // FIXME: this is so gross and completely defeats the point of having pools
-                    for (int n = 0; n < checkList.pairs.count(); ++n) {
-                        CandidatePair &pair = *checkList.pairs[n];
+                    for (auto &p : checkList.pairs.in(PInProgress)) {
+                        CandidatePair &pair = *p;
                         if (pair.state == PInProgress && pair.local->addr.addr == locCand.info->addr.addr
                             && pair.local->addr.port == locCand.info->addr.port)
                             pair.pool->writeIncomingMessage(msg);
@@ -1567,14 +1551,14 @@ private slots:
                     // iceDebug("received some non-stun or invalid stun packet");
 
                     // FIXME: i don't know if this is good enough
-                    if (StunMessage::isProbablyStun(buf)) {
+                    if (view.isValid()) {
                         iceDebug("unexpected stun packet (loopback?), skipping.");
                         continue;
                     }
 
                     int at = -1;
                     for (int n = 0; n < checkList.pairs.count(); ++n) {
-                        CandidatePair &pair = *checkList.pairs[n];
+                        CandidatePair &pair = *checkList.pairs.at(n);
                         if (pair.local->addr.addr == locCand.info->addr.addr
                             && pair.local->addr.port == locCand.info->addr.port) {
                             at = n;
@@ -1586,15 +1570,20 @@ private slots:
                         continue;
                     }
 
-                    int componentIndex = checkList.pairs[at]->local->componentId - 1;
+                    int componentIndex = checkList.pairs.at(at)->local->componentId - 1;
                     // iceDebug("packet is considered to be application data for component index %d", componentIndex);
 
                     // FIXME: this assumes components are ordered by id in our local arrays
                     in[componentIndex] += buf;
                     emit q->readyRead(componentIndex);
+                    if (!readyComponents.contains(componentIndex))
+                        readyComponents += componentIndex;
                 }
             }
         }
+
+        for (int componentIndex : qAsConst(readyComponents))
+            emit q->readyReadBurst(componentIndex);
     }
 
     void it_datagramsWritten(int path, int count, const TransportAddress &addr)
@@ -1695,6 +1684,7 @@ void Ice176::setRemoteCredentials(const QString &ufrag, const QString &pass)
     // TODO detect restart
     d->peerUser = ufrag;
     d->peerPass = pass;
+    d->peerKey  = StunMessage::IntegrityKey(pass.toUtf8());
 }
 
 void Ice176::addRemoteCandidates(const QList<Candidate> &list) { d->addRemoteCandidates(list); }
@@ -1717,8 +1707,20 @@ bool Ice176::hasPendingDatagrams(int componentIndex) const { return !d->in[compo
 
 QByteArray Ice176::readDatagram(int componentIndex) { return d->in[componentIndex].takeFirst(); }
 
+QList<QByteArray> Ice176::readDatagrams(int componentIndex)
+{
+    QList<QByteArray> ret;
+    ret.swap(d->in[componentIndex]);
+    return ret;
+}
+
 void Ice176::writeDatagram(int componentIndex, const QByteArray &datagram) { d->write(componentIndex, datagram); }
 
+void Ice176::writeDatagrams(int componentIndex, const QList<QByteArray> &datagrams)
+{
+    d->write(componentIndex, datagrams);
+}
+
 void Ice176::flagComponentAsLowOverhead(int componentIndex) { d->flagComponentAsLowOverhead(componentIndex); }
 
 bool Ice176::isIPv6LinkLocalAddress(const QHostAddress &addr)
@@ -1739,8 +1741,9 @@ void Ice176::changeThread(QThread *thread)
     }
     for (auto &p : d->checkList.pairs) {
         if (p->pool)
-            p->pool->moveToThread(thread);
+            p->pool->changeThread(thread);
     }
+    TimerWheel::instance()->moveTimers(this);
     moveToThread(thread);
 }
 
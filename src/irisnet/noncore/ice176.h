@@ -145,6 +145,11 @@ public:
     QByteArray readDatagram(int componentIndex);
     void       writeDatagram(int componentIndex, const QByteArray &datagram);
 
+    // readyReadBurst() is emitted once per received burst, so read all of it.
+    // writeDatagrams() sends them all on the same path in as few syscalls as the transport allows
+    QList<QByteArray> readDatagrams(int componentIndex);
+    void              writeDatagrams(int componentIndex, const QList<QByteArray> &datagrams);
+
     // this call will ensure that TURN headers are minimized on this
     //   component, with the drawback that packets might not be able to
     //   be set as non-fragmentable.  use this on components that expect
@@ -179,7 +184,8 @@ signals:
     void componentReady(int index); // has valid nominated candidate for component with index
     void iceFinished();             // Final nominated candidates are selected for all components
 
-    void readyRead(int componentIndex);
+    void readyRead(int componentIndex);      // for every datagram received
+    void readyReadBurst(int componentIndex); // after all the datagrams received at once
     void datagramsWritten(int componentIndex, int count);
 
 private:
@@ -0,0 +1,235 @@
+/*
+ * icechecklist.h - ice candidate pairs ordered and indexed
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ICECHECKLIST_H
+#define ICECHECKLIST_H
+
+#include "transportaddress.h"
+
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+namespace XMPP {
+// the pairs of an ice checklist (RFC 8445 6.1.2), highest priority first and
+//   then by component id, as the checks go. a pair is redundant with another
+//   one for the same component, local base and remote address, and only the
+//   higher of the two is kept (6.1.2.4).
+//
+// looking up a pair, and picking the best one in some state, is O(log n) at
+//   most: pairs are hashed by what makes them redundant and the ones in each
+//   state are kept in their own ordered set. adding and removing one is O(n),
+//   for the move of the QList of pairs, but a memmove of pointers with no
+//   comparisons of pairs. for this the state of a pair on the list must only
+//   be changed with setState().
+//
+// Pair is expected to have priority, state, local and remote, where local has
+//   componentId and base, and remote has addr. none but the state may change
+//   while the pair is on the list. the states are 0 to StateCount - 1
+template <class Pair, int StateCount> class IceCheckList {
+public:
+    using Ptr   = QSharedPointer<Pair>;
+    using State = decltype(Pair::state);
+
+    // highest priority first
+    const QList<Ptr> &pairs() const { return pairs_; }
+    int               count() const { return pairs_.count(); }
+    const Ptr &       at(int index) const { return pairs_.at(index); }
+    bool              contains(const Ptr &pair) const { return entries_.count(pair.data()) != 0; }
+
+    typename QList<Ptr>::const_iterator begin() const { return pairs_.begin(); }
+    typename QList<Ptr>::const_iterator end() const { return pairs_.end(); }
+
+    // returns false if the pair is redundant with a higher one on the list. otherwise a
+    //   lower one it makes redundant is removed
+    bool add(const Ptr &pair)
+    {
+        Q_ASSERT(!contains(pair));
+        Entry e;
+        e.pair = pair;
+        e.key  = Key { pair->local->componentId, pair->local->base, pair->remote->addr };
+        e.rank = Rank { pair->priority, pair->local->componentId, ++seq_, pair.data() };
+
+        auto other = byKey_.value(e.key);
+        if (other) {
+            if (entries_.at(other).rank < e.rank)
+                return false;
+            removeAt(indexOf(other));
+        }
+
+        auto at = std::upper_bound(pairs_.begin(), pairs_.end(), e.rank, [this](const Rank &rank, const Ptr &p) {
+            return rank < entries_.at(p.data()).rank;
+        });
+        pairs_.insert(at, pair);
+        byKey_.insert(e.key, pair.data());
+        states_[int(pair->state)].insert(e.rank);
+        entries_.emplace(pair.data(), e);
+        return true;
+    }
+
+    void removeAt(int index)
+    {
+        Ptr   pair = pairs_.takeAt(index);
+        auto  it   = entries_.find(pair.data());
+        Entry e    = it->second;
+        entries_.erase(it);
+        byKey_.remove(e.key);
+        states_[int(pair->state)].erase(e.rank);
+    }
+
+    bool remove(const Ptr &pair)
+    {
+        int index = indexOf(pair.data());
+        if (index == -1)
+            return false;
+        removeAt(index);
+        return true;
+    }
+
+    // drops the lowest ones
+    void truncate(int count)
+    {
+        while (pairs_.count() > count)
+            removeAt(pairs_.count() - 1);
+    }
+
+    void clear()
+    {
+        pairs_.clear();
+        byKey_.clear();
+        entries_.clear();
+        for (auto &s : states_)
+            s.clear();
+    }
+
+    // the pair on the list for the component, local base and remote address
+    Ptr find(int componentId, const TransportAddress &base, const TransportAddress &remote) const
+    {
+        Pair *pair = byKey_.value(Key { componentId, base, remote });
+        return pair ? entries_.at(pair).pair : Ptr();
+    }
+
+    // any pair may be given, the list is only updated for the ones on it
+    void setState(Pair *pair, State state)
+    {
+        Q_ASSERT(int(state) >= 0 && int(state) < StateCount);
+        if (pair->state == state)
+            return;
+        auto it = entries_.find(pair);
+        if (it != entries_.end()) {
+            states_[int(pair->state)].erase(it->second.rank);
+            states_[int(state)].insert(it->second.rank);
+        }
+        pair->state = state;
+    }
+    void setState(const Ptr &pair, State state) { setState(pair.data(), state); }
+
+    int countIn(State state) const { return int(states_[int(state)].size()); }
+
+    // the highest priority pair in the state
+    Ptr firstIn(State state) const
+    {
+        auto &s = states_[int(state)];
+        return s.empty() ? Ptr() : entries_.at(s.begin()->pair).pair;
+    }
+
+    // the pairs in the state, highest priority first. it's a copy, so states can be changed while going over it
+    QList<Ptr> in(State state) const
+    {
+        QList<Ptr> out;
+        out.reserve(int(states_[int(state)].size()));
+        for (auto &r : states_[int(state)])
+            out += entries_.at(r.pair).pair;
+        return out;
+    }
+
+    // same, but just the ones lower than the priority
+    QList<Ptr> in(State state, qint64 below) const
+    {
+        QList<Ptr> out;
+        auto &     s = states_[int(state)];
+        for (auto it = s.rbegin(); it != s.rend() && it->priority < below; ++it)
+            out.prepend(entries_.at(it->pair).pair);
+        return out;
+    }
+
+private:
+    // what makes pairs redundant
+    struct Key {
+        int              componentId;
+        TransportAddress base;
+        TransportAddress remote;
+
+        bool operator==(const Key &other) const
+        {
+            return componentId == other.componentId && base == other.base && remote == other.remote;
+        }
+        friend uint qHash(const Key &key, uint seed = 0)
+        {
+            return qHash(key.base, seed) ^ qHash(key.remote, seed) ^ uint(key.componentId);
+        }
+    };
+
+    // the order of the list. equal pairs stay in the order they were added
+    struct Rank {
+        qint64  priority;
+        int     componentId;
+        quint64 seq;
+        Pair *  pair;
+
+        bool operator<(const Rank &other) const
+        {
+            if (priority != other.priority)
+                return priority > other.priority;
+            if (componentId != other.componentId)
+                return componentId < other.componentId;
+            return seq < other.seq;
+        }
+    };
+
+    struct Entry {
+        Ptr  pair;
+        Key  key;
+        Rank rank;
+    };
+
+    int indexOf(Pair *pair) const
+    {
+        auto e = entries_.find(pair);
+        if (e == entries_.end())
+            return -1;
+        auto it = std::lower_bound(pairs_.begin(), pairs_.end(), e->second.rank,
+                                   [this](const Ptr &p, const Rank &r) { return entries_.at(p.data()).rank < r; });
+        Q_ASSERT(it != pairs_.end() && it->data() == pair);
+        return int(it - pairs_.begin());
+    }
+
+    QList<Ptr>                        pairs_;
+    QHash<Key, Pair *>                byKey_;
+    std::unordered_map<Pair *, Entry> entries_;
+    std::set<Rank>                    states_[StateCount];
+    quint64                           seq_ = 0;
+};
+} // namespace XMPP
+
+#endif // ICECHECKLIST_H
@@ -26,9 +26,19 @@
 #include "turnclient.h"
 
 #include <QHostAddress>
+#include <QNetworkInterface>
 #include <QUdpSocket>
 #include <QtCrypto>
 
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#endif
+
+#include <memory>
+#include <vector>
+
 // don't queue more incoming packets than this per transmit path
 #define MAX_PACKET_QUEUE 64
 
@@ -39,14 +49,91 @@ enum { Direct, Relayed };
 // SafeUdpSocket
 //----------------------------------------------------------------------------
 // DOR-safe wrapper for QUdpSocket
+//
+// on linux datagrams are read and written in batches with recvmmsg()/sendmmsg() straight on the descriptor,
+//   so a burst costs a few syscalls instead of two or three per datagram.
 class SafeUdpSocket : public QObject {
     Q_OBJECT
 
+public:
+    // datagrams per recvmmsg()/sendmmsg() call, size of a pooled receive buffer and datagrams per readyRead()
+    enum { BatchSize = 16, SlotSize = 9216, ReadLimit = 8 * BatchSize };
+
 private:
     ObjectSession sess;
     QUdpSocket *  sock;
     int           writtenCount;
 
+#ifdef Q_OS_LINUX
+    // allocated on first use and reused for every batch
+    struct BatchPool {
+        std::vector<char> buffer = std::vector<char>(BatchSize * SlotSize);
+        mmsghdr           msgs[BatchSize];
+        iovec             iovs[BatchSize];
+        sockaddr_storage  addrs[BatchSize];
+        sa_family_t       family = AF_UNSPEC; // of the socket
+    };
+    std::unique_ptr<BatchPool> pool;
+
+    BatchPool *batchPool()
+    {
+        if (!pool) {
+            pool.reset(new BatchPool);
+            sockaddr_storage ss;
+            socklen_t        len = sizeof(ss);
+            if (::getsockname(int(sock->socketDescriptor()), reinterpret_cast<sockaddr *>(&ss), &len) == 0)
+                pool->family = ss.ss_family;
+        }
+        return pool.get();
+    }
+
+    // same conversions as QUdpSocket does, so batched datagrams look like the ones read by it
+    static TransportAddress fromSockaddr(const sockaddr_storage &ss)
+    {
+        TransportAddress ta;
+        if (ss.ss_family == AF_INET) {
+            auto sin = reinterpret_cast<const sockaddr_in *>(&ss);
+            ta.addr.setAddress(ntohl(sin->sin_addr.s_addr));
+            ta.port = ntohs(sin->sin_port);
+        } else if (ss.ss_family == AF_INET6) {
+            auto sin6 = reinterpret_cast<const sockaddr_in6 *>(&ss);
+            ta.addr.setAddress(sin6->sin6_addr.s6_addr);
+            if (sin6->sin6_scope_id)
+                ta.addr.setScopeId(QNetworkInterface::interfaceNameFromIndex(int(sin6->sin6_scope_id)));
+            ta.port = ntohs(sin6->sin6_port);
+        }
+        return ta;
+    }
+
+    static bool toSockaddr(const TransportAddress &ta, sa_family_t family, sockaddr_storage &ss, socklen_t &len)
+    {
+        memset(&ss, 0, sizeof(ss));
+        if (family == AF_INET) {
+            if (ta.addr.protocol() != QAbstractSocket::IPv4Protocol)
+                return false;
+            auto sin             = reinterpret_cast<sockaddr_in *>(&ss);
+            sin->sin_family      = AF_INET;
+            sin->sin_port        = htons(ta.port);
+            sin->sin_addr.s_addr = htonl(ta.addr.toIPv4Address());
+            len                  = sizeof(sockaddr_in);
+            return true;
+        }
+        if (family == AF_INET6) {
+            // ipv4 destinations become v4-mapped on dual stack sockets
+            Q_IPV6ADDR ip6    = ta.addr.toIPv6Address();
+            auto       sin6   = reinterpret_cast<sockaddr_in6 *>(&ss);
+            sin6->sin6_family = AF_INET6;
+            sin6->sin6_port   = htons(ta.port);
+            memcpy(sin6->sin6_addr.s6_addr, &ip6, sizeof(ip6));
+            if (!ta.addr.scopeId().isEmpty())
+                sin6->sin6_scope_id = uint32_t(QNetworkInterface::interfaceIndexFromName(ta.addr.scopeId()));
+            len = sizeof(sockaddr_in6);
+            return true;
+        }
+        return false;
+    }
+#endif
+
 public:
     SafeUdpSocket(QUdpSocket *_sock, QObject *parent = nullptr) : QObject(parent), sess(this), sock(_sock)
     {
@@ -93,9 +180,112 @@ public:
         return buf;
     }
 
-    void writeDatagram(const QByteArray &buf, const TransportAddress &address)
+    // returns false if it was not sent, so datagramsWritten() won't count it
+    bool writeDatagram(const QByteArray &buf, const TransportAddress &address)
     {
-        sock->writeDatagram(buf, address.addr, address.port);
+        return sock->writeDatagram(buf, address.addr, address.port) >= 0;
+    }
+
+    // appends up to ReadLimit datagrams to out and returns how many
+    int readDatagrams(QList<IceTransport::Datagram> &out)
+    {
+        // the first one always goes through QUdpSocket. reading from it is what re-enables readyRead(),
+        //   and the rest is drained right after, so nothing that arrives meanwhile is missed
+        if (!sock->hasPendingDatagrams())
+            return 0;
+        IceTransport::Datagram dg;
+        dg.buf = readDatagram(dg.addr);
+        if (dg.buf.isEmpty())
+            return 0;
+        out += dg;
+        int count   = 1;
+        int handled = 1;
+
+#ifdef Q_OS_LINUX
+        BatchPool *p  = batchPool();
+        int        fd = int(sock->socketDescriptor());
+        while (handled < ReadLimit) {
+            for (int i = 0; i < BatchSize; ++i) {
+                p->iovs[i].iov_base = p->buffer.data() + i * SlotSize;
+                p->iovs[i].iov_len  = SlotSize;
+                memset(&p->msgs[i], 0, sizeof(mmsghdr));
+                p->msgs[i].msg_hdr.msg_name    = &p->addrs[i];
+                p->msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                p->msgs[i].msg_hdr.msg_iov     = &p->iovs[i];
+                p->msgs[i].msg_hdr.msg_iovlen  = 1;
+            }
+            int n = ::recvmmsg(fd, p->msgs, BatchSize, MSG_DONTWAIT, nullptr);
+            if (n <= 0) // drained. real errors are reported by QUdpSocket next time
+                break;
+            for (int i = 0; i < n; ++i) {
+                if (p->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    qWarning("SafeUdpSocket: dropped a datagram bigger than %d bytes", int(SlotSize));
+                    continue;
+                }
+                dg.addr = fromSockaddr(p->addrs[i]);
+                dg.buf  = QByteArray(static_cast<const char *>(p->iovs[i].iov_base), int(p->msgs[i].msg_len));
+                out += dg;
+                ++count;
+            }
+            handled += n;
+            if (n < BatchSize)
+                break;
+        }
+#else
+        while (handled++ < ReadLimit && sock->hasPendingDatagrams()) {
+            dg.buf = readDatagram(dg.addr);
+            if (dg.buf.isEmpty())
+                break;
+            out += dg;
+            ++count;
+        }
+#endif
+        return count;
+    }
+
+    // returns how many were sent
+    int writeDatagrams(const QList<QByteArray> &bufs, const TransportAddress &address)
+    {
+#ifdef Q_OS_LINUX
+        BatchPool *      p = batchPool();
+        sockaddr_storage to;
+        socklen_t        tolen;
+        if (bufs.size() > 1 && toSockaddr(address, p->family, to, tolen)) {
+            int fd   = int(sock->socketDescriptor());
+            int sent = 0;
+            while (sent < bufs.size()) {
+                int n = qMin(int(BatchSize), bufs.size() - sent);
+                for (int i = 0; i < n; ++i) {
+                    const QByteArray &buf = bufs[sent + i];
+                    p->iovs[i].iov_base   = const_cast<char *>(buf.constData());
+                    p->iovs[i].iov_len    = size_t(buf.size());
+                    memset(&p->msgs[i], 0, sizeof(mmsghdr));
+                    p->msgs[i].msg_hdr.msg_name    = &to;
+                    p->msgs[i].msg_hdr.msg_namelen = tolen;
+                    p->msgs[i].msg_hdr.msg_iov     = &p->iovs[i];
+                    p->msgs[i].msg_hdr.msg_iovlen  = 1;
+                }
+                int r = ::sendmmsg(fd, p->msgs, unsigned(n), MSG_DONTWAIT);
+                if (r <= 0) // the rest is dropped, just like a failed QUdpSocket::writeDatagram()
+                    break;
+                sent += r;
+                if (r < n)
+                    break;
+            }
+            if (sent) {
+                // QUdpSocket doesn't know about these
+                writtenCount += sent;
+                sess.deferExclusive(this, "processWritten");
+            }
+            return sent;
+        }
+#endif
+        int sent = 0;
+        for (const QByteArray &buf : bufs) {
+            if (writeDatagram(buf, address))
+                ++sent;
+        }
+        return sent;
     }
 
 signals:
@@ -135,6 +325,7 @@ public:
 
         Type             type;
         TransportAddress addr;
+        int              count; // consecutive writes of the same type to the same address
     };
 
     class Written {
@@ -143,12 +334,6 @@ public:
         int              count;
     };
 
-    class Datagram {
-    public:
-        TransportAddress addr;
-        QByteArray       buf;
-    };
-
     IceLocalTransport *      q;
     ObjectSession            sess;
     QUdpSocket *             extSock = nullptr;
@@ -256,6 +441,24 @@ public:
         do_turn();
     }
 
+    void addPendingWrite(WriteItem::Type type, const TransportAddress &to, int count)
+    {
+        if (count <= 0)
+            return;
+        if (!pendingWrites.isEmpty()) {
+            WriteItem &last = pendingWrites.last();
+            if (last.type == type && last.addr == to) {
+                last.count += count;
+                return;
+            }
+        }
+        WriteItem wi;
+        wi.type  = type;
+        wi.addr  = to;
+        wi.count = count;
+        pendingWrites += wi;
+    }
+
     void do_stun()
     {
         if (!stunBindAddr.isValid()) {
@@ -424,19 +627,15 @@ private slots:
     {
         ObjectSessionWatcher watch(&sess);
 
+        QList<Datagram> reads;
         QList<Datagram> dreads; // direct
         QList<Datagram> rreads; // relayed
 
-        while (sock->hasPendingDatagrams()) {
-            TransportAddress from;
-            Datagram         dg;
-
-            QByteArray buf = sock->readDatagram(from);
-            if (buf.isEmpty()) // it's weird we ever came here, but should relax static analyzer
-                break;
-            qDebug("got packet from %s", qPrintable(from));
-            if (from == stunBindAddr || from == stunRelayAddr) {
-                bool haveData = processIncomingStun(buf, from, &dg);
+        sock->readDatagrams(reads);
+        for (const Datagram &rd : qAsConst(reads)) {
+            if (rd.addr == stunBindAddr || rd.addr == stunRelayAddr) {
+                Datagram dg;
+                bool     haveData = processIncomingStun(rd.buf, rd.addr, &dg);
 
                 // processIncomingStun could cause signals to
                 //   emit.  for example, stopped()
@@ -446,9 +645,7 @@ private slots:
                 if (haveData)
                     rreads += dg;
             } else {
-                dg.addr = from;
-                dg.buf  = buf;
-                dreads += dg;
+                dreads += rd;
             }
         }
 
@@ -472,28 +669,35 @@ private slots:
 
         while (count > 0) {
             Q_ASSERT(!pendingWrites.isEmpty());
-            WriteItem wi = pendingWrites.takeFirst();
-            --count;
+            if (pendingWrites.isEmpty())
+                break;
+            WriteItem &wi = pendingWrites.first();
+            int        n  = qMin(count, wi.count);
+            count -= n;
 
             if (wi.type == WriteItem::Direct) {
                 int at = -1;
-                for (int n = 0; n < dwrites.count(); ++n) {
-                    if (dwrites[n].addr == wi.addr) {
-                        at = n;
+                for (int i = 0; i < dwrites.count(); ++i) {
+                    if (dwrites[i].addr == wi.addr) {
+                        at = i;
                         break;
                     }
                 }
 
                 if (at != -1) {
-                    ++dwrites[at].count;
+                    dwrites[at].count += n;
                 } else {
                     Written wr;
                     wr.addr  = wi.addr;
-                    wr.count = 1;
+                    wr.count = n;
                     dwrites += wr;
                 }
             } else if (wi.type == WriteItem::Turn)
-                ++twrites;
+                twrites += n;
+
+            wi.count -= n;
+            if (wi.count == 0)
+                pendingWrites.removeFirst();
         }
 
         if (dwrites.isEmpty() && twrites == 0)
@@ -520,16 +724,14 @@ private slots:
         // warning: read StunTransactionPool docs before modifying
         //   this function
 
-        WriteItem wi;
-        wi.type = WriteItem::Pool;
-        pendingWrites += wi;
         // emit q->debugLine(QString("Sending udp packet from: %1:%2 to: %3:%4")
         //                      .arg(sock->localAddress().toString())
         //                      .arg(sock->localPort())
         //                      .arg(toAddress.toString())
         //                      .arg(toPort));
 
-        sock->writeDatagram(packet, toAddress);
+        if (sock->writeDatagram(packet, toAddress))
+            addPendingWrite(WriteItem::Pool, toAddress, 1);
     }
 
     void pool_needAuthParams(const TransportAddress &addr)
@@ -623,10 +825,8 @@ private slots:
 
     void turn_outgoingDatagram(const QByteArray &buf)
     {
-        WriteItem wi;
-        wi.type = WriteItem::Turn;
-        pendingWrites += wi;
-        sock->writeDatagram(buf, stunRelayAddr);
+        if (sock->writeDatagram(buf, stunRelayAddr))
+            addPendingWrite(WriteItem::Turn, stunRelayAddr, 1);
     }
 
     void turn_debugLine(const QString &line) { emit q->debugLine(line); }
@@ -700,7 +900,7 @@ bool IceLocalTransport::hasPendingDatagrams(int path) const
 
 QByteArray IceLocalTransport::readDatagram(int path, TransportAddress &addr)
 {
-    QList<Private::Datagram> *in = nullptr;
+    QList<Datagram> *in = nullptr;
     if (path == Direct)
         in = &d->in;
     else if (path == Relayed)
@@ -709,21 +909,46 @@ QByteArray IceLocalTransport::readDatagram(int path, TransportAddress &addr)
         Q_ASSERT(0);
 
     if (!in->isEmpty()) {
-        Private::Datagram datagram = in->takeFirst();
-        addr                       = datagram.addr;
+        Datagram datagram = in->takeFirst();
+        addr              = datagram.addr;
         return datagram.buf;
     } else
         return QByteArray();
 }
 
+int IceLocalTransport::readDatagrams(int path, QList<Datagram> &out, int max)
+{
+    QList<Datagram> *in = nullptr;
+    if (path == Direct)
+        in = &d->in;
+    else if (path == Relayed)
+        in = &d->inRelayed;
+    else {
+        Q_ASSERT(0);
+        return 0;
+    }
+
+    if (max >= 0 && max < in->count()) {
+        for (int n = 0; n < max; ++n)
+            out += in->takeFirst();
+        return max;
+    }
+
+    int count = in->count();
+    if (out.isEmpty())
+        out.swap(*in);
+    else {
+        out += *in;
+        in->clear();
+    }
+    return count;
+}
+
 void IceLocalTransport::writeDatagram(int path, const QByteArray &buf, const TransportAddress &addr)
 {
     if (path == Direct) {
-        Private::WriteItem wi;
-        wi.type = Private::WriteItem::Direct;
-        wi.addr = addr;
-        d->pendingWrites += wi;
-        d->sock->writeDatagram(buf, addr);
+        if (d->sock->writeDatagram(buf, addr))
+            d->addPendingWrite(Private::WriteItem::Direct, addr, 1);
     } else if (path == Relayed) {
         if (d->turn && d->turnActivated)
             d->turn->write(buf, addr);
@@ -731,6 +956,19 @@ void IceLocalTransport::writeDatagram(int path, const QByteArray &buf, const Tra
         Q_ASSERT(0);
 }
 
+void IceLocalTransport::writeDatagrams(int path, const QList<QByteArray> &bufs, const TransportAddress &addr)
+{
+    if (path == Direct) {
+        d->addPendingWrite(Private::WriteItem::Direct, addr, d->sock->writeDatagrams(bufs, addr));
+    } else if (path == Relayed) {
+        if (d->turn && d->turnActivated) {
+            for (const QByteArray &buf : bufs)
+                d->turn->write(buf, addr);
+        }
+    } else
+        Q_ASSERT(0);
+}
+
 void IceLocalTransport::setDebugLevel(DebugLevel level)
 {
     d->debugLevel = level;
@@ -743,7 +981,7 @@ void IceLocalTransport::setDebugLevel(DebugLevel level)
 void IceLocalTransport::changeThread(QThread *thread)
 {
     if (d->pool)
-        d->pool->moveToThread(thread);
+        d->pool->changeThread(thread);
     moveToThread(thread);
 }
 
@@ -78,6 +78,8 @@ public:
     bool       hasPendingDatagrams(int path) const override;
     QByteArray readDatagram(int path, TransportAddress &addr) override;
     void       writeDatagram(int path, const QByteArray &buf, const TransportAddress &addr) override;
+    int        readDatagrams(int path, QList<Datagram> &out, int max = -1) override;
+    void       writeDatagrams(int path, const QList<QByteArray> &bufs, const TransportAddress &addr) override;
     void       addChannelPeer(const TransportAddress &addr) override;
     void       setDebugLevel(DebugLevel level) override;
     void       changeThread(QThread *thread) override;
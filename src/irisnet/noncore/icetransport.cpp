@@ -23,4 +23,22 @@ IceTransport::IceTransport(QObject *parent) : QObject(parent) { }
 
 IceTransport::~IceTransport() { }
 
+int IceTransport::readDatagrams(int path, QList<Datagram> &out, int max)
+{
+    int count = 0;
+    while ((max < 0 || count < max) && hasPendingDatagrams(path)) {
+        Datagram dg;
+        dg.buf = readDatagram(path, dg.addr);
+        out += dg;
+        ++count;
+    }
+    return count;
+}
+
+void IceTransport::writeDatagrams(int path, const QList<QByteArray> &bufs, const TransportAddress &addr)
+{
+    for (const QByteArray &buf : bufs)
+        writeDatagram(path, buf, addr);
+}
+
 } // namespace XMPP
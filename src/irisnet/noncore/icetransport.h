@@ -19,14 +19,16 @@
 #ifndef ICETRANSPORT_H
 #define ICETRANSPORT_H
 
+#include "transportaddress.h"
+
 #include <QByteArray>
+#include <QList>
 #include <QObject>
 #include <QWeakPointer>
 
 class QHostAddress;
 
 namespace XMPP {
-class TransportAddress;
 class IceTransport : public QObject {
     Q_OBJECT
 
@@ -35,6 +37,12 @@ public:
 
     enum DebugLevel { DL_None, DL_Info, DL_Packet };
 
+    class Datagram {
+    public:
+        TransportAddress addr;
+        QByteArray       buf;
+    };
+
     IceTransport(QObject *parent = nullptr);
     ~IceTransport();
 
@@ -45,6 +53,12 @@ public:
     virtual void       writeDatagram(int path, const QByteArray &buf, const TransportAddress &addr) = 0;
     virtual void       addChannelPeer(const TransportAddress &addr)                                 = 0;
 
+    // batched variants of the above. the default implementations just loop.
+    // readDatagrams() appends up to max pending datagrams (all if max < 0) to out and returns how many.
+    // writeDatagrams() sends all of bufs to addr. they are reported by datagramsWritten() as usual
+    virtual int  readDatagrams(int path, QList<Datagram> &out, int max = -1);
+    virtual void writeDatagrams(int path, const QList<QByteArray> &bufs, const TransportAddress &addr);
+
     virtual void setDebugLevel(DebugLevel level) = 0;
     virtual void changeThread(QThread *thread)   = 0;
 
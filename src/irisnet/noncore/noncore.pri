@@ -29,8 +29,10 @@ HEADERS += \
     $$PWD/icelocaltransport.h \
     $$PWD/iceturntransport.h \
     $$PWD/icecomponent.h \
+    $$PWD/icechecklist.h \
     $$PWD/ice176.h \
-    $$PWD/tcpportreserver.h
+    $$PWD/tcpportreserver.h \
+    $$PWD/timerwheel.h
 
 SOURCES += \
     $$PWD/dtls.cpp \
@@ -49,7 +51,8 @@ SOURCES += \
     $$PWD/iceturntransport.cpp \
     $$PWD/icecomponent.cpp \
     $$PWD/ice176.cpp \
-    $$PWD/tcpportreserver.cpp
+    $$PWD/tcpportreserver.cpp \
+    $$PWD/timerwheel.cpp
 
 INCLUDEPATH += $$PWD/legacy
 include(legacy/legacy.pri)
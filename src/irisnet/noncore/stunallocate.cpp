@@ -23,10 +23,10 @@
 #include "stuntransaction.h"
 #include "stuntypes.h"
 #include "stunutil.h"
+#include "timerwheel.h"
 
 #include <QHostAddress>
 #include <QMetaType>
-#include <QTimer>
 #include <QtCrypto>
 
 // permissions last 5 minutes, update them every 4 minutes
@@ -36,13 +36,6 @@
 #define CHAN_INTERVAL (9 * 60 * 1000)
 
 namespace XMPP {
-void releaseAndDeleteLater(QObject *owner, QObject *obj)
-{
-    obj->disconnect(owner);
-    obj->setParent(nullptr);
-    obj->deleteLater();
-}
-
 // return size of channelData packet, or -1
 static int check_channelData(const quint8 *data, int size)
 {
@@ -74,7 +67,7 @@ class StunAllocatePermission : public QObject {
     Q_OBJECT
 
 public:
-    QTimer *                 timer;
+    TimerWheel::Timer        timer;
     StunTransactionPool::Ptr pool;
     StunTransaction *        trans;
     TransportAddress         stunAddr;
@@ -86,18 +79,14 @@ public:
     StunAllocatePermission(StunTransactionPool::Ptr _pool, const QHostAddress &_addr) :
         QObject(_pool.data()), pool(_pool), trans(nullptr), addr(_addr), active(false)
     {
-        timer = new QTimer(this);
-        connect(timer, &QTimer::timeout, this, &StunAllocatePermission::timer_timeout);
-        timer->setSingleShot(true);
-        timer->setInterval(PERM_INTERVAL);
+        timer.setCallback([this]() { timer_timeout(); });
+        timer.setContext(this);
+        timer.setSingleShot(true);
+        timer.setInterval(PERM_INTERVAL);
     }
 
     ~StunAllocatePermission()
-    {
-        cleanup();
-
-        releaseAndDeleteLater(this, timer);
-    }
+    { cleanup(); }
 
     void start(const TransportAddress &_addr)
     {
@@ -134,7 +123,7 @@ private:
         delete trans;
         trans = nullptr;
 
-        timer->stop();
+        timer.stop();
 
         active = false;
     }
@@ -149,7 +138,7 @@ private:
         trans->start(pool.data(), stunAddr);
     }
 
-    void restartTimer() { timer->start(); }
+    void restartTimer() { timer.start(); }
 
 private slots:
     void trans_createMessage(const QByteArray &transactionId)
@@ -233,7 +222,7 @@ class StunAllocateChannel : public QObject {
     Q_OBJECT
 
 public:
-    QTimer *                 timer;
+    TimerWheel::Timer        timer;
     StunTransactionPool::Ptr pool;
     StunTransaction *        trans = nullptr;
     TransportAddress         stunAddr;
@@ -246,18 +235,14 @@ public:
     StunAllocateChannel(StunTransactionPool::Ptr _pool, int _channelId, const TransportAddress &_addr) :
         QObject(_pool.data()), pool(_pool), trans(nullptr), channelId(_channelId), addr(_addr), active(false)
     {
-        timer = new QTimer(this);
-        connect(timer, &QTimer::timeout, this, &StunAllocateChannel::timer_timeout);
-        timer->setSingleShot(true);
-        timer->setInterval(CHAN_INTERVAL);
+        timer.setCallback([this]() { timer_timeout(); });
+        timer.setContext(this);
+        timer.setSingleShot(true);
+        timer.setInterval(CHAN_INTERVAL);
     }
 
     ~StunAllocateChannel()
-    {
-        cleanup();
-
-        releaseAndDeleteLater(this, timer);
-    }
+    { cleanup(); }
 
     void start(const TransportAddress &_addr)
     {
@@ -294,7 +279,7 @@ private:
         delete trans;
         trans = nullptr;
 
-        timer->stop();
+        timer.stop();
 
         channelId = -1;
         active    = false;
@@ -310,7 +295,7 @@ private:
         trans->start(pool.data(), stunAddr);
     }
 
-    void restartTimer() { timer->start(); }
+    void restartTimer() { timer.start(); }
 
 private slots:
     void trans_createMessage(const QByteArray &transactionId)
@@ -420,7 +405,7 @@ public:
     TransportAddress                reflexiveAddress, relayedAddress;
     StunMessage                     msg;
     int                             allocateLifetime;
-    QTimer *                        allocateRefreshTimer;
+    TimerWheel::Timer               allocateRefreshTimer;
     QList<StunAllocatePermission *> perms;
     QList<StunAllocateChannel *>    channels;
     QList<QHostAddress>             permQueue;
@@ -433,17 +418,12 @@ public:
         QObject(_q), q(_q), sess(this), pool(nullptr), trans(nullptr), state(Stopped), dfState(DF_Unknown),
         erroringCode(-1)
     {
-        allocateRefreshTimer = new QTimer(this);
-        connect(allocateRefreshTimer, &QTimer::timeout, this, &Private::refresh);
-        allocateRefreshTimer->setSingleShot(true);
+        allocateRefreshTimer.setCallback([this]() { refresh(); });
+        allocateRefreshTimer.setContext(this);
+        allocateRefreshTimer.setSingleShot(true);
     }
 
-    ~Private()
-    {
-        cleanup();
-
-        releaseAndDeleteLater(this, allocateRefreshTimer);
-    }
+    ~Private() { cleanup(); }
 
     void start(const TransportAddress &_addr = TransportAddress())
     {
@@ -699,7 +679,7 @@ private:
         delete trans;
         trans = nullptr;
 
-        allocateRefreshTimer->stop();
+        allocateRefreshTimer.stop();
 
         qDeleteAll(channels);
         channels.clear();
@@ -723,7 +703,7 @@ private:
     void restartRefreshTimer()
     {
         // refresh 1 minute shy of the lifetime
-        allocateRefreshTimer->start((allocateLifetime - 60) * 1000);
+        allocateRefreshTimer.start((allocateLifetime - 60) * 1000);
     }
 
     bool updatePermsOut()
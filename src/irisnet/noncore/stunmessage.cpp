@@ -18,11 +18,19 @@
 
 #include "stunmessage.h"
 
+#include "stuntypes.h"
 #include "stunutil.h"
+#include "transportaddress.h"
 
 #include <QSharedData>
 #include <QtCrypto>
 
+#ifdef __ARM_FEATURE_CRC32
+#include <arm_acle.h>
+#endif
+
+#include <memory>
+
 #define ENSURE_D                                                                                                       \
     {                                                                                                                  \
         if (!d)                                                                                                        \
@@ -35,61 +43,63 @@ using namespace StunUtil;
 // some attribute types we need to explicitly support
 enum { AttribMessageIntegrity = 0x0008, AttribFingerprint = 0x8028 };
 
-// adapted from public domain source by Ross Williams and Eric Durbin
-unsigned long crctable[256] = {
-    0x00000000L, 0x77073096L, 0xEE0E612CL, 0x990951BAL, 0x076DC419L, 0x706AF48FL, 0xE963A535L, 0x9E6495A3L, 0x0EDB8832L,
-    0x79DCB8A4L, 0xE0D5E91EL, 0x97D2D988L, 0x09B64C2BL, 0x7EB17CBDL, 0xE7B82D07L, 0x90BF1D91L, 0x1DB71064L, 0x6AB020F2L,
-    0xF3B97148L, 0x84BE41DEL, 0x1ADAD47DL, 0x6DDDE4EBL, 0xF4D4B551L, 0x83D385C7L, 0x136C9856L, 0x646BA8C0L, 0xFD62F97AL,
-    0x8A65C9ECL, 0x14015C4FL, 0x63066CD9L, 0xFA0F3D63L, 0x8D080DF5L, 0x3B6E20C8L, 0x4C69105EL, 0xD56041E4L, 0xA2677172L,
-    0x3C03E4D1L, 0x4B04D447L, 0xD20D85FDL, 0xA50AB56BL, 0x35B5A8FAL, 0x42B2986CL, 0xDBBBC9D6L, 0xACBCF940L, 0x32D86CE3L,
-    0x45DF5C75L, 0xDCD60DCFL, 0xABD13D59L, 0x26D930ACL, 0x51DE003AL, 0xC8D75180L, 0xBFD06116L, 0x21B4F4B5L, 0x56B3C423L,
-    0xCFBA9599L, 0xB8BDA50FL, 0x2802B89EL, 0x5F058808L, 0xC60CD9B2L, 0xB10BE924L, 0x2F6F7C87L, 0x58684C11L, 0xC1611DABL,
-    0xB6662D3DL, 0x76DC4190L, 0x01DB7106L, 0x98D220BCL, 0xEFD5102AL, 0x71B18589L, 0x06B6B51FL, 0x9FBFE4A5L, 0xE8B8D433L,
-    0x7807C9A2L, 0x0F00F934L, 0x9609A88EL, 0xE10E9818L, 0x7F6A0DBBL, 0x086D3D2DL, 0x91646C97L, 0xE6635C01L, 0x6B6B51F4L,
-    0x1C6C6162L, 0x856530D8L, 0xF262004EL, 0x6C0695EDL, 0x1B01A57BL, 0x8208F4C1L, 0xF50FC457L, 0x65B0D9C6L, 0x12B7E950L,
-    0x8BBEB8EAL, 0xFCB9887CL, 0x62DD1DDFL, 0x15DA2D49L, 0x8CD37CF3L, 0xFBD44C65L, 0x4DB26158L, 0x3AB551CEL, 0xA3BC0074L,
-    0xD4BB30E2L, 0x4ADFA541L, 0x3DD895D7L, 0xA4D1C46DL, 0xD3D6F4FBL, 0x4369E96AL, 0x346ED9FCL, 0xAD678846L, 0xDA60B8D0L,
-    0x44042D73L, 0x33031DE5L, 0xAA0A4C5FL, 0xDD0D7CC9L, 0x5005713CL, 0x270241AAL, 0xBE0B1010L, 0xC90C2086L, 0x5768B525L,
-    0x206F85B3L, 0xB966D409L, 0xCE61E49FL, 0x5EDEF90EL, 0x29D9C998L, 0xB0D09822L, 0xC7D7A8B4L, 0x59B33D17L, 0x2EB40D81L,
-    0xB7BD5C3BL, 0xC0BA6CADL, 0xEDB88320L, 0x9ABFB3B6L, 0x03B6E20CL, 0x74B1D29AL, 0xEAD54739L, 0x9DD277AFL, 0x04DB2615L,
-    0x73DC1683L, 0xE3630B12L, 0x94643B84L, 0x0D6D6A3EL, 0x7A6A5AA8L, 0xE40ECF0BL, 0x9309FF9DL, 0x0A00AE27L, 0x7D079EB1L,
-    0xF00F9344L, 0x8708A3D2L, 0x1E01F268L, 0x6906C2FEL, 0xF762575DL, 0x806567CBL, 0x196C3671L, 0x6E6B06E7L, 0xFED41B76L,
-    0x89D32BE0L, 0x10DA7A5AL, 0x67DD4ACCL, 0xF9B9DF6FL, 0x8EBEEFF9L, 0x17B7BE43L, 0x60B08ED5L, 0xD6D6A3E8L, 0xA1D1937EL,
-    0x38D8C2C4L, 0x4FDFF252L, 0xD1BB67F1L, 0xA6BC5767L, 0x3FB506DDL, 0x48B2364BL, 0xD80D2BDAL, 0xAF0A1B4CL, 0x36034AF6L,
-    0x41047A60L, 0xDF60EFC3L, 0xA867DF55L, 0x316E8EEFL, 0x4669BE79L, 0xCB61B38CL, 0xBC66831AL, 0x256FD2A0L, 0x5268E236L,
-    0xCC0C7795L, 0xBB0B4703L, 0x220216B9L, 0x5505262FL, 0xC5BA3BBEL, 0xB2BD0B28L, 0x2BB45A92L, 0x5CB36A04L, 0xC2D7FFA7L,
-    0xB5D0CF31L, 0x2CD99E8BL, 0x5BDEAE1DL, 0x9B64C2B0L, 0xEC63F226L, 0x756AA39CL, 0x026D930AL, 0x9C0906A9L, 0xEB0E363FL,
-    0x72076785L, 0x05005713L, 0x95BF4A82L, 0xE2B87A14L, 0x7BB12BAEL, 0x0CB61B38L, 0x92D28E9BL, 0xE5D5BE0DL, 0x7CDCEFB7L,
-    0x0BDBDF21L, 0x86D3D2D4L, 0xF1D4E242L, 0x68DDB3F8L, 0x1FDA836EL, 0x81BE16CDL, 0xF6B9265BL, 0x6FB077E1L, 0x18B74777L,
-    0x88085AE6L, 0xFF0F6A70L, 0x66063BCAL, 0x11010B5CL, 0x8F659EFFL, 0xF862AE69L, 0x616BFFD3L, 0x166CCF45L, 0xA00AE278L,
-    0xD70DD2EEL, 0x4E048354L, 0x3903B3C2L, 0xA7672661L, 0xD06016F7L, 0x4969474DL, 0x3E6E77DBL, 0xAED16A4AL, 0xD9D65ADCL,
-    0x40DF0B66L, 0x37D83BF0L, 0xA9BCAE53L, 0xDEBB9EC5L, 0x47B2CF7FL, 0x30B5FFE9L, 0xBDBDF21CL, 0xCABAC28AL, 0x53B39330L,
-    0x24B4A3A6L, 0xBAD03605L, 0xCDD70693L, 0x54DE5729L, 0x23D967BFL, 0xB3667A2EL, 0xC4614AB8L, 0x5D681B02L, 0x2A6F2B94L,
-    0xB40BBE37L, 0xC30C8EA1L, 0x5A05DF1BL, 0x2D02EF8DL
-};
-
+// crc-32 as used by the fingerprint attribute (reflected 0x04C11DB7).
+// with armv8 crc instructions available at build time those are used. otherwise it's slice-by-8: eight bytes per
+//   step through eight derived tables. stun messages are a few hundred bytes at most, too short for carry-less
+//   multiplication folding to pay off
 class Crc32 {
 private:
-    quint32 result;
-
-public:
-    Crc32() { clear(); }
-
-    void clear() { result = 0xffffffff; }
+    struct Tables {
+        quint32 t[8][256];
+
+        Tables()
+        {
+            for (quint32 n = 0; n < 256; ++n) {
+                quint32 c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+                t[0][n] = c;
+            }
+            for (int k = 1; k < 8; ++k) {
+                for (int n = 0; n < 256; ++n)
+                    t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xff];
+            }
+        }
+    };
 
-    void update(const QByteArray &in)
+#ifndef __ARM_FEATURE_CRC32
+    static const Tables &tables()
     {
-        for (int n = 0; n < in.size(); ++n)
-            result = (result >> 8) ^ (crctable[(result & 0xff) ^ (quint8)in[n]]);
+        static const Tables tables;
+        return tables;
     }
+#endif
 
-    quint32 final() { return result ^= 0xffffffff; }
-
-    static quint32 process(const QByteArray &in)
+public:
+    static quint32 process(const quint8 *p, int size)
     {
-        Crc32 c;
-        c.update(in);
-        return c.final();
+        quint32 crc = 0xffffffff;
+#ifdef __ARM_FEATURE_CRC32
+        for (; size >= 8; p += 8, size -= 8) {
+            quint64 v;
+            memcpy(&v, p, 8);
+            crc = __crc32d(crc, v);
+        }
+        for (; size > 0; ++p, --size)
+            crc = __crc32b(crc, *p);
+#else
+        const Tables &tab = tables();
+        for (; size >= 8; p += 8, size -= 8) {
+            quint32 one = crc ^ (quint32(p[0]) | quint32(p[1]) << 8 | quint32(p[2]) << 16 | quint32(p[3]) << 24);
+            quint32 two = quint32(p[4]) | quint32(p[5]) << 8 | quint32(p[6]) << 16 | quint32(p[7]) << 24;
+            crc         = tab.t[7][one & 0xff] ^ tab.t[6][(one >> 8) & 0xff] ^ tab.t[5][(one >> 16) & 0xff]
+                ^ tab.t[4][one >> 24] ^ tab.t[3][two & 0xff] ^ tab.t[2][(two >> 8) & 0xff]
+                ^ tab.t[1][(two >> 16) & 0xff] ^ tab.t[0][two >> 24];
+        }
+        for (; size > 0; ++p, --size)
+            crc = (crc >> 8) ^ tab.t[0][(crc ^ *p) & 0xff];
+#endif
+        return crc ^ 0xffffffff;
     }
 };
 
@@ -145,19 +155,18 @@ static quint16 round_up_length(quint16 in)
     return out;
 }
 
-// buf    = entire stun packet
+// p      = entire stun packet
+// size   = where the attributes end
 // offset = byte index of current attribute (first is offset=20)
 // type   = take attribute type
 // len    = take attribute value length (value is at offset + 4)
 // returns offset of next attribute, -1 if no more
-static int get_attribute_props(const QByteArray &buf, int offset, quint16 *type, int *len)
+static int get_attribute_props(const quint8 *p, int size, int offset, quint16 *type, int *len)
 {
     Q_ASSERT(offset >= ATTRIBUTE_AREA_START);
 
-    const quint8 *p = (const quint8 *)buf.data();
-
     // need at least 4 bytes for an attribute
-    if (offset + 4 > buf.size())
+    if (offset + 4 > size)
         return -1;
 
     quint16 _type = read16(p + offset);
@@ -168,7 +177,7 @@ static int get_attribute_props(const QByteArray &buf, int offset, quint16 *type,
     // get physical length.  stun attributes are 4-byte aligned, and may
     //   contain 0-3 bytes of padding.
     quint16 plen = round_up_length(_alen);
-    if (offset + plen > buf.size())
+    if (offset + plen > size)
         return -1;
 
     *type = _type;
@@ -176,12 +185,13 @@ static int get_attribute_props(const QByteArray &buf, int offset, quint16 *type,
     return offset + plen;
 }
 
-// buf    = entire stun packet
+// p      = entire stun packet
+// size   = where the attributes end
 // type   = attribute type to find
 // len    = take attribute value length (value is at offset + 4)
 // next   = take offset of next attribute
 // returns offset of found attribute, -1 if not found
-static int find_attribute(const QByteArray &buf, quint16 type, int *len, int *next = nullptr)
+static int find_attribute(const quint8 *p, int size, quint16 type, int *len, int *next = nullptr)
 {
     int     at = ATTRIBUTE_AREA_START;
     quint16 _type;
@@ -189,7 +199,7 @@ static int find_attribute(const QByteArray &buf, quint16 type, int *len, int *ne
     int     _next;
 
     while (1) {
-        _next = get_attribute_props(buf, at, &_type, &_len);
+        _next = get_attribute_props(p, size, at, &_type, &_len);
         if (_next == -1)
             break;
         if (_type == type) {
@@ -235,81 +245,138 @@ static int append_attribute_uninitialized(QByteArray *buf, quint16 type, int len
     return at;
 }
 
-static quint32 fingerprint_calc(const quint8 *buf, int size)
-{
-    QByteArray region = QByteArray::fromRawData((const char *)buf, size);
-    return Crc32::process(region) ^ 0x5354554e;
-}
+static quint32 fingerprint_calc(const quint8 *buf, int size) { return Crc32::process(buf, size) ^ 0x5354554e; }
 
-static QByteArray message_integrity_calc(const quint8 *buf, int size, const QByteArray &key)
+static QByteArray message_integrity_calc(const quint8 *buf, int size, const StunMessage::IntegrityKey &key)
 {
-    QCA::MessageAuthenticationCode hmac("hmac(sha1)", key);
-    QByteArray                     region = QByteArray::fromRawData((const char *)buf, size);
-    QByteArray                     result = hmac.process(region).toByteArray();
+    QByteArray result = key.mac(buf, size);
     Q_ASSERT(result.size() == 20);
     return result;
 }
 
 // look for fingerprint attribute and confirm it
-// buf = entire stun packet
+// p    = entire stun packet
+// size = where the attributes end
 // returns true if fingerprint attribute exists and is correct
-static bool fingerprint_check(const QByteArray &buf)
+static bool fingerprint_check(const quint8 *p, int size)
 {
     int at, len;
-    at = find_attribute(buf, AttribFingerprint, &len);
+    at = find_attribute(p, size, AttribFingerprint, &len);
     if (at == -1 || len != 4) // value must be 4 bytes
         return false;
 
-    const quint8 *p      = (const quint8 *)buf.data();
-    quint32       fpval  = read32(p + at + 4);
-    quint32       fpcalc = fingerprint_calc(p, at);
+    quint32 fpval  = read32(p + at + 4);
+    quint32 fpcalc = fingerprint_calc(p, at);
     return fpval == fpcalc;
 }
 
-// copy the input buffer and prepare for message integrity checking.  the
-//   packet is truncated after the message-integrity attribute (since nothing
-//   after it is protected), and the packet length is adjusted in the header
-//   accordingly.
-// buf    = input stun packet
-// out    = take output stun packet
-// offset = take offset of message-integrity attribute
-// returns true if message-integrity attribute exists and packet is prepared
-// note: message-integrity value is at offset + 4 and is exactly 20 bytes
-static bool message_integrity_prep(const QByteArray &buf, QByteArray *out, int *offset)
+// confirm message integrity.  nothing after the message-integrity attribute
+//   is protected, so the hmac covers the packet up to it, with the packet
+//   length in the header as if the packet ended right after it.  the packet
+//   itself is left alone.
+// p    = entire stun packet
+// size = where the attributes end
+// key  = the HMAC key
+// end  = take offset following the message-integrity attribute
+// returns true if message-integrity attribute exists and is correct
+static bool message_integrity_check(const quint8 *p, int size, const StunMessage::IntegrityKey &key, int *end)
 {
     int at, len, next;
-    at = find_attribute(buf, AttribMessageIntegrity, &len, &next);
+    at = find_attribute(p, size, AttribMessageIntegrity, &len, &next);
     if (at == -1 || len != 20) // value must be 20 bytes
         return false;
 
-    // prepare new attribute area size
-    int i = next - ATTRIBUTE_AREA_START;
-
-    // new value must be divisible by 4
-    if (i % 4 != 0)
+    QByteArray micalc = key.mac(p, at, quint16(next - ATTRIBUTE_AREA_START));
+    Q_ASSERT(micalc.size() == 20);
+    if (memcmp(p + at + 4, micalc.data(), 20) != 0)
         return false;
 
-    // copy truncated packet
-    *out = buf.mid(0, next);
+    *end = next;
+    return true;
+}
+
+static StunMessage::Class class_from_type(const quint8 *p)
+{
+    // class bits are split into 2 sections
+    quint8 c1, c2;
+    c1 = quint8(p[0] & 0x01); // C1
+    c1 <<= 1;
+    c2 = quint8(p[1] & 0x10); // C0
+    c2 >>= 4;
 
-    // set new length in header
-    quint16 newlen = (quint16)i;
-    write16((quint8 *)out->data() + 2, newlen);
+    quint8 classbits = c1 | c2;
 
-    *offset = at;
-    return true;
+    if (classbits == 0) // 00
+        return StunMessage::Request;
+    else if (classbits == 1) // 01
+        return StunMessage::Indication;
+    else if (classbits == 2) // 10
+        return StunMessage::SuccessResponse;
+    else // 11
+        return StunMessage::ErrorResponse;
+}
+
+static quint16 method_from_type(const quint8 *p)
+{
+    // method bits are split into 3 sections
+    quint16 m1, m2, m3;
+    m1 = quint16(p[0] & 0x3e); // M7-11
+    m1 <<= 6;
+    m2 = quint16(p[1] & 0xe0); // M4-6
+    m2 >>= 1;
+    m3 = quint16(p[1] & 0x0f); // M0-3
+
+    return m1 | m2 | m3;
 }
 
-// confirm message integrity
-// buf    = prepared stun packet (from message_integrity_prep())
-// offset = offset of message-integrity attribute
-// key    = the HMAC key
-// returns true if correct
-static bool message_integrity_check(const QByteArray &buf, int offset, const QByteArray &key)
+class StunMessage::IntegrityKey::Private {
+public:
+    QByteArray                                      key;
+    std::unique_ptr<QCA::MessageAuthenticationCode> hmac; // created on first use
+
+    QCA::MessageAuthenticationCode &start()
+    {
+        // clear() sets the same key up again, skipping the provider lookup and the allocations of a new object
+        if (!hmac)
+            hmac.reset(new QCA::MessageAuthenticationCode("hmac(sha1)", key));
+        else
+            hmac->clear();
+        return *hmac;
+    }
+};
+
+static QByteArray raw_bytes(const quint8 *buf, int size)
+{
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(buf), size);
+}
+
+StunMessage::IntegrityKey::IntegrityKey() : d(new Private) { }
+
+StunMessage::IntegrityKey::IntegrityKey(const QByteArray &key) : d(new Private) { d->key = key; }
+
+bool StunMessage::IntegrityKey::isEmpty() const { return d->key.isEmpty(); }
+
+const QByteArray &StunMessage::IntegrityKey::key() const { return d->key; }
+
+QByteArray StunMessage::IntegrityKey::mac(const quint8 *buf, int size) const
 {
-    QByteArray mival  = QByteArray::fromRawData(buf.data() + offset + 4, 20);
-    QByteArray micalc = message_integrity_calc((const quint8 *)buf.data(), offset, key);
-    return mival == micalc;
+    QCA::MessageAuthenticationCode &hmac = d->start();
+    hmac.update(raw_bytes(buf, size));
+    return hmac.final().toByteArray();
+}
+
+QByteArray StunMessage::IntegrityKey::mac(const quint8 *buf, int size, quint16 length) const
+{
+    Q_ASSERT(size >= 4);
+
+    quint8 len[2];
+    write16(len, length);
+
+    QCA::MessageAuthenticationCode &hmac = d->start();
+    hmac.update(raw_bytes(buf, 2));
+    hmac.update(raw_bytes(len, 2));
+    hmac.update(raw_bytes(buf + 4, size - 4));
+    return hmac.final().toByteArray();
 }
 
 class StunMessage::Private : public QSharedData {
@@ -320,6 +387,12 @@ public:
     quint8             id[12];
     QList<Attribute>   attribs;
 
+    // a message from a view reads its attributes from the packet until they're set
+    QByteArray packet;
+    int        packetEnd = 0;
+
+    const quint8 *packetData() const { return reinterpret_cast<const quint8 *>(packet.constData()); }
+
     Private()
     {
         mclass = (StunMessage::Class)-1;
@@ -370,13 +443,43 @@ const quint8 *StunMessage::id() const
 QList<StunMessage::Attribute> StunMessage::attributes() const
 {
     Q_ASSERT(d);
-    return d->attribs;
+    if (!d->packetEnd)
+        return d->attribs;
+
+    const quint8 *   p = d->packetData();
+    QList<Attribute> list;
+    int              at = ATTRIBUTE_AREA_START;
+    while (1) {
+        quint16 type;
+        int     len;
+        int     next;
+
+        next = get_attribute_props(p, d->packetEnd, at, &type, &len);
+        if (next == -1)
+            break;
+
+        Attribute attrib;
+        attrib.type  = type;
+        attrib.value = QByteArray(reinterpret_cast<const char *>(p + at + 4), len);
+        list += attrib;
+
+        at = next;
+    }
+    return list;
 }
 
 QByteArray StunMessage::attribute(quint16 type) const
 {
     Q_ASSERT(d);
 
+    if (d->packetEnd) {
+        int len;
+        int at = find_attribute(d->packetData(), d->packetEnd, type, &len);
+        if (at == -1)
+            return QByteArray();
+        return QByteArray(reinterpret_cast<const char *>(d->packetData() + at + 4), len);
+    }
+
     for (const Attribute &i : d->attribs) {
         if (i.type == type)
             return i.value;
@@ -388,6 +491,11 @@ bool StunMessage::hasAttribute(quint16 type) const
 {
     Q_ASSERT(d);
 
+    if (d->packetEnd) {
+        int len;
+        return find_attribute(d->packetData(), d->packetEnd, type, &len) != -1;
+    }
+
     for (const Attribute &i : d->attribs) {
         if (i.type == type)
             return true;
@@ -423,15 +531,38 @@ void StunMessage::setAttributes(const QList<Attribute> &attribs)
 {
     ENSURE_D
     d->attribs = attribs;
+    d->packet.clear();
+    d->packetEnd = 0;
 }
 
 QByteArray StunMessage::toBinary(int validationFlags, const QByteArray &key) const
+{
+    return toBinary(validationFlags, IntegrityKey(key));
+}
+
+QByteArray StunMessage::toBinary(int validationFlags, const IntegrityKey &key) const
 {
     Q_ASSERT(d);
 
+    const QList<Attribute> attribs = attributes();
+
+    // the size is known up front, so everything is written into one allocation
+    int size = ATTRIBUTE_AREA_START;
+    for (const Attribute &i : attribs) {
+        if (i.value.size() > ATTRIBUTE_VALUE_MAX)
+            return QByteArray();
+        size += 4 + round_up_length(quint16(i.value.size()));
+    }
+    if (validationFlags & MessageIntegrity)
+        size += 4 + 20;
+    if (validationFlags & Fingerprint)
+        size += 4 + 4;
+
     // header
-    QByteArray buf(20, 0);
-    quint8 *   p = (quint8 *)buf.data();
+    QByteArray buf;
+    buf.reserve(size);
+    buf.resize(20);
+    quint8 *p = (quint8 *)buf.data();
 
     quint8 classbits = 0;
     if (d->mclass == Request)
@@ -466,7 +597,7 @@ QByteArray StunMessage::toBinary(int validationFlags, const QByteArray &key) con
     memcpy(p + 4, d->magic, 4);
     memcpy(p + 8, d->id, 12);
 
-    for (const Attribute &i : d->attribs) {
+    for (const Attribute &i : attribs) {
         int at = append_attribute_uninitialized(&buf, i.type, i.value.size());
         if (at == -1)
             return QByteArray();
@@ -518,143 +649,195 @@ QByteArray StunMessage::toBinary(int validationFlags, const QByteArray &key) con
 StunMessage StunMessage::fromBinary(const QByteArray &a, ConvertResult *result, int validationFlags,
                                     const QByteArray &key)
 {
-    int mlen = check_and_get_length(a);
-    if (mlen == -1) {
-        if (result)
-            *result = ErrorFormat;
-        return StunMessage();
-    }
+    return fromBinary(a, result, validationFlags, IntegrityKey(key));
+}
 
-    if (validationFlags & Fingerprint) {
-        if (!fingerprint_check(a)) {
-            if (result)
-                *result = ErrorFingerprint;
-            return StunMessage();
-        }
+StunMessage StunMessage::fromBinary(const QByteArray &a, ConvertResult *result, int validationFlags,
+                                    const IntegrityKey &key)
+{
+    StunMessageView view(a);
+    ConvertResult   r = view.isValid() ? view.validate(validationFlags, key) : ErrorFormat;
+    if (result)
+        *result = r;
+    return r == ConvertGood ? view.toMessage() : StunMessage();
+}
+
+bool StunMessage::isProbablyStun(const QByteArray &a) { return check_and_get_length(a) != -1; }
+
+StunMessage::Class StunMessage::extractClass(const QByteArray &in)
+{
+    return class_from_type((const quint8 *)in.data());
+}
+
+bool StunMessage::containsStun(const quint8 *data, int size)
+{
+    // check_and_get_length does a full packet check so it works even on a stream
+    return check_and_get_length(QByteArray::fromRawData((const char *)data, size)) != -1;
+}
+
+QByteArray StunMessage::readStun(const quint8 *data, int size)
+{
+    QByteArray in   = QByteArray::fromRawData((const char *)data, size);
+    int        mlen = check_and_get_length(in);
+    if (mlen != -1)
+        return QByteArray((const char *)data, mlen + 20);
+    else
+        return QByteArray();
+}
+
+//----------------------------------------------------------------------------
+// StunMessageView
+//----------------------------------------------------------------------------
+StunMessageView::StunMessageView(const QByteArray &_packet)
+{
+    int mlen = check_and_get_length(_packet);
+    if (mlen != -1) {
+        packet = _packet;
+        end    = ATTRIBUTE_AREA_START + mlen;
     }
+}
 
-    QByteArray in;
+static const quint8 *view_data(const QByteArray &packet)
+{
+    return reinterpret_cast<const quint8 *>(packet.constData());
+}
 
-    if (validationFlags & MessageIntegrity) {
-        int offset;
-        if (!message_integrity_prep(a, &in, &offset)) {
-            if (result)
-                *result = ErrorMessageIntegrity;
-            return StunMessage();
-        }
+bool StunMessageView::checkFingerprint() const
+{
+    Q_ASSERT(isValid());
+    return fingerprint_check(view_data(packet), end);
+}
 
-        if (!message_integrity_check(in, offset, key)) {
-            if (result)
-                *result = ErrorMessageIntegrity;
-            return StunMessage();
-        }
-    } else
-        in = a;
+bool StunMessageView::checkMessageIntegrity(const StunMessage::IntegrityKey &key)
+{
+    Q_ASSERT(isValid());
+    return message_integrity_check(view_data(packet), end, key, &end);
+}
 
-    // all validating complete, now just parse the packet
+StunMessage::ConvertResult StunMessageView::validate(int validationFlags, const StunMessage::IntegrityKey &key)
+{
+    // the fingerprint goes first. it's the last attribute, which a good message-integrity takes out of the view
+    if ((validationFlags & StunMessage::Fingerprint) && !checkFingerprint())
+        return StunMessage::ErrorFingerprint;
+    if ((validationFlags & StunMessage::MessageIntegrity) && !checkMessageIntegrity(key))
+        return StunMessage::ErrorMessageIntegrity;
+    return StunMessage::ConvertGood;
+}
 
-    const quint8 *p = (const quint8 *)in.data();
+StunMessage::Class StunMessageView::mclass() const
+{
+    Q_ASSERT(isValid());
+    return class_from_type(view_data(packet));
+}
 
-    // method bits are split into 3 sections
-    quint16 m1, m2, m3;
-    m1 = quint16(p[0] & 0x3e); // M7-11
-    m1 <<= 6;
-    m2 = quint16(p[1] & 0xe0); // M4-6
-    m2 >>= 1;
-    m3 = quint16(p[1] & 0x0f); // M0-3
+quint16 StunMessageView::method() const
+{
+    Q_ASSERT(isValid());
+    return method_from_type(view_data(packet));
+}
 
-    // class bits are split into 2 sections
-    quint8 c1, c2;
-    c1 = quint8(p[0] & 0x01); // C1
-    c1 <<= 1;
-    c2 = quint8(p[1] & 0x10); // C0
-    c2 >>= 4;
+const quint8 *StunMessageView::magic() const
+{
+    Q_ASSERT(isValid());
+    return view_data(packet) + 4;
+}
 
-    quint16 method    = m1 | m2 | m3;
-    quint8  classbits = c1 | c2;
+const quint8 *StunMessageView::id() const
+{
+    Q_ASSERT(isValid());
+    return view_data(packet) + 8;
+}
 
-    Class mclass;
-    if (classbits == 0) // 00
-        mclass = Request;
-    else if (classbits == 1) // 01
-        mclass = Indication;
-    else if (classbits == 2) // 10
-        mclass = SuccessResponse;
-    else // 11
-        mclass = ErrorResponse;
+int StunMessageView::firstAttribute() const
+{
+    quint16 type;
+    int     len;
+    if (!isValid() || get_attribute_props(view_data(packet), end, ATTRIBUTE_AREA_START, &type, &len) == -1)
+        return -1;
+    return ATTRIBUTE_AREA_START;
+}
 
-    StunMessage out;
-    out.setClass(mclass);
-    out.setMethod(method);
-    out.setMagic(p + 4);
-    out.setId(p + 8);
+int StunMessageView::nextAttribute(int offset) const
+{
+    quint16 type;
+    int     len;
+    int     next = get_attribute_props(view_data(packet), end, offset, &type, &len);
+    if (next == -1 || get_attribute_props(view_data(packet), end, next, &type, &len) == -1)
+        return -1;
+    return next;
+}
 
-    QList<Attribute> list;
-    int              at = ATTRIBUTE_AREA_START;
-    while (1) {
-        quint16 type;
-        int     len;
-        int     next;
+quint16 StunMessageView::attributeType(int offset) const { return read16(view_data(packet) + offset); }
 
-        next = get_attribute_props(in, at, &type, &len);
-        if (next == -1)
-            break;
+int StunMessageView::attributeLength(int offset) const { return read16(view_data(packet) + offset + 2); }
 
-        Attribute attrib;
-        attrib.type  = type;
-        attrib.value = in.mid(at + 4, len);
-        list += attrib;
+const quint8 *StunMessageView::attributeData(int offset) const { return view_data(packet) + offset + 4; }
 
-        at = next;
-    }
-    out.setAttributes(list);
+QByteArray StunMessageView::attributeValue(int offset) const
+{
+    return raw_bytes(attributeData(offset), attributeLength(offset));
+}
 
-    if (result)
-        *result = ConvertGood;
-    return out;
+int StunMessageView::findAttribute(quint16 type) const
+{
+    int len;
+    return isValid() ? find_attribute(view_data(packet), end, type, &len) : -1;
 }
 
-bool StunMessage::isProbablyStun(const QByteArray &a) { return check_and_get_length(a) != -1; }
+QByteArray StunMessageView::attribute(quint16 type) const
+{
+    int at = findAttribute(type);
+    return at != -1 ? attributeValue(at) : QByteArray();
+}
 
-StunMessage::Class StunMessage::extractClass(const QByteArray &in)
+bool StunMessageView::username(QString *username) const
 {
-    const quint8 *p = (const quint8 *)in.data();
+    int at = findAttribute(StunTypes::USERNAME);
+    return at != -1 && StunTypes::parseUsername(attributeValue(at), username);
+}
 
-    // class bits are split into 2 sections
-    quint8 c1, c2;
-    c1 = quint8(p[0] & 0x01); // C1
-    c1 <<= 1;
-    c2 = quint8(p[1] & 0x10); // C0
-    c2 >>= 4;
+bool StunMessageView::priority(quint32 *priority) const
+{
+    int at = findAttribute(StunTypes::PRIORITY);
+    return at != -1 && StunTypes::parsePriority(attributeValue(at), priority);
+}
 
-    quint8 classbits = c1 | c2;
+bool StunMessageView::iceControlling(quint64 *tieBreaker) const
+{
+    int at = findAttribute(StunTypes::ICE_CONTROLLING);
+    return at != -1 && StunTypes::parseIceControlling(attributeValue(at), tieBreaker);
+}
 
-    Class mclass;
-    if (classbits == 0) // 00
-        mclass = Request;
-    else if (classbits == 1) // 01
-        mclass = Indication;
-    else if (classbits == 2) // 10
-        mclass = SuccessResponse;
-    else // 11
-        mclass = ErrorResponse;
+bool StunMessageView::iceControlled(quint64 *tieBreaker) const
+{
+    int at = findAttribute(StunTypes::ICE_CONTROLLED);
+    return at != -1 && StunTypes::parseIceControlled(attributeValue(at), tieBreaker);
+}
 
-    return mclass;
+bool StunMessageView::xorMappedAddress(TransportAddress &addr) const
+{
+    int at = findAttribute(StunTypes::XOR_MAPPED_ADDRESS);
+    return at != -1 && StunTypes::parseXorMappedAddress(attributeValue(at), magic(), id(), addr);
 }
 
-bool StunMessage::containsStun(const quint8 *data, int size)
+bool StunMessageView::errorCode(int *code, QString *reason) const
 {
-    // check_and_get_length does a full packet check so it works even on a stream
-    return check_and_get_length(QByteArray::fromRawData((const char *)data, size)) != -1;
+    int at = findAttribute(StunTypes::ERROR_CODE);
+    return at != -1 && StunTypes::parseErrorCode(attributeValue(at), code, reason);
 }
 
-QByteArray StunMessage::readStun(const quint8 *data, int size)
+StunMessage StunMessageView::toMessage() const
 {
-    QByteArray in   = QByteArray::fromRawData((const char *)data, size);
-    int        mlen = check_and_get_length(in);
-    if (mlen != -1)
-        return QByteArray((const char *)data, mlen + 20);
-    else
-        return QByteArray();
+    if (!isValid())
+        return StunMessage();
+
+    StunMessage out;
+    out.setClass(mclass());
+    out.setMethod(method());
+    out.setMagic(magic());
+    out.setId(id());
+    out.d->packet    = packet;
+    out.d->packetEnd = end;
+    return out;
 }
 } // namespace XMPP
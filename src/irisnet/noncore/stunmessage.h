@@ -22,8 +22,13 @@
 #include <QByteArray>
 #include <QList>
 #include <QSharedDataPointer>
+#include <QSharedPointer>
+#include <QString>
 
 namespace XMPP {
+class StunMessageView;
+class TransportAddress;
+
 class StunMessage {
 public:
     enum Class { Request, SuccessResponse, ErrorResponse, Indication };
@@ -43,6 +48,29 @@ public:
         QByteArray value;
     };
 
+    // a message-integrity key with its hmac(sha1) set up once and reused for every message signed or checked
+    //   with it. keep one where the key lives instead of passing the bare key for each message.
+    //   copies share the hmac, so like the rest of the stun classes it's for one thread
+    class IntegrityKey {
+    public:
+        IntegrityKey();
+        explicit IntegrityKey(const QByteArray &key);
+
+        bool              isEmpty() const;
+        const QByteArray &key() const;
+
+        // the 20 bytes of hmac(sha1) over buf
+        QByteArray mac(const quint8 *buf, int size) const;
+
+        // same, but with the message length in the stun header of buf taken as length. it's how a received
+        //   packet is checked without copying it
+        QByteArray mac(const quint8 *buf, int size, quint16 length) const;
+
+    private:
+        class Private;
+        QSharedPointer<Private> d;
+    };
+
     StunMessage();
     StunMessage(const StunMessage &from);
     ~StunMessage();
@@ -66,8 +94,11 @@ public:
     void setAttributes(const QList<Attribute> &attribs);
 
     QByteArray         toBinary(int validationFlags = 0, const QByteArray &key = QByteArray()) const;
+    QByteArray         toBinary(int validationFlags, const IntegrityKey &key) const;
     static StunMessage fromBinary(const QByteArray &a, ConvertResult *result = nullptr, int validationFlags = 0,
                                   const QByteArray &key = QByteArray());
+    static StunMessage fromBinary(const QByteArray &a, ConvertResult *result, int validationFlags,
+                                  const IntegrityKey &key);
 
     // minimal 3-field check
     static bool isProbablyStun(const QByteArray &a);
@@ -85,9 +116,64 @@ public:
     static QByteArray readStun(const quint8 *data, int size);
 
 private:
+    friend class StunMessageView;
+
     class Private;
     QSharedDataPointer<Private> d;
 };
+
+// read-only view of a received stun packet. the header fields and the attributes are read from the packet by
+//   offset when asked for, nothing is parsed up front or copied. the view shares the packet, and the raw
+//   attribute values it returns point into it, so they are valid as long as the packet is
+class StunMessageView {
+public:
+    StunMessageView() = default;
+
+    // runs the 3-field check, see isValid()
+    explicit StunMessageView(const QByteArray &packet);
+
+    bool isValid() const { return end != 0; }
+
+    // these check the whole packet, whatever was checked before. a good message-integrity takes the
+    //   attributes following it out of the view, as they are not protected
+    bool                       checkFingerprint() const;
+    bool                       checkMessageIntegrity(const StunMessage::IntegrityKey &key);
+    StunMessage::ConvertResult validate(int validationFlags, const StunMessage::IntegrityKey &key);
+
+    StunMessage::Class mclass() const;
+    quint16            method() const;
+    const quint8 *     magic() const; // 4 bytes
+    const quint8 *     id() const;    // 12 bytes
+
+    // attributes are walked by offset:
+    //   for (int at = view.firstAttribute(); at != -1; at = view.nextAttribute(at))
+    int           firstAttribute() const;
+    int           nextAttribute(int offset) const;
+    quint16       attributeType(int offset) const;
+    int           attributeLength(int offset) const;
+    const quint8 *attributeData(int offset) const;
+    QByteArray    attributeValue(int offset) const;
+
+    // offset of the first instance or -1
+    int        findAttribute(quint16 type) const;
+    bool       hasAttribute(quint16 type) const { return findAttribute(type) != -1; }
+    QByteArray attribute(quint16 type) const; // null if missing
+
+    // typed accessors of the first instance. false if missing or malformed
+    bool username(QString *username) const;
+    bool priority(quint32 *priority) const;
+    bool iceControlling(quint64 *tieBreaker) const;
+    bool iceControlled(quint64 *tieBreaker) const;
+    bool xorMappedAddress(TransportAddress &addr) const;
+    bool errorCode(int *code, QString *reason) const;
+
+    // a message of the attributes in the view. it keeps the packet and copies a value only when it's asked for
+    StunMessage toMessage() const;
+
+private:
+    QByteArray packet;
+    int        end = 0; // the attributes in the view end here
+};
 } // namespace XMPP
 
 #endif // STUNMESSAGE_H
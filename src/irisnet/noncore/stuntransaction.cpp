@@ -23,69 +23,54 @@
 #include "stunmessage.h"
 #include "stuntypes.h"
 #include "stunutil.h"
+#include "timerwheel.h"
 #include "transportaddress.h"
 
 #include <QElapsedTimer>
 #include <QHash>
 #include <QMetaType>
+#include <QThread>
 #include <QTime>
-#include <QTimer>
 #include <QtCrypto>
 
 Q_DECLARE_METATYPE(XMPP::StunTransaction::Error)
 
 namespace XMPP {
-// parse a stun message, optionally performing validity checks.  the
-//   StunMessage class itself provides parsing with validity or parsing
-//   without validity, but it does not provide a way to do both together,
-//   so we attempt to do that here.
-// TODO: consider moving this code into StunMessage
-static StunMessage parse_stun_message(const QByteArray &packet, int *validationFlags, const QByteArray &key)
+// parse a stun message, performing the validity checks that pass.  a view
+//   checks the fingerprint and message-integrity on its own and parses
+//   nothing else, so each is done once.  the fingerprint goes first as it
+//   covers the attributes that a good message-integrity takes out of the view.
+static StunMessage parse_stun_message(const QByteArray &packet, int *validationFlags,
+                                      const StunMessage::IntegrityKey &key)
 {
-    // ideally we shouldn't fully parse the packet more than once.  the
-    //   integrity checks performed by fromBinary do not require fully
-    //   parsing the packet, so we should be able to avoid most redundant
-    //   processing.  fromBinary checks the fingerprint first, and we
-    //   can use that knowledge to avoid duplicating integrity checks.
-    int                        flags = 0;
-    StunMessage::ConvertResult result;
-    StunMessage                msg
-        = StunMessage::fromBinary(packet, &result, StunMessage::MessageIntegrity | StunMessage::Fingerprint, key);
-    if (result == StunMessage::ErrorFingerprint) {
-        // if fingerprint fails, then it is the only thing that was
-        //   performed and we can skip it now.
-        msg = StunMessage::fromBinary(packet, &result, StunMessage::MessageIntegrity, key);
-        if (result == StunMessage::ErrorMessageIntegrity) {
-            // if message-integrity fails, then it is the only
-            //   thing that was performed and we can skip it now
-            msg = StunMessage::fromBinary(packet, &result);
-            if (result == StunMessage::ConvertGood)
-                flags = 0;
-            else
-                return msg; // null
-        } else if (result == StunMessage::ConvertGood)
-            flags = StunMessage::MessageIntegrity;
-        else
-            return msg; // null
-    } else if (result == StunMessage::ErrorMessageIntegrity) {
-        // fingerprint succeeded, but message-integrity failed.  parse
-        //   without validation now (to skip redundant
-        //   fingerprint/message-integrity checks), and assume correct
-        //   fingerprint
-        msg = StunMessage::fromBinary(packet, &result);
-        if (result == StunMessage::ConvertGood)
-            flags = StunMessage::Fingerprint;
-        else
-            return msg; // null
-    } else if (result == StunMessage::ConvertGood)
-        flags = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
-    else
-        return msg; // null
+    StunMessageView view(packet);
+    if (!view.isValid())
+        return StunMessage();
+
+    int flags = 0;
+    if (view.checkFingerprint())
+        flags |= StunMessage::Fingerprint;
+    if (view.checkMessageIntegrity(key))
+        flags |= StunMessage::MessageIntegrity;
 
     *validationFlags = flags;
-    return msg;
+    return view.toMessage();
 }
 
+// the 96-bit transaction id, as the key of the transaction table
+class StunTransactionId {
+public:
+    quint64 hi = 0;
+    quint32 lo = 0;
+
+    StunTransactionId() = default;
+    explicit StunTransactionId(const quint8 *id) : hi(StunUtil::read64(id)), lo(StunUtil::read32(id + 8)) { }
+
+    bool operator==(const StunTransactionId &other) const { return hi == other.hi && lo == other.lo; }
+};
+
+inline uint qHash(const StunTransactionId &key, uint seed = 0) { return ::qHash(key.hi, seed) ^ ::qHash(key.lo, seed); }
+
 class StunTransactionPoolPrivate : public QObject {
     Q_OBJECT
 
@@ -93,19 +78,37 @@ public:
     StunTransactionPool *                q;
     StunTransaction::Mode                mode;
     QSet<StunTransaction *>              transactions;
-    QHash<StunTransaction *, QByteArray> transToId;
-    QHash<QByteArray, StunTransaction *> idToTrans;
-    bool                                 useLongTermAuth  = false;
-    bool                                 needLongTermAuth = false;
-    QSet<TransportAddress>               triedLongTermAuth;
-    QString                              user;
-    QCA::SecureArray                     pass;
-    QString                              realm;
-    QString                              nonce;
-    int                                  debugLevel = StunTransactionPool::DL_None;
+    QHash<StunTransactionId, StunTransaction *> idToTrans;
+    bool                                        useLongTermAuth  = false;
+    bool                                        needLongTermAuth = false;
+    QSet<TransportAddress>                      triedLongTermAuth;
+    QString                                     user;
+    QCA::SecureArray                            pass;
+    QString                                     realm;
+    QString                                     nonce;
+    int                                         debugLevel      = StunTransactionPool::DL_None;
+    qint64                                      retransmissions = 0;
+
+    // the wheel of the thread of the pool, which the timers of the transactions are on. unknown after a move
+    //   till something runs on the new thread
+    TimerWheel *wheel = TimerWheel::instance();
+
+    // hmacs already set up for the keys seen. there are a few at most: a short-term password per peer and a
+    //   long-term key per server
+    QHash<QByteArray, StunMessage::IntegrityKey> integrityKeys;
 
     StunTransactionPoolPrivate(StunTransactionPool *_q) : QObject(_q), q(_q) { }
 
+    StunMessage::IntegrityKey integrityKey(const QByteArray &key)
+    {
+        auto it = integrityKeys.constFind(key);
+        if (it != integrityKeys.constEnd())
+            return *it;
+        if (integrityKeys.size() >= 16)
+            integrityKeys.clear();
+        return *integrityKeys.insert(key, StunMessage::IntegrityKey(key));
+    }
+
     QByteArray generateId() const;
     void       insert(StunTransaction *trans);
     void       remove(StunTransaction *trans);
@@ -126,7 +129,7 @@ public:
     bool                     cancelling = false;
     StunTransaction::Mode    mode;
     StunMessage              origMessage;
-    QByteArray               id;
+    StunTransactionId        id;
     QByteArray               packet;
     TransportAddress         to_addr;
 
@@ -134,31 +137,26 @@ public:
     int     rto = 500, rc = 7, rm = 16, ti = 39500;
     int     tries;
     int     last_interval;
-    QTimer *t;
+    TimerWheel::Timer t; // one of many, see TimerWheel
 
     QString       stuser;
     QString       stpass;
-    bool          fpRequired = false;
-    QByteArray    key;
-    QElapsedTimer time;
+    bool                      fpRequired = false;
+    StunMessage::IntegrityKey key;
+    QElapsedTimer             time;
 
     StunTransactionPrivate(StunTransaction *_q) : QObject(_q), q(_q)
     {
         qRegisterMetaType<StunTransaction::Error>();
 
-        t = new QTimer(this);
-        connect(t, &QTimer::timeout, this, &StunTransactionPrivate::t_timeout);
-        t->setSingleShot(true);
+        t.setCallback([this]() { t_timeout(); });
+        t.setSingleShot(true);
     }
 
     ~StunTransactionPrivate()
     {
         if (pool)
             pool->d->remove(q);
-
-        t->disconnect(this);
-        t->setParent(nullptr);
-        t->deleteLater();
     }
 
     void start(StunTransactionPool::Ptr _pool, const TransportAddress &toAddress)
@@ -166,6 +164,7 @@ public:
         pool    = _pool;
         mode    = pool->d->mode;
         to_addr = toAddress;
+        t.setContext(pool.data()); // whoever owns the transaction, it goes along with the pool
 
         tryRequest();
     }
@@ -195,7 +194,7 @@ public:
         StunMessage out = origMessage;
 
         out.setClass(StunMessage::Request);
-        id = QByteArray((const char *)out.id(), 12);
+        id = StunTransactionId(out.id());
 
         if (!stuser.isEmpty()) {
             QList<StunMessage::Attribute> list = out.attributes();
@@ -206,7 +205,7 @@ public:
             list += attr;
             out.setAttributes(list);
 
-            key = StunUtil::saslPrep(stpass.toUtf8()).toByteArray();
+            key = pool->d->integrityKey(StunUtil::saslPrep(stpass.toUtf8()).toByteArray());
         } else if (!pool->d->nonce.isEmpty()) {
             QList<StunMessage::Attribute> list = out.attributes();
             {
@@ -237,7 +236,7 @@ public:
             buf += QByteArray(1, ':');
             buf += StunUtil::saslPrep(pool->d->pass);
 
-            key = QCA::Hash("md5").process(buf).toByteArray();
+            key = pool->d->integrityKey(QCA::Hash("md5").process(buf).toByteArray());
         }
 
         if (!key.isEmpty())
@@ -258,10 +257,10 @@ public:
 
         if (mode == StunTransaction::Udp) {
             last_interval = rm * rto;
-            t->start(rto);
+            t.start(rto);
             rto *= 2;
         } else if (mode == StunTransaction::Tcp) {
-            t->start(ti);
+            t.start(ti);
         } else
             Q_ASSERT(0);
 
@@ -270,7 +269,7 @@ public:
         transmit();
     }
 
-private slots:
+private:
     void t_timeout()
     {
         if (cancelling) {
@@ -285,9 +284,9 @@ private slots:
 
         ++tries;
         if (tries == rc) {
-            t->start(last_interval);
+            t.start(last_interval);
         } else {
-            t->start(rto);
+            t.start(rto);
             rto *= 2;
         }
 
@@ -296,10 +295,10 @@ private slots:
             dbg += QString("to=(%1)").arg(to_addr);
 
         emit pool->debugLine(QString("stun transaction %1 timeout. retransmitting..").arg(dbg));
+        ++pool->d->retransmissions;
         transmit();
     }
 
-private:
     void transmit()
     {
         if (pool->d->debugLevel >= StunTransactionPool::DL_Packet) {
@@ -326,7 +325,7 @@ private:
     void processIncoming(const StunMessage &msg, bool authed, const TransportAddress &from_addr)
     {
         active = false;
-        t->stop();
+        t.stop();
         if (cancelling) {
             q->deleteLater();
             return;
@@ -493,28 +492,24 @@ QByteArray StunTransactionPoolPrivate::generateId() const
 
     do {
         id = QCA::Random::randomArray(12).toByteArray();
-    } while (idToTrans.contains(id));
+    } while (idToTrans.contains(StunTransactionId((const quint8 *)id.data())));
 
     return id;
 }
 
 void StunTransactionPoolPrivate::insert(StunTransaction *trans)
 {
-    Q_ASSERT(!trans->d->id.isEmpty());
-
+    if (!wheel)
+        wheel = TimerWheel::instance();
     transactions.insert(trans);
-    QByteArray id = trans->d->id;
-    transToId.insert(trans, id);
-    idToTrans.insert(id, trans);
+    idToTrans.insert(trans->d->id, trans);
 }
 
 void StunTransactionPoolPrivate::remove(StunTransaction *trans)
 {
     if (transactions.contains(trans)) {
         transactions.remove(trans);
-        QByteArray id = transToId.value(trans);
-        transToId.remove(trans);
-        idToTrans.remove(id);
+        idToTrans.remove(trans->d->id);
     }
 }
 
@@ -548,7 +543,7 @@ bool StunTransactionPool::writeIncomingMessage(const StunMessage &msg, const Tra
         emit debugLine(StunTypes::print_packet_str(msg));
     }
 
-    QByteArray         id     = QByteArray::fromRawData((const char *)msg.id(), 12);
+    StunTransactionId  id(msg.id());
     StunMessage::Class mclass = msg.mclass();
 
     if (mclass != StunMessage::SuccessResponse && mclass != StunMessage::ErrorResponse)
@@ -581,7 +576,7 @@ bool StunTransactionPool::writeIncomingMessage(const QByteArray &packet, bool *n
 
     // isProbablyStun ensures the packet is 20 bytes long, so we can safely
     //   safely extract out the transaction id from the raw packet
-    QByteArray id = QByteArray((const char *)packet.data() + 8, 12);
+    StunTransactionId id((const quint8 *)packet.data() + 8);
 
     StunMessage::Class mclass = StunMessage::extractClass(packet);
 
@@ -607,6 +602,29 @@ bool StunTransactionPool::writeIncomingMessage(const QByteArray &packet, bool *n
     return ret;
 }
 
+StunTransactionPool::Stats StunTransactionPool::stats() const
+{
+    Stats s;
+    s.pendingTransactions = d->transactions.count();
+    s.retransmissions     = d->retransmissions;
+    if (!d->wheel && QThread::currentThread() == thread())
+        d->wheel = TimerWheel::instance();
+    s.wakeupsPerSecond = d->wheel ? d->wheel->stats().wakeupsPerSecond : 0;
+    return s;
+}
+
+void StunTransactionPool::changeThread(QThread *thread)
+{
+    TimerWheel::instance()->moveTimers(this);
+    d->wheel = nullptr;
+    // the transactions nobody owns don't go along with the pool by themselves
+    for (StunTransaction *trans : qAsConst(d->transactions)) {
+        if (!trans->parent())
+            trans->moveToThread(thread);
+    }
+    moveToThread(thread);
+}
+
 void StunTransactionPool::setLongTermAuthEnabled(bool enabled) { d->useLongTermAuth = enabled; }
 
 QString StunTransactionPool::realm() const { return d->realm; }
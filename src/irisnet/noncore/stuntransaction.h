@@ -131,6 +131,15 @@ public:
 
     enum DebugLevel { DL_None, DL_Info, DL_Packet };
 
+    class Stats {
+    public:
+        int    pendingTransactions = 0;
+        qint64 retransmissions     = 0;
+
+        // of the timer wheel driving the retransmissions. it's shared by all the pools of the thread
+        qreal wakeupsPerSecond = 0;
+    };
+
     StunTransactionPool(StunTransaction::Mode mode);
     ~StunTransactionPool();
 
@@ -164,6 +173,11 @@ public:
 
     void setDebugLevel(DebugLevel level); // default DL_None
 
+    // instead of moveToThread(), so the timers of the transactions go along
+    void changeThread(QThread *thread);
+
+    Stats stats() const;
+
 signals:
     // note: not DOR-SS safe.  writeIncomingMessage() must not be called
     //   during this signal.
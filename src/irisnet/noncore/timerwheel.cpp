@@ -0,0 +1,329 @@
+/*
+ * timerwheel.cpp - many timers on one
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "timerwheel.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QThreadStorage>
+#include <QTimer>
+
+#include <climits>
+
+namespace XMPP {
+// a power of two. with the default granularity a revolution is about 5 seconds, longer timeouts go round more than once
+static const int SlotCount = 512;
+
+// the list of the timers that are due and about to fire
+static const int Expired = SlotCount;
+
+class TimerWheel::Private {
+public:
+    TimerWheel *  q;
+    int           granularity;
+    QElapsedTimer clock;
+    QTimer        timer;
+
+    // each slot is a list in start order, so timers due together fire in that order
+    Timer *slots[SlotCount + 1] = {};
+    Timer *tails[SlotCount + 1] = {};
+    qint64 tick                 = 0;  // slots are processed up to this one
+    qint64 wakeAt               = -1; // what the timer is started for, if it is
+    int    pending              = 0;  // on the slots, not counting the expired ones
+
+    qint64 wakeups   = 0;
+    qint64 timeouts  = 0;
+    qint64 rateStart = 0; // msec
+    qint64 rateCount = 0;
+    qreal  rate      = 0;
+
+    Private(TimerWheel *_q, int _granularity) : q(_q), granularity(_granularity)
+    {
+        clock.start();
+        // the batching is done by the ticks. the timer itself better not be early
+        timer.setTimerType(Qt::PreciseTimer);
+        timer.setSingleShot(true);
+        QObject::connect(&timer, &QTimer::timeout, [this]() { process(); });
+    }
+
+    ~Private()
+    {
+        // whatever is left is just forgotten
+        for (Timer *head : slots) {
+            for (Timer *t = head; t; t = t->next_) {
+                t->on_   = nullptr;
+                t->slot_ = -1;
+            }
+        }
+    }
+
+    void link(Timer *t, int slot)
+    {
+        t->slot_ = slot;
+        t->prev_ = tails[slot];
+        t->next_ = nullptr;
+        if (tails[slot])
+            tails[slot]->next_ = t;
+        else
+            slots[slot] = t;
+        tails[slot] = t;
+    }
+
+    void unlink(Timer *t)
+    {
+        if (t->prev_)
+            t->prev_->next_ = t->next_;
+        else
+            slots[t->slot_] = t->next_;
+        if (t->next_)
+            t->next_->prev_ = t->prev_;
+        else
+            tails[t->slot_] = t->prev_;
+        t->prev_ = nullptr;
+        t->next_ = nullptr;
+        t->slot_ = -1;
+    }
+
+    void add(Timer *t, int msec)
+    {
+        // rounded up, it never fires early. the slot of the current tick is done already
+        qint64 due = (clock.elapsed() + qMax(msec, 0) + granularity - 1) / granularity;
+        due        = qMax(due, tick + 1);
+
+        t->on_  = q;
+        t->due_ = due;
+        link(t, int(due & (SlotCount - 1)));
+        ++pending;
+        schedule(due);
+    }
+
+    // msec till the timer is due
+    int remaining(const Timer *t) const
+    {
+        return int(qBound(qint64(0), t->due_ * granularity - clock.elapsed(), qint64(INT_MAX)));
+    }
+
+    void remove(Timer *t)
+    {
+        if (t->slot_ != Expired)
+            --pending;
+        unlink(t);
+        t->on_ = nullptr;
+    }
+
+    void schedule(qint64 due)
+    {
+        if (wakeAt != -1 && wakeAt <= due)
+            return;
+        wakeAt = due;
+        timer.start(int(qMax(due * granularity - clock.elapsed(), qint64(0))));
+    }
+
+    // the first tick within a revolution with a timer due, or a revolution later to look again
+    qint64 nextDue() const
+    {
+        for (qint64 k = tick + 1; k <= tick + SlotCount; ++k) {
+            for (Timer *t = slots[k & (SlotCount - 1)]; t; t = t->next_) {
+                if (t->due_ == k)
+                    return k;
+            }
+        }
+        return tick + SlotCount;
+    }
+
+    void process()
+    {
+        wakeAt = -1;
+
+        qint64 msec = clock.elapsed();
+        ++wakeups;
+        if (msec - rateStart >= 1000) {
+            rate      = qreal(rateCount) * 1000 / qreal(msec - rateStart);
+            rateStart = msec;
+            rateCount = 0;
+        }
+        ++rateCount;
+
+        // every slot passed since the last time, each once at most
+        qint64 now  = msec / granularity;
+        qint64 from = qMax(tick + 1, now - SlotCount + 1);
+        for (qint64 k = from; k <= now; ++k) {
+            for (Timer *t = slots[k & (SlotCount - 1)]; t;) {
+                Timer *next = t->next_;
+                if (t->due_ <= now) {
+                    unlink(t);
+                    --pending;
+                    link(t, Expired);
+                }
+                t = next;
+            }
+        }
+        tick = qMax(tick, now);
+
+        // a callback may start, stop or delete any timer, even the next one here. so the expired list is
+        //   read again for every timeout and the callback is called on a copy
+        while (Timer *t = slots[Expired]) {
+            unlink(t);
+            t->on_ = nullptr;
+            ++timeouts;
+            if (!t->singleShot_)
+                add(t, t->interval_);
+            std::function<void()> callback = t->callback_;
+            if (callback)
+                callback();
+        }
+
+        if (pending)
+            schedule(nextDue());
+    }
+};
+
+// a child of the object being moved, so it goes to the other thread along with it and the event posted to it.
+//   there the timers are started again
+class TimerWheel::Mover : public QObject {
+public:
+    struct Moving {
+        std::shared_ptr<Timer *> timer; // null once the timer was started, stopped or deleted meanwhile
+        int                      remaining;
+    };
+    QList<Moving> timers;
+
+    static QEvent::Type eventType()
+    {
+        static const QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+        return type;
+    }
+
+    explicit Mover(QObject *parent) : QObject(parent) { }
+
+    bool event(QEvent *e) override
+    {
+        if (e->type() != eventType())
+            return QObject::event(e);
+        for (const Moving &m : qAsConst(timers)) {
+            if (Timer *t = *m.timer) {
+                t->moving_.reset();
+                TimerWheel::instance()->d->add(t, m.remaining);
+            }
+        }
+        deleteLater();
+        return true;
+    }
+};
+
+//----------------------------------------------------------------------------
+// TimerWheel::Timer
+//----------------------------------------------------------------------------
+TimerWheel::Timer::Timer(std::function<void()> callback, TimerWheel *wheel) :
+    wheel_(wheel), callback_(std::move(callback))
+{
+}
+
+TimerWheel::Timer::~Timer() { stop(); }
+
+void TimerWheel::Timer::setCallback(std::function<void()> callback) { callback_ = std::move(callback); }
+
+void TimerWheel::Timer::start()
+{
+    stop();
+    TimerWheel *wheel = wheel_ ? wheel_ : TimerWheel::instance();
+    wheel->d->add(this, interval_);
+}
+
+void TimerWheel::Timer::start(int msec)
+{
+    interval_ = msec;
+    start();
+}
+
+void TimerWheel::Timer::stop()
+{
+    if (moving_) {
+        *moving_ = nullptr;
+        moving_.reset();
+    }
+    if (on_)
+        on_->d->remove(this);
+}
+
+//----------------------------------------------------------------------------
+// TimerWheel
+//----------------------------------------------------------------------------
+TimerWheel::TimerWheel(int granularity) : d(new Private(this, qMax(granularity, 1))) { }
+
+TimerWheel::~TimerWheel() { delete d; }
+
+TimerWheel *TimerWheel::instance()
+{
+    static QThreadStorage<TimerWheel *> wheels;
+    if (!wheels.hasLocalData())
+        wheels.setLocalData(new TimerWheel);
+    return wheels.localData();
+}
+
+int TimerWheel::granularity() const { return d->granularity; }
+
+void TimerWheel::moveTimers(QObject *object)
+{
+    auto owned = [object](const Timer *t) {
+        if (t->wheel_) // given a wheel of its own, it stays there
+            return false;
+        for (QObject *o = t->context_; o; o = o->parent()) {
+            if (o == object)
+                return true;
+        }
+        return false;
+    };
+
+    Mover *mover = nullptr;
+    for (int slot = 0; slot <= SlotCount; ++slot) {
+        for (Timer *t = d->slots[slot]; t;) {
+            Timer *next = t->next_;
+            if (owned(t)) {
+                if (!mover)
+                    mover = new Mover(object);
+                int remaining = d->remaining(t);
+                d->remove(t);
+                t->moving_ = std::make_shared<Timer *>(t);
+                mover->timers += Mover::Moving { t->moving_, remaining };
+            }
+            t = next;
+        }
+    }
+    if (mover)
+        QCoreApplication::postEvent(mover, new QEvent(Mover::eventType()));
+}
+
+TimerWheel::Stats TimerWheel::stats() const
+{
+    Stats s;
+    s.pending  = d->pending;
+    s.wakeups  = d->wakeups;
+    s.timeouts = d->timeouts;
+
+    // the last full second, unless it was a while ago
+    qint64 msec = d->clock.elapsed() - d->rateStart;
+    if (msec >= 2000)
+        s.wakeupsPerSecond = qreal(d->rateCount) * 1000 / qreal(msec);
+    else
+        s.wakeupsPerSecond = d->rate;
+    return s;
+}
+} // namespace XMPP
@@ -0,0 +1,117 @@
+/*
+ * timerwheel.h - many timers on one
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+
+#include <functional>
+#include <memory>
+
+class QObject;
+
+namespace XMPP {
+// a hashed timer wheel: any number of timers driven by a single QTimer.
+//   time goes in ticks of granularity() milliseconds and timeouts are
+//   rounded up to a whole tick, so timers due close together fire from the
+//   same wakeup. starting and stopping a timer is O(1), and nothing is
+//   registered with the event loop per timer.
+//
+// a wheel belongs to a thread. instance() is the one of the current thread,
+//   which timers use unless they are given another. unlike a QTimer, a timer
+//   doesn't follow its object to another thread by itself, see moveTimers().
+class TimerWheel {
+public:
+    // works like a single QTimer, without being a QObject. it may be
+    //   restarted, stopped or deleted from its own callback
+    class Timer {
+    public:
+        explicit Timer(std::function<void()> callback = nullptr, TimerWheel *wheel = nullptr);
+        ~Timer();
+
+        void setCallback(std::function<void()> callback);
+
+        // the object the timer belongs to, for moveTimers()
+        QObject *context() const { return context_; }
+        void     setContext(QObject *context) { context_ = context; }
+
+        int  interval() const { return interval_; }
+        void setInterval(int msec) { interval_ = msec; }
+        bool isSingleShot() const { return singleShot_; }
+        void setSingleShot(bool singleShot) { singleShot_ = singleShot; }
+
+        bool isActive() const { return on_ != nullptr || moving_; }
+        void start();
+        void start(int msec);
+        void stop();
+
+    private:
+        Q_DISABLE_COPY(Timer)
+
+        friend class TimerWheel;
+
+        TimerWheel *          wheel_;
+        std::function<void()> callback_;
+        QObject *             context_    = nullptr;
+        int                   interval_   = 0;
+        bool                  singleShot_ = false;
+
+        // while on the way to the wheel of another thread
+        std::shared_ptr<Timer *> moving_;
+
+        // while active
+        TimerWheel *on_   = nullptr;
+        qint64      due_  = 0; // tick
+        int         slot_ = -1;
+        Timer *     prev_ = nullptr;
+        Timer *     next_ = nullptr;
+    };
+
+    class Stats {
+    public:
+        int    pending          = 0; // active timers
+        qint64 wakeups          = 0; // of the driving timer, since the wheel was created
+        qint64 timeouts         = 0; // of the timers, same
+        qreal  wakeupsPerSecond = 0; // over about the last second
+    };
+
+    explicit TimerWheel(int granularity = 10);
+    ~TimerWheel();
+
+    static TimerWheel *instance();
+
+    int   granularity() const;
+    Stats stats() const;
+
+    // the active timers here whose context is the object or one of its children are stopped, and
+    //   started again for what was left of them on the wheel of the thread the object is moved to.
+    //   to be called right before object->moveToThread(), from the thread of this wheel
+    void moveTimers(QObject *object);
+
+private:
+    Q_DISABLE_COPY(TimerWheel)
+
+    class Mover;
+    class Private;
+    Private *d;
+};
+} // namespace XMPP
+
+#endif // TIMERWHEEL_H
@@ -951,7 +951,7 @@ void TurnClient::setDebugLevel(DebugLevel level)
 void TurnClient::changeThread(QThread *thread)
 {
     if (d->pool)
-        d->pool->moveToThread(thread);
+        d->pool->changeThread(thread);
     moveToThread(thread);
 }
 } // namespace XMPP
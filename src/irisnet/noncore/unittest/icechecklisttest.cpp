@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "icechecklist.h"
+#include "qttestutil/qttestutil.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+enum PairState { Waiting, InProgress, Succeeded, Failed, Frozen };
+
+// just what the checklist looks at
+struct Candidate {
+    using Ptr = QSharedPointer<Candidate>;
+
+    int              componentId = 1;
+    TransportAddress base;
+    TransportAddress addr;
+};
+
+struct Pair {
+    using Ptr = QSharedPointer<Pair>;
+
+    Candidate::Ptr local, remote;
+    qint64         priority = 0;
+    PairState      state    = Frozen;
+};
+
+using CheckList = IceCheckList<Pair, Frozen + 1>;
+
+Candidate::Ptr candidate(int componentId, quint32 ip, quint16 port)
+{
+    auto c         = Candidate::Ptr::create();
+    c->componentId = componentId;
+    c->addr        = TransportAddress(QHostAddress(ip), port);
+    c->base        = c->addr;
+    return c;
+}
+
+Pair::Ptr pair(const Candidate::Ptr &local, const Candidate::Ptr &remote, qint64 priority)
+{
+    auto p      = Pair::Ptr::create();
+    p->local    = local;
+    p->remote   = remote;
+    p->priority = priority;
+    return p;
+}
+
+QList<qint64> priorities(const QList<Pair::Ptr> &pairs)
+{
+    QList<qint64> out;
+    for (auto &p : pairs)
+        out += p->priority;
+    return out;
+}
+} // namespace
+
+class IceCheckListTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testOrder()
+    {
+        CheckList list;
+        auto      r = candidate(1, 0x0a000001, 1000);
+        for (qint64 prio : { 20, 50, 10, 50, 30 })
+            QVERIFY(list.add(pair(candidate(1, 0xc0a80001, quint16(prio + list.count())), r, prio)));
+        auto c2 = pair(candidate(2, 0xc0a80001, 5000), candidate(2, 0x0a000001, 1001), 50);
+        QVERIFY(list.add(c2));
+
+        QCOMPARE(priorities(list.pairs()), QList<qint64>({ 50, 50, 50, 30, 20, 10 }));
+        QCOMPARE(list.at(2), c2); // component 1 before 2, otherwise in the order added
+        QVERIFY(list.contains(c2));
+    }
+
+    void testRedundant()
+    {
+        CheckList list;
+        auto      local  = candidate(1, 0xc0a80001, 1000);
+        auto      remote = candidate(1, 0x0a000001, 2000);
+
+        // a reflexive candidate has the same base as the host one
+        auto srflx  = candidate(1, 0x01020304, 3000);
+        srflx->base = local->base;
+
+        auto host = pair(local, remote, 100);
+        QVERIFY(list.add(host));
+        QVERIFY(!list.add(pair(srflx, remote, 50)));
+        QVERIFY(!list.add(pair(srflx, remote, 100))); // equal keeps what is there
+        QCOMPARE(list.count(), 1);
+
+        auto higher = pair(srflx, remote, 200);
+        QVERIFY(list.add(higher));
+        QCOMPARE(list.count(), 1);
+        QVERIFY(!list.contains(host));
+        QCOMPARE(list.find(1, local->base, remote->addr), higher);
+        QVERIFY(!list.find(2, local->base, remote->addr));
+
+        // another component isn't redundant
+        auto c2 = candidate(2, 0xc0a80001, 1000);
+        QVERIFY(list.add(pair(c2, candidate(2, 0x0a000001, 2000), 10)));
+        QCOMPARE(list.count(), 2);
+    }
+
+    void testStates()
+    {
+        CheckList        list;
+        auto             r = candidate(1, 0x0a000001, 1000);
+        QList<Pair::Ptr> pairs;
+        for (int n = 0; n < 10; ++n) {
+            pairs += pair(candidate(1, 0xc0a80001, quint16(n + 1)), r, 100 - n);
+            list.add(pairs.last());
+        }
+        QCOMPARE(list.countIn(Frozen), 10);
+        QCOMPARE(list.firstIn(Frozen), pairs[0]);
+        QVERIFY(!list.firstIn(Waiting));
+
+        list.setState(pairs[5], Waiting);
+        list.setState(pairs[3], Waiting);
+        list.setState(pairs[0], InProgress);
+        QCOMPARE(list.firstIn(Waiting), pairs[3]);
+        QCOMPARE(list.firstIn(Frozen), pairs[1]);
+        QCOMPARE(priorities(list.in(Waiting)), QList<qint64>({ 97, 95 }));
+        QCOMPARE(priorities(list.in(Frozen, 94)), QList<qint64>({ 93, 92, 91 }));
+        QCOMPARE(list.countIn(Frozen), 7);
+
+        // removed pairs leave their state too
+        list.remove(pairs[3]);
+        QCOMPARE(list.firstIn(Waiting), pairs[5]);
+        list.truncate(5);
+        QCOMPARE(list.countIn(Frozen), 3);
+        QCOMPARE(list.count(), 5);
+
+        // not on the list anymore
+        list.setState(pairs[9], Succeeded);
+        QCOMPARE(pairs[9]->state, Succeeded);
+        QCOMPARE(list.countIn(Succeeded), 0);
+    }
+
+    // 50 local and 50 remote candidates for each of 2 components, paired as the remote ones trickle in,
+    //   and checked in order till nothing is left
+    void benchmarkChecks()
+    {
+        const int components = 2;
+        const int count      = 50;
+
+        QList<Candidate::Ptr> local, remote;
+        for (int c = 1; c <= components; ++c) {
+            for (int n = 0; n < count; ++n) {
+                local += candidate(c, 0xc0a80000 + quint32(n), quint16(10000 + c));
+                remote += candidate(c, 0x0a000000 + quint32(n), quint16(20000 + c));
+            }
+        }
+
+        QBENCHMARK
+        {
+            CheckList list;
+            for (auto &r : remote) {
+                for (auto &l : local) {
+                    if (l->componentId == r->componentId)
+                        list.add(pair(l, r, (qint64(qHash(l->addr) ^ qHash(r->addr)) << 8) + l->componentId));
+                }
+                list.truncate(100 * components);
+            }
+
+            int checks = 0;
+            while (auto p = list.firstIn(Waiting) ? list.firstIn(Waiting) : list.firstIn(Frozen)) {
+                list.setState(p, InProgress);
+                list.setState(p, (checks++ % 3) ? Failed : Succeeded);
+            }
+            QCOMPARE(checks, 100 * components);
+        }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(IceCheckListTest);
+#include "icechecklisttest.moc"
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "stunmessage.h"
+#include "stuntypes.h"
+#include "transportaddress.h"
+
+#include <QObject>
+#include <QtCrypto>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+// RFC 5769 2.1. Sample Request
+const char sampleRequest[] = "000100582112a442b7e7a701bc34d686fa87dfae802200105354554e207465737420636c"
+                             "69656e74002400046e0001ff80290008932ff9b151263b36000600096576746a3a6836"
+                             "7659202020000800149aeaa70cbfd8cb56781ef2b5b2d3f249c1b571a280280004e57a"
+                             "3bcf";
+const char samplePassword[] = "VOkJxbRl1RmTxUk/WvJxBt";
+
+// RFC 5769 2.2. Sample IPv4 Response
+const char sampleResponse[] = "0101003c2112a442b7e7a701bc34d686fa87dfae8022000b7465737420766563746f7220002000"
+                              "080001a147e112a643000800142b91f599fd9e90c38c7489f92af9ba53f06be7d78028000"
+                              "4c07d4c96";
+
+StunMessage bindingRequest(int usernameSize)
+{
+    StunMessage msg;
+    msg.setClass(StunMessage::Request);
+    msg.setMethod(0x001);
+    quint8 id[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    msg.setId(id);
+
+    StunMessage::Attribute attr;
+    attr.type  = 0x0006; // USERNAME
+    attr.value = QByteArray(usernameSize, 'u');
+    msg.setAttributes({ attr });
+    return msg;
+}
+} // namespace
+
+class StunMessageTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        if (!QCA::isSupported("hmac(sha1)"))
+            QSKIP("hmac(sha1) not supported in QCA.");
+    }
+
+    void testRfc5769Request()
+    {
+        const QByteArray packet = QByteArray::fromHex(sampleRequest);
+        const int        flags  = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
+
+        StunMessage::ConvertResult result;
+        StunMessage                msg = StunMessage::fromBinary(packet, &result, flags, QByteArray(samplePassword));
+        QCOMPARE(result, StunMessage::ConvertGood);
+        QCOMPARE(msg.attribute(0x0006), QByteArray("evtj:h6vY"));
+
+        StunMessage::IntegrityKey key(samplePassword);
+        for (int n = 0; n < 2; ++n) { // the second time with the hmac already set up
+            StunMessage::fromBinary(packet, &result, flags, key);
+            QCOMPARE(result, StunMessage::ConvertGood);
+        }
+
+        StunMessage::fromBinary(packet, &result, flags, StunMessage::IntegrityKey("wrong"));
+        QCOMPARE(result, StunMessage::ErrorMessageIntegrity);
+
+        QByteArray broken = packet;
+        broken[30]        = 'x';
+        StunMessage::fromBinary(broken, &result, StunMessage::Fingerprint);
+        QCOMPARE(result, StunMessage::ErrorFingerprint);
+    }
+
+    void testRoundTrip()
+    {
+        // every length mod 8 goes through the crc tail
+        StunMessage::IntegrityKey key(samplePassword);
+        for (int size = 1; size <= 40; ++size) {
+            QByteArray packet = bindingRequest(size).toBinary(
+                StunMessage::MessageIntegrity | StunMessage::Fingerprint, key);
+            QVERIFY(!packet.isEmpty());
+
+            StunMessage::ConvertResult result;
+            StunMessage                msg = StunMessage::fromBinary(
+                packet, &result, StunMessage::MessageIntegrity | StunMessage::Fingerprint, QByteArray(samplePassword));
+            QCOMPARE(result, StunMessage::ConvertGood);
+            QCOMPARE(msg.attribute(0x0006), QByteArray(size, 'u'));
+        }
+    }
+
+    void testViewRequest()
+    {
+        const QByteArray packet = QByteArray::fromHex(sampleRequest);
+        StunMessageView  view(packet);
+        QVERIFY(view.isValid());
+        QCOMPARE(view.mclass(), StunMessage::Request);
+        QCOMPARE(view.method(), quint16(StunTypes::Binding));
+
+        QList<quint16> types;
+        for (int at = view.firstAttribute(); at != -1; at = view.nextAttribute(at))
+            types += view.attributeType(at);
+        QCOMPARE(types,
+                 QList<quint16>({ StunTypes::SOFTWARE, StunTypes::PRIORITY, StunTypes::ICE_CONTROLLED,
+                                  StunTypes::USERNAME, StunTypes::MESSAGE_INTEGRITY, StunTypes::FINGERPRINT }));
+
+        QString username;
+        QVERIFY(view.username(&username));
+        QCOMPARE(username, QString("evtj:h6vY"));
+        quint32 priority;
+        QVERIFY(view.priority(&priority));
+        QCOMPARE(priority, quint32(0x6e0001ff));
+        quint64 tieBreaker;
+        QVERIFY(view.iceControlled(&tieBreaker));
+        QCOMPARE(tieBreaker, quint64(0x932ff9b151263b36));
+        QVERIFY(!view.iceControlling(&tieBreaker));
+
+        // the value points into the packet
+        QCOMPARE(view.attribute(StunTypes::USERNAME).constData(),
+                 packet.constData() + view.findAttribute(StunTypes::USERNAME) + 4);
+
+        QVERIFY(view.checkFingerprint());
+        QVERIFY(!view.checkMessageIntegrity(StunMessage::IntegrityKey("wrong")));
+        QVERIFY(view.hasAttribute(StunTypes::FINGERPRINT));
+        QVERIFY(view.checkMessageIntegrity(StunMessage::IntegrityKey(samplePassword)));
+        QVERIFY(!view.hasAttribute(StunTypes::FINGERPRINT)); // not protected
+
+        StunMessage msg = view.toMessage();
+        QCOMPARE(msg.attributes().count(), 5);
+        QCOMPARE(msg.attribute(StunTypes::USERNAME), QByteArray("evtj:h6vY"));
+        QCOMPARE(QByteArray((const char *)msg.id(), 12), packet.mid(8, 12));
+    }
+
+    void testViewResponse()
+    {
+        const QByteArray packet = QByteArray::fromHex(sampleResponse);
+        StunMessageView  view(packet);
+        QCOMPARE(view.validate(StunMessage::MessageIntegrity | StunMessage::Fingerprint,
+                               StunMessage::IntegrityKey(samplePassword)),
+                 StunMessage::ConvertGood);
+        QCOMPARE(view.mclass(), StunMessage::SuccessResponse);
+
+        TransportAddress addr;
+        QVERIFY(view.xorMappedAddress(addr));
+        QCOMPARE(addr, TransportAddress(QHostAddress("192.0.2.1"), 32853));
+
+        QVERIFY(!StunMessageView(packet.left(19)).isValid());
+        QVERIFY(!StunMessageView(packet.left(packet.size() - 4)).isValid());
+    }
+
+    void benchmarkEncode_data()
+    {
+        QTest::addColumn<bool>("cachedKey");
+        QTest::newRow("bare key") << false;
+        QTest::newRow("IntegrityKey") << true;
+    }
+
+    void benchmarkEncode()
+    {
+        QFETCH(bool, cachedKey);
+        const StunMessage         msg   = bindingRequest(9);
+        const int                 flags = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
+        const QByteArray          pass(samplePassword);
+        StunMessage::IntegrityKey key(pass);
+
+        QBENCHMARK
+        {
+            QByteArray packet = cachedKey ? msg.toBinary(flags, key) : msg.toBinary(flags, pass);
+            Q_UNUSED(packet)
+        }
+    }
+
+    void benchmarkValidate_data() { benchmarkEncode_data(); }
+
+    void benchmarkValidate()
+    {
+        QFETCH(bool, cachedKey);
+        const QByteArray          packet = QByteArray::fromHex(sampleRequest);
+        const int                 flags  = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
+        const QByteArray          pass(samplePassword);
+        StunMessage::IntegrityKey key(pass);
+
+        StunMessage::ConvertResult result = StunMessage::ErrorConvertUnknown;
+        QBENCHMARK
+        {
+            if (cachedKey)
+                StunMessage::fromBinary(packet, &result, flags, key);
+            else
+                StunMessage::fromBinary(packet, &result, flags, pass);
+        }
+        QCOMPARE(result, StunMessage::ConvertGood);
+    }
+
+    void benchmarkParse_data()
+    {
+        QTest::addColumn<bool>("view");
+        QTest::newRow("fromBinary") << false;
+        QTest::newRow("StunMessageView") << true;
+    }
+
+    void benchmarkParse()
+    {
+        QFETCH(bool, view);
+        const QByteArray          packet = QByteArray::fromHex(sampleRequest);
+        const int                 flags  = StunMessage::MessageIntegrity | StunMessage::Fingerprint;
+        StunMessage::IntegrityKey key(samplePassword);
+
+        // what an ice agent takes from an incoming binding request
+        quint32 priority = 0;
+        QBENCHMARK
+        {
+            if (view) {
+                StunMessageView v(packet);
+                QString         username;
+                if (v.validate(flags, key) == StunMessage::ConvertGood && v.username(&username))
+                    v.priority(&priority);
+            } else {
+                StunMessage msg = StunMessage::fromBinary(packet, nullptr, flags, key);
+                QString     username;
+                if (StunTypes::parseUsername(msg.attribute(StunTypes::USERNAME), &username))
+                    StunTypes::parsePriority(msg.attribute(StunTypes::PRIORITY), &priority);
+            }
+        }
+        QCOMPARE(priority, quint32(0x6e0001ff));
+    }
+
+    void benchmarkFingerprint()
+    {
+        const QByteArray           packet = QByteArray::fromHex(sampleRequest);
+        StunMessage::ConvertResult result = StunMessage::ErrorConvertUnknown;
+        QBENCHMARK { StunMessage::fromBinary(packet, &result, StunMessage::Fingerprint); }
+        QCOMPARE(result, StunMessage::ConvertGood);
+    }
+
+private:
+    QCA::Initializer initializer;
+};
+
+QTTESTUTIL_REGISTER_TEST(StunMessageTest);
+#include "stunmessagetest.moc"
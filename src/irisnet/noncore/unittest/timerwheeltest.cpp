@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "timerwheel.h"
+
+#include <QObject>
+#include <QThread>
+#include <QtTest/QtTest>
+
+#include <memory>
+#include <vector>
+
+using namespace XMPP;
+
+class TimerWheelTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testOrder()
+    {
+        TimerWheel        wheel;
+        QList<int>        fired;
+        TimerWheel::Timer a([&]() { fired += 100; }, &wheel);
+        TimerWheel::Timer b([&]() { fired += 20; }, &wheel);
+        TimerWheel::Timer c([&]() { fired += 60; }, &wheel);
+        for (auto t : { &a, &b, &c })
+            t->setSingleShot(true);
+        a.start(100);
+        b.start(20);
+        c.start(60);
+        QVERIFY(a.isActive());
+
+        QTRY_COMPARE(fired.count(), 3);
+        QCOMPARE(fired, QList<int>({ 20, 60, 100 }));
+        QVERIFY(!a.isActive());
+        QCOMPARE(wheel.stats().pending, 0);
+        QCOMPARE(wheel.stats().timeouts, qint64(3));
+    }
+
+    void testBatching()
+    {
+        // all within the first tick
+        TimerWheel                                      wheel(50);
+        int                                             count = 0;
+        std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+        for (int n = 0; n < 100; ++n) {
+            timers.emplace_back(new TimerWheel::Timer([&]() { ++count; }, &wheel));
+            timers.back()->setSingleShot(true);
+            timers.back()->start(n % 10);
+        }
+        QCOMPARE(wheel.stats().pending, 100);
+
+        QTRY_COMPARE(count, 100);
+        QVERIFY(wheel.stats().wakeups <= 2);
+    }
+
+    void testStopAndDelete()
+    {
+        TimerWheel                         wheel;
+        bool                               otherFired = false;
+        std::unique_ptr<TimerWheel::Timer> other(new TimerWheel::Timer([&]() { otherFired = true; }, &wheel));
+        std::unique_ptr<TimerWheel::Timer> self;
+        bool                               selfFired = false;
+        self.reset(new TimerWheel::Timer(
+            [&]() {
+                selfFired = true;
+                other.reset(); // due in the same wakeup
+                self.reset();
+            },
+            &wheel));
+        self->setSingleShot(true);
+        other->setSingleShot(true);
+        self->start(10);
+        other->start(10);
+
+        TimerWheel::Timer stopped([]() { QFAIL("stopped timer fired"); }, &wheel);
+        stopped.setSingleShot(true);
+        stopped.start(10);
+        stopped.stop();
+
+        QTRY_VERIFY(selfFired);
+        QVERIFY(!otherFired);
+        QCOMPARE(wheel.stats().pending, 0);
+    }
+
+    void testRepeat()
+    {
+        TimerWheel        wheel;
+        int               count = 0;
+        TimerWheel::Timer t(nullptr, &wheel);
+        t.setCallback([&]() {
+            if (++count == 3)
+                t.stop();
+        });
+        t.start(10);
+
+        QTRY_COMPARE(count, 3);
+        QTest::qWait(50);
+        QCOMPARE(count, 3);
+        QVERIFY(!t.isActive());
+    }
+
+    void testMoveTimers()
+    {
+        QThread                 thread;
+        QObject                 object;
+        QObject                 child(&object);
+        QAtomicPointer<QThread> firedOn;
+        TimerWheel::Timer       moved([&]() { firedOn.storeRelease(QThread::currentThread()); });
+        moved.setContext(&child);
+        moved.setSingleShot(true);
+        moved.start(50);
+
+        // given a wheel, a timer stays on it
+        TimerWheel        wheel;
+        bool              stayed = false;
+        TimerWheel::Timer pinned([&]() { stayed = true; }, &wheel);
+        pinned.setContext(&object);
+        pinned.setSingleShot(true);
+        pinned.start(50);
+
+        TimerWheel::instance()->moveTimers(&object);
+        QVERIFY(moved.isActive());
+        QVERIFY(pinned.isActive());
+        object.moveToThread(&thread);
+        thread.start();
+
+        QTRY_COMPARE(firedOn.loadAcquire(), &thread);
+        QTRY_VERIFY(stayed);
+        thread.quit();
+        QVERIFY(thread.wait());
+        QVERIFY(!moved.isActive());
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(TimerWheelTest);
+#include "timerwheeltest.moc"
@@ -0,0 +1,4 @@
+SOURCES += \
+    $$PWD/icechecklisttest.cpp \
+    $$PWD/stunmessagetest.cpp \
+    $$PWD/timerwheeltest.cpp
@@ -0,0 +1,23 @@
+include(../../../xmpp/modules.pri)
+include($$IRIS_XMPP_QA_UNITTEST_MODULE)
+include(unittest.pri)
+
+INCLUDEPATH *= $$PWD/..
+DEPENDPATH *= $$PWD/..
+
+HEADERS += \
+    $$PWD/../icechecklist.h \
+    $$PWD/../stunmessage.h \
+    $$PWD/../stuntypes.h \
+    $$PWD/../stunutil.h \
+    $$PWD/../timerwheel.h \
+    $$PWD/../transportaddress.h
+
+SOURCES += \
+    $$PWD/../stunmessage.cpp \
+    $$PWD/../stuntypes.cpp \
+    $$PWD/../stunutil.cpp \
+    $$PWD/../timerwheel.cpp
+
+include(../../../../../third-party/qca/qca.pri)
+include(../../../../../third-party/qca/qca-ossl.pri)
@@ -24,97 +24,155 @@
 #endif
 
 #include "qstringprep.h"
+#include <QCache>
 #include <QCoreApplication>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QVector>
+
+#include <atomic>
+#include <cstring>
 
 using namespace XMPP;
 
 //----------------------------------------------------------------------------
 // StringPrepCache
 //----------------------------------------------------------------------------
-QScopedPointer<StringPrepCache> StringPrepCache::_instance;
-
-bool StringPrepCache::nameprep(const QString &in, int maxbytes, QString &out)
-{
-    if (in.trimmed().isEmpty()) {
-        out = QString();
-        return false; // empty names or just spaces are disallowed (rfc5892+rfc6122)
+namespace {
+// ascii characters a profile passes through unchanged
+class AsciiSet {
+public:
+    AsciiSet(ushort first, ushort last, const char *excluded = "", bool upper = true)
+    {
+        for (ushort c = first; c <= last; ++c)
+            bits[c >> 5] |= 1u << (c & 31);
+        for (; *excluded; ++excluded)
+            bits[uchar(*excluded) >> 5] &= ~(1u << (uchar(*excluded) & 31));
+        if (!upper) {
+            for (ushort c = 'A'; c <= 'Z'; ++c)
+                bits[c >> 5] &= ~(1u << (c & 31));
+        }
     }
 
-    StringPrepCache *that = instance();
-
-    auto it = that->nameprep_table.constFind(in);
-    if (it != that->nameprep_table.constEnd()) {
-        if (it.value().isNull()) {
-            return false;
+    // c must be < 0x80
+    bool has(ushort c) const { return bits[c >> 5] & (1u << (c & 31)); }
+
+    bool containsAll(const QString &s) const
+    {
+        const ushort *p = s.utf16();
+        const int     n = s.size();
+        int           i = 0;
+        // drop out on the first non-ascii char, four chars at a time
+        for (; i + 4 <= n; i += 4) {
+            quint64 w;
+            memcpy(&w, p + i, sizeof(w));
+            if (w & Q_UINT64_C(0xff80ff80ff80ff80))
+                return false;
+            if (!(has(p[i]) && has(p[i + 1]) && has(p[i + 2]) && has(p[i + 3])))
+                return false;
+        }
+        for (; i < n; ++i) {
+            if (p[i] >= 0x80 || !has(p[i]))
+                return false;
         }
-        out = it.value();
         return true;
     }
 
-    out = in;
-    if (stringprep(out, (Stringprep_profile_flags)0, stringprep_nameprep) != 0 || out.size() > maxbytes) {
-        that->nameprep_table.insert(in, QString());
-        return false;
-    }
+private:
+    quint32 bits[4] = { 0, 0, 0, 0 };
+};
+
+struct ProfileInfo {
+    const Stringprep_profile *profile;
+    AsciiSet                  prepped;
+};
 
-    that->nameprep_table.insert(in, out);
-    return true;
+// for ascii input the profiles only case fold (B.2) and prohibit the space (C.1.1), controls (C.2.1) and the
+// nodeprep specials. so anything else is already normalized
+const ProfileInfo &profileInfo(StringPrepCache::Profile profile)
+{
+    static const ProfileInfo infos[StringPrepCache::ProfileCount]
+        = { { stringprep_nameprep, AsciiSet(0x21, 0x7e, "", false) },
+            { stringprep_xmpp_nodeprep, AsciiSet(0x21, 0x7e, "\"&'/:<>@", false) },
+            { stringprep_xmpp_resourceprep, AsciiSet(0x20, 0x7e) },
+            { stringprep_saslprep, AsciiSet(0x20, 0x7e) } };
+    return infos[profile];
 }
 
-bool StringPrepCache::nodeprep(const QString &in, int maxbytes, QString &out)
+std::atomic<int> cacheCapacity { StringPrepCache::DefaultCapacity };
+} // namespace
+
+class StringPrepCache::Table {
+public:
+    QMutex                   mutex;
+    QCache<QString, QString> lru; // null string if rejected by stringprep()
+    quint64                  hits   = 0;
+    quint64                  misses = 0;
+    std::atomic<quint64>     fastPath { 0 };
+
+    Table() : lru(cacheCapacity) { }
+};
+
+QAtomicPointer<StringPrepCache> StringPrepCache::_instance;
+
+bool StringPrepCache::prep(Profile profile, const QString &in, int maxbytes, QString &out)
 {
-    if (in.isEmpty()) {
-        out = QString();
-        return true;
+    const ProfileInfo &info = profileInfo(profile);
+    if (info.prepped.containsAll(in)) {
+        instance()->tables[profile]->fastPath.fetch_add(1, std::memory_order_relaxed);
+        out = in;
+        return out.size() <= maxbytes;
     }
 
-    StringPrepCache *that = instance();
-
-    auto it = that->nodeprep_table.constFind(in);
-    if (it != that->nodeprep_table.constEnd()) {
-        if (it.value().isNull()) {
-            return false;
+    Table &t = *instance()->tables[profile];
+    {
+        QMutexLocker locker(&t.mutex);
+        if (const QString *cached = t.lru.object(in)) {
+            ++t.hits;
+            out = *cached;
+            return !out.isNull() && out.size() <= maxbytes;
         }
-        out = it.value();
-        return true;
+        ++t.misses;
     }
 
-    out = in;
-    if (stringprep(out, (Stringprep_profile_flags)0, stringprep_xmpp_nodeprep) != 0 || out.size() > maxbytes) {
-        that->nodeprep_table.insert(in, QString());
-        return false;
+    // stringprep() runs unlocked. two threads may prep the same string, the second insert just replaces the first
+    QString prepped = in;
+    if (stringprep(prepped, (Stringprep_profile_flags)0, info.profile) != 0)
+        prepped = QString();
+    {
+        QMutexLocker locker(&t.mutex);
+        t.lru.insert(in, new QString(prepped));
     }
 
-    that->nodeprep_table.insert(in, out);
-    return true;
+    out = prepped;
+    return !out.isNull() && out.size() <= maxbytes;
 }
 
-bool StringPrepCache::resourceprep(const QString &in, int maxbytes, QString &out)
+bool StringPrepCache::nameprep(const QString &in, int maxbytes, QString &out)
 {
-    if (in.isEmpty()) {
+    if (in.trimmed().isEmpty()) {
         out = QString();
-        return true;
+        return false; // empty names or just spaces are disallowed (rfc5892+rfc6122)
     }
+    return prep(NamePrep, in, maxbytes, out);
+}
 
-    StringPrepCache *that = instance();
-
-    auto it = that->resourceprep_table.constFind(in);
-    if (it != that->resourceprep_table.constEnd()) {
-        if (it.value().isNull()) {
-            return false;
-        }
-        out = it.value();
+bool StringPrepCache::nodeprep(const QString &in, int maxbytes, QString &out)
+{
+    if (in.isEmpty()) {
+        out = QString();
         return true;
     }
+    return prep(NodePrep, in, maxbytes, out);
+}
 
-    out = in;
-    if (stringprep(out, (Stringprep_profile_flags)0, stringprep_xmpp_resourceprep) != 0 || out.size() > maxbytes) {
-        that->resourceprep_table.insert(in, QString());
-        return false;
+bool StringPrepCache::resourceprep(const QString &in, int maxbytes, QString &out)
+{
+    if (in.isEmpty()) {
+        out = QString();
+        return true;
     }
-
-    that->resourceprep_table.insert(in, out);
-    return true;
+    return prep(ResourcePrep, in, maxbytes, out);
 }
 
 bool StringPrepCache::saslprep(const QString &in, int maxbytes, QString &out)
@@ -123,42 +181,72 @@ bool StringPrepCache::saslprep(const QString &in, int maxbytes, QString &out)
         out = QString();
         return true;
     }
+    return prep(SaslPrep, in, maxbytes, out);
+}
 
+void StringPrepCache::setCapacity(int entries)
+{
+    cacheCapacity = qMax(0, entries);
     StringPrepCache *that = instance();
-
-    auto it = that->saslprep_table.constFind(in);
-    if (it != that->saslprep_table.constEnd()) {
-        if (it.value().isNull()) {
-            return false;
-        }
-        out = it.value();
-        return true;
+    for (auto &t : that->tables) {
+        QMutexLocker locker(&t->mutex);
+        t->lru.setMaxCost(cacheCapacity);
     }
+}
 
-    out = in;
-    if (stringprep(out, (Stringprep_profile_flags)0, stringprep_saslprep) != 0 || out.size() > maxbytes) {
-        that->saslprep_table.insert(in, QString());
-        return false;
-    }
+int StringPrepCache::capacity() { return cacheCapacity; }
 
-    that->saslprep_table.insert(in, out);
-    return true;
+StringPrepCache::Stats StringPrepCache::stats(Profile profile)
+{
+    Table &      t = *instance()->tables[profile];
+    QMutexLocker locker(&t.mutex);
+    Stats        s;
+    s.hits     = t.hits;
+    s.misses   = t.misses;
+    s.fastPath = t.fastPath;
+    s.entries  = t.lru.count();
+    return s;
 }
 
-void StringPrepCache::cleanup() { _instance.reset(nullptr); }
+void StringPrepCache::clear()
+{
+    StringPrepCache *that = instance();
+    for (auto &t : that->tables) {
+        QMutexLocker locker(&t->mutex);
+        t->lru.clear();
+        t->hits     = 0;
+        t->misses   = 0;
+        t->fastPath = 0;
+    }
+}
+
+// not thread safe. called on shutdown
+void StringPrepCache::cleanup() { delete _instance.fetchAndStoreOrdered(nullptr); }
 
 StringPrepCache *StringPrepCache::instance()
 {
-    if (!_instance) {
-        _instance.reset(new StringPrepCache);
+    StringPrepCache *that = _instance.loadAcquire();
+    if (that)
+        return that;
+
+    auto created = new StringPrepCache;
+    if (!_instance.testAndSetOrdered(nullptr, created)) {
+        delete created; // another thread won
+        return _instance.loadAcquire();
+    }
 #ifndef NO_IRISNET
-        irisNetAddPostRoutine(cleanup); // REVIEW probably not necessary since heap will be deallocated with destructors
+    irisNetAddPostRoutine(cleanup); // REVIEW probably not necessary since heap will be deallocated with destructors
 #endif
-    }
-    return _instance.data();
+    return created;
 }
 
-StringPrepCache::StringPrepCache() { }
+StringPrepCache::StringPrepCache()
+{
+    for (auto &t : tables)
+        t.reset(new Table);
+}
+
+StringPrepCache::~StringPrepCache() { }
 
 //----------------------------------------------------------------------------
 // Jid
@@ -173,19 +261,100 @@ static inline bool validResource(const QString &s, QString &norm)
     return StringPrepCache::resourceprep(s, 1024, norm);
 }
 
+// parsed and normalized strings to their blocks. the table is shared by all the threads behind a mutex, and each
+//   thread also keeps the strings it saw last, so parsing one of them again takes no lock. a string new to the
+//   thread locks the table once to look it up, and once more if it is new to the table as well
+class Jid::Table {
+public:
+    enum { Capacity = 4096, RecentCapacity = 256 };
+
+    QExplicitlySharedDataPointer<Data> find(const QString &s)
+    {
+        Recent &r = recent(s);
+        if (r.data && r.key == s)
+            return r.data;
+
+        QExplicitlySharedDataPointer<Data> ret;
+        {
+            QMutexLocker locker(&mutex);
+            if (auto data = lru.object(s))
+                ret = *data;
+        }
+        if (ret)
+            r = { s, ret };
+        return ret;
+    }
+
+    // the block the string has already, or else data
+    QExplicitlySharedDataPointer<Data> intern(const QString &s, const QExplicitlySharedDataPointer<Data> &data)
+    {
+        Recent &r = recent(s);
+        if (r.data && r.key == s)
+            return r.data;
+
+        QExplicitlySharedDataPointer<Data> ret = data;
+        {
+            QMutexLocker locker(&mutex);
+            if (auto found = lru.object(s))
+                ret = *found;
+            else
+                lru.insert(s, new QExplicitlySharedDataPointer<Data>(data));
+        }
+        r = { s, ret };
+        return ret;
+    }
+
+    void insert(const QString &s, const QExplicitlySharedDataPointer<Data> &data)
+    {
+        {
+            QMutexLocker locker(&mutex);
+            lru.insert(s, new QExplicitlySharedDataPointer<Data>(data));
+        }
+        recent(s) = { s, data };
+    }
+
+    static Table *instance()
+    {
+        static Table table;
+        return &table;
+    }
+
+private:
+    struct Recent {
+        QString                            key;
+        QExplicitlySharedDataPointer<Data> data;
+    };
+
+    QMutex                                              mutex;
+    QCache<QString, QExplicitlySharedDataPointer<Data>> lru { Capacity };
+    QThreadStorage<QVector<Recent> *>                   recents;
+
+    // direct mapped, a string takes the place of whatever was there
+    Recent &recent(const QString &s)
+    {
+        if (!recents.hasLocalData())
+            recents.setLocalData(new QVector<Recent>(RecentCapacity));
+        return (*recents.localData())[int(qHash(s) & (RecentCapacity - 1))];
+    }
+};
+
 Jid::Jid()
 {
-    valid = false;
-    null  = true;
+    static const QExplicitlySharedDataPointer<Data> nullData = [] {
+        QExplicitlySharedDataPointer<Data> data(new Data);
+        data->hash = qHash(QString());
+        return data;
+    }();
+    p = nullData;
 }
 
 Jid::~Jid() { }
 
-Jid::Jid(const QString &s) { set(s); }
+Jid::Jid(const QString &s) : Jid() { set(s); }
 
-Jid::Jid(const QString &node, const QString &domain, const QString &resource) { set(domain, node, resource); }
+Jid::Jid(const QString &node, const QString &domain, const QString &resource) : Jid() { set(domain, node, resource); }
 
-Jid::Jid(const char *s) { set(QString(s)); }
+Jid::Jid(const char *s) : Jid() { set(QString(s)); }
 
 Jid &Jid::operator=(const QString &s)
 {
@@ -199,35 +368,40 @@ Jid &Jid::operator=(const char *s)
     return *this;
 }
 
-void Jid::reset()
-{
-    f     = QString();
-    b     = QString();
-    d     = QString();
-    n     = QString();
-    r     = QString();
-    valid = false;
-    null  = true;
-}
+void Jid::reset() { *this = Jid(); }
 
-void Jid::update()
+// expects normalized parts
+void Jid::update(const QString &domain, const QString &node, const QString &resource)
 {
-    // build 'bare' and 'full' jids
-    if (n.isEmpty())
-        b = d;
+    QString bare, full;
+    if (node.isEmpty())
+        bare = domain;
     else
-        b = n + '@' + d;
-    if (r.isEmpty())
-        f = b;
+        bare = node + '@' + domain;
+    if (resource.isEmpty())
+        full = bare;
     else
-        f = b + '/' + r;
-    if (f.isEmpty())
-        valid = false;
-    null = f.isEmpty() && r.isEmpty();
+        full = bare + '/' + resource;
+
+    QExplicitlySharedDataPointer<Data> data(new Data);
+    data->full     = full;
+    data->bare     = bare;
+    data->domain   = domain;
+    data->node     = node;
+    data->resource = resource;
+    data->hash     = qHash(full);
+    data->valid    = true;
+    p              = Table::instance()->intern(full, data);
 }
 
 void Jid::set(const QString &s)
 {
+    Table *table = Table::instance();
+    if (auto data = table->find(s)) {
+        p = data;
+        return;
+    }
+
     QString rest, domain, node, resource;
     QString norm_domain, norm_node, norm_resource;
     int     x = s.indexOf('/');
@@ -256,12 +430,9 @@ void Jid::set(const QString &s)
         return;
     }
 
-    valid = true;
-    null  = false;
-    d     = norm_domain;
-    n     = norm_node;
-    r     = norm_resource;
-    update();
+    update(norm_domain, norm_node, norm_resource);
+    if (p->full != s)
+        table->insert(s, p);
 }
 
 void Jid::set(const QString &domain, const QString &node, const QString &resource)
@@ -271,51 +442,43 @@ void Jid::set(const QString &domain, const QString &node, const QString &resourc
         reset();
         return;
     }
-    valid = true;
-    null  = false;
-    d     = norm_domain;
-    n     = norm_node;
-    r     = norm_resource;
-    update();
+    update(norm_domain, norm_node, norm_resource);
 }
 
 void Jid::setDomain(const QString &s)
 {
-    if (!valid)
+    if (!p->valid)
         return;
     QString norm;
     if (!validDomain(s, norm)) {
         reset();
         return;
     }
-    d = norm;
-    update();
+    update(norm, p->node, p->resource);
 }
 
 void Jid::setNode(const QString &s)
 {
-    if (!valid)
+    if (!p->valid)
         return;
     QString norm;
     if (!validNode(s, norm)) {
         reset();
         return;
     }
-    n = norm;
-    update();
+    update(p->domain, norm, p->resource);
 }
 
 void Jid::setResource(const QString &s)
 {
-    if (!valid)
+    if (!p->valid)
         return;
     QString norm;
     if (!validResource(s, norm)) {
         reset();
         return;
     }
-    r = norm;
-    update();
+    update(p->domain, p->node, norm);
 }
 
 Jid Jid::withNode(const QString &s) const
@@ -339,18 +502,21 @@ Jid Jid::withResource(const QString &s) const
     return j;
 }
 
-bool Jid::isValid() const { return valid; }
+bool Jid::isValid() const { return p->valid; }
 
-bool Jid::isEmpty() const { return f.isEmpty(); }
+bool Jid::isEmpty() const { return p->full.isEmpty(); }
 
 bool Jid::compare(const Jid &a, bool compareRes) const
 {
-    if (null && a.null)
+    // interned or copied jids share the block. this also covers two null jids
+    if (p == a.p)
         return true;
 
     // only compare valid jids
-    if (!valid || !a.valid)
+    if (!p->valid || !a.p->valid)
         return false;
 
-    return !(compareRes ? (f != a.f) : (b != a.b));
+    if (compareRes)
+        return p->hash == a.p->hash && p->full == a.p->full;
+    return p->bare == a.p->bare;
 }
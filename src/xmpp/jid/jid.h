@@ -20,33 +20,69 @@
 #ifndef XMPP_JID_H
 #define XMPP_JID_H
 
+#include <QAtomicPointer>
 #include <QByteArray>
 #include <QHash>
 #include <QScopedPointer>
+#include <QSharedData>
 #include <QString>
 
 namespace XMPP {
+/**
+ * @brief Cache of stringprep() results, shared by all threads.
+ *
+ * Each profile has its own LRU table bounded to capacity() entries, behind
+ * its own lock. Strings which are already in normalized form for the profile
+ * (plain ascii without the characters the profile maps or prohibits) are
+ * returned as is, without looking at the table or calling stringprep().
+ */
 class StringPrepCache {
 public:
+    enum Profile { NamePrep, NodePrep, ResourcePrep, SaslPrep, ProfileCount };
+    enum { DefaultCapacity = 4096 };
+
+    struct Stats {
+        quint64 hits     = 0; // found in the table
+        quint64 misses   = 0; // went through stringprep()
+        quint64 fastPath = 0; // already normalized
+        int     entries  = 0;
+    };
+
     static bool nameprep(const QString &in, int maxbytes, QString &out);
     static bool nodeprep(const QString &in, int maxbytes, QString &out);
     static bool resourceprep(const QString &in, int maxbytes, QString &out);
     static bool saslprep(const QString &in, int maxbytes, QString &out);
 
+    // entries per profile. 0 disables the tables
+    static void  setCapacity(int entries);
+    static int   capacity();
+    static Stats stats(Profile profile);
+    static void  clear();
+
     static void cleanup();
 
 private:
-    QHash<QString, QString> nameprep_table;
-    QHash<QString, QString> nodeprep_table;
-    QHash<QString, QString> resourceprep_table;
-    QHash<QString, QString> saslprep_table;
+    class Table;
+    QScopedPointer<Table> tables[ProfileCount];
 
-    static QScopedPointer<StringPrepCache> _instance;
+    static QAtomicPointer<StringPrepCache> _instance;
     static StringPrepCache *               instance();
 
     StringPrepCache();
+    ~StringPrepCache();
+
+    static bool prep(Profile profile, const QString &in, int maxbytes, QString &out);
 };
 
+/**
+ * @brief XMPP address.
+ *
+ * The parts live in one immutable block shared by all the copies, so a Jid is
+ * a single pointer. Parsed addresses are interned: the same string parsed again
+ * reuses the block of the first one without splitting or stringprep, and equal
+ * jids usually compare by pointer. The unseeded hash of the full jid is computed
+ * once.
+ */
 class Jid {
 public:
     Jid();
@@ -58,12 +94,12 @@ public:
     Jid &operator=(const QString &s);
     Jid &operator=(const char *s);
 
-    bool           isNull() const { return null; }
-    const QString &domain() const { return d; }
-    const QString &node() const { return n; }
-    const QString &resource() const { return r; }
-    const QString &bare() const { return b; }
-    const QString &full() const { return f; }
+    bool           isNull() const { return !p->valid; }
+    const QString &domain() const { return p->domain; }
+    const QString &node() const { return p->node; }
+    const QString &resource() const { return p->resource; }
+    const QString &bare() const { return p->bare; }
+    const QString &full() const { return p->full; }
 
     Jid withNode(const QString &s) const;
     Jid withDomain(const QString &s) const;
@@ -84,16 +120,27 @@ private:
     void setResource(const QString &s);
 
 private:
+    class Data : public QSharedData {
+    public:
+        QString full, bare, domain, node, resource;
+        uint    hash  = 0; // qHash(full), unseeded
+        bool    valid = false;
+    };
+    class Table;
+
     void reset();
-    void update();
+    void update(const QString &domain, const QString &node, const QString &resource);
+
+    QExplicitlySharedDataPointer<Data> p; // never null
 
-    QString f, b, d, n, r;
-    bool    valid, null;
+    friend uint qHash(const Jid &key, uint seed) Q_DECL_NOTHROW;
 };
 
+// a seeded hash can't be made from the cached one without giving away the seed protection of QHash,
+//   so that one is computed every time
 Q_DECL_PURE_FUNCTION inline uint qHash(const XMPP::Jid &key, uint seed = 0) Q_DECL_NOTHROW
 {
-    return qHash(key.full(), seed);
+    return seed ? qHash(key.p->full, seed) : key.p->hash;
 }
 } // namespace XMPP
 
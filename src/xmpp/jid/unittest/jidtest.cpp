@@ -38,6 +38,71 @@ private slots:
         QCOMPARE(testling.domain(), QString("bar"));
         QCOMPARE(testling.resource(), QString("baz"));
     }
+
+    void testNormalization()
+    {
+        Jid testling(QString::fromUtf8("Foo@Bar.example/Baz Qux"));
+
+        QCOMPARE(testling.node(), QString("foo"));
+        QCOMPARE(testling.domain(), QString("bar.example"));
+        QCOMPARE(testling.resource(), QString("Baz Qux"));
+        QVERIFY(!Jid("f\"o@bar").isValid());
+        QVERIFY(!Jid("foo bar@bar").isValid());
+    }
+
+    void testInterning()
+    {
+        Jid a("foo@bar/baz");
+        Jid b("Foo@BAR/baz");
+        Jid c = Jid("foo@bar").withResource("baz");
+
+        QCOMPARE(a, b);
+        QCOMPARE(a, c);
+        QCOMPARE(a.full().constData(), b.full().constData());
+        QCOMPARE(qHash(a), qHash(c));
+        QCOMPARE(qHash(a, 42), qHash(a.full(), 42)); // seeded, as QHash does
+        QCOMPARE(a.bare(), QString("foo@bar"));
+        QVERIFY(a.compare(Jid("foo@bar/other"), false));
+        QVERIFY(a != Jid("foo@bar/other"));
+
+        QVERIFY(Jid().isNull());
+        QCOMPARE(Jid(), Jid("@"));
+        QVERIFY(Jid() != a);
+        QVERIFY(Jid("bar").withNode("x@y").isNull());
+    }
+
+    void testStringPrepFastPath()
+    {
+        StringPrepCache::clear();
+
+        QString out;
+        QVERIFY(StringPrepCache::nodeprep("alice.smith", 1024, out));
+        QCOMPARE(out, QString("alice.smith"));
+        QVERIFY(StringPrepCache::nodeprep("Alice", 1024, out));
+        QCOMPARE(out, QString("alice"));
+        QVERIFY(StringPrepCache::nodeprep("Alice", 1024, out));
+        QVERIFY(!StringPrepCache::nodeprep("alice", 3, out));
+
+        StringPrepCache::Stats s = StringPrepCache::stats(StringPrepCache::NodePrep);
+        QCOMPARE(s.fastPath, quint64(2));
+        QCOMPARE(s.misses, quint64(1));
+        QCOMPARE(s.hits, quint64(1));
+        QCOMPARE(s.entries, 1);
+    }
+
+    void testStringPrepCacheBounded()
+    {
+        StringPrepCache::clear();
+        StringPrepCache::setCapacity(8);
+
+        QString out;
+        for (int n = 0; n < 100; ++n)
+            QVERIFY(StringPrepCache::resourceprep(QString::fromUtf8("r\xc3\xa9s %1").arg(n), 1024, out));
+        QCOMPARE(StringPrepCache::stats(StringPrepCache::ResourcePrep).entries, 8);
+        QCOMPARE(StringPrepCache::stats(StringPrepCache::ResourcePrep).misses, quint64(100));
+
+        StringPrepCache::setCapacity(StringPrepCache::DefaultCapacity);
+    }
 };
 
 QTTESTUTIL_REGISTER_TEST(JidTest);
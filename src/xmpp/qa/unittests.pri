@@ -2,3 +2,8 @@
 
 include($$PWD/../base/unittest/unittest.pri)
 include($$PWD/../sasl/unittest/unittest.pri)
+include($$PWD/../xmpp-core/unittest/unittest.pri)
+include($$PWD/../xmpp-im/unittest/unittest.pri)
+include($$PWD/../zlib/unittest/unittest.pri)
+include($$PWD/../../irisnet/noncore/cutestuff/unittest/unittest.pri)
+include($$PWD/../../irisnet/noncore/unittest/unittest.pri)
@@ -5,13 +5,11 @@
 #include <QDebug>
 #include <QTimer>
 
-CompressionHandler::CompressionHandler() : errorCode_(0)
+CompressionHandler::CompressionHandler(const ZLibOptions &options) :
+    outgoingPlain_(0), outgoingScheduled_(false), incomingScheduled_(false), errorCode_(0)
 {
-    outgoing_buffer_.open(QIODevice::ReadWrite);
-    compressor_ = new ZLibCompressor(&outgoing_buffer_);
-
-    incoming_buffer_.open(QIODevice::ReadWrite);
-    decompressor_ = new ZLibDecompressor(&incoming_buffer_);
+    compressor_   = new ZLibCompressor(options);
+    decompressor_ = new ZLibDecompressor();
 }
 
 CompressionHandler::~CompressionHandler()
@@ -24,40 +22,66 @@ void CompressionHandler::writeIncoming(const QByteArray &a)
 {
     // qDebug("CompressionHandler::writeIncoming");
     // qDebug() << QString("Incoming %1 bytes").arg(a.size());
-    errorCode_ = int(decompressor_->write(a));
-    if (!errorCode_)
-        QTimer::singleShot(0, this, SIGNAL(readyRead()));
-    else
+    errorCode_ = int(decompressor_->write(a, &incoming_));
+    if (errorCode_)
         QTimer::singleShot(0, this, SIGNAL(error()));
+    else if (!incomingScheduled_) {
+        incomingScheduled_ = true;
+        QTimer::singleShot(0, this, SLOT(flushIncoming()));
+    }
 }
 
 void CompressionHandler::write(const QByteArray &a)
 {
     // qDebug() << QString("CompressionHandler::write(%1)").arg(a.size());
-    errorCode_ = compressor_->write(a);
+    // Everything written before we get back to the event loop is compressed
+    // and sync flushed at once, instead of flushing the stream after every
+    // stanza
+    pending_ += a;
+    if (!outgoingScheduled_) {
+        outgoingScheduled_ = true;
+        QTimer::singleShot(0, this, SLOT(flushOutgoing()));
+    }
+}
+
+void CompressionHandler::flushOutgoing()
+{
+    outgoingScheduled_ = false;
+    if (pending_.isEmpty())
+        return;
+
+    errorCode_ = compressor_->write(pending_, &outgoing_);
+    outgoingPlain_ += pending_.size();
+    pending_.clear();
     if (!errorCode_)
-        QTimer::singleShot(0, this, SIGNAL(readyReadOutgoing()));
+        emit readyReadOutgoing();
     else
-        QTimer::singleShot(0, this, SIGNAL(error()));
+        emit error();
+}
+
+void CompressionHandler::flushIncoming()
+{
+    incomingScheduled_ = false;
+    if (!incoming_.isEmpty())
+        emit readyRead();
 }
 
 QByteArray CompressionHandler::read()
 {
     // qDebug("CompressionHandler::read");
-    QByteArray b = incoming_buffer_.buffer();
-    incoming_buffer_.buffer().clear();
-    incoming_buffer_.reset();
+    QByteArray b;
+    b.swap(incoming_);
     return b;
 }
 
 QByteArray CompressionHandler::readOutgoing(int *i)
 {
     // qDebug("CompressionHandler::readOutgoing");
-    // qDebug() << QString("Outgoing %1 bytes").arg(outgoing_buffer_.size());
-    QByteArray b = outgoing_buffer_.buffer();
-    outgoing_buffer_.buffer().clear();
-    outgoing_buffer_.reset();
-    *i = b.size();
+    // qDebug() << QString("Outgoing %1 bytes").arg(outgoing_.size());
+    QByteArray b;
+    b.swap(outgoing_);
+    *i             = outgoingPlain_;
+    outgoingPlain_ = 0;
     return b;
 }
 
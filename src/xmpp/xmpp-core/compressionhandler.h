@@ -1,17 +1,17 @@
 #ifndef COMPRESSIONHANDLER_H
 #define COMPRESSIONHANDLER_H
 
-#include <QBuffer>
+#include "xmpp/zlib/zlibcompressor.h"
+
 #include <QObject>
 
-class ZLibCompressor;
 class ZLibDecompressor;
 
 class CompressionHandler : public QObject {
     Q_OBJECT
 
 public:
-    CompressionHandler();
+    CompressionHandler(const ZLibOptions &options = ZLibOptions());
     ~CompressionHandler();
     void       writeIncoming(const QByteArray &a);
     void       write(const QByteArray &a);
@@ -24,10 +24,17 @@ signals:
     void readyReadOutgoing();
     void error();
 
+private slots:
+    void flushOutgoing();
+    void flushIncoming();
+
 private:
     ZLibCompressor *  compressor_;
     ZLibDecompressor *decompressor_;
-    QBuffer           outgoing_buffer_, incoming_buffer_;
+    QByteArray        pending_; // plain data written since the last flush
+    QByteArray        outgoing_, incoming_;
+    int               outgoingPlain_;
+    bool              outgoingScheduled_, incomingScheduled_;
     int               errorCode_;
 };
 
@@ -19,10 +19,79 @@
 
 #include "parser.h"
 
+#include "stanzatree.h"
+#include "xmpp_atoms.h"
+
+#include <deque>
 #include <queue>
 
 namespace XMPP {
 
+//----------------------------------------------------------------------------
+// InputQueue
+//----------------------------------------------------------------------------
+// Received chunks waiting to be fed to the reader. Chunks are never split or
+// shifted: the front one is consumed by moving an offset, and a partial
+// feed is handed to the reader as a raw-data view (QXmlStreamReader copies
+// it into its own buffer anyway).
+class InputQueue {
+public:
+    void append(const QByteArray &a)
+    {
+        chunks.push_back(a);
+        appended += a.size();
+        int n = a.lastIndexOf('>'); // this may happend in CDATA too, but let's hope Qt handles it properly
+        if (n != -1)
+            completeEnd = appended - a.size() + n + 1;
+    }
+
+    // true if there is data ending with '>' not passed to the reader yet
+    bool hasCompleteTag() const { return completeEnd > consumed; }
+
+    // feeds everything up to and including the last known '>'
+    void feedCompleteTo(QXmlStreamReader &reader)
+    {
+        while (consumed < completeEnd) {
+            const QByteArray &front = chunks.front();
+            int               avail = front.size() - frontOffset;
+            int               take  = int(qMin<qint64>(avail, completeEnd - consumed));
+            if (frontOffset == 0 && take == front.size())
+                reader.addData(front);
+            else
+                reader.addData(QByteArray::fromRawData(front.constData() + frontOffset, take));
+            consumed += take;
+            if (take == avail) {
+                chunks.pop_front();
+                frontOffset = 0;
+            } else {
+                frontOffset += take;
+            }
+        }
+    }
+
+    QByteArray unprocessed() const
+    {
+        QByteArray ret;
+        ret.reserve(int(appended - consumed));
+        bool first = true;
+        for (auto const &a : chunks) {
+            if (first && frontOffset)
+                ret.append(a.constData() + frontOffset, a.size() - frontOffset);
+            else
+                ret += a;
+            first = false;
+        }
+        return ret;
+    }
+
+private:
+    std::deque<QByteArray> chunks;
+    int                    frontOffset = 0; // consumed part of chunks.front()
+    qint64                 appended    = 0; // stream positions
+    qint64                 consumed    = 0;
+    qint64                 completeEnd = 0; // position right after the last '>'. workaround for bugs like QTBUG-14661
+};
+
 //----------------------------------------------------------------------------
 // Event
 //----------------------------------------------------------------------------
@@ -34,6 +103,11 @@ public:
     QDomElement          e;
     QString              str;
 
+    // element is converted from the tree on first request
+    std::shared_ptr<StanzaTree> tree;
+    QDomDocument                doc;
+    StanzaDocument              stanzaDoc; // instead of doc for stanzas
+
     QXmlStreamNamespaceDeclarations nsPrefixes;
 };
 
@@ -107,9 +181,29 @@ QString Parser::Event::actualString() const
 QDomElement Parser::Event::element() const
 {
     Q_ASSERT(d != nullptr);
+    if (d->e.isNull() && d->tree) {
+        if (d->stanzaDoc.isNull()) {
+            d->e = d->tree->toElement(d->doc);
+        } else {
+            d->e = d->tree->toElement(d->stanzaDoc.document());
+            d->stanzaDoc.setRoot(d->e);
+        }
+    }
     return d->e;
 }
 
+StanzaDocument Parser::Event::document() const
+{
+    Q_ASSERT(d != nullptr);
+    return d->stanzaDoc;
+}
+
+const StanzaTree *Parser::Event::stanzaTree() const
+{
+    Q_ASSERT(d != nullptr);
+    return d->tree.get();
+}
+
 void Parser::Event::setDocumentOpen(const QString &namespaceURI, const QString &localName, const QString &qName,
                                     const QXmlStreamAttributes &atts, const QXmlStreamNamespaceDeclarations &nsPrefixes)
 {
@@ -131,11 +225,22 @@ void Parser::Event::setDocumentClose(const QString &namespaceURI, const QString
     d->qn   = qName;
 }
 
-void Parser::Event::setElement(const QDomElement &elem)
+void Parser::Event::setElement(const QDomElement &elem, const StanzaDocument &stanzaDoc)
 {
     ensureD();
-    d->type = Element;
-    d->e    = elem;
+    d->type      = Element;
+    d->e         = elem;
+    d->stanzaDoc = stanzaDoc;
+}
+
+void Parser::Event::setStanzaTree(const std::shared_ptr<StanzaTree> &tree, const QDomDocument &doc,
+                                  const StanzaDocument &stanzaDoc)
+{
+    ensureD();
+    d->type      = Element;
+    d->tree      = tree;
+    d->doc       = doc;
+    d->stanzaDoc = stanzaDoc;
 }
 
 void Parser::Event::setError()
@@ -155,49 +260,78 @@ void Parser::Event::setActualString(const QString &str)
 //----------------------------------------------------------------------------
 class Parser::Private {
 public:
-    QDomDocument          doc;
+    QDomDocument          doc;       // stream level elements
+    StanzaDocument        stanzaDoc; // of the stanza being parsed
     QDomElement           curElement;
     QDomElement           element; // root part
-    std::list<QByteArray> in;
+    InputQueue            in;
     QXmlStreamReader      reader;
-    const char *          completeTag    = nullptr; // this is basically a workaround for bugs like QTBUG-14661
-    int                   completeOffset = 0;
-    bool                  streamOpened   = false;
-    bool                  readerStarted  = false;
+    bool                  streamOpened  = false;
+    bool                  readerStarted = false;
     std::queue<Event>     events;
     QString               streamQName;
 
+    // stanza tree mode
+    bool                        useTree = false;
+    std::shared_ptr<NameTable>  names;
+    std::shared_ptr<StanzaTree> tree;
+    int                         curNode = -1;
+
+    // stanzas get a document each, released once they are dispatched. the stream level elements are few and
+    // some are kept by the protocol for the life of the stream, so they stay in the parser's one
+    static bool isStanza(const QStringRef &name)
+    {
+        return name == Atom::string(Atom::Message) || name == Atom::string(Atom::Presence)
+            || name == Atom::string(Atom::Iq);
+    }
+
+    QDomDocument &elementDoc() { return stanzaDoc.isNull() ? doc : stanzaDoc.document(); }
+
     void pushDataToReader()
     {
-        if (completeTag) {
+        // Qt has some bugs, so ensure we push data only ending with '>'
+        if (in.hasCompleteTag()) {
             readerStarted = true;
-            while (!in.empty()) {
-                if (in.front().constData() != completeTag) {
-                    reader.addData(in.front());
-                    in.erase(in.begin());
-                } else {
-                    // Qt has some bugs, so ensure we push data only ending with '>'
-                    if (completeOffset == in.front().size() - 1) {
-                        reader.addData(in.front());
-                        in.erase(in.begin());
-                    } else {
-                        QByteArray part = in.front().left(completeOffset + 1);
-                        reader.addData(part);
-                        in.front().remove(0, completeOffset + 1);
-                    }
-                    completeTag = nullptr;
-                    break;
-                }
-            }
+            in.feedCompleteTo(reader);
+        }
+    }
+
+    void handleTreeStartElement()
+    {
+        if (curNode == -1)
+            tree = std::make_shared<StanzaTree>(names);
+        curNode = tree->addElement(curNode, reader.namespaceUri(), reader.name(), reader.prefix());
+        for (auto const &a : reader.attributes())
+            tree->addAttribute(curNode, a.namespaceUri(), a.name(), a.prefix(), a.value());
+    }
+
+    void handleTreeEndElement()
+    {
+        Q_ASSERT_X(tree->tagName(curNode) == reader.name(), "xml parser",
+                   "XML reader hasn't reported open/close tags mismatch");
+        curNode = tree->parentNode(curNode);
+        if (curNode == -1) {
+            Event e;
+            e.setStanzaTree(tree, doc, isStanza(tree->tagName()) ? StanzaDocument::create() : StanzaDocument());
+            events.push(e);
+            tree.reset();
         }
     }
 
     void handleStartElement()
     {
-        auto    ns   = reader.namespaceUri().toString();
-        QString name = reader.name().toString();
+        if (streamOpened && useTree) {
+            handleTreeStartElement();
+            return;
+        }
+        // known names come from the atom table so the routing code can compare them cheaply
+        QString ns   = Atom::intern(reader.namespaceUri());
+        QString name = Atom::intern(reader.name());
         if (streamOpened) {
-            QDomElement newEl;
+            if (curElement.isNull())
+                stanzaDoc = isStanza(reader.name()) ? StanzaDocument::create() : StanzaDocument();
+            QDomDocument &doc = elementDoc();
+            QDomElement   newEl;
             if (ns.isEmpty())
                 newEl = doc.createElement(name);
             else
@@ -215,7 +349,7 @@ public:
                 if (a.namespaceUri().isEmpty())
                     da = doc.createAttribute(a.name().toString());
                 else
-                    da = doc.createAttributeNS(a.namespaceUri().toString(), a.name().toString());
+                    da = doc.createAttributeNS(Atom::intern(a.namespaceUri()), a.name().toString());
                 da.setPrefix(a.prefix().toString());
                 da.setValue(a.value().toString());
                 if (a.namespaceUri().isEmpty())
@@ -234,12 +368,17 @@ public:
 
     void handleEndElement()
     {
-        if (curElement.isNull() && reader.qualifiedName() == streamQName) {
+        bool inStanza = useTree ? curNode != -1 : !curElement.isNull();
+        if (!inStanza && reader.qualifiedName() == streamQName) {
             Event e;
             e.setDocumentClose(reader.namespaceUri().toString(), reader.name().toString(), streamQName);
             events.push(e);
             return;
         }
+        if (useTree) {
+            handleTreeEndElement();
+            return;
+        }
         Q_ASSERT_X(!curElement.isNull(), "xml parser", "XML reader hasn't reported error for invalid element close");
         Q_ASSERT_X(
             curElement.namespaceURI() == reader.namespaceUri() && curElement.tagName() == reader.name(), "xml parser",
@@ -266,20 +405,27 @@ public:
 #endif
         if (curElement.parentNode().isNull()) {
             Event e;
-            e.setElement(curElement);
+            if (!stanzaDoc.isNull())
+                stanzaDoc.setRoot(curElement);
+            e.setElement(curElement, stanzaDoc);
             events.push(e);
+            stanzaDoc = StanzaDocument();
         }
         curElement = curElement.parentNode().toElement();
     }
 
     void handleText()
     {
+        if (useTree && curNode != -1) {
+            tree->addText(curNode, reader.text());
+            return;
+        }
         if (curElement.isNull()) {
             if (!reader.isWhitespace())
                 qWarning("Text node out of element (ignored): %s", qPrintable(reader.text().toString()));
             return;
         }
-        auto node = doc.createTextNode(reader.text().toString());
+        auto node = elementDoc().createTextNode(reader.text().toString());
         curElement.appendChild(node);
     }
 
@@ -328,32 +474,32 @@ Parser::Parser() { reset(); }
 
 Parser::~Parser() { }
 
-void Parser::reset() { d.reset(new Private); }
+void Parser::reset()
+{
+    bool                       useTree = d && d->useTree;
+    std::shared_ptr<NameTable> names   = d ? d->names : nullptr;
+    d.reset(new Private);
+    d->useTree = useTree;
+    d->names   = names;
+}
+
+void Parser::setStanzaTreeEnabled(bool enabled)
+{
+    d->useTree = enabled;
+    if (enabled && !d->names)
+        d->names = std::make_shared<NameTable>();
+}
 
 void Parser::appendData(const QByteArray &a)
 {
     if (a.isEmpty())
         return;
-    d->in.push_back(a);
-    for (int i = a.size() - 1; i >= 0; --i) {
-        if (a.at(i) == '>') { // this may happend in CDATA too, but let's hope Qt handles it properly
-            d->completeTag    = a.constData();
-            d->completeOffset = i;
-            break;
-        }
-    }
+    d->in.append(a);
 }
 
 Parser::Event Parser::readNext() { return d->readNext(); }
 
-QByteArray Parser::unprocessed() const
-{
-    QByteArray ret;
-    for (auto const &a : d->in) {
-        ret += a;
-    }
-    return ret;
-}
+QByteArray Parser::unprocessed() const { return d->in.unprocessed(); }
 
 QStringRef Parser::encoding() const { return d->reader.documentEncoding(); }
 
@@ -20,6 +20,8 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "stanzadocument.h"
+
 #include <QDomElement>
 #include <QExplicitlySharedDataPointer>
 #include <QXmlStreamAttributes>
@@ -27,6 +29,8 @@
 #include <memory>
 
 namespace XMPP {
+class NameTable;
+class StanzaTree;
 
 class Parser {
 public:
@@ -56,7 +60,9 @@ public:
         QXmlStreamAttributes atts() const;
 
         // for element
-        QDomElement element() const;
+        QDomElement       element() const;
+        StanzaDocument    document() const;   // owner of element() if it's a stanza. null otherwise
+        const StanzaTree *stanzaTree() const; // null unless the parser builds stanza trees
 
         // for any
         QString actualString() const;
@@ -65,7 +71,9 @@ public:
         void setDocumentOpen(const QString &namespaceURI, const QString &localName, const QString &qName,
                              const QXmlStreamAttributes &atts, const QXmlStreamNamespaceDeclarations &nsPrefixes);
         void setDocumentClose(const QString &namespaceURI, const QString &localName, const QString &qName);
-        void setElement(const QDomElement &elem);
+        void setElement(const QDomElement &elem, const StanzaDocument &stanzaDoc = StanzaDocument());
+        void setStanzaTree(const std::shared_ptr<StanzaTree> &tree, const QDomDocument &doc,
+                           const StanzaDocument &stanzaDoc = StanzaDocument());
         void setError();
         void setActualString(const QString &);
 
@@ -79,6 +87,7 @@ public:
     ~Parser();
 
     void       reset();
+    void       setStanzaTreeEnabled(bool enabled);
     void       appendData(const QByteArray &a);
     Event      readNext();
     QByteArray unprocessed() const;
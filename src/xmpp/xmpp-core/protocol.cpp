@@ -23,6 +23,9 @@
 
 #include "protocol.h"
 
+#include "stanzatree.h"
+#include "xmpp_atoms.h"
+
 #ifdef XMPP_TEST
 #include "td.h"
 #endif
@@ -168,14 +171,17 @@ void BasicProtocol::reset()
     sasl_mech = QString();
     sasl_mechlist.clear();
     sasl_step.resize(0);
-    stanzaToRecv = QDomElement();
+    stanzaToRecv    = QDomElement();
+    stanzaDocToRecv = StanzaDocument();
     sendList.clear();
 }
 
-void BasicProtocol::sendStanza(const QDomElement &e)
+void BasicProtocol::sendStanza(const QDomElement &e, const QByteArray &utf8)
 {
     SendItem i;
+    i.stanzaOwner  = e.ownerDocument();
     i.stanzaToSend = e;
+    i.stanzaUtf8   = utf8;
     sendList += i;
 }
 
@@ -199,10 +205,13 @@ void BasicProtocol::clearSendQueue()
     XmlProtocol::clearSendQueue();
 }
 
-QDomElement BasicProtocol::recvStanza()
+QDomElement BasicProtocol::recvStanza(StanzaDocument *doc)
 {
     QDomElement e = stanzaToRecv;
     stanzaToRecv  = QDomElement();
+    if (doc)
+        *doc = stanzaDocToRecv;
+    stanzaDocToRecv = StanzaDocument();
     return e;
 }
 
@@ -318,6 +327,8 @@ void BasicProtocol::send(const QDomElement &e, bool clip) { writeElement(e, Type
 
 void BasicProtocol::sendUrgent(const QDomElement &e, bool clip) { writeElement(e, TypeElement, false, clip, true); }
 
+void BasicProtocol::sendUtf8(const QByteArray &utf8) { writeElement(QDomElement(), utf8, TypeElement, false); }
+
 void BasicProtocol::sendStreamError(int cond, const QString &text, const QDomElement &appSpec)
 {
     QDomElement se  = doc.createElementNS(NS_ETHERX, "stream:error");
@@ -521,7 +532,10 @@ bool BasicProtocol::doStep(const QDomElement &e)
             // outgoing stanza?
             if (!i.stanzaToSend.isNull()) {
                 ++stanzasPending;
-                writeElement(i.stanzaToSend, TypeStanza, true);
+                if (i.stanzaUtf8.isEmpty())
+                    writeElement(i.stanzaToSend, TypeStanza, true);
+                else
+                    writeElement(i.stanzaToSend, i.stanzaUtf8, TypeStanza, true);
                 event = ESend;
             }
             // direct send?
@@ -629,10 +643,14 @@ void CoreProtocol::needTimer(int seconds)
 void CoreProtocol::sendStanza(const QDomElement &e)
 {
     if (sm.isActive()) {
-        int len = sm.addUnacknowledgedStanza(e);
+        // serialize once, for the wire and for the resend queue
+        QByteArray utf8 = elementToUtf8(e);
+        int        len  = sm.addUnacknowledgedStanza(utf8);
         if (len > 5 && len % 4 == 0)
             if (needSMRequest())
                 event = ESend;
+        BasicProtocol::sendStanza(e, utf8);
+        return;
     }
     BasicProtocol::sendStanza(e);
 }
@@ -709,6 +727,29 @@ void CoreProtocol::setFrom(const QString &s) { from = s; }
 
 void CoreProtocol::setDialbackKey(const QString &s) { dialback_key = s; }
 
+bool CoreProtocol::requestBind()
+{
+    QDomElement e = doc.createElement("iq");
+    e.setAttribute("type", "set");
+    e.setAttribute("id", "bind_1");
+    QDomElement b = doc.createElementNS(NS_BIND, "bind");
+
+    // request specific resource?
+    QString resource = jid_.resource();
+    if (!resource.isEmpty()) {
+        QDomElement r = doc.createElement("resource");
+        r.appendChild(doc.createTextNode(jid_.resource()));
+        b.appendChild(r);
+    }
+
+    e.appendChild(b);
+
+    send(e);
+    event = ESend;
+    step  = GetBindResponse;
+    return true;
+}
+
 bool CoreProtocol::loginComplete()
 {
     setReady(true);
@@ -868,24 +909,38 @@ bool CoreProtocol::doStep2(const QDomElement &e)
 
 bool CoreProtocol::isValidStanza(const QDomElement &e) const
 {
-    QString      s    = e.tagName();
-    Stanza::Kind kind = Stanza::kind(s);
-    return e.namespaceURI() == (server ? NS_SERVER : NS_CLIENT)
-        && (kind == Stanza::Message || kind == Stanza::Presence || kind == Stanza::IQ);
+    Stanza::Kind kind = Stanza::kind(e.tagName());
+    return (kind == Stanza::Message || kind == Stanza::Presence || kind == Stanza::IQ)
+        && Atom::is(e.namespaceURI(), server ? Atom::NsServer : Atom::NsClient);
 }
 
-bool CoreProtocol::streamManagementHandleStanza(const QDomElement &e)
+bool CoreProtocol::isValidStanza(const StanzaTree &tree) const
 {
-    QString s = e.tagName();
-    if (s == "r") {
+    Atom::Id name = tree.nameAtom();
+    return (name == Atom::Message || name == Atom::Presence || name == Atom::Iq)
+        && tree.namespaceAtom() == (server ? Atom::NsServer : Atom::NsClient);
+}
+
+// stanzas still go up as QDom. but once the stream is up, stream management acks and requests are read off the
+// tree, and the other elements which are dropped anyway are never converted
+bool CoreProtocol::elementNeeded(const StanzaTree &tree) const
+{
+    if (dialback || step != Done || !isReady())
+        return true;
+    return tree.namespaceAtom() == Atom::NsEtherx || isValidStanza(tree);
+}
+
+bool CoreProtocol::streamManagementHandleStanza(Atom::Id name, const QString &h)
+{
+    if (name == Atom::R) {
 #ifdef IRIS_SM_DEBUG
         qDebug() << "Stream Management: [<-?] Received request from server";
 #endif
         sendUrgent(sm.makeResponseStanza(doc));
         event = ESend;
         return true;
-    } else if (s == "a") {
-        quint32 last_id = e.attribute("h").toUInt();
+    } else if (name == Atom::A) {
+        quint32 last_id = h.toUInt();
 #ifdef IRIS_SM_DEBUG
         qDebug() << "Stream Management: [<--] Received ack response from server with h =" << last_id;
 #endif
@@ -1029,8 +1084,9 @@ bool CoreProtocol::dialbackStep(const QDomElement &e)
                 if (isValidStanza(e)) {
                     // TODO: disconnect if stanza is from unverified sender
                     // TODO: ignore packets from receiving servers
-                    stanzaToRecv = e;
-                    event        = EStanzaReady;
+                    stanzaToRecv    = e;
+                    stanzaDocToRecv = stepDocument();
+                    event           = EStanzaReady;
                     return true;
                 }
             }
@@ -1125,29 +1181,14 @@ bool CoreProtocol::normalStep(const QDomElement &e)
             return true;
         }
 
+        if (sm.state().restored && !features.sm_supported)
+            sm.state().resumption_id.clear(); // nothing live to lose. just start a new session
+
         if (sm.state().isResumption()) {
             // try to resume;
             return loginComplete();
         } else {
-            QDomElement e = doc.createElement("iq");
-            e.setAttribute("type", "set");
-            e.setAttribute("id", "bind_1");
-            QDomElement b = doc.createElementNS(NS_BIND, "bind");
-
-            // request specific resource?
-            QString resource = jid_.resource();
-            if (!resource.isEmpty()) {
-                QDomElement r = doc.createElement("resource");
-                r.appendChild(doc.createTextNode(jid_.resource()));
-                b.appendChild(r);
-            }
-
-            e.appendChild(b);
-
-            send(e);
-            event = ESend;
-            step  = GetBindResponse;
-            return true;
+            return requestBind();
         }
     } else if (step == GetSASLFirst) {
         QDomElement e = doc.createElementNS(NS_SASL, "auth");
@@ -1692,6 +1733,7 @@ bool CoreProtocol::normalStep(const QDomElement &e)
                 QString rs = e.attribute("resume");
                 QString id = (rs == "true" || rs == "1") ? e.attribute("id") : QString();
                 sm.start(id);
+                sm.state().jid = jid_.full();
                 if (!id.isEmpty()) {
 #ifdef IRIS_SM_DEBUG
                     qDebug() << "Stream Management: [INF] Resumption Supported";
@@ -1726,12 +1768,14 @@ bool CoreProtocol::normalStep(const QDomElement &e)
                 step  = Done;
                 return true;
             } else if (e.localName() == "resumed") {
+                if (sm.state().restored && !sm.state().jid.isEmpty())
+                    jid_ = sm.state().jid;
                 sm.resume(e.attribute("h").toUInt());
                 while (true) {
-                    QDomElement st = sm.getUnacknowledgedStanza();
+                    QByteArray st = sm.getUnacknowledgedStanza();
                     if (st.isNull())
                         break;
-                    send(st);
+                    sendUtf8(st);
                 }
                 needTimer(SM_TIMER_INTERVAL_SECS);
                 event = EReady;
@@ -1740,6 +1784,13 @@ bool CoreProtocol::normalStep(const QDomElement &e)
             } else if (e.localName() == "failed") {
                 if (sm.state().isResumption()) { // tried to resume? ok, then try to just enable
                     sm.state().resumption_id.clear();
+                    if (sm.state().restored) {
+                        // the session came from a snapshot, so nobody is attached to it. bind a new one instead
+                        sm.state().restored = false;
+                        sm.state().resetCounters();
+                        setReady(false);
+                        return requestBind();
+                    }
                     // step = HandleFeatures;
                     event = ESMResumeFailed;
                     return true;
@@ -1751,13 +1802,17 @@ bool CoreProtocol::normalStep(const QDomElement &e)
     if (isReady()) {
         if (!e.isNull()) {
             if (isValidStanza(e)) {
-                stanzaToRecv = e;
-                event        = EStanzaReady;
+                stanzaToRecv    = e;
+                stanzaDocToRecv = stepDocument();
+                event           = EStanzaReady;
                 setIncomingAsExternal();
                 return true;
             } else if (sm.isActive()) {
-                return streamManagementHandleStanza(e);
+                return streamManagementHandleStanza(Atom::id(e.tagName()), e.attribute("h"));
             }
+        } else if (stepStanzaTree() && sm.isActive()) {
+            const StanzaTree *tree = stepStanzaTree();
+            return streamManagementHandleStanza(tree->nameAtom(), tree->attribute(0, "h").toString());
         }
         if (sm.isActive()) {
             if (sm.lastAckElapsed() >= SM_TIMER_INTERVAL_SECS) {
@@ -23,6 +23,7 @@
 #include "sm.h"
 #include "xmlprotocol.h"
 #include "xmpp.h"
+#include "xmpp_atoms.h"
 
 #include <QList>
 #include <QObject>
@@ -157,11 +158,11 @@ public:
     void       setSASLAuthed();
 
     // send / recv
-    void        sendStanza(const QDomElement &e);
+    void        sendStanza(const QDomElement &e, const QByteArray &utf8 = QByteArray());
     void        sendDirect(const QString &s);
     void        sendWhitespace();
     void        clearSendQueue();
-    QDomElement recvStanza();
+    QDomElement recvStanza(StanzaDocument *doc = nullptr);
 
     // shutdown
     void shutdown();
@@ -192,6 +193,7 @@ protected:
 
     void send(const QDomElement &e, bool clip = false);
     void sendUrgent(const QDomElement &e, bool clip = false);
+    void sendUtf8(const QByteArray &utf8); // element serialized before
     void sendStreamError(int cond, const QString &text = "", const QDomElement &appSpec = QDomElement());
     void sendStreamError(const QString &text); // old-style
 
@@ -220,7 +222,8 @@ protected:
     QByteArray  sasl_step;
     bool        sasl_authed;
 
-    QDomElement stanzaToRecv;
+    QDomElement    stanzaToRecv;
+    StanzaDocument stanzaDocToRecv;
 
 private:
     struct SASLCondEntry {
@@ -236,9 +239,11 @@ private:
     static StreamCondEntry streamCondTable[];
 
     struct SendItem {
-        QDomElement stanzaToSend;
-        QString     stringToSend;
-        bool        doWhitespace;
+        QDomDocument stanzaOwner; // keeps stanzaToSend alive after the Stanza is gone
+        QDomElement  stanzaToSend;
+        QByteArray   stanzaUtf8; // stanzaToSend already serialized, if not empty
+        QString      stringToSend;
+        bool         doWhitespace;
     };
     QList<SendItem> sendList;
 
@@ -351,9 +356,11 @@ private:
     void       init();
     static int getOldErrorCode(const QDomElement &e);
     bool       loginComplete();
+    bool       requestBind();
 
     bool isValidStanza(const QDomElement &e) const;
-    bool streamManagementHandleStanza(const QDomElement &e);
+    bool isValidStanza(const StanzaTree &tree) const;
+    bool streamManagementHandleStanza(Atom::Id name, const QString &h);
     bool grabPendingItem(const Jid &to, const Jid &from, int type, DBItem *item);
     bool normalStep(const QDomElement &e);
     bool dialbackStep(const QDomElement &e);
@@ -363,6 +370,7 @@ private:
     // reimplemented
     bool        stepAdvancesParser() const;
     bool        stepRequiresElement() const;
+    bool        elementNeeded(const StanzaTree &tree) const;
     void        stringSend(const QString &s);
     void        stringRecv(const QString &s);
     QString     defaultNamespace();
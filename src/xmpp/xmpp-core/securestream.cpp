@@ -451,12 +451,14 @@ void SecureStream::startTLSServer(QCA::TLS *t, const QByteArray &spare)
     insertData(spare);
 }
 
-void SecureStream::setLayerCompress(const QByteArray &spare)
+void SecureStream::setLayerCompress(const QByteArray &spare) { setLayerCompress(spare, ZLibOptions()); }
+
+void SecureStream::setLayerCompress(const QByteArray &spare, const ZLibOptions &options)
 {
     if (!d->active || d->topInProgress || d->haveCompress())
         return;
 
-    SecureLayer *s = new SecureLayer(new CompressionHandler());
+    SecureLayer *s = new SecureLayer(new CompressionHandler(options));
     s->prebytes    = calcPrebytes();
     linkLayer(s);
     d->layers.append(s);
@@ -19,15 +19,159 @@
 
 #include "sm.h"
 
+#include <QDataStream>
 #ifdef IRIS_SM_DEBUG
 #include <QDebug>
 #endif
 
 using namespace XMPP;
 
+//----------------------------------------------------------------------------
+// SMQueue
+//----------------------------------------------------------------------------
+void SMQueue::clear()
+{
+    data_.clear();
+    head_ = 0;
+    base_ = 0;
+    starts_.clear();
+    dropped_    = 0;
+    lost_       = 0;
+    overflowed_ = false;
+}
+
+void SMQueue::setLimit(qint64 bytes, OverflowPolicy policy)
+{
+    limit_  = qMax(qint64(0), bytes);
+    policy_ = policy;
+}
+
+bool SMQueue::enqueue(const QByteArray &stanza)
+{
+    if (overflowed_) {
+        ++dropped_;
+        ++lost_;
+        return false;
+    }
+
+    bool fits = true;
+    if (limit_ && bytes() + stanza.size() > limit_) {
+        fits = false;
+        if (policy_ == DisableResumption || stanza.size() > limit_) {
+            // the new one is forgotten too. it can't be stored after forgotten ones
+            forgetStored();
+            ++dropped_;
+            ++lost_;
+            overflowed_ = policy_ == DisableResumption;
+            return false;
+        }
+        while (bytes() + stanza.size() > limit_) {
+            popStored();
+            ++dropped_;
+            ++lost_;
+        }
+    }
+
+    starts_.push_back(base_ + data_.size());
+    data_ += stanza;
+    return fits;
+}
+
+void SMQueue::dequeue()
+{
+    if (dropped_ > 0)
+        --dropped_;
+    else if (!starts_.empty())
+        popStored();
+}
+
+QByteArray SMQueue::stored(int n) const
+{
+    if (n < 0 || n >= storedCount())
+        return QByteArray();
+    qint64 from = starts_[size_t(n)] - base_;
+    qint64 to   = (n + 1 < storedCount() ? starts_[size_t(n + 1)] - base_ : data_.size());
+    return data_.mid(int(from), int(to - from));
+}
+
+void SMQueue::popStored()
+{
+    starts_.pop_front();
+    if (starts_.empty()) {
+        // all acked. give the memory back
+        base_ += data_.size();
+        data_.clear();
+        head_ = 0;
+        return;
+    }
+
+    head_ = int(starts_.front() - base_);
+    // move the rest to the front once the consumed part dominates. amortized O(1) per byte
+    if (head_ >= 65536 && head_ >= data_.size() / 2) {
+        data_.remove(0, head_);
+        base_ += head_;
+        head_ = 0;
+    }
+}
+
+void SMQueue::forgetStored()
+{
+    int n = storedCount();
+    dropped_ += n;
+    lost_ += quint64(n);
+    base_ += data_.size();
+    data_.clear();
+    head_ = 0;
+    starts_.clear();
+}
+
+void SMQueue::write(QDataStream &out) const
+{
+    out << quint8(1) << qint64(limit_) << quint8(policy_) << quint8(overflowed_) << qint32(dropped_)
+        << quint64(lost_) << qint32(storedCount());
+    for (int n = 0; n < storedCount(); ++n)
+        out << stored(n);
+}
+
+bool SMQueue::read(QDataStream &in)
+{
+    quint8  version, policy, overflowed;
+    qint64  limit;
+    qint32  dropped, count;
+    quint64 lost;
+    in >> version;
+    if (version != 1)
+        return false;
+    in >> limit >> policy >> overflowed >> dropped >> lost >> count;
+    if (in.status() != QDataStream::Ok || dropped < 0 || count < 0 || policy > DisableResumption)
+        return false;
+
+    clear();
+    limit_      = limit;
+    policy_     = OverflowPolicy(policy);
+    overflowed_ = overflowed;
+    dropped_    = dropped;
+    lost_       = lost;
+    for (qint32 n = 0; n < count; ++n) {
+        QByteArray stanza;
+        in >> stanza;
+        if (in.status() != QDataStream::Ok) {
+            clear();
+            return false;
+        }
+        starts_.push_back(base_ + data_.size());
+        data_ += stanza;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// SMState
+//----------------------------------------------------------------------------
 SMState::SMState()
 {
-    enabled = false;
+    enabled  = false;
+    restored = false;
     resumption_id.clear();
     resumption_location.host.clear();
     resumption_location.port = 0;
@@ -41,6 +185,39 @@ void SMState::resetCounters()
     send_queue.clear();
 }
 
+void SMState::write(QDataStream &out) const
+{
+    out << quint32(0x49534d53) << quint8(1); // "ISMS"
+    out << resumption_id << resumption_location.host << resumption_location.port << jid;
+    out << received_count << server_last_handled;
+    send_queue.write(out);
+}
+
+bool SMState::read(QDataStream &in)
+{
+    quint32 magic;
+    quint8  version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != 0x49534d53 || version != 1)
+        return false;
+
+    SMState s;
+    in >> s.resumption_id >> s.resumption_location.host >> s.resumption_location.port >> s.jid;
+    in >> s.received_count >> s.server_last_handled;
+    if (in.status() != QDataStream::Ok || s.resumption_id.isEmpty() || !s.send_queue.read(in))
+        return false;
+
+    // the limit is up to this process
+    s.send_queue.setLimit(send_queue.limit(), send_queue.overflowPolicy());
+    s.enabled  = true;
+    s.restored = true;
+    *this      = s;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// StreamManagement
+//----------------------------------------------------------------------------
 StreamManagement::StreamManagement(QObject *parent) :
     QObject(parent), sm_started(false), sm_resumed(false), sm_stanzas_notify(0), sm_resend_pos(0)
 {
@@ -61,14 +238,16 @@ void StreamManagement::start(const QString &resumption_id)
     reset();
     state_.resetCounters();
     state_.resumption_id = resumption_id;
+    state_.restored      = false;
     sm_started           = true;
     sm_timeout_data.elapsed_timer.start();
 }
 
 void StreamManagement::resume(quint32 last_handled)
 {
-    sm_resumed    = true;
-    sm_resend_pos = 0;
+    state_.restored = false;
+    sm_resumed      = true;
+    sm_resend_pos   = 0;
     processAcknowledgement(last_handled);
     sm_timeout_data.waiting_answer = false;
     sm_timeout_data.elapsed_timer.start();
@@ -107,23 +286,35 @@ void StreamManagement::countInputRawData(int bytes)
     }
 }
 
-QDomElement StreamManagement::getUnacknowledgedStanza()
+QByteArray StreamManagement::getUnacknowledgedStanza()
 {
-    if (sm_resend_pos < state_.send_queue.size())
-        return state_.send_queue.at(sm_resend_pos++);
-    return QDomElement();
+    // forgotten stanzas are skipped. they are lost
+    if (sm_resend_pos < state_.send_queue.storedCount())
+        return state_.send_queue.stored(sm_resend_pos++);
+    return QByteArray();
 }
 
-int StreamManagement::addUnacknowledgedStanza(const QDomElement &e)
+int StreamManagement::addUnacknowledgedStanza(const QByteArray &stanza)
 {
-    state_.send_queue.enqueue(e);
-    int len = state_.send_queue.length();
+    if (!state_.send_queue.enqueue(stanza)) {
+#ifdef IRIS_SM_DEBUG
+        qDebug() << "Stream Management: [ERR] Send queue overflow. Lost stanzas: " << state_.send_queue.lostCount();
+#endif
+        if (state_.send_queue.isOverflowed())
+            state_.resumption_id.clear(); // can't resume without the stanzas
+    }
+    int len = state_.send_queue.count();
 #ifdef IRIS_SM_DEBUG
     qDebug() << "Stream Management: [INF] Send queue length is changed: " << len;
 #endif
     return len;
 }
 
+void StreamManagement::setQueueLimit(qint64 bytes, SMQueue::OverflowPolicy policy)
+{
+    state_.send_queue.setLimit(bytes, policy);
+}
+
 void StreamManagement::processAcknowledgement(quint32 last_handled)
 {
     sm_timeout_data.waiting_answer = false;
@@ -141,7 +332,7 @@ void StreamManagement::processAcknowledgement(quint32 last_handled)
     }
 #ifdef IRIS_SM_DEBUG
     if (f) {
-        qDebug() << "Stream Management: [INF] Send queue length is changed: " << state_.send_queue.length();
+        qDebug() << "Stream Management: [INF] Send queue length is changed: " << state_.send_queue.count();
         if (state_.send_queue.isEmpty() && last_handled != state_.server_last_handled)
             qDebug() << "Stream Management: [ERR] Send queue is empty but last_handled != server_last_handled "
                      << last_handled << state_.server_last_handled;
@@ -20,10 +20,14 @@
 #ifndef XMPP_SM_H
 #define XMPP_SM_H
 
+#include <QByteArray>
 #include <QDomElement>
 #include <QElapsedTimer>
 #include <QObject>
-#include <QQueue>
+
+#include <deque>
+
+class QDataStream;
 
 #define NS_STREAM_MANAGEMENT "urn:xmpp:sm:3"
 #define SM_TIMER_INTERVAL_SECS 40
@@ -31,6 +35,56 @@
 //#define IRIS_SM_DEBUG
 
 namespace XMPP {
+/**
+ * @brief Unacknowledged stanzas, as they were written to the wire.
+ *
+ * The stanzas are kept back to back in one byte buffer which is consumed from
+ * the front as acks arrive, so an ack is O(1) and no DOM is kept alive. If
+ * the buffer would grow over limit() bytes, the overflow policy decides what
+ * to forget. Forgotten stanzas still count as unacknowledged but can't be
+ * resent.
+ */
+class SMQueue {
+public:
+    enum OverflowPolicy {
+        DropOldest,       // forget the oldest stanzas. they are lost if the stream gets resumed
+        DisableResumption // forget all of them. a new session has to be started instead of resuming
+    };
+
+    void           clear();
+    void           setLimit(qint64 bytes, OverflowPolicy policy); // 0 - no limit
+    qint64         limit() const { return limit_; }
+    OverflowPolicy overflowPolicy() const { return policy_; }
+
+    // returns false if this or older stanzas had to be forgotten
+    bool       enqueue(const QByteArray &stanza);
+    void       dequeue();
+    bool       isEmpty() const { return count() == 0; }
+    int        count() const { return dropped_ + storedCount(); }
+    int        storedCount() const { return int(starts_.size()); }
+    QByteArray stored(int n) const; // n-th oldest stanza which can be resent
+    qint64     bytes() const { return data_.size() - head_; }
+    quint64    lostCount() const { return lost_; }
+    bool       isOverflowed() const { return overflowed_; }
+
+    void write(QDataStream &out) const;
+    bool read(QDataStream &in);
+
+private:
+    QByteArray         data_;
+    int                head_       = 0; // first byte of the oldest stored stanza
+    qint64             base_       = 0; // absolute position of data_[0]
+    std::deque<qint64> starts_;         // absolute positions of the stored stanzas
+    int                dropped_    = 0; // unacknowledged but forgotten. always older than the stored ones
+    quint64            lost_       = 0; // forgotten since clear()
+    qint64             limit_      = 0;
+    OverflowPolicy     policy_     = DropOldest;
+    bool               overflowed_ = false;
+
+    void popStored();
+    void forgetStored();
+};
+
 class SMState {
 public:
     SMState();
@@ -40,16 +94,22 @@ public:
     bool isLocationValid() { return !resumption_location.host.isEmpty() && resumption_location.port != 0; }
     void setEnabled(bool e) { enabled = e; }
 
+    // the resumable session, to take it over in another process
+    void write(QDataStream &out) const;
+    bool read(QDataStream &in);
+
 public:
     bool                enabled;
     quint32             received_count;
     quint32             server_last_handled;
-    QQueue<QDomElement> send_queue;
+    SMQueue             send_queue;
     QString             resumption_id;
     struct {
         QString host;
         quint16 port;
     } resumption_location;
+    QString jid;      // bound to the session
+    bool    restored; // read from a snapshot. there is no live session behind it
 };
 
 class StreamManagement : QObject {
@@ -66,8 +126,9 @@ public:
     int                  lastAckElapsed() const;
     int                  takeAckedCount();
     void                 countInputRawData(int bytes);
-    QDomElement          getUnacknowledgedStanza();
-    int                  addUnacknowledgedStanza(const QDomElement &e);
+    QByteArray           getUnacknowledgedStanza();
+    int                  addUnacknowledgedStanza(const QByteArray &stanza);
+    void                 setQueueLimit(qint64 bytes, SMQueue::OverflowPolicy policy);
     void                 processAcknowledgement(quint32 last_handled);
     void                 markStanzaHandled();
     QDomElement          generateRequestStanza(QDomDocument &doc);
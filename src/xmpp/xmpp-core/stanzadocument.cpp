@@ -0,0 +1,129 @@
+/*
+ * stanzadocument.cpp - short lived document of one stanza
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stanzadocument.h"
+
+#include <QMutex>
+#include <QSharedData>
+
+namespace XMPP {
+
+//----------------------------------------------------------------------------
+// StanzaDocument
+//----------------------------------------------------------------------------
+class StanzaDocument::Private : public QSharedData {
+public:
+    QDomDocument doc;
+    QDomElement  root; // destroyed before the document
+
+    // all the live documents are linked together so liveNodes() can walk them
+    Private *prev = nullptr;
+    Private *next = nullptr;
+
+    static QMutex   mutex;
+    static Private *first;
+    static int      count;
+
+    Private()
+    {
+        QMutexLocker locker(&mutex);
+        next = first;
+        if (first)
+            first->prev = this;
+        first = this;
+        ++count;
+    }
+
+    ~Private()
+    {
+        QMutexLocker locker(&mutex);
+        if (prev)
+            prev->next = next;
+        else
+            first = next;
+        if (next)
+            next->prev = prev;
+        --count;
+    }
+
+    static qint64 countNodes(const QDomNode &n)
+    {
+        qint64 ret = 1 + n.attributes().count();
+        for (QDomNode c = n.firstChild(); !c.isNull(); c = c.nextSibling())
+            ret += countNodes(c);
+        return ret;
+    }
+};
+
+QMutex                    StanzaDocument::Private::mutex;
+StanzaDocument::Private * StanzaDocument::Private::first = nullptr;
+int                       StanzaDocument::Private::count = 0;
+
+StanzaDocument::StanzaDocument() { }
+
+StanzaDocument::StanzaDocument(const StanzaDocument &other) : d(other.d) { }
+
+StanzaDocument &StanzaDocument::operator=(const StanzaDocument &other)
+{
+    d = other.d;
+    return *this;
+}
+
+StanzaDocument::~StanzaDocument() { }
+
+StanzaDocument StanzaDocument::create()
+{
+    StanzaDocument sd;
+    sd.d = new Private;
+    return sd;
+}
+
+QDomDocument &StanzaDocument::document() const
+{
+    Q_ASSERT(d);
+    return d->doc;
+}
+
+QDomElement StanzaDocument::root() const { return d ? d->root : QDomElement(); }
+
+void StanzaDocument::setRoot(const QDomElement &root)
+{
+    Q_ASSERT(d);
+    d->root = root;
+}
+
+int StanzaDocument::liveDocuments()
+{
+    QMutexLocker locker(&Private::mutex);
+    return Private::count;
+}
+
+qint64 StanzaDocument::liveNodes()
+{
+    // walks the trees, so other threads must not be changing their stanzas meanwhile. it's a debugging aid
+    QMutexLocker locker(&Private::mutex);
+    qint64       ret = 0;
+    for (Private *p = Private::first; p; p = p->next) {
+        if (!p->root.isNull())
+            ret += Private::countNodes(p->root);
+    }
+    return ret;
+}
+
+} // namespace XMPP
@@ -0,0 +1,72 @@
+/*
+ * stanzadocument.h - short lived document of one stanza
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef XMPP_STANZADOCUMENT_H
+#define XMPP_STANZADOCUMENT_H
+
+#include <QDomDocument>
+#include <QDomElement>
+#include <QExplicitlySharedDataPointer>
+
+namespace XMPP {
+
+/**
+ * @brief Owner document of the nodes of a single stanza.
+ *
+ * Received stanzas and stanzas created with Stream::createStanza() get one
+ * each, instead of sharing the document of the stream or the client for the
+ * life of the process. All the nodes of the stanza go away together when the
+ * last holder of the document is gone, which is when the stanza was sent or
+ * dispatched.
+ *
+ * QDom nodes don't keep their owner document alive. Whoever keeps an element
+ * of a stanza past its dispatch has to keep the document as well, or import
+ * the element into a document of its own.
+ *
+ * liveDocuments() and liveNodes() report what is currently held, for leak
+ * hunting. They are expected to stay flat on a long running client.
+ */
+class StanzaDocument {
+public:
+    StanzaDocument();
+    StanzaDocument(const StanzaDocument &other);
+    StanzaDocument &operator=(const StanzaDocument &other);
+    ~StanzaDocument();
+
+    static StanzaDocument create();
+
+    bool isNull() const { return !d; }
+
+    QDomDocument &document() const;
+
+    // the root element of the stanza, counted by liveNodes()
+    QDomElement root() const;
+    void        setRoot(const QDomElement &root);
+
+    static int    liveDocuments();
+    static qint64 liveNodes();
+
+private:
+    class Private;
+    QExplicitlySharedDataPointer<Private> d;
+};
+
+} // namespace XMPP
+
+#endif // XMPP_STANZADOCUMENT_H
@@ -0,0 +1,220 @@
+/*
+ * stanzatree.cpp - compact tree of a received top-level element
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "stanzatree.h"
+
+#include <QHash>
+
+namespace XMPP {
+
+//----------------------------------------------------------------------------
+// NameTable
+//----------------------------------------------------------------------------
+NameTable::NameTable()
+{
+    for (int id = Atom::Unknown; id < Atom::Count; ++id)
+        strings.push_back(Atom::string(Atom::Id(id))); // shared with the atom table
+    rehash(256);
+}
+
+int NameTable::intern(const QStringRef &s)
+{
+
+    const size_t mask = buckets.size() - 1;
+    size_t       i    = qHash(s) & mask;
+    while (buckets[i] != -1) {
+        if (strings[size_t(buckets[i])] == s)
+            return buckets[i];
+        i = (i + 1) & mask;
+    }
+
+    if (strings.size() >= MaxNames)
+        return -1;
+
+    int id = int(strings.size());
+    strings.push_back(s.toString());
+    buckets[i] = id;
+    if (strings.size() * 2 > buckets.size())
+        rehash(buckets.size() * 2);
+    return id;
+}
+
+void NameTable::rehash(size_t size)
+{
+    buckets.assign(size, -1);
+    const size_t mask = size - 1;
+    for (size_t id = 0; id < strings.size(); ++id) {
+        size_t i = qHash(strings[id]) & mask;
+        while (buckets[i] != -1)
+            i = (i + 1) & mask;
+        buckets[i] = int(id);
+    }
+}
+
+//----------------------------------------------------------------------------
+// StanzaTree
+//----------------------------------------------------------------------------
+StanzaTree::StanzaTree(const std::shared_ptr<NameTable> &names) : names(names)
+{
+    nodes.reserve(16);
+    attrs.reserve(16);
+    chars.reserve(512);
+}
+
+StanzaTree::Str StanzaTree::store(const QStringRef &s, bool intern)
+{
+    Str ret;
+    if (s.isEmpty())
+        return ret;
+    if (intern) {
+        ret.atom = names->intern(s);
+        if (ret.atom != -1)
+            return ret;
+    }
+    ret.offset = chars.size();
+    ret.length = s.size();
+    chars.append(s);
+    return ret;
+}
+
+Atom::Id StanzaTree::atom(const Str &s) const
+{
+    return s.atom > Atom::Unknown && s.atom < Atom::Count ? Atom::Id(s.atom) : Atom::Unknown;
+}
+
+QStringRef StanzaTree::ref(const Str &s) const
+{
+    if (s.atom != -1)
+        return QStringRef(&names->string(s.atom));
+    return QStringRef(&chars, s.offset, s.length);
+}
+
+QString StanzaTree::string(const Str &s) const
+{
+    if (s.atom != -1)
+        return names->string(s.atom); // shared, no copy
+    return chars.mid(s.offset, s.length);
+}
+
+void StanzaTree::appendNode(int parent, Node &&n)
+{
+    int id   = int(nodes.size());
+    n.parent = parent;
+    nodes.push_back(std::move(n));
+    if (parent == -1)
+        return;
+    Node &p = nodes[size_t(parent)];
+    if (p.lastChild == -1)
+        p.firstChild = id;
+    else
+        nodes[size_t(p.lastChild)].nextSibling = id;
+    p.lastChild = id;
+}
+
+int StanzaTree::addElement(int parent, const QStringRef &ns, const QStringRef &name, const QStringRef &prefix)
+{
+    Node n;
+    n.type      = ElementNode;
+    n.name      = store(name, true);
+    n.ns        = store(ns, true);
+    n.prefix    = store(prefix, true);
+    n.firstAttr = int(attrs.size());
+    appendNode(parent, std::move(n));
+    return int(nodes.size()) - 1;
+}
+
+void StanzaTree::addAttribute(int element, const QStringRef &ns, const QStringRef &name, const QStringRef &prefix,
+                              const QStringRef &value)
+{
+    // attributes arrive together with their element, so they are contiguous
+    Q_ASSERT(nodes[size_t(element)].firstAttr + nodes[size_t(element)].attrCount == int(attrs.size()));
+    Attr a;
+    a.name   = store(name, true);
+    a.ns     = store(ns, true);
+    a.prefix = store(prefix, true);
+    a.value  = store(value, false);
+    attrs.push_back(a);
+    nodes[size_t(element)].attrCount++;
+}
+
+void StanzaTree::addText(int parent, const QStringRef &text)
+{
+    Node n;
+    n.type = TextNode;
+    n.text = store(text, false);
+    appendNode(parent, std::move(n));
+}
+
+QStringRef StanzaTree::attribute(int node, const QString &name) const
+{
+    const Node &n = nodes[size_t(node)];
+    for (int i = n.firstAttr; i < n.firstAttr + n.attrCount; ++i) {
+        const Attr &a = attrs[size_t(i)];
+        if (a.ns.atom == -1 && a.ns.length == 0 && ref(a.name) == name)
+            return ref(a.value);
+    }
+    return QStringRef();
+}
+
+int StanzaTree::firstChildElement(int node, const QString &name, const QString &ns) const
+{
+    for (int c = firstChild(node); c != -1; c = nextSibling(c)) {
+        const Node &n = nodes[size_t(c)];
+        if (n.type == ElementNode && (name.isEmpty() || ref(n.name) == name) && (ns.isEmpty() || ref(n.ns) == ns))
+            return c;
+    }
+    return -1;
+}
+
+QDomElement StanzaTree::toElement(QDomDocument &doc, int node) const
+{
+    // mirrors what Parser does when it builds QDom directly
+    const Node &n = nodes[size_t(node)];
+    QDomElement e;
+    if (n.ns.atom == -1 && n.ns.length == 0)
+        e = doc.createElement(string(n.name));
+    else
+        e = doc.createElementNS(string(n.ns), string(n.name));
+
+    for (int i = n.firstAttr; i < n.firstAttr + n.attrCount; ++i) {
+        const Attr &a     = attrs[size_t(i)];
+        bool        hasNS = !(a.ns.atom == -1 && a.ns.length == 0);
+        QDomAttr    da;
+        if (hasNS)
+            da = doc.createAttributeNS(string(a.ns), string(a.name));
+        else
+            da = doc.createAttribute(string(a.name));
+        da.setPrefix(string(a.prefix));
+        da.setValue(string(a.value));
+        if (hasNS)
+            e.setAttributeNodeNS(da);
+        else
+            e.setAttributeNode(da);
+    }
+
+    for (int c = n.firstChild; c != -1; c = nodes[size_t(c)].nextSibling) {
+        if (nodes[size_t(c)].type == ElementNode)
+            e.appendChild(toElement(doc, c));
+        else
+            e.appendChild(doc.createTextNode(string(nodes[size_t(c)].text)));
+    }
+    return e;
+}
+
+} // namespace XMPP
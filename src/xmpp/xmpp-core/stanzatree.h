@@ -0,0 +1,135 @@
+/*
+ * stanzatree.h - compact tree of a received top-level element
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef XMPP_STANZATREE_H
+#define XMPP_STANZATREE_H
+
+#include "xmpp_atoms.h"
+
+#include <QDomElement>
+#include <QString>
+#include <QStringRef>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace XMPP {
+
+/**
+ * @brief Interns element/attribute names and namespaces.
+ *
+ * Shared by all the trees built by one parser, so the same name received
+ * again and again is stored only once. The table is bounded since names come
+ * from the peer; when it's full, new names are kept in the tree itself.
+ *
+ * The table starts with the names of Atom, under the same ids.
+ */
+class NameTable {
+public:
+    enum { MaxNames = 4096 };
+
+    NameTable();
+
+    // returns -1 if the table is full
+    int            intern(const QStringRef &s);
+    const QString &string(int id) const { return strings[size_t(id)]; }
+    int            count() const { return int(strings.size()); }
+
+private:
+    std::deque<QString> strings; // stable addresses for QStringRef
+    std::vector<int>    buckets; // open addressing. index into strings or -1
+
+    void rehash(size_t size);
+};
+
+/**
+ * @brief Tree of one top-level element as received from the stream.
+ *
+ * Nodes, attributes and character data live in three flat arrays which are
+ * allocated once per stanza, instead of a heap allocated QDom object per node.
+ * Node 0 is the root element. toElement() converts the tree to QDom for the
+ * consumers which need it.
+ */
+class StanzaTree {
+public:
+    enum NodeType { ElementNode, TextNode };
+
+    StanzaTree(const std::shared_ptr<NameTable> &names);
+
+    bool isNull() const { return nodes.empty(); }
+    int  nodeCount() const { return int(nodes.size()); }
+
+    // building
+    int  addElement(int parent, const QStringRef &ns, const QStringRef &name, const QStringRef &prefix);
+    void addAttribute(int element, const QStringRef &ns, const QStringRef &name, const QStringRef &prefix,
+                      const QStringRef &value);
+    void addText(int parent, const QStringRef &text);
+    int  parentNode(int node) const { return nodes[size_t(node)].parent; }
+
+    // inspection
+    NodeType   nodeType(int node) const { return NodeType(nodes[size_t(node)].type); }
+    QStringRef tagName(int node = 0) const { return ref(nodes[size_t(node)].name); }
+    QStringRef namespaceURI(int node = 0) const { return ref(nodes[size_t(node)].ns); }
+    Atom::Id   nameAtom(int node = 0) const { return atom(nodes[size_t(node)].name); }
+    Atom::Id   namespaceAtom(int node = 0) const { return atom(nodes[size_t(node)].ns); }
+    QStringRef text(int node) const { return ref(nodes[size_t(node)].text); }
+    QStringRef attribute(int node, const QString &name) const;
+    int        firstChild(int node) const { return nodes[size_t(node)].firstChild; }
+    int        nextSibling(int node) const { return nodes[size_t(node)].nextSibling; }
+    int        firstChildElement(int node, const QString &name = QString(), const QString &ns = QString()) const;
+
+    QDomElement toElement(QDomDocument &doc, int node = 0) const;
+
+private:
+    // either an interned string (atom >= 0) or a slice of chars
+    struct Str {
+        int atom   = -1;
+        int offset = 0;
+        int length = 0;
+    };
+    struct Node {
+        int type;
+        Str name, ns, prefix, text;
+        int parent      = -1;
+        int firstChild  = -1;
+        int lastChild   = -1;
+        int nextSibling = -1;
+        int firstAttr   = 0;
+        int attrCount   = 0;
+    };
+    struct Attr {
+        Str name, ns, prefix, value;
+    };
+
+    std::shared_ptr<NameTable> names;
+    std::vector<Node>          nodes;
+    std::vector<Attr>          attrs;
+    QString                    chars;
+
+    Str        store(const QStringRef &s, bool intern);
+    Atom::Id   atom(const Str &s) const;
+    QStringRef ref(const Str &s) const;
+    QString    string(const Str &s) const;
+    void       appendNode(int parent, Node &&n);
+};
+
+} // namespace XMPP
+
+#endif // XMPP_STANZATREE_H
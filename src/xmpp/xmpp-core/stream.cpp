@@ -51,10 +51,15 @@
 #ifdef XMPP_TEST
 #include "td.h"
 #endif
+#include "xmpp/zlib/zlibcompressor.h"
 
 #include <QByteArray>
+#include <QDataStream>
+#include <QFile>
 #include <QList>
+#include <QMetaMethod>
 #include <QPointer>
+#include <QSaveFile>
 #include <QTextStream>
 #include <QTimer>
 #include <QUrl>
@@ -102,6 +107,8 @@ Stanza Stream::createStanza(Stanza::Kind k, const Jid &to, const QString &type,
 
 Stanza Stream::createStanza(const QDomElement &e) { return Stanza(this, e); }
 
+Stanza Stream::createStanza(const QDomElement &e, const StanzaDocument &doc) { return Stanza(this, e, doc); }
+
 QString Stream::xmlToString(const QDomElement &e, bool clip)
 {
     if (!foo) {
@@ -138,6 +145,8 @@ public:
         sasl_ssf   = 0;
         tls_warned = false;
         using_tls  = false;
+        pendingOut.clear();
+        flushTimer.stop();
     }
 
     Jid                    jid;
@@ -179,6 +188,8 @@ public:
     bool doAuth;
     bool doCompress = false;
 
+    ZLibOptions compressOptions;
+
     QStringList sasl_mechlist;
 
     int                     errCond;
@@ -192,6 +203,13 @@ public:
     QTimer noopTimer;
     int    noop_time;
     bool   quiet_reconnection = false;
+
+    // write coalescing
+    int                      coalesceBytes = 0; // 0 - disabled
+    int                      coalesceDelay = 0;
+    QByteArray               pendingOut;
+    QTimer                   flushTimer;
+    ClientStream::WriteStats writeStats;
 };
 
 ClientStream::ClientStream(Connector *conn, TLSHandler *tlsHandler, QObject *parent) : Stream(parent)
@@ -205,7 +223,13 @@ ClientStream::ClientStream(Connector *conn, TLSHandler *tlsHandler, QObject *par
     d->noop_time = 0;
     connect(&d->noopTimer, SIGNAL(timeout()), SLOT(doNoop()));
 
+    d->flushTimer.setSingleShot(true);
+    connect(&d->flushTimer, SIGNAL(timeout()), SLOT(flushWrites()));
+
     d->tlsHandler = tlsHandler;
+
+    // routing is decided on stanza trees, so stream management acks and such never become QDom
+    d->client.setStanzaTreeEnabled(true);
 }
 
 ClientStream::ClientStream(const QString &host, const QString &defRealm, ByteStream *bs, QCA::TLS *tls,
@@ -242,6 +266,28 @@ ClientStream::ClientStream(const QString &host, const QString &defRealm, ByteStr
     connect(&(d->timeout_timer), SIGNAL(timeout()), SLOT(sm_timeout()));
 }
 
+void ClientStream::connectNotify(const QMetaMethod &signal)
+{
+    if (signal == QMetaMethod::fromSignal(&ClientStream::incomingXml)
+        || signal == QMetaMethod::fromSignal(&ClientStream::outgoingXml))
+        updateTransferTap();
+}
+
+void ClientStream::disconnectNotify(const QMetaMethod &signal)
+{
+    // may be invalid for disconnect() of everything
+    if (!signal.isValid() || signal == QMetaMethod::fromSignal(&ClientStream::incomingXml)
+        || signal == QMetaMethod::fromSignal(&ClientStream::outgoingXml))
+        updateTransferTap();
+}
+
+void ClientStream::updateTransferTap()
+{
+    // record sent/received xml only if somebody wants to see it
+    d->client.setTransferTapEnabled(isSignalConnected(QMetaMethod::fromSignal(&ClientStream::incomingXml))
+                                    || isSignalConnected(QMetaMethod::fromSignal(&ClientStream::outgoingXml)));
+}
+
 ClientStream::~ClientStream()
 {
     // fprintf(stderr, "\tClientStream::~ClientStream\n");
@@ -464,6 +510,16 @@ void ClientStream::setLocalAddr(const QHostAddress &addr, quint16 port)
 
 void ClientStream::setCompress(bool compress) { d->doCompress = compress; }
 
+void ClientStream::setCompressionOptions(int level, int windowBits, int memLevel)
+{
+    d->compressOptions       = ZLibOptions();
+    d->compressOptions.level = level;
+    if (windowBits != -1)
+        d->compressOptions.windowBits = windowBits;
+    if (memLevel != -1)
+        d->compressOptions.memLevel = memLevel;
+}
+
 int ClientStream::errorCondition() const { return d->errCond; }
 
 QString ClientStream::errorText() const { return d->errText; }
@@ -525,6 +581,47 @@ void ClientStream::write(const Stanza &s)
 
 void ClientStream::clearSendQueue() { d->client.clearSendQueue(); }
 
+void ClientStream::setWriteCoalescing(int maxBytes, int maxDelay)
+{
+    d->coalesceBytes = maxBytes;
+    d->coalesceDelay = maxDelay;
+    if (!maxBytes)
+        flushWrites();
+}
+
+ClientStream::WriteStats ClientStream::writeStats() const { return d->writeStats; }
+
+void ClientStream::writeOut(const QByteArray &a)
+{
+    ++d->writeStats.chunks;
+    // layer switches (tls, compression, sasl) happen before the stream is
+    // active, and everything written before them must go out unchanged
+    if (!d->coalesceBytes || d->state != Active) {
+        flushWrites();
+        ++d->writeStats.flushes;
+        d->writeStats.bytes += quint64(a.size());
+        d->ss->write(a);
+        return;
+    }
+
+    d->pendingOut += a;
+    if (d->pendingOut.size() >= d->coalesceBytes)
+        flushWrites();
+    else if (!d->flushTimer.isActive())
+        d->flushTimer.start(d->coalesceDelay);
+}
+
+void ClientStream::flushWrites()
+{
+    d->flushTimer.stop();
+    if (d->pendingOut.isEmpty() || !d->ss)
+        return;
+    ++d->writeStats.flushes;
+    d->writeStats.bytes += quint64(d->pendingOut.size());
+    d->ss->write(d->pendingOut);
+    d->pendingOut.clear();
+}
+
 void ClientStream::cr_connected()
 {
     d->connectHost = d->conn->host();
@@ -892,7 +989,9 @@ void ClientStream::processNext()
                 if (i.str.trimmed().isEmpty())
                     continue;
                 str = i.str;
-            } else
+            } else if (!i.raw.isEmpty())
+                str = QString::fromUtf8(i.raw);
+            else
                 str = d->client.elementToString(i.elem);
             if (i.isSent)
                 emit outgoingXml(str);
@@ -949,7 +1048,7 @@ void ClientStream::processNext()
 #ifdef XMPP_DEBUG
                 qDebug("Need Send: {%s}\n", a.data());
 #endif
-                d->ss->write(a);
+                writeOut(a);
             }
             break;
         }
@@ -1022,7 +1121,9 @@ void ClientStream::processNext()
 #endif
             // store the stanza for now, announce after processing all events
             // TODO: add a method to the stanza to mark them handled.
-            Stanza s = createStanza(d->client.recvStanza());
+            StanzaDocument doc;
+            QDomElement    e = d->client.recvStanza(&doc);
+            Stanza         s = createStanza(e, doc);
             if (s.isNull())
                 break;
             if (d->client.sm.isActive())
@@ -1115,7 +1216,7 @@ bool ClientStream::handleNeed()
 #ifdef XMPP_DEBUG
         qDebug("Need compress\n");
 #endif
-        d->ss->setLayerCompress(d->client.spare);
+        d->ss->setLayerCompress(d->client.spare, d->compressOptions);
         return true;
     }
     case CoreProtocol::NSASLFirst: {
@@ -1509,6 +1610,36 @@ bool ClientStream::isResumed() const { return d->client.sm.isResumed(); }
 
 void ClientStream::setSMEnabled(bool e) { d->client.sm.state().setEnabled(e); }
 
+void ClientStream::setSMQueueLimit(qint64 bytes, SMOverflowPolicy policy)
+{
+    d->client.sm.setQueueLimit(bytes, policy == SMDropOldest ? SMQueue::DropOldest : SMQueue::DisableResumption);
+}
+
+bool ClientStream::saveSMState(const QString &fileName) const
+{
+    const SMState &state = d->client.sm.state();
+    if (!state.isResumption())
+        return false;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    state.write(out);
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool ClientStream::restoreSMState(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+    return d->client.sm.state().read(in);
+}
+
 void ClientStream::setTimer(int secs)
 {
     d->timeout_timer.setSingleShot(true);
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/parser.h"
+#include "xmpp/xmpp-core/stanzadocument.h"
+#include "xmpp/xmpp-core/stanzatree.h"
+#include "xmpp/xmpp-core/xmpp_atoms.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+static const char *streamOpen = "<?xml version='1.0'?>"
+                                "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' "
+                                "from='example.com' id='abc' version='1.0'>";
+
+static const char *message = "<message from='romeo@example.net/orchard' to='juliet@example.com' type='chat' "
+                             "xml:lang='en'><body>Art thou not &lt;Romeo&gt;?</body>"
+                             "<active xmlns='http://jabber.org/protocol/chatstates'/>"
+                             "<x xmlns='jabber:x:foo' xmlns:p='urn:p' p:attr='v'>mixed <b>content</b> here</x>"
+                             "</message>";
+
+class ParserTest : public QObject {
+    Q_OBJECT
+
+    static QList<Parser::Event> parse(Parser &p, const QByteArray &data)
+    {
+        QList<Parser::Event> events;
+        p.appendData(data);
+        for (Parser::Event e = p.readNext(); !e.isNull(); e = p.readNext())
+            events += e;
+        return events;
+    }
+
+    static QString dump(const QDomElement &e)
+    {
+        QString     out;
+        QTextStream ts(&out);
+        e.save(ts, 0);
+        return out;
+    }
+
+private slots:
+    void initTestCase() { qSetGlobalQHashSeed(0); }
+
+    void testStanzaTree()
+    {
+        Parser p;
+        p.setStanzaTreeEnabled(true);
+        auto events = parse(p, QByteArray(streamOpen) + message);
+        QCOMPARE(events.size(), 2);
+        QCOMPARE(events[0].type(), int(Parser::Event::DocumentOpen));
+        QCOMPARE(events[1].type(), int(Parser::Event::Element));
+
+        const StanzaTree *t = events[1].stanzaTree();
+        QVERIFY(t);
+        QCOMPARE(t->tagName().toString(), QString("message"));
+        QCOMPARE(t->namespaceURI().toString(), QString("jabber:client"));
+        QCOMPARE(t->attribute(0, "type").toString(), QString("chat"));
+        int body = t->firstChildElement(0, "body");
+        QVERIFY(body != -1);
+        QCOMPARE(t->text(t->firstChild(body)).toString(), QString("Art thou not <Romeo>?"));
+        QVERIFY(t->firstChildElement(0, "active", "http://jabber.org/protocol/chatstates") != -1);
+        QCOMPARE(t->firstChildElement(0, "active", "jabber:client"), -1);
+    }
+
+    void testSameAsQDom()
+    {
+        Parser qdom;
+        Parser tree;
+        tree.setStanzaTreeEnabled(true);
+        auto expected = parse(qdom, QByteArray(streamOpen) + message);
+        auto actual   = parse(tree, QByteArray(streamOpen) + message);
+        QCOMPARE(actual.size(), expected.size());
+        QCOMPARE(dump(actual[1].element()), dump(expected[1].element()));
+    }
+
+    void testTreeSurvivesReset()
+    {
+        Parser p;
+        p.setStanzaTreeEnabled(true);
+        auto events = parse(p, QByteArray(streamOpen) + message);
+        p.reset();
+        QCOMPARE(events[1].element().tagName(), QString("message"));
+        QCOMPARE(parse(p, QByteArray(streamOpen) + message)[1].stanzaTree()->tagName().toString(), QString("message"));
+    }
+
+    void testStanzaDocuments_data()
+    {
+        QTest::addColumn<bool>("useTree");
+        QTest::newRow("qdom") << false;
+        QTest::newRow("tree") << true;
+    }
+
+    void testStanzaDocuments()
+    {
+        QFETCH(bool, useTree);
+        const int    documents = StanzaDocument::liveDocuments();
+        const qint64 nodes     = StanzaDocument::liveNodes();
+
+        Parser p;
+        p.setStanzaTreeEnabled(useTree);
+        auto events = parse(p, QByteArray(streamOpen) + message + "<stream:features/>" + message);
+        QCOMPARE(events.size(), 4);
+        for (auto const &e : events)
+            e.element();
+
+        // stanzas own a document each, stream level elements don't
+        QVERIFY(!events[1].document().isNull());
+        QVERIFY(events[2].document().isNull());
+        QVERIFY(!events[3].document().isNull());
+        QVERIFY(events[1].document().root() == events[1].element());
+        QCOMPARE(StanzaDocument::liveDocuments(), documents + 2);
+        const qint64 perStanza = (StanzaDocument::liveNodes() - nodes) / 2;
+        QVERIFY(perStanza > 10);
+
+        // whoever holds the document can keep using the element
+        StanzaDocument kept = events[3].document();
+        QDomElement    e    = events[3].element();
+        events.clear();
+        QCOMPARE(StanzaDocument::liveDocuments(), documents + 1);
+        QCOMPARE(StanzaDocument::liveNodes(), nodes + perStanza);
+        e.appendChild(e.ownerDocument().createElement("extra"));
+        QCOMPARE(StanzaDocument::liveNodes(), nodes + perStanza + 1);
+
+        // and then it's all gone
+        e    = QDomElement();
+        kept = StanzaDocument();
+        QCOMPARE(StanzaDocument::liveDocuments(), documents);
+        QCOMPARE(StanzaDocument::liveNodes(), nodes);
+    }
+
+    void testAtoms()
+    {
+        QCOMPARE(Atom::id(QString("jabber:client")), Atom::NsClient);
+        QCOMPARE(Atom::id(QString("message")), Atom::Message);
+        QCOMPARE(Atom::id(QString("jabber:x:foo")), Atom::Unknown);
+        QVERIFY(Atom::is(QString("body"), Atom::Body));
+        QVERIFY(!Atom::is(QString("body"), Atom::Html));
+
+        // parsed names are the very strings of the table
+        Parser      qdom;
+        QDomElement e = parse(qdom, QByteArray(streamOpen) + message)[1].element();
+        QCOMPARE(e.tagName().constData(), Atom::string(Atom::Message).constData());
+        QCOMPARE(e.namespaceURI().constData(), Atom::string(Atom::NsClient).constData());
+        QDomElement active = e.firstChildElement("active");
+        QVERIFY(Atom::is(active, Atom::NsChatStates, Atom::Active));
+        QCOMPARE(e.firstChildElement("x").namespaceURI(), QString("jabber:x:foo"));
+
+        // and the tree hands out their ids
+        Parser tree;
+        tree.setStanzaTreeEnabled(true);
+        const StanzaTree *t = parse(tree, QByteArray(streamOpen) + message)[1].stanzaTree();
+        QCOMPARE(t->nameAtom(), Atom::Message);
+        QCOMPARE(t->namespaceAtom(), Atom::NsClient);
+        int x = t->firstChildElement(0, "x");
+        QCOMPARE(t->nameAtom(x), Atom::X);
+        QCOMPARE(t->namespaceAtom(x), Atom::Unknown);
+        QCOMPARE(t->namespaceURI(x).toString(), QString("jabber:x:foo"));
+    }
+
+    void testSlicedInput()
+    {
+        QByteArray stream = QByteArray(streamOpen) + message + message;
+        for (int slice : { 1, 3, 7, 64 }) {
+            Parser               p;
+            QList<Parser::Event> events;
+            for (int i = 0; i < stream.size(); i += slice)
+                events += parse(p, stream.mid(i, slice));
+            QCOMPARE(events.size(), 3);
+            QCOMPARE(events[2].element().tagName(), QString("message"));
+        }
+    }
+
+    void testUnprocessed()
+    {
+        Parser p;
+        auto   events
+            = parse(p, QByteArray(streamOpen) + "<proceed xmlns='urn:ietf:params:xml:ns:xmpp-tls'/>\x16\x03");
+        QCOMPARE(events.size(), 2);
+        p.appendData("\x01\x02");
+        QCOMPARE(p.unprocessed(), QByteArray("\x16\x03\x01\x02"));
+    }
+
+    // Recorded traffic isn't shipped, so the stream is synthesized from the
+    // same stanza. Throughput must not depend on how the input is sliced.
+    void benchmarkSlicing_data()
+    {
+        QTest::addColumn<int>("slice");
+        for (int slice : { 1, 16, 512, 4096, 65536 })
+            QTest::newRow(qPrintable(QString::number(slice))) << slice;
+    }
+    void benchmarkSlicing()
+    {
+        QFETCH(int, slice);
+        QByteArray stream = streamOpen;
+        while (stream.size() < 1024 * 1024)
+            stream += message;
+        QList<QByteArray> slices;
+        for (int i = 0; i < stream.size(); i += slice)
+            slices += stream.mid(i, slice);
+        QBENCHMARK
+        {
+            Parser p;
+            for (auto const &s : slices) {
+                p.appendData(s);
+                while (!p.readNext().isNull()) { }
+            }
+        }
+    }
+
+    void benchmarkParse_data()
+    {
+        QTest::addColumn<bool>("useTree");
+        QTest::newRow("qdom") << false;
+        QTest::newRow("tree") << true;
+    }
+    void benchmarkParse()
+    {
+        QFETCH(bool, useTree);
+        QByteArray stanzas;
+        for (int i = 0; i < 1000; ++i)
+            stanzas += message;
+        QBENCHMARK
+        {
+            Parser p;
+            p.setStanzaTreeEnabled(useTree);
+            parse(p, QByteArray(streamOpen) + stanzas);
+        }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(ParserTest);
+#include "parsertest.moc"
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/sm.h"
+
+#include <QDataStream>
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+static QByteArray stanza(int n)
+{
+    return "<message to='peer@example.org' id='" + QByteArray::number(n) + "'><body>hello</body></message>\n";
+}
+
+class SMQueueTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testQueue()
+    {
+        SMQueue q;
+        for (int n = 0; n < 1000; ++n)
+            QVERIFY(q.enqueue(stanza(n)));
+        QCOMPARE(q.count(), 1000);
+
+        for (int n = 0; n < 990; ++n)
+            q.dequeue();
+        QCOMPARE(q.count(), 10);
+        QCOMPARE(q.stored(0), stanza(990));
+        QCOMPARE(q.stored(9), stanza(999));
+        QVERIFY(q.stored(10).isNull());
+
+        for (int n = 0; n < 10; ++n)
+            q.dequeue();
+        QVERIFY(q.isEmpty());
+        QCOMPARE(q.bytes(), qint64(0));
+    }
+
+    void testDropOldest()
+    {
+        SMQueue q;
+        q.setLimit(stanza(0).size() * 3, SMQueue::DropOldest);
+        for (int n = 0; n < 5; ++n)
+            q.enqueue(stanza(n));
+
+        QCOMPARE(q.count(), 5);
+        QCOMPARE(q.storedCount(), 3);
+        QCOMPARE(q.lostCount(), quint64(2));
+        QCOMPARE(q.stored(0), stanza(2));
+
+        // acks take the forgotten ones first
+        q.dequeue();
+        q.dequeue();
+        QCOMPARE(q.storedCount(), 3);
+        q.dequeue();
+        QCOMPARE(q.stored(0), stanza(3));
+    }
+
+    void testDisableResumption()
+    {
+        SMQueue q;
+        q.setLimit(stanza(0).size() * 3, SMQueue::DisableResumption);
+        for (int n = 0; n < 3; ++n)
+            QVERIFY(q.enqueue(stanza(n)));
+        QVERIFY(!q.enqueue(stanza(3)));
+        QVERIFY(!q.enqueue(stanza(4)));
+
+        QVERIFY(q.isOverflowed());
+        QCOMPARE(q.count(), 5);
+        QCOMPARE(q.storedCount(), 0);
+
+        q.clear();
+        QVERIFY(!q.isOverflowed());
+        QVERIFY(q.enqueue(stanza(0)));
+    }
+
+    void testPersistence()
+    {
+        SMQueue q;
+        q.setLimit(1 << 20, SMQueue::DropOldest);
+        for (int n = 0; n < 100; ++n)
+            q.enqueue(stanza(n));
+        for (int n = 0; n < 40; ++n)
+            q.dequeue();
+
+        QByteArray data;
+        {
+            QDataStream out(&data, QIODevice::WriteOnly);
+            q.write(out);
+        }
+        SMQueue     r;
+        QDataStream in(data);
+        QVERIFY(r.read(in));
+        QCOMPARE(r.count(), 60);
+        QCOMPARE(r.limit(), qint64(1 << 20));
+        QCOMPARE(r.stored(0), stanza(40));
+        QCOMPARE(r.stored(59), stanza(99));
+
+        QDataStream truncated(data.left(data.size() / 2));
+        QVERIFY(!r.read(truncated));
+        QVERIFY(r.isEmpty());
+    }
+
+    void testStateSnapshot()
+    {
+        SMState state;
+        state.resumption_id            = "some-long-sm-id";
+        state.resumption_location.host = "sm.example.org";
+        state.resumption_location.port = 5222;
+        state.jid                      = "user@example.org/home";
+        state.received_count           = 1234;
+        state.server_last_handled      = 77;
+        state.send_queue.enqueue(stanza(78));
+        state.send_queue.enqueue(stanza(79));
+
+        QByteArray data;
+        {
+            QDataStream out(&data, QIODevice::WriteOnly);
+            state.write(out);
+        }
+        SMState     restored;
+        QDataStream in(data);
+        QVERIFY(restored.read(in));
+        QVERIFY(restored.restored);
+        QVERIFY(restored.isEnabled());
+        QVERIFY(restored.isResumption());
+        QVERIFY(restored.isLocationValid());
+        QCOMPARE(restored.jid, state.jid);
+        QCOMPARE(restored.received_count, quint32(1234));
+        QCOMPARE(restored.server_last_handled, quint32(77));
+        QCOMPARE(restored.send_queue.count(), 2);
+        QCOMPARE(restored.send_queue.stored(1), stanza(79));
+
+        SMState     garbage;
+        QDataStream junk(QByteArray("not a snapshot"));
+        QVERIFY(!garbage.read(junk));
+        QVERIFY(!garbage.isResumption());
+    }
+
+    void benchmarkAckedBacklog()
+    {
+        // a flaky link: tens of thousands unacked, then acked in batches
+        QBENCHMARK
+        {
+            SMQueue q;
+            for (int n = 0; n < 50000; ++n)
+                q.enqueue(stanza(n));
+            while (!q.isEmpty()) {
+                for (int n = 0; n < 100 && !q.isEmpty(); ++n)
+                    q.dequeue();
+            }
+        }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(SMQueueTest);
+#include "smqueuetest.moc"
@@ -0,0 +1,4 @@
+SOURCES += \
+    $$PWD/parsertest.cpp \
+    $$PWD/smqueuetest.cpp \
+    $$PWD/xmlprotocoltest.cpp
@@ -0,0 +1,24 @@
+include(../../modules.pri)
+include($$IRIS_XMPP_QA_UNITTEST_MODULE)
+include(unittest.pri)
+
+QT += xml
+
+INCLUDEPATH *= $$PWD/.. $$PWD/../../.. $$PWD/../../../irisnet/noncore/cutestuff
+DEPENDPATH *= $$PWD/..
+
+HEADERS += \
+    $$PWD/../parser.h \
+    $$PWD/../sm.h \
+    $$PWD/../stanzadocument.h \
+    $$PWD/../stanzatree.h \
+    $$PWD/../xmlprotocol.h \
+    $$PWD/../xmpp_atoms.h
+
+SOURCES += \
+    $$PWD/../parser.cpp \
+    $$PWD/../sm.cpp \
+    $$PWD/../stanzadocument.cpp \
+    $$PWD/../stanzatree.cpp \
+    $$PWD/../xmlprotocol.cpp \
+    $$PWD/../xmpp_atoms.cpp
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/stanzatree.h"
+#include "xmpp/xmpp-core/xmlprotocol.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+#define NS_ETHERX "http://etherx.jabber.org/streams"
+#define NS_CLIENT "jabber:client"
+
+class TestProtocol : public XmlProtocol {
+public:
+    QDomDocument doc;
+    bool         reading = false;
+
+    // what doStep() got: the name from the tree and whether there was an element too
+    QList<QPair<QString, bool>> steps;
+
+    void connectToPeer() { startConnect(); }
+
+protected:
+    QDomElement docElement()
+    {
+        QDomElement e = doc.createElementNS(NS_ETHERX, "stream:stream");
+        e.setAttribute(QString::fromLatin1("xmlns"), NS_CLIENT);
+        e.setAttribute(QString::fromLatin1("version"), "1.0");
+        return e;
+    }
+    void handleDocOpen(const Parser::Event &) { }
+    bool handleError() { return false; }
+    bool handleCloseFinished() { return false; }
+    bool stepAdvancesParser() const { return reading; }
+    bool elementNeeded(const StanzaTree &tree) const { return tree.tagName() != QLatin1String("r"); }
+    bool doStep(const QDomElement &e)
+    {
+        if (!stepStanzaTree())
+            return false;
+        steps += qMakePair(stepStanzaTree()->tagName().toString(), !e.isNull());
+        return true;
+    }
+};
+
+class XmlProtocolTest : public QObject {
+    Q_OBJECT
+
+    QDomDocument doc;
+
+    QDomElement message(const QString &body)
+    {
+        QDomElement m = doc.createElementNS(NS_CLIENT, "message");
+        m.setAttribute("to", "juliet@example.com/balcony");
+        m.setAttribute("type", "chat");
+        m.setAttribute("id", "ktx72v49");
+        QDomElement b = doc.createElementNS(NS_CLIENT, "body");
+        b.appendChild(doc.createTextNode(body));
+        m.appendChild(b);
+        QDomElement cs = doc.createElementNS("http://jabber.org/protocol/chatstates", "active");
+        m.appendChild(cs);
+        return m;
+    }
+
+    // the old way of doing things is still used for debug output
+    void compareWithQDom(TestProtocol &p, const QDomElement &e)
+    {
+        QCOMPARE(p.elementToUtf8(e), p.elementToString(e).toUtf8());
+        QCOMPARE(p.elementToUtf8(e, true), p.elementToString(e, true).toUtf8());
+    }
+
+private slots:
+    void initTestCase() { qSetGlobalQHashSeed(0); }
+
+    void testEmptyElement()
+    {
+        TestProtocol p;
+        QDomElement  e = doc.createElementNS(NS_CLIENT, "presence");
+        QCOMPARE(p.elementToUtf8(e, true), QByteArray("<presence/>"));
+        compareWithQDom(p, e);
+    }
+
+    void testNamespaces()
+    {
+        TestProtocol p;
+        QDomElement  iq = doc.createElementNS(NS_CLIENT, "iq");
+        iq.setAttribute("type", "get");
+        QDomElement q = doc.createElementNS("jabber:iq:roster", "query");
+        q.appendChild(doc.createElementNS("jabber:iq:roster", "item"));
+        iq.appendChild(q);
+        QCOMPARE(p.elementToUtf8(iq, true),
+                 QByteArray("<iq type=\"get\">\n<query xmlns=\"jabber:iq:roster\">\n<item/>\n</query>\n</iq>"));
+        compareWithQDom(p, iq);
+
+        QDomElement se = doc.createElementNS(NS_ETHERX, "stream:error");
+        se.appendChild(doc.createElementNS("urn:ietf:params:xml:ns:xmpp-streams", "conflict"));
+        QDomElement te = doc.createElementNS("urn:ietf:params:xml:ns:xmpp-streams", "text");
+        te.setAttributeNS(NS_XML, "xml:lang", "en");
+        te.appendChild(doc.createTextNode("Replaced by new connection"));
+        se.appendChild(te);
+        compareWithQDom(p, se);
+    }
+
+    void testEscaping()
+    {
+        TestProtocol p;
+        QDomElement  m = message("a < b && c > d \"quoted\" 'single' ]]> \r\n\t end");
+        m.setAttribute("id", "<\"&'>\t\n\r");
+        compareWithQDom(p, m);
+    }
+
+    void testNonAsciiAndInvalidChars()
+    {
+        TestProtocol p;
+        QString      body = QString::fromUtf8("Привет, 世界 \xF0\x9F\x98\x80");
+        body += QChar(0x1);       // not allowed in XML
+        body += QChar(0xD800);    // lone high surrogate
+        body += QChar(0xFFFE);    // not a character
+        body += QChar(0xDC00);    // lone low surrogate
+        QDomElement m = message(body);
+        compareWithQDom(p, m);
+        QVERIFY(!p.elementToUtf8(m).contains('\x01'));
+    }
+
+    void testMixedContent()
+    {
+        TestProtocol p;
+        QDomElement  html = doc.createElementNS("http://jabber.org/protocol/xhtml-im", "html");
+        QDomElement  body = doc.createElementNS("http://www.w3.org/1999/xhtml", "body");
+        body.appendChild(doc.createTextNode("Hello, "));
+        QDomElement em = doc.createElementNS("http://www.w3.org/1999/xhtml", "em");
+        em.appendChild(doc.createTextNode("world"));
+        body.appendChild(em);
+        body.appendChild(doc.createTextNode("!"));
+        body.appendChild(doc.createElementNS("http://www.w3.org/1999/xhtml", "br"));
+        html.appendChild(body);
+        compareWithQDom(p, html);
+    }
+
+    void testCDataFallback()
+    {
+        TestProtocol p;
+        QDomElement  m = message("text");
+        m.firstChildElement().appendChild(doc.createCDATASection("<raw>"));
+        compareWithQDom(p, m);
+    }
+
+    void testStanzaTreeStep()
+    {
+        TestProtocol p;
+        p.setStanzaTreeEnabled(true);
+        p.connectToPeer();
+        QVERIFY(p.processStep()); // our stream open
+        p.reading = true;
+        p.addIncomingData("<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' "
+                          "version='1.0'><r xmlns='urn:xmpp:sm:3'/><message id='m1'><body>hi</body></message>");
+        for (int n = 0; n < 10 && p.processStep(); ++n)
+            ;
+
+        // the ack request is never converted to QDom
+        QCOMPARE(p.steps.count(), 2);
+        QCOMPARE(p.steps[0].first, QString("r"));
+        QVERIFY(!p.steps[0].second);
+        QCOMPARE(p.steps[1].first, QString("message"));
+        QVERIFY(p.steps[1].second);
+    }
+
+    void benchmarkQDom_data() { benchmarkUtf8_data(); }
+    void benchmarkQDom()
+    {
+        QFETCH(int, size);
+        TestProtocol p;
+        QDomElement  m = message(QString(size, QChar('x')));
+        QBENCHMARK { p.elementToString(m).toUtf8(); }
+    }
+
+    void benchmarkUtf8_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::newRow("small") << 32;
+        QTest::newRow("large") << 16384;
+    }
+    void benchmarkUtf8()
+    {
+        QFETCH(int, size);
+        TestProtocol p;
+        QDomElement  m = message(QString(size, QChar('x')));
+        QBENCHMARK { p.elementToUtf8(m); }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(XmlProtocolTest);
+#include "xmlprotocoltest.moc"
@@ -23,6 +23,7 @@
 
 #include <QByteArray>
 #include <QList>
+#include <QStringList>
 #include <QTextStream>
 
 using namespace XMPP;
@@ -225,6 +226,204 @@ static QString sanitizeForStream(const QString &in)
     return out;
 }
 
+// Direct UTF-8 serializer
+//
+// The functions below produce exactly the same bytes as
+// sanitizeForStream(xmlToString(...)).toUtf8() does, but they walk the element
+// once and append straight to the output buffer.  No clone of the tree, no
+// namespace-stripped copy and no intermediate UTF-16 string are made.
+enum EscapeMode {
+    EscapeText,      // character data of an element
+    EscapeAttribute, // attribute value
+    EscapeNamespace  // value of a namespace declaration
+};
+
+static inline void appendUtf8(QByteArray &out, quint32 ch)
+{
+    if (ch < 0x80) {
+        out += char(ch);
+    } else if (ch < 0x800) {
+        out += char(0xC0 | (ch >> 6));
+        out += char(0x80 | (ch & 0x3F));
+    } else if (ch < 0x10000) {
+        out += char(0xE0 | (ch >> 12));
+        out += char(0x80 | ((ch >> 6) & 0x3F));
+        out += char(0x80 | (ch & 0x3F));
+    } else {
+        out += char(0xF0 | (ch >> 18));
+        out += char(0x80 | ((ch >> 12) & 0x3F));
+        out += char(0x80 | ((ch >> 6) & 0x3F));
+        out += char(0x80 | (ch & 0x3F));
+    }
+}
+
+// names are markup, so they are neither escaped nor sanitized
+static void appendName(QByteArray &out, const QString &s)
+{
+    const QChar *p   = s.constData();
+    const QChar *end = p + s.size();
+    for (; p != end; ++p) {
+        if (p->unicode() >= 0x80) {
+            out += s.toUtf8();
+            return;
+        }
+    }
+    for (p = s.constData(); p != end; ++p)
+        out += char(p->unicode());
+}
+
+// the same escaping QDom does on save() followed by the sanitizeForStream() filter
+static void appendEscaped(QByteArray &out, const QString &s, EscapeMode mode)
+{
+    const ushort *p   = s.utf16();
+    const int     len = s.size();
+    for (int n = 0; n < len; ++n) {
+        const ushort c = p[n];
+        switch (c) {
+        case '<':
+            out += "&lt;";
+            continue;
+        case '>':
+            out += "&gt;";
+            continue;
+        case '&':
+            out += "&amp;";
+            continue;
+        case '"':
+            if (mode != EscapeText) {
+                out += "&quot;";
+                continue;
+            }
+            break;
+        case 0x9:
+        case 0xA:
+            if (mode == EscapeAttribute) {
+                out += c == 0x9 ? "&#x9;" : "&#xa;";
+                continue;
+            }
+            break;
+        case 0xD:
+            if (mode != EscapeNamespace) {
+                out += "&#xd;";
+                continue;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (c < 0x80 && validChar(c)) {
+            out += char(c);
+        } else if (validChar(c)) {
+            appendUtf8(out, c);
+        } else if (highSurrogate(c) && (n + 1 < len) && lowSurrogate(p[n + 1])) {
+            appendUtf8(out, ((quint32(c) - 0xD800) << 10) + (quint32(p[n + 1]) - 0xDC00) + 0x10000);
+            ++n;
+        } else {
+            qDebug("Dropping invalid XML char U+%04x", c);
+        }
+    }
+}
+
+// scopeNS is the namespace of the closest namespaced ancestor (null if none).
+// Returns false if the element contains nodes other than elements and text,
+// in which case the caller has to fall back to QDom serialization.
+static bool appendElement(QByteArray &out, const QDomElement &e, const QString &scopeNS)
+{
+    const QString ns     = e.namespaceURI();
+    const QString prefix = e.prefix();
+    // stripExtraNS() recreates the element without a namespace (and thus
+    // without a declaration) when it matches the one in scope
+    const bool showNS = !ns.isNull() && (scopeNS.isNull() || scopeNS != ns);
+
+    QString qName;
+    if (!prefix.isEmpty())
+        qName = prefix + ':' + e.localName();
+    else
+        qName = e.tagName();
+
+    out += '<';
+    appendName(out, qName);
+    if (showNS) {
+        if (prefix.isEmpty()) {
+            out += " xmlns=\"";
+        } else {
+            out += " xmlns:";
+            appendName(out, prefix);
+            out += "=\"";
+        }
+        appendEscaped(out, ns, EscapeNamespace);
+        out += '"';
+    }
+
+    const QDomNamedNodeMap al = e.attributes();
+    const int              ac = al.count();
+    if (ac) {
+        const QString elemPrefix = showNS ? prefix : QString();
+        QStringList   declaredPrefixes;
+        for (int x = 0; x < ac; ++x) {
+            const QDomAttr a   = al.item(x).toAttr();
+            const QString  ans = a.namespaceURI();
+            out += ' ';
+            if (ans.isNull()) {
+                appendName(out, a.name());
+            } else if (ans == QLatin1String(NS_XML)) {
+                // don't show xml namespace
+                out += "xml:";
+                appendName(out, a.name());
+            } else {
+                appendName(out, a.prefix());
+                out += ':';
+                appendName(out, a.name());
+            }
+            out += "=\"";
+            appendEscaped(out, a.value(), EscapeAttribute);
+            out += '"';
+
+            if (!ans.isNull() && ans != QLatin1String(NS_XML) && elemPrefix != a.prefix()
+                && !declaredPrefixes.contains(a.prefix())) {
+                declaredPrefixes += a.prefix();
+                out += " xmlns:";
+                appendName(out, a.prefix());
+                out += "=\"";
+                appendEscaped(out, ans, EscapeAttribute);
+                out += '"';
+            }
+        }
+    }
+
+    QDomNode child = e.firstChild();
+    if (child.isNull()) {
+        out += "/>";
+        return true;
+    }
+
+    out += '>';
+    if (!child.isText())
+        out += '\n';
+
+    const QString &childScopeNS = ns.isNull() ? scopeNS : ns;
+    while (!child.isNull()) {
+        QDomNode next = child.nextSibling();
+        if (child.nodeType() == QDomNode::ElementNode) {
+            if (!appendElement(out, child.toElement(), childScopeNS))
+                return false;
+            if (!next.isText())
+                out += '\n';
+        } else if (child.nodeType() == QDomNode::TextNode) {
+            appendEscaped(out, child.nodeValue(), EscapeText);
+        } else {
+            return false;
+        }
+        child = next;
+    }
+
+    out += "</";
+    appendName(out, qName);
+    out += '>';
+    return true;
+}
+
 //----------------------------------------------------------------------------
 // Protocol
 //----------------------------------------------------------------------------
@@ -236,7 +435,7 @@ XmlProtocol::TransferItem::TransferItem(const QString &_str, bool sent, bool ext
 }
 
 XmlProtocol::TransferItem::TransferItem(const QDomElement &_elem, bool sent, bool external) :
-    isSent(sent), isString(false), isExternal(external), elem(_elem)
+    isSent(sent), isString(false), isExternal(external), elemOwner(_elem.ownerDocument()), elem(_elem)
 {
 }
 
@@ -307,13 +506,15 @@ bool XmlProtocol::processStep()
             // note: error/close events should be handled for ALL steps, so do them here
             switch (pe.type()) {
             case Parser::Event::DocumentOpen: {
-                transferItemList += TransferItem(pe.actualString(), false);
+                if (transferTap)
+                    transferItemList += TransferItem(pe.actualString(), false);
 
                 // stringRecv(pe.actualString());
                 break;
             }
             case Parser::Event::DocumentClose: {
-                transferItemList += TransferItem(pe.actualString(), false);
+                if (transferTap)
+                    transferItemList += TransferItem(pe.actualString(), false);
 
                 // stringRecv(pe.actualString());
                 if (incoming) {
@@ -327,8 +528,10 @@ bool XmlProtocol::processStep()
                 return true;
             }
             case Parser::Event::Element: {
-                QDomElement e = elemDoc.importNode(pe.element(), true).toElement();
-                transferItemList += TransferItem(e, false);
+                if (transferTap) {
+                    QDomElement e = elemDoc.importNode(pe.element(), true).toElement();
+                    transferItemList += TransferItem(e, false);
+                }
 
                 // elementRecv(pe.element());
                 break;
@@ -364,50 +567,72 @@ bool XmlProtocol::processStep()
 QString XmlProtocol::xmlEncoding() const { return xml.encoding().toString(); }
 
 QString XmlProtocol::elementToString(const QDomElement &e, bool clip)
+{
+    if (elem.isNull())
+        elem = elemDoc.importNode(docElement(), true).toElement();
+
+    // build qName
+    QString qn;
+    if (!elem.prefix().isEmpty())
+        qn = elem.prefix() + ':';
+    qn += elem.localName();
+
+    // make the string
+    return sanitizeForStream(xmlToString(e, streamNamespace(e), qn, clip));
+}
+
+QByteArray XmlProtocol::elementToUtf8(const QDomElement &e, bool clip)
+{
+    QByteArray out;
+    appendElementUtf8(out, e, clip);
+    return out;
+}
+
+QString XmlProtocol::streamNamespace(const QDomElement &e)
 {
     if (elem.isNull())
         elem = elemDoc.importNode(docElement(), true).toElement();
 
     // Determine the appropriate 'fakeNS' to use
-    QString ns;
 
     // first, check root namespace
     QString pre = e.prefix();
     if (pre.isNull())
         pre = "";
-    if (pre == elem.prefix()) {
-        ns = elem.namespaceURI();
-    } else {
-        // scan the root attributes for 'xmlns' (oh joyous hacks)
-        QDomNamedNodeMap al = elem.attributes();
-        int              n;
-        for (n = 0; n < al.count(); ++n) {
-            QDomAttr a = al.item(n).toAttr();
-            QString  s = a.name();
-            int      x = s.indexOf(':');
-            if (x != -1)
-                s = s.mid(x + 1);
-            else
-                s = "";
-            if (pre == s) {
-                ns = a.value();
-                break;
-            }
-        }
-        if (n >= al.count()) {
-            // if we get here, then no appropriate ns was found.  use root then..
-            ns = elem.namespaceURI();
-        }
+    if (pre == elem.prefix())
+        return elem.namespaceURI();
+
+    // scan the root attributes for 'xmlns' (oh joyous hacks)
+    QDomNamedNodeMap al = elem.attributes();
+    for (int n = 0; n < al.count(); ++n) {
+        QDomAttr a = al.item(n).toAttr();
+        QString  s = a.name();
+        int      x = s.indexOf(':');
+        if (x != -1)
+            s = s.mid(x + 1);
+        else
+            s = "";
+        if (pre == s)
+            return a.value();
     }
 
-    // build qName
-    QString qn;
-    if (!elem.prefix().isEmpty())
-        qn = elem.prefix() + ':';
-    qn += elem.localName();
+    // if we get here, then no appropriate ns was found.  use root then..
+    return elem.namespaceURI();
+}
 
-    // make the string
-    return sanitizeForStream(xmlToString(e, ns, qn, clip));
+void XmlProtocol::appendElementUtf8(QByteArray &out, const QDomElement &e, bool clip)
+{
+    const int from = out.size();
+    if (appendElement(out, e, streamNamespace(e))) {
+        // 'clip' means to remove the trailing newline
+        if (!clip)
+            out += '\n';
+        return;
+    }
+
+    // comments, CDATA sections and such. rare enough to take the slow path
+    out.truncate(from);
+    out += elementToString(e, clip).toUtf8();
 }
 
 bool XmlProtocol::stepRequiresElement() const
@@ -416,6 +641,12 @@ bool XmlProtocol::stepRequiresElement() const
     return false;
 }
 
+bool XmlProtocol::elementNeeded(const StanzaTree &) const
+{
+    // default converts everything
+    return true;
+}
+
 void XmlProtocol::itemWritten(int, int)
 {
     // default does nothing
@@ -463,7 +694,8 @@ bool XmlProtocol::close()
 
 int XmlProtocol::writeString(const QString &s, int id, bool external)
 {
-    transferItemList += TransferItem(s, true, external);
+    if (transferTap)
+        transferItemList += TransferItem(s, true, external);
     return internalWriteString(s, TrackItem::Custom, id);
 }
 
@@ -471,11 +703,29 @@ int XmlProtocol::writeElement(const QDomElement &e, int id, bool external, bool
 {
     if (e.isNull())
         return 0;
-    transferItemList += TransferItem(e, true, external);
 
     // elementSend(e);
-    QString out = sanitizeForStream(elementToString(e, clip));
-    return internalWriteString(out, TrackItem::Custom, id, urgent);
+    QByteArray &out  = urgent ? outDataUrgent : outDataNormal;
+    const int   from = out.size();
+    appendElementUtf8(out, e, clip);
+    if (transferTap) {
+        TransferItem i(e, true, external);
+        i.raw = out.mid(from);
+        transferItemList += i;
+    }
+    return internalTrackData(out.size() - from, TrackItem::Custom, id, urgent);
+}
+
+// utf8 is e as returned by elementToUtf8(). e is only for the transfer tap and may be null
+int XmlProtocol::writeElement(const QDomElement &e, const QByteArray &utf8, int id, bool external)
+{
+    if (transferTap) {
+        TransferItem i = e.isNull() ? TransferItem(QString::fromUtf8(utf8), true, external)
+                                    : TransferItem(e, true, external);
+        i.raw = utf8;
+        transferItemList += i;
+    }
+    return internalWriteData(utf8, TrackItem::Custom, id, false);
 }
 
 QByteArray XmlProtocol::resetStream()
@@ -493,20 +743,26 @@ QByteArray XmlProtocol::resetStream()
 }
 
 int XmlProtocol::internalWriteData(const QByteArray &a, TrackItem::Type t, int id, bool urgent)
+{
+    if (urgent)
+        outDataUrgent += a;
+    else
+        outDataNormal += a;
+    return internalTrackData(a.size(), t, id, urgent);
+}
+
+int XmlProtocol::internalTrackData(int size, TrackItem::Type t, int id, bool urgent)
 {
     TrackItem i;
     i.type = t;
     i.id   = id;
-    i.size = a.size();
+    i.size = size;
 
-    if (urgent) {
+    if (urgent)
         trackQueueUrgent += i;
-        outDataUrgent += a;
-    } else {
+    else
         trackQueueNormal += i;
-        outDataNormal += a;
-    }
-    return a.size();
+    return size;
 }
 
 int XmlProtocol::internalWriteString(const QString &s, TrackItem::Type t, int id, bool urgent)
@@ -556,8 +812,10 @@ void XmlProtocol::sendTagOpen()
     s += xmlHeader + '\n';
     s += sanitizeForStream(tagOpen) + '\n';
 
-    transferItemList += TransferItem(xmlHeader, true);
-    transferItemList += TransferItem(tagOpen, true);
+    if (transferTap) {
+        transferItemList += TransferItem(xmlHeader, true);
+        transferItemList += TransferItem(tagOpen, true);
+    }
 
     // stringSend(xmlHeader);
     // stringSend(tagOpen);
@@ -566,7 +824,8 @@ void XmlProtocol::sendTagOpen()
 
 void XmlProtocol::sendTagClose()
 {
-    transferItemList += TransferItem(tagClose, true);
+    if (transferTap)
+        transferItemList += TransferItem(tagClose, true);
 
     // stringSend(tagClose);
     internalWriteString(tagClose, TrackItem::Close);
@@ -595,9 +854,16 @@ bool XmlProtocol::baseStep(const Parser::Event &pe)
         return true;
     } else if (state == Open) {
         QDomElement e;
-        if (pe.type() == Parser::Event::Element)
-            e = pe.element();
-        return doStep(e);
+        if (pe.type() == Parser::Event::Element) {
+            stepTree = pe.stanzaTree();
+            if (!stepTree || elementNeeded(*stepTree))
+                e = pe.element();
+            stepDoc = pe.document();
+        }
+        bool ret = doStep(e);
+        stepDoc  = StanzaDocument();
+        stepTree = nullptr;
+        return ret;
     }
     // Closing
     else {
@@ -60,6 +60,9 @@ public:
 
     virtual void reset();
 
+    // parse top-level elements into StanzaTree and convert to QDom on demand
+    void setStanzaTreeEnabled(bool enabled) { xml.setStanzaTreeEnabled(enabled); }
+
     // byte I/O for the stream
     void       addIncomingData(const QByteArray &);
     QByteArray takeOutgoingData();
@@ -75,6 +78,7 @@ public:
     inline bool isIncoming() const { return incoming; }
     QString     xmlEncoding() const;
     QString     elementToString(const QDomElement &e, bool clip = false);
+    QByteArray  elementToUtf8(const QDomElement &e, bool clip = false); // what actually goes to the wire
 
     class TransferItem {
     public:
@@ -85,9 +89,15 @@ public:
         bool        isSent;     // else, received
         bool        isString;   // else, is element
         bool        isExternal; // not owned by protocol
-        QString     str;
-        QDomElement elem;
+        QString      str;
+        QDomDocument elemOwner; // nodes don't keep their document alive
+        QDomElement  elem;
+        QByteArray   raw; // element as it was written to the wire, if known
     };
+    // Recording of transfer items is for debug consoles and such. It's off by
+    // default, so nobody pays for copies of every stanza unless asked to.
+    void                setTransferTapEnabled(bool enabled) { transferTap = enabled; }
+    bool                isTransferTapEnabled() const { return transferTap; }
     QList<TransferItem> transferItemList;
     void                setIncomingAsExternal();
 
@@ -101,6 +111,14 @@ protected:
     virtual bool        doStep(const QDomElement &e) = 0;
     virtual void        itemWritten(int id, int size);
 
+    // owner of the element given to doStep() if it's a stanza. valid only during doStep()
+    StanzaDocument stepDocument() const { return stepDoc; }
+
+    // with stanza trees on, the tree of what doStep() got. valid only during doStep(). the element is
+    //   only converted to QDom for doStep() if elementNeeded() says so, it's null otherwise
+    const StanzaTree *stepStanzaTree() const { return stepTree; }
+    virtual bool      elementNeeded(const StanzaTree &tree) const;
+
     // 'debug'
     virtual void stringSend(const QString &s);
     virtual void stringRecv(const QString &s);
@@ -112,6 +130,7 @@ protected:
     bool       close();
     int        writeString(const QString &s, int id, bool external);
     int        writeElement(const QDomElement &e, int id, bool external, bool clip = false, bool urgent = false);
+    int        writeElement(const QDomElement &e, const QByteArray &utf8, int id, bool external);
     QByteArray resetStream();
 
 private:
@@ -123,13 +142,16 @@ private:
     };
 
     bool         incoming;
-    QDomDocument elemDoc;
-    QDomElement  elem;
+    QDomDocument   elemDoc;
+    StanzaDocument stepDoc;
+    const StanzaTree *stepTree = nullptr;
+    QDomElement    elem;
     QString      tagOpen;
     QString      tagClose;
     int          state = 0;
     bool         peerClosed;
     bool         closeWritten;
+    bool         transferTap = false;
 
     Parser           xml;
     QByteArray       outDataNormal;
@@ -137,13 +159,16 @@ private:
     QList<TrackItem> trackQueueNormal;
     QList<TrackItem> trackQueueUrgent;
 
-    void init();
-    int  internalWriteData(const QByteArray &a, TrackItem::Type t, int id = -1, bool urgent = false);
-    int  internalWriteString(const QString &s, TrackItem::Type t, int id = -1, bool urgent = false);
-    int  processTrackQueue(QList<TrackItem> &queue, int bytes);
-    void sendTagOpen();
-    void sendTagClose();
-    bool baseStep(const Parser::Event &pe);
+    void    init();
+    int     internalWriteData(const QByteArray &a, TrackItem::Type t, int id = -1, bool urgent = false);
+    int     internalWriteString(const QString &s, TrackItem::Type t, int id = -1, bool urgent = false);
+    int     internalTrackData(int size, TrackItem::Type t, int id = -1, bool urgent = false);
+    void    appendElementUtf8(QByteArray &out, const QDomElement &e, bool clip);
+    QString streamNamespace(const QDomElement &e);
+    int     processTrackQueue(QList<TrackItem> &queue, int bytes);
+    void    sendTagOpen();
+    void    sendTagClose();
+    bool    baseStep(const Parser::Event &pe);
 };
 } // namespace XMPP
 
@@ -0,0 +1,82 @@
+/*
+ * xmpp_atoms.cpp - table of well-known XMPP names
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "xmpp_atoms.h"
+
+#include <QHash>
+
+namespace XMPP { namespace Atom {
+
+    namespace {
+        // Built once and never modified afterwards, so it's safe to use from
+        // any thread.
+        class Table {
+        public:
+            enum { Buckets = 256 }; // power of two, at least twice Count
+
+            QString strings[Count];
+            qint16  buckets[Buckets];
+
+            Table()
+            {
+#define XMPP_ATOM_STRING(id, str) strings[id] = QStringLiteral(str);
+                XMPP_ATOM_NAMESPACES(XMPP_ATOM_STRING)
+                XMPP_ATOM_NAMES(XMPP_ATOM_STRING)
+#undef XMPP_ATOM_STRING
+                static_assert(Count * 2 <= Buckets, "atom table is too small");
+                for (auto &b : buckets)
+                    b = Unknown;
+                for (int id = Unknown + 1; id < Count; ++id) {
+                    uint i = qHash(strings[id], 0) & (Buckets - 1);
+                    while (buckets[i] != Unknown)
+                        i = (i + 1) & (Buckets - 1);
+                    buckets[i] = qint16(id);
+                }
+            }
+
+            template <typename S> Id find(const S &s) const
+            {
+                for (uint i = qHash(s, 0) & (Buckets - 1); buckets[i] != Unknown; i = (i + 1) & (Buckets - 1)) {
+                    if (strings[buckets[i]] == s)
+                        return Id(buckets[i]);
+                }
+                return Unknown;
+            }
+        };
+
+        const Table &table()
+        {
+            static const Table t;
+            return t;
+        }
+    } // namespace
+
+    const QString &string(Id id) { return table().strings[id]; }
+
+    Id id(const QString &s) { return s.isEmpty() ? Unknown : table().find(s); }
+
+    Id id(const QStringRef &s) { return s.isEmpty() ? Unknown : table().find(s); }
+
+    QString intern(const QStringRef &s)
+    {
+        Id a = id(s);
+        return a == Unknown ? s.toString() : table().strings[a];
+    }
+
+}} // namespace XMPP::Atom
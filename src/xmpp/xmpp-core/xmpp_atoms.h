@@ -0,0 +1,148 @@
+/*
+ * xmpp_atoms.h - table of well-known XMPP names
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef XMPP_ATOMS_H
+#define XMPP_ATOMS_H
+
+#include <QDomElement>
+#include <QString>
+#include <QStringRef>
+
+// clang-format off
+#define XMPP_ATOM_NAMESPACES(F) \
+    F(NsClient,         "jabber:client") \
+    F(NsServer,         "jabber:server") \
+    F(NsEtherx,         "http://etherx.jabber.org/streams") \
+    F(NsStanzas,        "urn:ietf:params:xml:ns:xmpp-stanzas") \
+    F(NsXml,            "http://www.w3.org/XML/1998/namespace") \
+    F(NsSm,             "urn:xmpp:sm:3") \
+    F(NsAddress,        "http://jabber.org/protocol/address") \
+    F(NsBob,            "urn:xmpp:bob") \
+    F(NsCaps,           "http://jabber.org/protocol/caps") \
+    F(NsCaptcha,        "urn:xmpp:captcha") \
+    F(NsCarbons,        "urn:xmpp:carbons:2") \
+    F(NsChatStates,     "http://jabber.org/protocol/chatstates") \
+    F(NsConference,     "jabber:x:conference") \
+    F(NsDelay,          "urn:xmpp:delay") \
+    F(NsDiscoInfo,      "http://jabber.org/protocol/disco#info") \
+    F(NsDiscoItems,     "http://jabber.org/protocol/disco#items") \
+    F(NsEncrypted,      "jabber:x:encrypted") \
+    F(NsEvent,          "jabber:x:event") \
+    F(NsForward,        "urn:xmpp:forward:0") \
+    F(NsHints,          "urn:xmpp:hints") \
+    F(NsHttpAuth,       "http://jabber.org/protocol/http-auth") \
+    F(NsIbb,            "http://jabber.org/protocol/ibb") \
+    F(NsLegacyDelay,    "jabber:x:delay") \
+    F(NsMessageCorrect, "urn:xmpp:message-correct:0") \
+    F(NsMuc,            "http://jabber.org/protocol/muc") \
+    F(NsMucUser,        "http://jabber.org/protocol/muc#user") \
+    F(NsNick,           "http://jabber.org/protocol/nick") \
+    F(NsOob,            "jabber:x:oob") \
+    F(NsPing,           "urn:xmpp:ping") \
+    F(NsPubSubEvent,    "http://jabber.org/protocol/pubsub#event") \
+    F(NsReceipts,       "urn:xmpp:receipts") \
+    F(NsReference,      "urn:xmpp:reference:0") \
+    F(NsRoster,         "jabber:iq:roster") \
+    F(NsRosterX,        "http://jabber.org/protocol/rosterx") \
+    F(NsSid,            "urn:xmpp:sid:0") \
+    F(NsSigned,         "jabber:x:signed") \
+    F(NsSxe,            "http://jabber.org/protocol/sxe") \
+    F(NsXData,          "jabber:x:data") \
+    F(NsXhtml,          "http://www.w3.org/1999/xhtml") \
+    F(NsXhtmlIm,        "http://jabber.org/protocol/xhtml-im")
+
+#define XMPP_ATOM_NAMES(F) \
+    F(Message,          "message") \
+    F(Presence,         "presence") \
+    F(Iq,               "iq") \
+    F(A,                "a") \
+    F(Active,           "active") \
+    F(Addresses,        "addresses") \
+    F(Body,             "body") \
+    F(C,                "c") \
+    F(Captcha,          "captcha") \
+    F(Composing,        "composing") \
+    F(Confirm,          "confirm") \
+    F(Data,             "data") \
+    F(Delay,            "delay") \
+    F(Error,            "error") \
+    F(Event,            "event") \
+    F(Forwarded,        "forwarded") \
+    F(Gone,             "gone") \
+    F(Html,             "html") \
+    F(Inactive,         "inactive") \
+    F(Item,             "item") \
+    F(Items,            "items") \
+    F(Nick,             "nick") \
+    F(NoCopy,           "no-copy") \
+    F(NoPermanentStore, "no-permanent-store") \
+    F(NoStore,          "no-store") \
+    F(OriginId,         "origin-id") \
+    F(Paused,           "paused") \
+    F(Priority,         "priority") \
+    F(Query,            "query") \
+    F(R,                "r") \
+    F(Received,         "received") \
+    F(Reference,        "reference") \
+    F(Replace,          "replace") \
+    F(Request,          "request") \
+    F(Retract,          "retract") \
+    F(Show,             "show") \
+    F(StanzaId,         "stanza-id") \
+    F(Status,           "status") \
+    F(Store,            "store") \
+    F(Subject,          "subject") \
+    F(Sxe,              "sxe") \
+    F(Thread,           "thread") \
+    F(X,                "x")
+// clang-format on
+
+/**
+ * @brief Interned namespaces and element names which the routing code looks at.
+ *
+ * The strings are created once per process and the parser hands out these very
+ * instances for the names it reads, so a received element shares its name and
+ * namespace with the table. is() then boils down to a pointer compare; for
+ * elements built elsewhere it falls back to a normal string compare.
+ *
+ * The stanza tree of the parser uses the same ids for its interned names, see
+ * StanzaTree::nameAtom().
+ */
+namespace XMPP { namespace Atom {
+#define XMPP_ATOM_ENUM(id, str) id,
+    enum Id : int { Unknown = 0, XMPP_ATOM_NAMESPACES(XMPP_ATOM_ENUM) XMPP_ATOM_NAMES(XMPP_ATOM_ENUM) Count };
+#undef XMPP_ATOM_ENUM
+
+    const QString &string(Id id);
+    Id             id(const QString &s);
+    Id             id(const QStringRef &s);
+
+    // returns the interned instance if s is a known name, or a copy of s
+    QString intern(const QStringRef &s);
+
+    inline bool is(const QString &s, Id id)
+    {
+        const QString &a = string(id);
+        return s.constData() == a.constData() || s == a;
+    }
+
+    inline bool is(const QDomElement &e, Id ns, Id name) { return is(e.tagName(), name) && is(e.namespaceURI(), ns); }
+}} // namespace XMPP::Atom
+
+#endif // XMPP_ATOMS_H
@@ -135,6 +135,10 @@ public:
 
     // Compression
     void setCompress(bool);
+    // zlib parameters for the data we send, -1 keeps the default. Lower
+    // windowBits (9..15) and memLevel (1..9) use less memory per connection
+    // at some cost in ratio
+    void setCompressionOptions(int level, int windowBits = -1, int memLevel = -1);
 
     // reimplemented
     QDomDocument &doc() const;
@@ -156,9 +160,33 @@ public:
     void writeDirect(const QString &s);
     void setNoopTime(int mills);
 
+    // Write coalescing. Once the stream is active, outgoing data is collected
+    // for up to maxDelay msecs (0 - until the event loop is reached again) or
+    // until maxBytes are pending, and then goes to the security layers and the
+    // socket as one write. maxBytes = 0 (default) writes everything at once.
+    struct WriteStats {
+        quint64 chunks  = 0; // pieces of data produced by the protocol
+        quint64 flushes = 0; // writes to the security layer
+        quint64 bytes   = 0;
+    };
+    void       setWriteCoalescing(int maxBytes, int maxDelay = 0);
+    WriteStats writeStats() const;
+
     // Stream management
     bool isResumed() const;
     void setSMEnabled(bool enable);
+    // Bytes kept for resending unacknowledged stanzas, 0 - no limit (default).
+    // On overflow either the oldest stanzas are forgotten (and lost if the
+    // stream gets resumed), or resumption is given up and the next reconnect
+    // starts a new session
+    enum SMOverflowPolicy { SMDropOldest, SMDisableResumption };
+    void setSMQueueLimit(qint64 bytes, SMOverflowPolicy policy = SMDropOldest);
+    // The resumable session with its unacknowledged stanzas, for another
+    // process to take over. Save it instead of closing the stream on
+    // shutdown. A stream restored from it before connectToServer() resumes the
+    // session, or binds a new one if the server doesn't know it anymore.
+    bool saveSMState(const QString &fileName) const;
+    bool restoreSMState(const QString &fileName);
 
     // barracuda extension
     QStringList hosts() const;
@@ -180,6 +208,10 @@ signals:
 public slots:
     void continueAfterWarning();
 
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
+
 private slots:
     void cr_connected();
     void cr_error();
@@ -205,6 +237,7 @@ private slots:
 
     void doNoop();
     void doReadyRead();
+    void flushWrites();
 
 private:
     class Private;
@@ -217,6 +250,8 @@ private:
     void handleError();
     void srvProcessNext();
     void setTimer(int secs);
+    void updateTransferTap();
+    void writeOut(const QByteArray &a);
 };
 } // namespace XMPP
 
@@ -18,7 +18,9 @@
 
 #include "xmpp_stanza.h"
 
+#include "stanzadocument.h"
 #include "xmpp/jid/jid.h"
+#include "xmpp_atoms.h"
 #include "xmpp_clientstream.h"
 #include "xmpp_stream.h"
 
@@ -354,7 +356,7 @@ bool Stanza::Error::fromXml(const QDomElement &e, const QString &baseNS)
                 condition = Private::stringToErrorCond(t.tagName());
             }
         } else {
-            appSpec = t;
+            appSpec = appSpecDoc.importNode(t, true).toElement();
         }
 
         if (condition != -1 && !appSpec.isNull() && !text.isEmpty())
@@ -453,11 +455,11 @@ class Stanza::Private {
 public:
     static int stringToKind(const QString &s)
     {
-        if (s == QLatin1String("message"))
+        if (Atom::is(s, Atom::Message))
             return Message;
-        else if (s == QLatin1String("presence"))
+        else if (Atom::is(s, Atom::Presence))
             return Presence;
-        else if (s == QLatin1String("iq"))
+        else if (Atom::is(s, Atom::Iq))
             return IQ;
         else
             return -1;
@@ -466,16 +468,19 @@ public:
     static QString kindToString(Kind k)
     {
         if (k == Message)
-            return QLatin1String("message");
+            return Atom::string(Atom::Message);
         else if (k == Presence)
-            return QLatin1String("presence");
+            return Atom::string(Atom::Presence);
         else
-            return QLatin1String("iq");
+            return Atom::string(Atom::Iq);
     }
 
     Stream *                     s;
+    StanzaDocument               stanzaDoc; // owner of e, unless it came from elsewhere
     QDomElement                  e;
     QSharedPointer<QDomDocument> sharedDoc;
+
+    QDomDocument &doc() const { return stanzaDoc.isNull() ? s->doc() : stanzaDoc.document(); }
 };
 
 Stanza::Stanza() { d = nullptr; }
@@ -491,9 +496,10 @@ Stanza::Stanza(Stream *s, Kind k, const Jid &to, const QString &type, const QStr
     else
         kind = Message;
 
-    d->s = s;
-    if (d->s)
-        d->e = d->s->doc().createElementNS(s->baseNS(), Private::kindToString(kind));
+    d->s         = s;
+    d->stanzaDoc = StanzaDocument::create();
+    d->e         = d->stanzaDoc.document().createElementNS(s->baseNS(), Private::kindToString(kind));
+    d->stanzaDoc.setRoot(d->e);
     if (to.isValid())
         setTo(to);
     if (!type.isEmpty())
@@ -516,6 +522,12 @@ Stanza::Stanza(Stream *s, const QDomElement &e)
     d->e = e;
 }
 
+Stanza::Stanza(Stream *s, const QDomElement &e, const StanzaDocument &doc) : Stanza(s, e)
+{
+    if (d)
+        d->stanzaDoc = doc;
+}
+
 Stanza::Stanza(const Stanza &from)
 {
     d     = nullptr;
@@ -542,19 +554,19 @@ QDomElement Stanza::element() const { return d->e; }
 
 QString Stanza::toString() const { return Stream::xmlToString(d->e); }
 
-QDomDocument &Stanza::doc() const { return d->s->doc(); }
+QDomDocument &Stanza::doc() const { return d->doc(); }
 
 QString Stanza::baseNS() const { return d->s->baseNS(); }
 
 QDomElement Stanza::createElement(const QString &ns, const QString &tagName)
 {
-    return d->s->doc().createElementNS(ns, tagName);
+    return d->doc().createElementNS(ns, tagName);
 }
 
 QDomElement Stanza::createTextElement(const QString &ns, const QString &tagName, const QString &text)
 {
-    QDomElement e = d->s->doc().createElementNS(ns, tagName);
-    e.appendChild(d->s->doc().createTextNode(text));
+    QDomElement e = d->doc().createElementNS(ns, tagName);
+    e.appendChild(d->doc().createTextNode(text));
     return e;
 }
 
@@ -618,6 +630,8 @@ void Stanza::clearError()
 
 QSharedPointer<QDomDocument> Stanza::unboundDocument(QSharedPointer<QDomDocument> sd)
 {
+    if (!d->stanzaDoc.isNull())
+        return sd; // doesn't depend on the stream's document
     if (!sd) {
         sd = QSharedPointer<QDomDocument>(new QDomDocument);
     }
@@ -19,6 +19,7 @@
 #ifndef XMPP_STANZA_H
 #define XMPP_STANZA_H
 
+#include <QDomDocument>
 #include <QDomElement>
 #include <QPair>
 #include <QSharedPointer>
@@ -28,6 +29,7 @@ class QDomDocument;
 
 namespace XMPP {
 class Jid;
+class StanzaDocument;
 class Stream;
 
 class Stanza {
@@ -89,7 +91,8 @@ public:
 
     private:
         class Private;
-        int originalCode;
+        int          originalCode;
+        QDomDocument appSpecDoc; // a received appSpec outlives the document of its stanza
     };
 
     bool isNull() const;
@@ -132,6 +135,7 @@ private:
     friend class Stream;
     Stanza(Stream *s, Kind k, const Jid &to, const QString &type, const QString &id);
     Stanza(Stream *s, const QDomElement &e);
+    Stanza(Stream *s, const QDomElement &e, const StanzaDocument &doc);
 
     class Private;
     Private *d;
@@ -65,6 +65,7 @@ public:
 
     Stanza createStanza(Stanza::Kind k, const Jid &to = "", const QString &type = "", const QString &id = "");
     Stanza createStanza(const QDomElement &e);
+    Stanza createStanza(const QDomElement &e, const StanzaDocument &doc); // the stanza keeps doc alive
 
     static QString xmlToString(const QDomElement &e, bool clip = false);
 
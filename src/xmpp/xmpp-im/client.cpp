@@ -73,10 +73,12 @@
 #include "jingle-ice.h"
 #include "jingle-s5b.h"
 #include "jingle.h"
+#include "rosterindex_p.h"
 #include "s5b.h"
 #include "stundisco.h"
 #include "tcpportreserver.h"
 #include "xmpp/xmpp-core/protocol.h"
+#include "xmpp/xmpp-core/stanzadocument.h"
 #include "xmpp_bitsofbinary.h"
 #include "xmpp_caps.h"
 #include "xmpp_externalservicediscovery.h"
@@ -88,6 +90,7 @@
 
 #include <QList>
 #include <QMap>
+#include <QMetaMethod>
 #include <QObject>
 #include <QPointer>
 #include <QTimer>
@@ -214,9 +217,8 @@ void Client::connectToServer(ClientStream *s, const Jid &j, bool auth)
     // connect(d->stream, SIGNAL(sslCertificateReady(QSSLCert)), SLOT(streamSSLCertificateReady(QSSLCert)));
     connect(d->stream, SIGNAL(readyRead()), SLOT(streamReadyRead()));
     // connect(d->stream, SIGNAL(closeFinished()), SLOT(streamCloseFinished()));
-    connect(d->stream, SIGNAL(incomingXml(QString)), SLOT(streamIncomingXml(QString)));
-    connect(d->stream, SIGNAL(outgoingXml(QString)), SLOT(streamOutgoingXml(QString)));
     connect(d->stream, SIGNAL(haveUnhandledFeatures()), SLOT(parseUnhandledStreamFeatures()));
+    updateXmlTap();
 
     d->stream->connectToServer(j, auth);
 }
@@ -521,9 +523,11 @@ void Client::streamReadyRead()
     while (d->stream && d->stream->stanzaAvailable()) {
         Stanza s = d->stream->read();
 
-        QString out = s.toString();
-        debug(QString("Client: incoming: [\n%1]\n").arg(out));
-        emit xmlIncoming(out);
+        if (isXmlTapped()) {
+            QString out = s.toString();
+            debug(QString("Client: incoming: [\n%1]\n").arg(out));
+            emit xmlIncoming(out);
+        }
 
         QDomElement x = s.element(); // oldStyleNS(s.element());
         distribute(x);
@@ -561,6 +565,44 @@ void Client::parseUnhandledStreamFeatures()
 
 void Client::debug(const QString &str) { emit debugText(str); }
 
+void Client::connectNotify(const QMetaMethod &signal)
+{
+    if (signal == QMetaMethod::fromSignal(&Client::xmlIncoming)
+        || signal == QMetaMethod::fromSignal(&Client::xmlOutgoing))
+        updateXmlTap();
+}
+
+void Client::disconnectNotify(const QMetaMethod &signal)
+{
+    if (!signal.isValid() || signal == QMetaMethod::fromSignal(&Client::xmlIncoming)
+        || signal == QMetaMethod::fromSignal(&Client::xmlOutgoing))
+        updateXmlTap();
+}
+
+bool Client::isXmlTapped() const
+{
+    return isSignalConnected(QMetaMethod::fromSignal(&Client::xmlIncoming))
+        || isSignalConnected(QMetaMethod::fromSignal(&Client::xmlOutgoing))
+        || isSignalConnected(QMetaMethod::fromSignal(&Client::debugText));
+}
+
+// Forward stream xml only while somebody listens to us, so the stream
+// doesn't record and stringify everything for nothing.
+void Client::updateXmlTap()
+{
+    if (!d->stream)
+        return;
+    ClientStream *cs = d->stream;
+    if (isSignalConnected(QMetaMethod::fromSignal(&Client::xmlIncoming))
+        || isSignalConnected(QMetaMethod::fromSignal(&Client::xmlOutgoing))) {
+        connect(cs, &ClientStream::incomingXml, this, &Client::streamIncomingXml, Qt::UniqueConnection);
+        connect(cs, &ClientStream::outgoingXml, this, &Client::streamOutgoingXml, Qt::UniqueConnection);
+    } else {
+        disconnect(cs, &ClientStream::incomingXml, this, &Client::streamIncomingXml);
+        disconnect(cs, &ClientStream::outgoingXml, this, &Client::streamOutgoingXml);
+    }
+}
+
 QString Client::genUniqueId()
 {
 #if QT_VERSION >= QT_VERSION_CHECK(5,11,0)
@@ -623,8 +665,11 @@ void Client::send(const QDomElement &x)
     // debug(QString("Client: outgoing: [\n%1]\n").arg(out));
     // xmlOutgoing(out);
 
-    QDomElement e = addCorrectNS(x);
-    Stanza      s = d->stream->createStanza(e);
+    // the copy gets a document of its own, released once the stanza is written
+    StanzaDocument sd = StanzaDocument::create();
+    QDomElement    e  = addCorrectNS(x, sd.document());
+    sd.setRoot(e);
+    Stanza s = d->stream->createStanza(e, sd);
     if (s.isNull()) { // e's namespace is not "jabber:client" or e.tagName is not in (message,presence,iq)
         // printf("bad stanza??\n");
         return;
@@ -633,10 +678,12 @@ void Client::send(const QDomElement &x)
     if (e.isNull()) {              // so it was changed by signal above
         return;
     }
-    QString out = s.toString();
-    // qWarning() << "Out: " << out;
-    debug(QString("Client: outgoing: [\n%1]\n").arg(out));
-    emit xmlOutgoing(out);
+    if (isXmlTapped()) {
+        QString out = s.toString();
+        // qWarning() << "Out: " << out;
+        debug(QString("Client: outgoing: [\n%1]\n").arg(out));
+        emit xmlOutgoing(out);
+    }
 
     // printf("x[%s] x2[%s] s[%s]\n", Stream::xmlToString(x).toLatin1(), Stream::xmlToString(e).toLatin1(),
     // s.toString().toLatin1());
@@ -760,12 +807,9 @@ void Client::ppPresence(const Jid &j, const Status &s)
         updateSelfPresence(j, s);
     } else {
         // update all relavent roster entries
-        for (LiveRoster::Iterator it = d->roster.begin(); it != d->roster.end(); ++it) {
+        for (LiveRoster::Iterator it : d->roster.findAll(j, false)) {
             LiveRosterItem &i = *it;
 
-            if (!i.jid().compare(j, false))
-                continue;
-
             // roster item has its own resource?
             if (!i.jid().resource().isEmpty()) {
                 if (i.jid().resource() != j.resource())
@@ -923,7 +967,7 @@ void Client::slotRosterRequestFinished()
             LiveRosterItem &i = *it;
             if (i.flagForDelete()) {
                 emit rosterItemRemoved(i);
-                it = d->roster.erase(it);
+                it = d->roster.removeItem(it);
             } else
                 ++it;
         }
@@ -978,7 +1022,7 @@ void Client::importRosterItem(const RosterItem &item)
         LiveRoster::Iterator it = d->roster.find(item.jid());
         if (it != d->roster.end()) {
             emit rosterItemRemoved(*it);
-            d->roster.erase(it);
+            d->roster.removeItem(it);
         }
         dstr = "Client: (Removed) ";
     }
@@ -993,7 +1037,7 @@ void Client::importRosterItem(const RosterItem &item)
             dstr = "Client: (Updated) ";
         } else {
             LiveRosterItem i(item);
-            d->roster += i;
+            d->roster.addItem(i);
 
             // signal it
             emit rosterItemAdded(i);
@@ -1280,7 +1324,8 @@ void LiveRosterItem::setFlagForDelete(bool b) { v_flagForDelete = b; }
 //---------------------------------------------------------------------------
 class LiveRoster::Private {
 public:
-    QString groupsDelimiter;
+    QString                     groupsDelimiter;
+    RosterIndex<LiveRosterItem> index;
 };
 
 LiveRoster::LiveRoster() : QList<LiveRosterItem>(), d(new LiveRoster::Private) { }
@@ -1295,6 +1340,7 @@ LiveRoster &LiveRoster::operator=(const LiveRoster &other)
 {
     QList<LiveRosterItem>::operator=(other);
     d->groupsDelimiter             = other.d->groupsDelimiter;
+    d->index.invalidate();
     return *this;
 }
 void LiveRoster::flagAllForDelete()
@@ -1305,22 +1351,49 @@ void LiveRoster::flagAllForDelete()
 
 LiveRoster::Iterator LiveRoster::find(const Jid &j, bool compareRes)
 {
-    Iterator it;
-    for (it = begin(); it != end(); ++it) {
-        if ((*it).jid().compare(j, compareRes))
-            break;
-    }
-    return it;
+    int pos = d->index.find(*this, j.bare(),
+                            [&j, compareRes](const LiveRosterItem &i) { return i.jid().compare(j, compareRes); });
+    if (pos == -1)
+        return end();
+    d->index.touched(pos);
+    return begin() + pos;
 }
 
 LiveRoster::ConstIterator LiveRoster::find(const Jid &j, bool compareRes) const
 {
-    ConstIterator it;
-    for (it = begin(); it != end(); ++it) {
-        if ((*it).jid().compare(j, compareRes))
-            break;
+    int pos = d->index.find(*this, j.bare(),
+                            [&j, compareRes](const LiveRosterItem &i) { return i.jid().compare(j, compareRes); });
+    return pos == -1 ? end() : begin() + pos;
+}
+
+QList<LiveRoster::Iterator> LiveRoster::findAll(const Jid &j, bool compareRes)
+{
+    QList<Iterator> ret;
+    for (int pos : d->index.positions(*this, j.bare())) {
+        if (at(pos).jid().compare(j, compareRes)) {
+            d->index.touched(pos);
+            ret += begin() + pos;
+        }
     }
-    return it;
+    return ret;
+}
+
+void LiveRoster::addItem(const LiveRosterItem &item)
+{
+    append(item);
+    d->index.added(*this);
+}
+
+void LiveRoster::setItem(Iterator it, const LiveRosterItem &item)
+{
+    *it = item;
+    d->index.touched(int(it - begin()));
+}
+
+LiveRoster::Iterator LiveRoster::removeItem(Iterator it)
+{
+    d->index.invalidate();
+    return erase(it);
 }
 
 void LiveRoster::setGroupsDelimiter(const QString &groupsDelimiter) { d->groupsDelimiter = groupsDelimiter; }
@@ -728,14 +728,16 @@ namespace XMPP { namespace Jingle { namespace ICE {
                             c.dtls->onRemoteAcceptedFingerprint();
                 },
                 Qt::QueuedConnection); // signal is not DOR-SS
-            q->connect(ice, &Ice176::readyRead, q, [this](int componentIndex) {
+            q->connect(ice, &Ice176::readyReadBurst, q, [this](int componentIndex) {
                 // qDebug("ICE readyRead");
-                auto  buf       = ice->readDatagram(componentIndex);
-                auto &component = components[componentIndex];
-                if (component.dtls) {
-                    component.dtls->writeIncomingDatagram(buf);
-                } else if (component.rawConnection) {
-                    component.rawConnection->enqueueIncomingUDP(buf);
+                const auto datagrams = ice->readDatagrams(componentIndex);
+                auto      &component = components[componentIndex];
+                for (const auto &buf : datagrams) {
+                    if (component.dtls) {
+                        component.dtls->writeIncomingDatagram(buf);
+                    } else if (component.rawConnection) {
+                        component.rawConnection->enqueueIncomingUDP(buf);
+                    }
                 }
             });
 
@@ -1014,7 +1016,7 @@ namespace XMPP { namespace Jingle { namespace ICE {
         }
 
         if (Dtls::isSupported()
-            && ((isLocal() && _pad->session()->checkPeerCaps(Dtls::FingerPrint::ns()))
+            && ((isLocal() && _pad->session()->checkPeerCaps(Features::WK_JingleDtls))
                 || (isRemote() && d->remoteState->fingerprint.isValid()))) {
             qDebug("initialize DTLS");
 
@@ -653,7 +653,7 @@ namespace XMPP { namespace Jingle {
                                                         ? XMPP::Stanza::Error::UnexpectedRequest
                                                         : XMPP::Stanza::Error::BadRequest);
                     if (err == Private::AddContentError::Unexpected) {
-                        ErrorUtil::fill(jingleEl.ownerDocument(), lastError, ErrorUtil::OutOfOrder);
+                        ErrorUtil::fill(*manager->client()->doc(), lastError, ErrorUtil::OutOfOrder);
                     }
                     return std::tuple<bool, QList<Application *>>(false, QList<Application *>());
                 }
@@ -721,7 +721,7 @@ namespace XMPP { namespace Jingle {
             case Private::AddContentError::Unexpected:
                 lastError = XMPP::Stanza::Error(XMPP::Stanza::Error::Cancel, XMPP::Stanza::Error::BadRequest);
                 if (err == Private::AddContentError::Unexpected) {
-                    ErrorUtil::fill(jingleEl.ownerDocument(), lastError, ErrorUtil::OutOfOrder);
+                    ErrorUtil::fill(*manager->client()->doc(), lastError, ErrorUtil::OutOfOrder);
                 }
                 return false;
             case Private::AddContentError::Unsupported:
@@ -999,7 +999,7 @@ namespace XMPP { namespace Jingle {
         d->role            = role;
         d->manager         = manager;
         d->otherParty      = peer;
-        d->groupingAllowed = checkPeerCaps(QLatin1String("urn:ietf:rfc:5888"));
+        d->groupingAllowed = checkPeerCaps(Features::WK_JingleGrouping);
         d->stepTimer.setSingleShot(true);
         d->stepTimer.setInterval(0);
         connect(&d->stepTimer, &QTimer::timeout, this, [this]() { d->doStep(); });
@@ -1041,7 +1041,12 @@ namespace XMPP { namespace Jingle {
 
     bool Session::checkPeerCaps(const QString &ns) const
     {
-        return d->manager->client()->capsManager()->disco(peer()).features().test(QStringList() << ns);
+        return d->manager->client()->capsManager()->disco(peer()).features().test(ns);
+    }
+
+    bool Session::checkPeerCaps(Features::WellKnown feature) const
+    {
+        return d->manager->client()->capsManager()->disco(peer()).features().test(feature);
     }
 
     bool Session::isGroupingAllowed() const { return d->groupingAllowed; }
@@ -1223,7 +1228,7 @@ namespace XMPP { namespace Jingle {
     {
         if (d->state == State::Finished) {
             d->lastError = XMPP::Stanza::Error(XMPP::Stanza::Error::Cancel, XMPP::Stanza::Error::UnexpectedRequest);
-            ErrorUtil::fill(jingleEl.ownerDocument(), d->lastError, ErrorUtil::OutOfOrder);
+            ErrorUtil::fill(*d->manager->client()->doc(), d->lastError, ErrorUtil::OutOfOrder);
             return false;
         }
 
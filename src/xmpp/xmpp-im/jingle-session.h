@@ -50,6 +50,7 @@ namespace XMPP { namespace Jingle {
         Origin   role() const; // my role in session: initiator or responder
         Origin   peerRole() const;
         bool     checkPeerCaps(const QString &ns) const;
+        bool     checkPeerCaps(Features::WellKnown feature) const;
         Features peerFeatures() const;
 
         bool isGroupingAllowed() const;
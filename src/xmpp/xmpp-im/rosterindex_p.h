@@ -0,0 +1,170 @@
+/*
+ * rosterindex_p.h - bare jid index of a roster list
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef XMPP_ROSTERINDEX_P_H
+#define XMPP_ROSTERINDEX_P_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+namespace XMPP {
+
+/**
+ * @brief Bare jid to positions index of a QList of roster items.
+ *
+ * Each Roster and LiveRoster keeps one of its own, and their modifiers tell it
+ * what changed: added() after an append, touched() for an item which may be
+ * edited in place, like one handed out by a non-const find(), and invalidate()
+ * after anything else. They are still plain QLists though, so the index also
+ * checks itself on use: it is rebuilt when the list size changed since it was
+ * built, or when a position it holds no longer has the expected bare jid. What
+ * goes past this is a jid changed in place through QList itself, or an item
+ * inserted through it while the size is kept. Items with the same bare jid are
+ * chained in list order, so lookups return the same item the linear scan did.
+ */
+template <typename Item> class RosterIndex {
+public:
+    void invalidate() { size_ = -1; }
+
+    void added(const QList<Item> &list)
+    {
+        const int pos = list.size() - 1;
+        if (size_ != pos) {
+            invalidate();
+            return;
+        }
+        keys_.append(list.at(pos).jid().bare());
+        next_.append(-1);
+        link(keys_.last(), pos);
+        size_ = list.size();
+    }
+
+    // the item may be changed in place, so its jid is looked at again by the next lookup
+    void touched(int pos)
+    {
+        if (size_ != -1)
+            touched_.append(pos);
+    }
+
+    // position of the first item with the bare jid for which match(item) is true, or -1
+    template <typename Match> int find(const QList<Item> &list, const QString &bare, Match match)
+    {
+        int found = -1;
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (walk(list, bare, [&](int pos) {
+                    if (!match(list.at(pos)))
+                        return false;
+                    found = pos;
+                    return true;
+                }))
+                return found;
+            invalidate();
+        }
+        return -1;
+    }
+
+    // positions of all the items with the bare jid, in list order
+    QVector<int> positions(const QList<Item> &list, const QString &bare)
+    {
+        QVector<int> ret;
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            ret.clear();
+            if (walk(list, bare, [&](int pos) {
+                    ret.append(pos);
+                    return false;
+                }))
+                return ret;
+            invalidate();
+        }
+        return ret;
+    }
+
+private:
+    struct Chain {
+        int first;
+        int last;
+    };
+
+    QHash<QString, Chain> chains_;
+    QVector<QString>      keys_; // bare jid of each position
+    QVector<int>          next_; // next position with the same bare jid or -1
+    QVector<int>          touched_;
+    int                   size_ = -1;
+
+    void link(const QString &bare, int pos)
+    {
+        auto it = chains_.find(bare);
+        if (it == chains_.end()) {
+            chains_.insert(bare, { pos, pos });
+        } else {
+            next_[it->last] = pos;
+            it->last        = pos;
+        }
+    }
+
+    void rebuild(const QList<Item> &list)
+    {
+        chains_.clear();
+        chains_.reserve(list.size());
+        keys_.resize(list.size());
+        next_.fill(-1, list.size());
+        touched_.clear();
+        for (int n = 0; n < list.size(); ++n) {
+            keys_[n] = list.at(n).jid().bare();
+            link(keys_.at(n), n);
+        }
+        size_ = list.size();
+    }
+
+    bool isCurrent(const QList<Item> &list)
+    {
+        if (size_ != list.size())
+            return false;
+        bool current = true;
+        for (int pos : qAsConst(touched_)) {
+            if (list.at(pos).jid().bare() != keys_.at(pos))
+                current = false;
+        }
+        touched_.clear();
+        return current;
+    }
+
+    // calls visit(pos) along the chain until it returns true. returns false if the index turned out stale
+    template <typename Visit> bool walk(const QList<Item> &list, const QString &bare, Visit visit)
+    {
+        if (!isCurrent(list))
+            rebuild(list);
+        auto it = chains_.constFind(bare);
+        if (it == chains_.constEnd())
+            return true;
+        for (int pos = it->first; pos != -1; pos = next_[pos]) {
+            if (list.at(pos).jid().bare() != bare)
+                return false;
+            if (visit(pos))
+                return true;
+        }
+        return true;
+    }
+};
+
+} // namespace XMPP
+
+#endif // XMPP_ROSTERINDEX_P_H
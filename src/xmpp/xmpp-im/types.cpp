@@ -18,6 +18,7 @@
  */
 
 #include "im.h"
+#include "rosterindex_p.h"
 #include "xmpp/xmpp-core/protocol.h"
 #include "xmpp_bitsofbinary.h"
 #include "xmpp_captcha.h"
@@ -26,8 +27,12 @@
 #include "xmpp_reference.h"
 #include "xmpp_xmlcommon.h"
 
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QMutex>
+#include <atomic>
+#include <memory>
 #include <type_traits>
 
 #define NS_XML "http://www.w3.org/XML/1998/namespace"
@@ -726,6 +731,7 @@ public:
     XData                      xdata;
     IBBData                    ibbData;
     QMap<QString, HTMLElement> htmlElements;
+    QDomDocument               sxeDoc; // received sxe outlives the document of its stanza
     QDomElement                sxe;
     QList<BoBData>             bobDataList;
     Jid                        forwardedFrom;
@@ -1408,6 +1414,170 @@ Stanza Message::toStanza(Stream *stream) const
     return s;
 }
 
+namespace {
+    // Extensions of <message/> read by Message::fromStanza()
+    enum Extension {
+        ExtNone,
+        // may repeat
+        ExtPubSubEvent,
+        ExtNoPermanentStore,
+        ExtNoStore,
+        ExtNoCopy,
+        ExtStore,
+        ExtOriginId,
+        ExtStanzaId,
+        ExtBoB,
+        ExtOob,
+        ExtReference,
+        // only the first one counts
+        ExtXhtmlIm,
+        ExtDelay,
+        ExtLegacyDelay,
+        ExtEvent,
+        ExtActive,
+        ExtComposing,
+        ExtPaused,
+        ExtInactive,
+        ExtGone,
+        ExtReceiptRequest,
+        ExtReceiptReceived,
+        ExtSigned,
+        ExtEncrypted,
+        ExtAddresses,
+        ExtRosterX,
+        ExtConference,
+        ExtNick,
+        ExtSxe,
+        ExtMucUser,
+        ExtHttpAuth,
+        ExtCaptcha,
+        ExtXData,
+        ExtIbb,
+        ExtReplace,
+        ExtCount
+    };
+
+    class ExtensionTable {
+    public:
+        ExtensionTable()
+        {
+            static const struct {
+                Atom::Id  ns, name;
+                Extension ext;
+            } extensions[] = { { Atom::NsPubSubEvent, Atom::Event, ExtPubSubEvent },
+                               { Atom::NsHints, Atom::NoPermanentStore, ExtNoPermanentStore },
+                               { Atom::NsHints, Atom::NoStore, ExtNoStore },
+                               { Atom::NsHints, Atom::NoCopy, ExtNoCopy },
+                               { Atom::NsHints, Atom::Store, ExtStore },
+                               { Atom::NsSid, Atom::OriginId, ExtOriginId },
+                               { Atom::NsSid, Atom::StanzaId, ExtStanzaId },
+                               { Atom::NsBob, Atom::Data, ExtBoB },
+                               { Atom::NsOob, Atom::X, ExtOob },
+                               { Atom::NsReference, Atom::Reference, ExtReference },
+                               { Atom::NsXhtmlIm, Atom::Html, ExtXhtmlIm },
+                               { Atom::NsDelay, Atom::Delay, ExtDelay },
+                               { Atom::NsLegacyDelay, Atom::X, ExtLegacyDelay },
+                               { Atom::NsEvent, Atom::X, ExtEvent },
+                               { Atom::NsChatStates, Atom::Active, ExtActive },
+                               { Atom::NsChatStates, Atom::Composing, ExtComposing },
+                               { Atom::NsChatStates, Atom::Paused, ExtPaused },
+                               { Atom::NsChatStates, Atom::Inactive, ExtInactive },
+                               { Atom::NsChatStates, Atom::Gone, ExtGone },
+                               { Atom::NsReceipts, Atom::Request, ExtReceiptRequest },
+                               { Atom::NsReceipts, Atom::Received, ExtReceiptReceived },
+                               { Atom::NsSigned, Atom::X, ExtSigned },
+                               { Atom::NsEncrypted, Atom::X, ExtEncrypted },
+                               { Atom::NsAddress, Atom::Addresses, ExtAddresses },
+                               { Atom::NsRosterX, Atom::X, ExtRosterX },
+                               { Atom::NsConference, Atom::X, ExtConference },
+                               { Atom::NsNick, Atom::Nick, ExtNick },
+                               { Atom::NsSxe, Atom::Sxe, ExtSxe },
+                               { Atom::NsMucUser, Atom::X, ExtMucUser },
+                               { Atom::NsHttpAuth, Atom::Confirm, ExtHttpAuth },
+                               { Atom::NsCaptcha, Atom::Captcha, ExtCaptcha },
+                               { Atom::NsXData, Atom::X, ExtXData },
+                               { Atom::NsIbb, Atom::Data, ExtIbb },
+                               { Atom::NsMessageCorrect, Atom::Replace, ExtReplace } };
+            for (const auto &e : extensions)
+                table.insert(key(e.ns, e.name), e.ext);
+        }
+
+        Extension find(Atom::Id ns, Atom::Id name) const { return table.value(key(ns, name), ExtNone); }
+
+    private:
+        QHash<int, Extension> table;
+
+        static int key(Atom::Id ns, Atom::Id name) { return int(ns) * Atom::Count + int(name); }
+    };
+
+    Extension extension(Atom::Id ns, Atom::Id name)
+    {
+        if (ns == Atom::Unknown || name == Atom::Unknown)
+            return ExtNone;
+        static const ExtensionTable table;
+        return table.find(ns, name);
+    }
+
+    // Parsers registered by the application. Updates replace the whole map, so
+    // fromStanza() can use it without holding a lock.
+    class MessageExtensionRegistry {
+    public:
+        using Map = QHash<QPair<QString, QString>, QList<Message::ExtensionParser>>;
+
+        void add(const QString &ns, const QString &localName, const Message::ExtensionParser &parser)
+        {
+            QMutexLocker locker(&mutex);
+            auto         updated = std::make_shared<Map>(map ? *map : Map());
+            (*updated)[qMakePair(ns, localName)] += parser;
+            std::atomic_store(&map, std::shared_ptr<const Map>(updated));
+        }
+
+        void remove(const QString &ns, const QString &localName)
+        {
+            QMutexLocker locker(&mutex);
+            if (!map || !map->contains(qMakePair(ns, localName)))
+                return;
+            auto updated = std::make_shared<Map>(*map);
+            updated->remove(qMakePair(ns, localName));
+            std::atomic_store(&map, std::shared_ptr<const Map>(updated));
+        }
+
+        std::shared_ptr<const Map> snapshot() const { return std::atomic_load(&map); }
+
+    private:
+        QMutex                     mutex;
+        std::shared_ptr<const Map> map;
+    };
+
+    MessageExtensionRegistry *extensionRegistry()
+    {
+        static MessageExtensionRegistry registry;
+        return &registry;
+    }
+} // namespace
+
+/**
+  \brief Registers \a parser for the child elements of messages with namespace \a ns and local name \a localName
+
+  fromStanza() reads all the extensions in a single walk over the children of the message. The parser is called
+  for every matching child, once the built-in extensions are read. It may be called from any thread which parses
+  messages.
+  */
+void Message::registerExtensionParser(const QString &ns, const QString &localName, const ExtensionParser &parser)
+{
+    extensionRegistry()->add(ns, localName, parser);
+}
+
+/**
+  \brief Removes all the parsers registered for \a ns and \a localName
+
+  Messages parsed already, or being parsed meanwhile, are not affected.
+  */
+void Message::unregisterExtensionParser(const QString &ns, const QString &localName)
+{
+    extensionRegistry()->remove(ns, localName);
+}
+
 /**
   \brief Create Message from Stanza \a s, using given \a timeZoneOffset (old style)
   */
@@ -1445,86 +1615,117 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
 
     QDomElement root = s.element();
 
-    XDomNodeList nl = root.childNodes();
-    int          n;
-    for (n = 0; n < nl.count(); ++n) {
-        QDomNode i = nl.item(n);
-        if (i.isElement()) {
-            QDomElement e = i.toElement();
-            if (e.namespaceURI() == s.baseNS()) {
-                if (e.tagName() == QLatin1String("subject")) {
-                    QString lang = e.attributeNS(NS_XML, "lang", "");
-                    if (lang.isEmpty() || !(lang = XMLHelper::sanitizedLang(lang)).isEmpty()) {
-                        d->subject[lang] = e.text();
-                    }
-                } else if (e.tagName() == QLatin1String("body")) {
-                    QString lang = e.attributeNS(NS_XML, "lang", "");
-                    if (lang.isEmpty() || !(lang = XMLHelper::sanitizedLang(lang)).isEmpty()) {
-                        d->body[lang] = e.text();
-                    }
-                } else if (e.tagName() == QLatin1String("thread"))
-                    d->thread = e.text();
-            } else if (e.tagName() == QLatin1String("event")
-                       && e.namespaceURI() == QLatin1String("http://jabber.org/protocol/pubsub#event")) {
-                for (QDomNode enode = e.firstChild(); !enode.isNull(); enode = enode.nextSibling()) {
-                    QDomElement eel = enode.toElement();
-                    if (eel.tagName() == QLatin1String("items")) {
-                        d->pubsubNode = eel.attribute("node");
-                        for (QDomNode inode = eel.firstChild(); !inode.isNull(); inode = inode.nextSibling()) {
-                            QDomElement o = inode.toElement();
-                            if (o.tagName() == QLatin1String("item")) {
-                                for (QDomNode j = o.firstChild(); !j.isNull(); j = j.nextSibling()) {
-                                    QDomElement item = j.toElement();
-                                    if (!item.isNull()) {
-                                        d->pubsubItems += PubSubItem(o.attribute("id"), item);
-                                    }
+    // Walk the children once. Extensions which may repeat are read in place,
+    // of the others only the first one counts and is read after the walk.
+    const auto                                         customParsers = extensionRegistry()->snapshot();
+    const QString                                      baseNS        = s.baseNS();
+    QDomElement                                        first[ExtCount];
+    QList<QPair<const ExtensionParser *, QDomElement>> custom; // application extensions
+    for (QDomElement e = root.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        const QString ns = e.namespaceURI();
+        if (ns == baseNS) {
+            if (Atom::is(e.tagName(), Atom::Subject)) {
+                QString lang = e.attributeNS(NS_XML, "lang", "");
+                if (lang.isEmpty() || !(lang = XMLHelper::sanitizedLang(lang)).isEmpty()) {
+                    d->subject[lang] = e.text();
+                }
+            } else if (Atom::is(e.tagName(), Atom::Body)) {
+                QString lang = e.attributeNS(NS_XML, "lang", "");
+                if (lang.isEmpty() || !(lang = XMLHelper::sanitizedLang(lang)).isEmpty()) {
+                    d->body[lang] = e.text();
+                }
+            } else if (Atom::is(e.tagName(), Atom::Thread))
+                d->thread = e.text();
+            continue;
+        }
+
+        if (customParsers) {
+            auto it = customParsers->constFind(qMakePair(ns, e.tagName()));
+            if (it != customParsers->constEnd()) {
+                for (const ExtensionParser &p : it.value())
+                    custom += qMakePair(&p, e);
+            }
+        }
+
+        const Extension ext = extension(Atom::id(ns), Atom::id(e.tagName()));
+        switch (ext) {
+        case ExtNone:
+            break;
+        case ExtPubSubEvent:
+            for (QDomNode enode = e.firstChild(); !enode.isNull(); enode = enode.nextSibling()) {
+                QDomElement eel = enode.toElement();
+                if (eel.tagName() == QLatin1String("items")) {
+                    d->pubsubNode = eel.attribute("node");
+                    for (QDomNode inode = eel.firstChild(); !inode.isNull(); inode = inode.nextSibling()) {
+                        QDomElement o = inode.toElement();
+                        if (o.tagName() == QLatin1String("item")) {
+                            for (QDomNode j = o.firstChild(); !j.isNull(); j = j.nextSibling()) {
+                                QDomElement item = j.toElement();
+                                if (!item.isNull()) {
+                                    d->pubsubItems += PubSubItem(o.attribute("id"), item);
                                 }
                             }
-                            if (o.tagName() == "retract") {
-                                d->pubsubRetractions += PubSubRetraction(o.attribute("id"));
-                            }
+                        }
+                        if (o.tagName() == "retract") {
+                            d->pubsubRetractions += PubSubRetraction(o.attribute("id"));
                         }
                     }
                 }
-            } else if (e.tagName() == QLatin1String("no-permanent-store")
-                       && e.namespaceURI() == QLatin1String("urn:xmpp:hints")) {
-                d->processingHints |= NoPermanentStore;
-            } else if (e.tagName() == QLatin1String("no-store")
-                       && e.namespaceURI() == QLatin1String("urn:xmpp:hints")) {
-                d->processingHints |= NoStore;
-            } else if (e.tagName() == QLatin1String("no-copy") && e.namespaceURI() == QLatin1String("urn:xmpp:hints")) {
-                d->processingHints |= NoCopy;
-            } else if (e.tagName() == QLatin1String("store") && e.namespaceURI() == QLatin1String("urn:xmpp:hints")) {
-                d->processingHints |= Store;
-            } else if (e.tagName() == QLatin1String("origin-id")
-                       && e.namespaceURI() == QLatin1String("urn:xmpp:sid:0")) {
-                d->originId = e.attribute(QStringLiteral("id"));
-            } else if (e.tagName() == QLatin1String("stanza-id")
-                       && e.namespaceURI() == QLatin1String("urn:xmpp:sid:0")) {
-                d->stanzaId.id = e.attribute(QStringLiteral("id"));
-                d->stanzaId.by = Jid(e.attribute(QStringLiteral("by")));
             }
-
-            else {
-                // printf("extension element: [%s]\n", e.tagName().latin1());
+            break;
+        case ExtNoPermanentStore:
+            d->processingHints |= NoPermanentStore;
+            break;
+        case ExtNoStore:
+            d->processingHints |= NoStore;
+            break;
+        case ExtNoCopy:
+            d->processingHints |= NoCopy;
+            break;
+        case ExtStore:
+            d->processingHints |= Store;
+            break;
+        case ExtOriginId:
+            d->originId = e.attribute(QStringLiteral("id"));
+            break;
+        case ExtStanzaId:
+            d->stanzaId.id = e.attribute(QStringLiteral("id"));
+            d->stanzaId.by = Jid(e.attribute(QStringLiteral("by")));
+            break;
+        case ExtBoB:
+            // Bits of Binary XEP-0231
+            addBoBData(BoBData(e));
+            break;
+        case ExtOob: {
+            // urls
+            Url u;
+            u.setUrl(e.elementsByTagName("url").item(0).toElement().text());
+            u.setDesc(e.elementsByTagName("desc").item(0).toElement().text());
+            d->urlList += u;
+            break;
+        }
+        case ExtReference: {
+            // XEP-0385 SIMS and XEP-0372 Reference
+            Reference r;
+            if (r.fromXml(e)) {
+                d->references.append(r);
             }
+            break;
+        }
+        default:
+            if (first[ext].isNull())
+                first[ext] = e;
+            break;
         }
     }
 
     if (s.type() == "error")
         d->error = s.error();
 
-    // Bits of Binary XEP-0231
-    nl = childElementsByTagNameNS(root, "urn:xmpp:bob", "data");
-    for (n = 0; n < nl.count(); ++n) {
-        addBoBData(BoBData(nl.item(n).toElement()));
-    }
-
     // xhtml-im
-    nl = childElementsByTagNameNS(root, "http://jabber.org/protocol/xhtml-im", "html");
-    if (nl.count()) {
-        nl = nl.item(0).childNodes();
-        for (n = 0; n < nl.count(); ++n) {
+    if (!first[ExtXhtmlIm].isNull()) {
+        XDomNodeList nl = first[ExtXhtmlIm].childNodes();
+        for (int n = 0; n < nl.count(); ++n) {
             QDomElement e = nl.item(n).toElement();
             if (e.tagName() == "body" && e.namespaceURI() == "http://www.w3.org/1999/xhtml") {
                 QString lang = e.attributeNS(NS_XML, "lang", "");
@@ -1537,12 +1738,12 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
     }
 
     // timestamp
-    QDomElement t = childElementsByTagNameNS(root, "urn:xmpp:delay", "delay").item(0).toElement();
+    QDomElement t = first[ExtDelay];
     QDateTime   stamp;
     if (!t.isNull()) {
         stamp = QDateTime::fromString(t.attribute("stamp").left(19), Qt::ISODate);
     } else {
-        t = childElementsByTagNameNS(root, "jabber:x:delay", "x").item(0).toElement();
+        t = first[ExtLegacyDelay];
         if (!t.isNull()) {
             stamp = stamp2TS(t.attribute("stamp"));
         }
@@ -1562,23 +1763,10 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
         d->spooled       = false;
     }
 
-    // urls
-    d->urlList.clear();
-    nl = childElementsByTagNameNS(root, "jabber:x:oob", "x");
-    for (n = 0; n < nl.count(); ++n) {
-        QDomElement t = nl.item(n).toElement();
-        Url         u;
-        u.setUrl(t.elementsByTagName("url").item(0).toElement().text());
-        u.setDesc(t.elementsByTagName("desc").item(0).toElement().text());
-        d->urlList += u;
-    }
-
     // events
-    d->eventList.clear();
-    nl = childElementsByTagNameNS(root, "jabber:x:event", "x");
-    if (nl.count()) {
-        nl = nl.item(0).childNodes();
-        for (n = 0; n < nl.count(); ++n) {
+    if (!first[ExtEvent].isNull()) {
+        XDomNodeList nl = first[ExtEvent].childNodes();
+        for (int n = 0; n < nl.count(); ++n) {
             QString evtag = nl.item(n).toElement().tagName();
             if (evtag == "id") {
                 d->eventId = nl.item(n).toElement().text();
@@ -1594,31 +1782,23 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
     }
 
     // Chat states
-    QString chatStateNS = "http://jabber.org/protocol/chatstates";
-    t                   = childElementsByTagNameNS(root, chatStateNS, "active").item(0).toElement();
-    if (!t.isNull())
+    if (!first[ExtActive].isNull())
         d->chatState = StateActive;
-    t = childElementsByTagNameNS(root, chatStateNS, "composing").item(0).toElement();
-    if (!t.isNull())
+    if (!first[ExtComposing].isNull())
         d->chatState = StateComposing;
-    t = childElementsByTagNameNS(root, chatStateNS, "paused").item(0).toElement();
-    if (!t.isNull())
+    if (!first[ExtPaused].isNull())
         d->chatState = StatePaused;
-    t = childElementsByTagNameNS(root, chatStateNS, "inactive").item(0).toElement();
-    if (!t.isNull())
+    if (!first[ExtInactive].isNull())
         d->chatState = StateInactive;
-    t = childElementsByTagNameNS(root, chatStateNS, "gone").item(0).toElement();
-    if (!t.isNull())
+    if (!first[ExtGone].isNull())
         d->chatState = StateGone;
 
     // message receipts
-    QString messageReceiptNS = "urn:xmpp:receipts";
-    t                        = childElementsByTagNameNS(root, messageReceiptNS, "request").item(0).toElement();
-    if (!t.isNull()) {
+    if (!first[ExtReceiptRequest].isNull()) {
         d->messageReceipt = ReceiptRequest;
         d->messageReceiptId.clear();
     }
-    t = childElementsByTagNameNS(root, messageReceiptNS, "received").item(0).toElement();
+    t = first[ExtReceiptReceived];
     if (!t.isNull()) {
         d->messageReceipt   = ReceiptReceived;
         d->messageReceiptId = t.attribute("id");
@@ -1627,14 +1807,14 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
     }
 
     // xsigned
-    t = childElementsByTagNameNS(root, "jabber:x:signed", "x").item(0).toElement();
+    t = first[ExtSigned];
     if (!t.isNull())
         d->xsigned = t.text();
     else
         d->xsigned = QString();
 
     // xencrypted
-    t = childElementsByTagNameNS(root, "jabber:x:encrypted", "x").item(0).toElement();
+    t = first[ExtEncrypted];
     if (!t.isNull())
         d->xencrypted = t.text();
     else
@@ -1642,22 +1822,18 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
 
     // addresses
     d->addressList.clear();
-    nl = childElementsByTagNameNS(root, "http://jabber.org/protocol/address", "addresses");
-    if (nl.count()) {
-        QDomElement t = nl.item(0).toElement();
-        nl            = t.elementsByTagName("address");
-        for (n = 0; n < nl.count(); ++n) {
+    if (!first[ExtAddresses].isNull()) {
+        QDomNodeList nl = first[ExtAddresses].elementsByTagName("address");
+        for (int n = 0; n < nl.count(); ++n) {
             d->addressList += Address(nl.item(n).toElement());
         }
     }
 
     // roster item exchange
     d->rosterExchangeItems.clear();
-    nl = childElementsByTagNameNS(root, "http://jabber.org/protocol/rosterx", "x");
-    if (nl.count()) {
-        QDomElement t = nl.item(0).toElement();
-        nl            = t.elementsByTagName("item");
-        for (n = 0; n < nl.count(); ++n) {
+    if (!first[ExtRosterX].isNull()) {
+        QDomNodeList nl = first[ExtRosterX].elementsByTagName("item");
+        for (int n = 0; n < nl.count(); ++n) {
             RosterExchangeItem it = RosterExchangeItem(nl.item(n).toElement());
             if (!it.isNull())
                 d->rosterExchangeItems += it;
@@ -1665,27 +1841,24 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
     }
 
     // invite
-    t = childElementsByTagNameNS(root, "jabber:x:conference", "x").item(0).toElement();
+    t = first[ExtConference];
     if (!t.isNull())
         d->invite = t.attribute("jid");
     else
         d->invite = QString();
 
     // nick
-    t = childElementsByTagNameNS(root, "http://jabber.org/protocol/nick", "nick").item(0).toElement();
+    t = first[ExtNick];
     if (!t.isNull())
         d->nick = t.text();
     else
         d->nick = QString();
 
     // sxe
-    t = childElementsByTagNameNS(root, "http://jabber.org/protocol/sxe", "sxe").item(0).toElement();
-    if (!t.isNull())
-        d->sxe = t;
-    else
-        d->sxe = QDomElement();
+    t      = first[ExtSxe];
+    d->sxe = t.isNull() ? QDomElement() : d->sxeDoc.importNode(t, true).toElement();
 
-    t = childElementsByTagNameNS(root, "http://jabber.org/protocol/muc#user", "x").item(0).toElement();
+    t = first[ExtMucUser];
     if (!t.isNull()) {
         d->hasMUCUser = true;
         for (QDomNode muc_n = t.firstChild(); !muc_n.isNull(); muc_n = muc_n.nextSibling()) {
@@ -1707,42 +1880,34 @@ bool Message::fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOf
     }
 
     // http auth
-    t = childElementsByTagNameNS(root, "http://jabber.org/protocol/http-auth", "confirm").item(0).toElement();
+    t = first[ExtHttpAuth];
     if (!t.isNull()) {
         d->httpAuthRequest = HttpAuthRequest(t);
     } else {
         d->httpAuthRequest = HttpAuthRequest();
     }
 
-    QDomElement captcha   = childElementsByTagNameNS(root, "urn:xmpp:captcha", "captcha").item(0).toElement();
-    QDomElement xdataRoot = root;
-    if (!captcha.isNull()) {
-        xdataRoot = captcha;
-    }
-
-    // data form
-    t = childElementsByTagNameNS(xdataRoot, "jabber:x:data", "x").item(0).toElement();
+    // data form, inside of the captcha element if there is one
+    QDomElement captcha = first[ExtCaptcha];
+    if (!captcha.isNull())
+        t = childElementsByTagNameNS(captcha, Atom::NsXData, Atom::X).item(0).toElement();
+    else
+        t = first[ExtXData];
     if (!t.isNull()) {
         d->xdata.fromXml(t);
     }
 
-    t = childElementsByTagNameNS(root, IBBManager::ns(), "data").item(0).toElement();
+    t = first[ExtIbb];
     if (!t.isNull()) {
         d->ibbData.fromXml(t);
     }
-    t = childElementsByTagNameNS(root, "urn:xmpp:message-correct:0", "replace").item(0).toElement();
+    t = first[ExtReplace];
     if (!t.isNull()) {
         d->replaceId = t.attribute("id");
     }
 
-    // XEP-0385 SIMS and XEP-0372 Reference
-    auto references = childElementsByTagNameNS(root, REFERENCE_NS, QString::fromLatin1("reference"));
-    for (int i = 0; i < references.size(); i++) {
-        Reference r;
-        if (r.fromXml(references.at(i).toElement())) {
-            d->references.append(r);
-        }
-    }
+    for (const auto &c : qAsConst(custom))
+        (*c.first)(*this, c.second);
 
     return true;
 }
@@ -2498,7 +2663,8 @@ bool RosterItem::fromXml(const QDomElement &item)
 //---------------------------------------------------------------------------
 class Roster::Private {
 public:
-    QString groupsDelimiter;
+    QString                 groupsDelimiter;
+    RosterIndex<RosterItem> index;
 };
 
 Roster::Roster() : QList<RosterItem>(), d(new Roster::Private) { }
@@ -2514,27 +2680,41 @@ Roster &Roster::operator=(const Roster &other)
 {
     QList<RosterItem>::operator=(other);
     d->groupsDelimiter         = other.d->groupsDelimiter;
+    d->index.invalidate();
     return *this;
 }
 
 Roster::Iterator Roster::find(const Jid &j)
 {
-    for (Roster::Iterator it = begin(); it != end(); ++it) {
-        if ((*it).jid().compare(j))
-            return it;
-    }
-
-    return end();
+    int pos = d->index.find(*this, j.bare(), [&j](const RosterItem &i) { return i.jid().compare(j); });
+    if (pos == -1)
+        return end();
+    d->index.touched(pos);
+    return begin() + pos;
 }
 
 Roster::ConstIterator Roster::find(const Jid &j) const
 {
-    for (Roster::ConstIterator it = begin(); it != end(); ++it) {
-        if ((*it).jid().compare(j))
-            return it;
-    }
+    int pos = d->index.find(*this, j.bare(), [&j](const RosterItem &i) { return i.jid().compare(j); });
+    return pos == -1 ? end() : begin() + pos;
+}
 
-    return end();
+void Roster::addItem(const RosterItem &item)
+{
+    append(item);
+    d->index.added(*this);
+}
+
+void Roster::setItem(Iterator it, const RosterItem &item)
+{
+    *it = item;
+    d->index.touched(int(it - begin()));
+}
+
+Roster::Iterator Roster::removeItem(Iterator it)
+{
+    d->index.invalidate();
+    return erase(it);
 }
 
 void Roster::setGroupsDelimiter(const QString &groupsDelimiter) { d->groupsDelimiter = groupsDelimiter; }
@@ -2739,7 +2919,10 @@ void SearchResult::setEmail(const QString &email) { v_email = email; }
 
 PubSubItem::PubSubItem() { }
 
-PubSubItem::PubSubItem(const QString &id, const QDomElement &payload) : id_(id), payload_(payload) { }
+PubSubItem::PubSubItem(const QString &id, const QDomElement &payload) :
+    id_(id), payload_(doc_.importNode(payload, true).toElement())
+{
+}
 
 const QString &PubSubItem::id() const { return id_; }
 
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/xmpp.h"
+#include "xmpp/xmpp-core/xmpp_clientstream.h"
+#include "xmpp/xmpp-im/xmpp_caps.h"
+#include "xmpp/xmpp-im/xmpp_client.h"
+#include "xmpp/xmpp-im/xmpp_discoinfotask.h"
+
+#include <QDomDocument>
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+// never connects, so the stream stays in Connecting and drops whatever is written
+class NullConnector : public Connector {
+public:
+    void        setOptHostPort(const QString &, quint16) override { }
+    void        connectToServer(const QString &) override { }
+    ByteStream *stream() const override { return nullptr; }
+    void        done() override { }
+};
+
+DiscoItem clientInfo()
+{
+    DiscoItem item;
+    item.setIdentities(DiscoItem::Identity("client", "pc", QString(), "Example"));
+    item.setFeatures(Features(QStringList({ "http://jabber.org/protocol/caps", "urn:example:feature" })));
+    return item;
+}
+} // namespace
+
+class CapsManagerTest : public QObject {
+    Q_OBJECT
+
+    QDomDocument  doc;
+    CapsRegistry *registry = nullptr;
+    NullConnector connector;
+    ClientStream *stream = nullptr;
+    Client *      client = nullptr;
+
+    // a node of its own for every test, the requests are per node
+    CapsSpec spec() const
+    {
+        return CapsSpec(QString("http://example.org/%1").arg(QTest::currentTestFunction()), QCryptographicHash::Sha1,
+                        clientInfo().capsHash(QCryptographicHash::Sha1));
+    }
+
+    static Jid contact(int n) { return Jid(QString("contact%1@example.org/r").arg(n)); }
+
+    QList<DiscoInfoTask *> outstanding() const
+    {
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        return client->rootTask()->findChildren<DiscoInfoTask *>(QString(), Qt::FindDirectChildrenOnly);
+    }
+
+    // the only request out, or null
+    DiscoInfoTask *request() const
+    {
+        const QList<DiscoInfoTask *> tasks = outstanding();
+        return tasks.size() == 1 ? tasks.first() : nullptr;
+    }
+
+    void reply(DiscoInfoTask *task, const QString &type, const DiscoItem &item = DiscoItem())
+    {
+        QDomElement iq = doc.createElement("iq");
+        iq.setAttribute("type", type);
+        iq.setAttribute("from", task->jid().full());
+        iq.setAttribute("id", task->id());
+        if (type == "result") {
+            iq.appendChild(item.toDiscoInfoResult(&doc));
+        } else {
+            QDomElement error = doc.createElement("error");
+            error.setAttribute("type", "cancel");
+            error.appendChild(doc.createElementNS("urn:ietf:params:xml:ns:xmpp-stanzas", "item-not-found"));
+            iq.appendChild(error);
+        }
+        QVERIFY(client->rootTask()->take(iq));
+    }
+
+private slots:
+    void init()
+    {
+        registry = new CapsRegistry;
+        CapsRegistry::setInstance(registry);
+        stream = new ClientStream(&connector);
+        client = new Client;
+        client->connectToServer(stream, Jid("me@example.org/r"), false);
+    }
+
+    void cleanup()
+    {
+        delete client;
+        delete stream;
+        CapsRegistry::setInstance(nullptr);
+        delete registry;
+    }
+
+    void testOneRequestPerNode()
+    {
+        for (int i = 0; i < 3; ++i)
+            client->capsManager()->updateCaps(contact(i), spec());
+        DiscoInfoTask *task = request();
+        QVERIFY(task);
+        QCOMPARE(task->node(), spec().flatten());
+
+        reply(task, "result", clientInfo());
+        QVERIFY(registry->isRegistered(spec().flatten()));
+        QVERIFY(outstanding().isEmpty());
+        QVERIFY(client->capsManager()->features(contact(1)).test("urn:example:feature"));
+
+        // known now, so nobody is asked any more
+        client->capsManager()->updateCaps(contact(3), spec());
+        QVERIFY(outstanding().isEmpty());
+    }
+
+    void testRetryAnotherJid()
+    {
+        client->capsManager()->updateCaps(contact(0), spec());
+        client->capsManager()->updateCaps(contact(1), spec());
+        DiscoInfoTask *task = request();
+        QVERIFY(task);
+        const Jid first = task->jid();
+
+        reply(task, "error");
+        task = request();
+        QVERIFY(task);
+        QVERIFY(!task->jid().compare(first));
+        QVERIFY(task->jid().compare(contact(0)) || task->jid().compare(contact(1)));
+
+        // an answer which does not hash to the version is no better
+        DiscoItem other = clientInfo();
+        other.setFeatures(Features(QStringList("urn:example:other")));
+        reply(task, "result", other);
+        QVERIFY(outstanding().isEmpty());
+        QVERIFY(!registry->isRegistered(spec().flatten()));
+
+        // the ones advertising it later may know
+        client->capsManager()->updateCaps(contact(2), spec());
+        task = request();
+        QVERIFY(task);
+        QVERIFY(task->jid().compare(contact(2)));
+    }
+
+    void testMaxAttempts()
+    {
+        for (int i = 0; i < 5; ++i)
+            client->capsManager()->updateCaps(contact(i), spec());
+
+        QSet<QString> asked;
+        for (int i = 0; i < 3; ++i) {
+            DiscoInfoTask *task = request();
+            QVERIFY(task);
+            asked += task->jid().full();
+            reply(task, "error");
+        }
+        QCOMPARE(asked.size(), 3);
+        QVERIFY(outstanding().isEmpty());
+
+        client->capsManager()->updateCaps(contact(5), spec());
+        QVERIFY(outstanding().isEmpty());
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(CapsManagerTest);
+#include "capsmanagertest.moc"
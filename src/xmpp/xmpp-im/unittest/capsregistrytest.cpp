@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-im/xmpp_caps.h"
+#include "xmpp/xmpp-im/xmpp_discoitem.h"
+#include "xmpp/xmpp-im/xmpp_status.h"
+
+#include <QDataStream>
+#include <QDomDocument>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+CapsSpec spec(int n) { return CapsSpec("http://example.org/client", QCryptographicHash::Sha1, QString("v%1").arg(n)); }
+
+DiscoItem item(int n, int features = 3)
+{
+    DiscoItem   item;
+    QStringList list;
+    for (int i = 0; i < features; ++i)
+        list += QString("urn:example:%1:feature:%2").arg(n).arg(i);
+    item.setIdentities(DiscoItem::Identity("client", "pc", QString(), QString("client %1").arg(n)));
+    item.setFeatures(Features(list));
+    return item;
+}
+
+// a record the way the registry writes them, so the file can be made up front
+QByteArray record(const QString &node, const QDateTime &seen, const DiscoItem &item)
+{
+    QDomDocument doc;
+    doc.appendChild(item.toDiscoInfoResult(&doc));
+    QByteArray  payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << node << qint64(seen.toMSecsSinceEpoch()) << doc.toByteArray(-1);
+
+    QByteArray r(4, '\0');
+    qToBigEndian<quint32>(quint32(payload.size()), reinterpret_cast<uchar *>(r.data()));
+    return r + payload;
+}
+
+QByteArray header()
+{
+    QByteArray h(5, '\0');
+    qToBigEndian<quint32>(0x49435253, reinterpret_cast<uchar *>(h.data()));
+    h[4] = 1;
+    return h;
+}
+} // namespace
+
+class CapsRegistryTest : public QObject {
+    Q_OBJECT
+
+    QTemporaryDir dir;
+
+    void verifyStored(const QString &fileName, const QList<int> &stored)
+    {
+        CapsRegistry reg;
+        reg.setStorageFile(fileName);
+        reg.load();
+        for (int n : stored) {
+            QVERIFY2(reg.isRegistered(spec(n).flatten()), qPrintable(spec(n).flatten()));
+            QCOMPARE(reg.disco(spec(n).flatten()).features().list(), item(n).features().list());
+        }
+    }
+
+private slots:
+    void testAppend()
+    {
+        const QString fileName = dir.filePath("append.caps");
+        {
+            CapsRegistry reg;
+            reg.setStorageFile(fileName);
+            reg.load();
+            reg.registerCaps(spec(1), item(1));
+            reg.save();
+            reg.registerCaps(spec(2), item(2));
+            reg.registerCaps(spec(3), item(3));
+            reg.save();
+            reg.registerCaps(spec(4), item(4));
+            reg.save();
+            reg.save(); // nothing new
+            QVERIFY(reg.isRegistered(spec(1).flatten()));
+        }
+        verifyStored(fileName, { 1, 2, 3, 4 });
+
+        // and once more after a reload
+        {
+            CapsRegistry reg;
+            reg.setStorageFile(fileName);
+            reg.load();
+            reg.registerCaps(spec(5), item(5));
+            reg.save();
+        }
+        verifyStored(fileName, { 1, 2, 3, 4, 5 });
+    }
+
+    void testTornTail()
+    {
+        const QString fileName = dir.filePath("torn.caps");
+        {
+            CapsRegistry reg;
+            reg.setStorageFile(fileName);
+            reg.load();
+            reg.registerCaps(spec(1), item(1));
+            reg.registerCaps(spec(2), item(2));
+            reg.save();
+        }
+        const qint64 whole = QFileInfo(fileName).size();
+
+        // a crash in the middle of a record
+        QByteArray torn = record(spec(3).flatten(), QDateTime::currentDateTimeUtc(), item(3));
+        {
+            QFile f(fileName);
+            QVERIFY(f.open(QIODevice::Append));
+            f.write(torn.left(torn.size() / 2));
+        }
+        verifyStored(fileName, { 1, 2 });
+        {
+            CapsRegistry reg;
+            reg.setStorageFile(fileName);
+            reg.load();
+            QVERIFY(!reg.isRegistered(spec(3).flatten()));
+            reg.registerCaps(spec(4), item(4));
+            reg.save();
+        }
+        verifyStored(fileName, { 1, 2, 4 });
+        QCOMPARE(QFileInfo(fileName).size(), whole + record(spec(4).flatten(), QDateTime(), item(4)).size());
+    }
+
+    void testCompact()
+    {
+        const QString fileName = dir.filePath("compact.caps");
+        const auto    now      = QDateTime::currentDateTimeUtc();
+        {
+            QByteArray data = header() + record(spec(1).flatten(), now, item(1));
+            for (int n = 100; data.size() < 200000; ++n)
+                data += record(spec(n).flatten(), now.addMonths(-4), item(n, 20)); // expired
+            data += record(spec(1).flatten(), now, item(1)); // stored twice
+            QFile f(fileName);
+            QVERIFY(f.open(QIODevice::WriteOnly));
+            f.write(data);
+        }
+        {
+            CapsRegistry reg;
+            reg.setStorageFile(fileName);
+            reg.load();
+            QVERIFY(reg.isRegistered(spec(1).flatten()));
+            QVERIFY(!reg.isRegistered(spec(100).flatten()));
+            reg.registerCaps(spec(2), item(2));
+            reg.save();
+        }
+        QVERIFY(QFileInfo(fileName).size() < 65536);
+        verifyStored(fileName, { 1, 2 });
+
+        CapsRegistry reg;
+        reg.setStorageFile(fileName);
+        reg.load();
+        QVERIFY(!reg.isRegistered(spec(100).flatten()));
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(CapsRegistryTest);
+#include "capsregistrytest.moc"
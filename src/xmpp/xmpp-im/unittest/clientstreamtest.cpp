@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/protocol.h"
+#include "xmpp/xmpp-core/sm.h"
+#include "xmpp/xmpp-core/xmpp.h"
+#include "xmpp/xmpp-core/xmpp_clientstream.h"
+
+#include <QDataStream>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+class NullConnector : public Connector {
+public:
+    void        setOptHostPort(const QString &, quint16) override { }
+    void        connectToServer(const QString &) override { }
+    ByteStream *stream() const override { return nullptr; }
+    void        done() override { }
+};
+
+QByteArray stanza(int n)
+{
+    return "<message to='peer@example.org' id='" + QByteArray::number(n) + "'><body>hello</body></message>\n";
+}
+
+QByteArray snapshot(quint32 magic = 0x49534d53, quint8 version = 1)
+{
+    SMState state;
+    state.resumption_id            = "sm-id";
+    state.resumption_location.host = "sm.example.org";
+    state.resumption_location.port = 5222;
+    state.jid                      = "user@example.org/home";
+    state.received_count           = 1234;
+    state.server_last_handled      = 77;
+    state.send_queue.enqueue(stanza(78));
+    state.send_queue.enqueue(stanza(79));
+
+    QByteArray data;
+    {
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_6);
+        state.write(out);
+    }
+    qToBigEndian<quint32>(magic, reinterpret_cast<uchar *>(data.data()));
+    data[4] = char(version);
+    return data;
+}
+
+const char *serverOpen = "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' "
+                         "from='example.org' id='s1' version='1.0'>";
+} // namespace
+
+class ClientStreamTest : public QObject {
+    Q_OBJECT
+
+    QTemporaryDir dir;
+    NullConnector connector;
+
+    QString writeFile(const QString &name, const QByteArray &data)
+    {
+        QFile file(dir.filePath(name));
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+            return QString();
+        return file.fileName();
+    }
+
+    // runs the client side until it waits for the server, as ClientStream would with a plain SASL exchange
+    QByteArray drive(CoreProtocol &p, const QByteArray &in, QList<int> *events = nullptr)
+    {
+        if (!in.isEmpty())
+            p.addIncomingData(in);
+        for (int n = 0; n < 100; ++n) {
+            if (p.processStep()) {
+                if (p.event == CoreProtocol::EError)
+                    break;
+                if (events && p.event != CoreProtocol::ESend)
+                    *events += p.event;
+            } else if (p.need == CoreProtocol::NSASLFirst) {
+                p.setSASLFirst("PLAIN", QByteArray());
+            } else if (p.need != CoreProtocol::NSASLLayer) {
+                break;
+            }
+        }
+        return p.takeOutgoingData();
+    }
+
+    // logs in with the session of the snapshot, up to the resumption request
+    QByteArray resumeRestored(CoreProtocol &p)
+    {
+        QDataStream in(snapshot());
+        in.setVersion(QDataStream::Qt_5_6);
+        if (!p.sm.state().read(in))
+            return QByteArray();
+
+        p.startClientOut(Jid("user@example.org"), false, true, true, false);
+        drive(p, QByteArray());
+        drive(p,
+              QByteArray(serverOpen)
+                  + "<stream:features><mechanisms xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>"
+                    "<mechanism>PLAIN</mechanism></mechanisms></stream:features>");
+        drive(p, "<success xmlns='urn:ietf:params:xml:ns:xmpp-sasl'/>");
+        return drive(p,
+                     QByteArray(serverOpen)
+                         + "<stream:features><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'/>"
+                           "<sm xmlns='urn:xmpp:sm:3'/></stream:features>");
+    }
+
+private slots:
+    void testRestoreFile()
+    {
+        ClientStream stream(&connector);
+        const QString fileName = writeFile("good", snapshot());
+        QVERIFY(stream.restoreSMState(fileName));
+
+        // the session is there to be saved again, just as it was
+        const QString saved = dir.filePath("saved");
+        QVERIFY(stream.saveSMState(saved));
+        QFile file(saved);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), snapshot());
+    }
+
+    void testRejectSnapshot_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+        QTest::newRow("magic") << snapshot(0x49534d54);
+        QTest::newRow("version") << snapshot(0x49534d53, 2);
+        QTest::newRow("truncated") << snapshot().left(20);
+    }
+
+    void testRejectSnapshot()
+    {
+        QFETCH(QByteArray, data);
+        ClientStream  stream(&connector);
+        const QString fileName = writeFile("bad", data);
+        QVERIFY(!fileName.isEmpty());
+        QVERIFY(!stream.restoreSMState(fileName));
+        QVERIFY(!stream.restoreSMState(dir.filePath("missing")));
+
+        // nothing to resume, so nothing to save either
+        QVERIFY(!stream.saveSMState(dir.filePath("unsaved")));
+    }
+
+    void testResume()
+    {
+        CoreProtocol     p;
+        const QByteArray sent = resumeRestored(p);
+        QVERIFY(sent.contains("<resume"));
+        QVERIFY(sent.contains("previd=\"sm-id\""));
+        QVERIFY(sent.contains("h=\"1234\""));
+        QVERIFY(!sent.contains("bind_1"));
+
+        // the server handled 78, so 79 goes again, and the session is the one of the snapshot
+        QList<int>       events;
+        const QByteArray resent = drive(p, "<resumed xmlns='urn:xmpp:sm:3' previd='sm-id' h='78'/>", &events);
+        QVERIFY(events.contains(CoreProtocol::EReady));
+        QVERIFY(p.sm.isResumed());
+        QVERIFY(!p.sm.state().restored);
+        QCOMPARE(p.jid().full(), QString("user@example.org/home"));
+        QVERIFY(resent.contains("id='79'"));
+        QVERIFY(!resent.contains("id='78'"));
+    }
+
+    void testResumeFailed()
+    {
+        CoreProtocol p;
+        QVERIFY(resumeRestored(p).contains("<resume"));
+
+        // nobody is attached to a restored session, so a new one is bound rather than giving up
+        QList<int>       events;
+        const QByteArray sent = drive(p, "<failed xmlns='urn:xmpp:sm:3'/>", &events);
+        QVERIFY(!events.contains(CoreProtocol::ESMResumeFailed));
+        QVERIFY(sent.contains("bind_1"));
+        QVERIFY(sent.contains("urn:ietf:params:xml:ns:xmpp-bind"));
+        QVERIFY(!p.sm.state().isResumption());
+        QVERIFY(!p.sm.state().restored);
+        QCOMPARE(p.sm.state().send_queue.count(), 0);
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(ClientStreamTest);
+#include "clientstreamtest.moc"
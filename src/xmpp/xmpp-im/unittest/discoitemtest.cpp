@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-im/xmpp_discoitem.h"
+
+#include <QDomDocument>
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+// the examples of XEP-0115 5.2 and 5.3
+static const char *simpleInfo = "<query xmlns='http://jabber.org/protocol/disco#info'>"
+                                "<identity category='client' name='Exodus 0.9.1' type='pc'/>"
+                                "<feature var='http://jabber.org/protocol/caps'/>"
+                                "<feature var='http://jabber.org/protocol/disco#info'/>"
+                                "<feature var='http://jabber.org/protocol/disco#items'/>"
+                                "<feature var='http://jabber.org/protocol/muc'/>"
+                                "</query>";
+
+// without the identities, they have languages
+static const char *complexInfo
+    = "<query xmlns='http://jabber.org/protocol/disco#info'>"
+      "<feature var='http://jabber.org/protocol/caps'/>"
+      "<feature var='http://jabber.org/protocol/disco#info'/>"
+      "<feature var='http://jabber.org/protocol/disco#items'/>"
+      "<feature var='http://jabber.org/protocol/muc'/>"
+      "<x xmlns='jabber:x:data' type='result'>"
+      "<field var='FORM_TYPE' type='hidden'><value>urn:xmpp:dataforms:softwareinfo</value></field>"
+      "<field var='ip_version'><value>ipv4</value><value>ipv6</value></field>"
+      "<field var='os'><value>Mac</value></field>"
+      "<field var='os_version'><value>10.5.1</value></field>"
+      "<field var='software'><value>Psi</value></field>"
+      "<field var='software_version'><value>0.11</value></field>"
+      "</x>"
+      "</query>";
+
+class DiscoItemTest : public QObject {
+    Q_OBJECT
+
+    static DiscoItem parse(const char *xml)
+    {
+        QDomDocument doc;
+        doc.setContent(QString::fromUtf8(xml), true);
+        return DiscoItem::fromDiscoInfoResult(doc.documentElement());
+    }
+
+    static DiscoItem complex()
+    {
+        DiscoItem item = parse(complexInfo);
+        item.setIdentities({ DiscoItem::Identity("client", "pc", "en", "Psi 0.11"),
+                             DiscoItem::Identity("client", "pc", "el", QString::fromUtf8("\xce\xa8 0.11")) });
+        return item;
+    }
+
+private slots:
+    void testKnownVectors()
+    {
+        QCOMPARE(parse(simpleInfo).capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+        QCOMPARE(complex().capsHash(QCryptographicHash::Sha1), QString("q07IKJEyjvHSyhy//CH0CxmKi8w="));
+
+        // several at once give the same
+        DiscoItem   item   = complex();
+        QStringList hashes = item.capsHashes({ QCryptographicHash::Sha256, QCryptographicHash::Sha1 });
+        QCOMPARE(hashes.size(), 2);
+        QCOMPARE(hashes.at(1), QString("q07IKJEyjvHSyhy//CH0CxmKi8w="));
+        QCOMPARE(hashes.at(0), complex().capsHash(QCryptographicHash::Sha256));
+    }
+
+    void testIllFormed()
+    {
+        // two forms of the same type
+        DiscoItem item = complex();
+        item.setExtensions(item.extensions() + item.extensions());
+        QVERIFY(item.capsHash(QCryptographicHash::Sha1).isEmpty());
+    }
+
+    void testSettersInvalidate()
+    {
+        DiscoItem     item   = complex();
+        const QString before = item.capsHash(QCryptographicHash::Sha1);
+
+        item.setExtensions(QList<XData>());
+        const QString noExt = item.capsHash(QCryptographicHash::Sha1);
+        QVERIFY(noExt != before);
+
+        item.setIdentities(parse(simpleInfo).identities());
+        QCOMPARE(item.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+
+        Features features = item.features();
+        features.addFeature("urn:example:extra");
+        item.setFeatures(features);
+        QVERIFY(item.capsHash(QCryptographicHash::Sha1) != QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+        item.setFeatures(parse(simpleInfo).features());
+        QCOMPARE(item.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+    }
+
+    void testCopiesAreIndependent()
+    {
+        DiscoItem a = parse(simpleInfo);
+        QCOMPARE(a.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+
+        // b shares the data of a, memo included, till it is changed
+        DiscoItem b = a;
+        QCOMPARE(b.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+        b.setIdentities(complex().identities());
+        b.setExtensions(complex().extensions());
+        QCOMPARE(b.capsHash(QCryptographicHash::Sha1), QString("q07IKJEyjvHSyhy//CH0CxmKi8w="));
+        QCOMPARE(a.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+
+        // and the other way round, with the memo filled in only after the copy
+        DiscoItem c = parse(simpleInfo);
+        DiscoItem e = c;
+        c.setFeatures(Features());
+        QCOMPARE(e.capsHash(QCryptographicHash::Sha1), QString("QgayPKawpkPSDYmwT/WM94uAlu0="));
+        QVERIFY(c.capsHash(QCryptographicHash::Sha1) != e.capsHash(QCryptographicHash::Sha1));
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(DiscoItemTest);
+#include "discoitemtest.moc"
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-im/xmpp_features.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+class FeaturesTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testWellKnownRegistry()
+    {
+        for (int i = 0; i < Features::WK_Count; ++i) {
+            auto    f  = Features::WellKnown(i);
+            QString ns = Features::wellKnown(f);
+            QVERIFY(!ns.isEmpty());
+            QCOMPARE(Features::wellKnown(ns), f);
+        }
+        QCOMPARE(Features::wellKnown(QString("urn:example:unknown")), Features::WK_Count);
+        QCOMPARE(Features::wellKnown(Features::WK_Receipts), QString("urn:xmpp:receipts"));
+    }
+
+    void testBitsFollowList()
+    {
+        Features f;
+        QVERIFY(!f.test(Features::WK_Receipts));
+
+        f.addFeature("urn:xmpp:receipts");
+        f << "urn:example:unknown";
+        QVERIFY(f.test(Features::WK_Receipts));
+        QVERIFY(f.test("urn:xmpp:receipts"));
+        QVERIFY(f.test("urn:example:unknown"));
+        QVERIFY(!f.test(Features::WK_ChatState));
+
+        f.setList(QStringList { "http://jabber.org/protocol/chatstates" });
+        QVERIFY(!f.test(Features::WK_Receipts));
+        QVERIFY(f.hasChatState());
+
+        Features g(QString("urn:xmpp:hash-function-text-names:sha-256"));
+        f += g;
+        QVERIFY(f.test(Features::WK_HashSha256));
+        QVERIFY(!f.test(QStringList { "http://jabber.org/protocol/chatstates", "urn:xmpp:receipts" }));
+    }
+
+    void testHasDiscoNeedsAll()
+    {
+        Features f(QStringList { "http://jabber.org/protocol/disco#info", "http://jabber.org/protocol/disco#items" });
+        QVERIFY(!f.hasDisco());
+        f.addFeature("http://jabber.org/protocol/disco");
+        QVERIFY(f.hasDisco());
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(FeaturesTest);
+#include "featurestest.moc"
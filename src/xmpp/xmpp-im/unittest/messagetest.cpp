@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/xmpp_stream.h"
+#include "xmpp/xmpp-im/xmpp_message.h"
+#include "xmpp/xmpp-im/xmpp_url.h"
+
+#include <QDomDocument>
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+// just enough of a stream to make stanzas of elements
+class DocStream : public Stream {
+public:
+    mutable QDomDocument document;
+
+    QDomDocument &doc() const override { return document; }
+    QString       baseNS() const override { return "jabber:client"; }
+    bool          old() const override { return false; }
+
+    void   close() override { }
+    bool   stanzaAvailable() const override { return false; }
+    Stanza read() override { return Stanza(); }
+    void   write(const Stanza &) override { }
+
+    int                     errorCondition() const override { return 0; }
+    QString                 errorText() const override { return QString(); }
+    QHash<QString, QString> errorLangText() const override { return QHash<QString, QString>(); }
+    QDomElement             errorAppSpec() const override { return QDomElement(); }
+};
+} // namespace
+
+class MessageTest : public QObject {
+    Q_OBJECT
+
+    DocStream stream;
+
+    Message parse(const QString &children)
+    {
+        QString xml = "<message xmlns='jabber:client' from='a@example.org/r' to='b@example.org' id='m1' type='chat'>"
+            + children + "</message>";
+        QDomDocument doc;
+        if (!doc.setContent(xml, true))
+            return Message();
+        Message m;
+        if (!m.fromStanza(stream.createStanza(doc.documentElement())))
+            return Message();
+        return m;
+    }
+
+private slots:
+    void testChatStateOrder()
+    {
+        // of several states, the later one in active, composing, paused, inactive, gone wins, not the later child
+        const QString ns = " xmlns='http://jabber.org/protocol/chatstates'/>";
+        QCOMPARE(parse("<composing" + ns).chatState(), StateComposing);
+        QCOMPARE(parse("<paused" + ns + "<active" + ns).chatState(), StatePaused);
+        QCOMPARE(parse("<gone" + ns + "<composing" + ns).chatState(), StateGone);
+        QCOMPARE(parse("<body>hi</body>").chatState(), StateNone);
+    }
+
+    void testReceipts()
+    {
+        Message m = parse("<request xmlns='urn:xmpp:receipts'/>");
+        QCOMPARE(m.messageReceipt(), ReceiptRequest);
+        QVERIFY(m.messageReceiptId().isEmpty());
+
+        // a receipt wins over a request, and without an id it is for the message itself
+        m = parse("<received xmlns='urn:xmpp:receipts' id='x1'/><request xmlns='urn:xmpp:receipts'/>");
+        QCOMPARE(m.messageReceipt(), ReceiptReceived);
+        QCOMPARE(m.messageReceiptId(), QString("x1"));
+        m = parse("<request xmlns='urn:xmpp:receipts'/><received xmlns='urn:xmpp:receipts'/>");
+        QCOMPARE(m.messageReceipt(), ReceiptReceived);
+        QCOMPARE(m.messageReceiptId(), QString("m1"));
+    }
+
+    void testCaptchaForm()
+    {
+        const QString plain   = "<x xmlns='jabber:x:data' type='form'><title>plain</title></x>";
+        const QString captcha = "<captcha xmlns='urn:xmpp:captcha'>"
+                                "<x xmlns='jabber:x:data' type='form'><title>captcha</title></x></captcha>";
+        QCOMPARE(parse(plain).getForm().title(), QString("plain"));
+        QCOMPARE(parse(plain + captcha).getForm().title(), QString("captcha"));
+        QCOMPARE(parse(captcha + plain).getForm().title(), QString("captcha"));
+    }
+
+    void testRepeatable()
+    {
+        Message m = parse("<no-store xmlns='urn:xmpp:hints'/><no-copy xmlns='urn:xmpp:hints'/>"
+                          "<x xmlns='jabber:x:oob'><url>https://example.org/1</url></x>"
+                          "<x xmlns='jabber:x:oob'><url>https://example.org/2</url></x>");
+        QCOMPARE(int(m.processingHints()), int(Message::NoStore | Message::NoCopy));
+        QCOMPARE(m.urlList().count(), 2);
+        QCOMPARE(m.urlList().at(0).url(), QString("https://example.org/1"));
+        QCOMPARE(m.urlList().at(1).url(), QString("https://example.org/2"));
+    }
+
+    void testExtensionParser()
+    {
+        const QString ns = "urn:example:ext";
+        QStringList   seen;
+        Message::registerExtensionParser(ns, "tag", [&seen](Message &, const QDomElement &e) {
+            seen += e.attribute("v");
+        });
+
+        Message m = parse("<tag xmlns='urn:example:ext' v='1'/><body>hi</body><tag xmlns='urn:example:ext' v='2'/>"
+                          "<other xmlns='urn:example:ext' v='3'/><tag xmlns='urn:example:other' v='4'/>");
+        QCOMPARE(seen, QStringList({ "1", "2" }));
+        QCOMPARE(m.body(), QString("hi"));
+
+        // parsers for a built-in extension run after it, so they get the last word
+        Message::registerExtensionParser("urn:xmpp:receipts", "received", [](Message &m, const QDomElement &) {
+            m.setMessageReceiptId("overridden");
+        });
+        m = parse("<received xmlns='urn:xmpp:receipts' id='x1'/>");
+        QCOMPARE(m.messageReceipt(), ReceiptReceived);
+        QCOMPARE(m.messageReceiptId(), QString("overridden"));
+
+        Message::unregisterExtensionParser("urn:xmpp:receipts", "received");
+        Message::unregisterExtensionParser(ns, "tag");
+        seen.clear();
+        m = parse("<received xmlns='urn:xmpp:receipts' id='x1'/><tag xmlns='urn:example:ext' v='1'/>");
+        QCOMPARE(m.messageReceiptId(), QString("x1"));
+        QVERIFY(seen.isEmpty());
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(MessageTest);
+#include "messagetest.moc"
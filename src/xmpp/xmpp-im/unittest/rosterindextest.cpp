@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/jid/jid.h"
+#include "xmpp/xmpp-im/rosterindex_p.h"
+#include "xmpp/xmpp-im/xmpp_liveroster.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+struct Item {
+    Jid v_jid;
+    int presences = 0;
+
+    const Jid &jid() const { return v_jid; }
+};
+
+QList<Item> makeRoster(int count)
+{
+    QList<Item> roster;
+    for (int n = 0; n < count; ++n)
+        roster += Item { Jid(QString("contact%1@example.org").arg(n)) };
+    return roster;
+}
+
+// what the first login presence burst looks like: every contact with one or two online resources
+QList<Jid> presenceFlood(int contacts)
+{
+    QList<Jid> flood;
+    for (int n = 0; n < contacts; ++n) {
+        QString bare = QString("contact%1@example.org").arg((n * 7919) % contacts);
+        flood += Jid(bare + "/phone");
+        if (n % 3 == 0)
+            flood += Jid(bare + "/desktop");
+    }
+    return flood;
+}
+
+int linearFind(const QList<Item> &roster, const Jid &j)
+{
+    for (int n = 0; n < roster.size(); ++n) {
+        if (roster.at(n).jid().compare(j, false))
+            return n;
+    }
+    return -1;
+}
+} // namespace
+
+class RosterIndexTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testFind()
+    {
+        QList<Item>       roster = makeRoster(100);
+        RosterIndex<Item> index;
+        auto              bareMatch = [](const Jid &j) {
+            return [j](const Item &i) { return i.jid().compare(j, false); };
+        };
+
+        QCOMPARE(index.find(roster, "contact42@example.org", bareMatch(Jid("contact42@example.org/x"))), 42);
+        QCOMPARE(index.find(roster, "nobody@example.org", bareMatch(Jid("nobody@example.org"))), -1);
+
+        roster += Item { Jid("late@example.org") };
+        index.added(roster);
+        QCOMPARE(index.find(roster, "late@example.org", bareMatch(Jid("late@example.org"))), 100);
+    }
+
+    void testSameBareInListOrder()
+    {
+        QList<Item> roster;
+        roster += Item { Jid("a@example.org/one") };
+        roster += Item { Jid("b@example.org") };
+        roster += Item { Jid("a@example.org/two") };
+        RosterIndex<Item> index;
+
+        QCOMPARE(index.positions(roster, "a@example.org"), QVector<int>({ 0, 2 }));
+        Jid two("a@example.org/two");
+        QCOMPARE(index.find(roster, two.bare(), [&two](const Item &i) { return i.jid().compare(two); }), 2);
+    }
+
+    void testStaleIndex()
+    {
+        QList<Item>       roster = makeRoster(10);
+        RosterIndex<Item> index;
+        QCOMPARE(index.positions(roster, "contact3@example.org"), QVector<int>({ 3 }));
+
+        // moved behind the index' back
+        std::swap(roster[3], roster[7]);
+        QCOMPARE(index.positions(roster, "contact3@example.org"), QVector<int>({ 7 }));
+
+        // removed and appended behind its back
+        roster.removeAt(0);
+        roster += Item { Jid("new@example.org") };
+        index.invalidate();
+        QCOMPARE(index.positions(roster, "new@example.org"), QVector<int>({ 9 }));
+        QCOMPARE(index.positions(roster, "contact0@example.org"), QVector<int>());
+    }
+
+    void testJidChangedInPlace()
+    {
+        QList<Item>       roster = makeRoster(10);
+        RosterIndex<Item> index;
+        QCOMPARE(index.positions(roster, "contact3@example.org"), QVector<int>({ 3 }));
+
+        index.touched(3);
+        roster[3].v_jid = Jid("renamed@example.org");
+        QCOMPARE(index.positions(roster, "renamed@example.org"), QVector<int>({ 3 }));
+        QCOMPARE(index.positions(roster, "contact3@example.org"), QVector<int>());
+
+        // now to a bare jid which is already there
+        index.touched(5);
+        roster[5].v_jid = Jid("contact1@example.org/other");
+        QCOMPARE(index.positions(roster, "contact1@example.org"), QVector<int>({ 1, 5 }));
+
+        // a touched item which kept its jid leaves the index alone
+        index.touched(1);
+        QCOMPARE(index.positions(roster, "contact1@example.org"), QVector<int>({ 1, 5 }));
+    }
+
+    void testLiveRoster()
+    {
+        LiveRoster roster;
+        for (int n = 0; n < 10; ++n)
+            roster.addItem(LiveRosterItem(Jid(QString("contact%1@example.org").arg(n))));
+        QVERIFY(roster.find(Jid("contact3@example.org"), false) == roster.begin() + 3);
+
+        // updated from a roster push, through what find() returned
+        LiveRoster::Iterator it = roster.find(Jid("contact3@example.org"), false);
+        it->setRosterItem(RosterItem(Jid("renamed@example.org")));
+        QVERIFY(roster.find(Jid("renamed@example.org"), false) == roster.begin() + 3);
+        QVERIFY(roster.find(Jid("contact3@example.org"), false) == roster.end());
+
+        // replaced
+        roster.setItem(roster.begin() + 4, LiveRosterItem(Jid("assigned@example.org")));
+        QVERIFY(roster.find(Jid("assigned@example.org"), false) == roster.begin() + 4);
+
+        roster.removeItem(roster.begin());
+        QVERIFY(roster.find(Jid("renamed@example.org"), false) == roster.begin() + 2);
+        QVERIFY(roster.find(Jid("contact0@example.org"), false) == roster.end());
+        roster.addItem(LiveRosterItem(Jid("contact1@example.org/other")));
+        QCOMPARE(roster.findAll(Jid("contact1@example.org"), false).size(), 2);
+
+        // each roster has an index of its own
+        LiveRoster copy = roster;
+        copy.setItem(copy.begin(), LiveRosterItem(Jid("copy@example.org")));
+        QVERIFY(copy.find(Jid("copy@example.org"), false) == copy.begin());
+        QVERIFY(roster.find(Jid("copy@example.org"), false) == roster.end());
+        QVERIFY(roster.find(Jid("contact1@example.org"), false) == roster.begin());
+    }
+
+    void benchmarkPresenceFlood_data()
+    {
+        QTest::addColumn<bool>("indexed");
+        QTest::newRow("linear") << false;
+        QTest::newRow("indexed") << true;
+    }
+
+    void benchmarkPresenceFlood()
+    {
+        QFETCH(bool, indexed);
+        QList<Item>      roster = makeRoster(10000);
+        const QList<Jid> flood  = presenceFlood(10000);
+
+        QBENCHMARK
+        {
+            RosterIndex<Item> index;
+            for (const Jid &j : flood) {
+                auto match = [&j](const Item &i) { return i.jid().compare(j, false); };
+                int  pos   = indexed ? index.find(roster, j.bare(), match) : linearFind(roster, j);
+                if (pos != -1)
+                    ++roster[pos].presences;
+            }
+        }
+        QVERIFY(roster.first().presences > 0);
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(RosterIndexTest);
+#include "rosterindextest.moc"
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-core/parser.h"
+#include "xmpp/xmpp-core/stanzadocument.h"
+#include "xmpp/xmpp-core/xmpp_stanza.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+static const char *streamOpen = "<?xml version='1.0'?>"
+                                "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' "
+                                "from='example.com' id='abc' version='1.0'>";
+
+static const char *iqError = "<iq type='error' id='q1' from='example.com'><error type='cancel'>"
+                             "<feature-not-implemented xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/>"
+                             "<unsupported xmlns='urn:example:app' feature='x'><detail>why</detail></unsupported>"
+                             "</error></iq>";
+
+class StanzaErrorTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    // the application condition is kept after the document of the stanza is gone
+    void testAppSpecOutlivesStanza()
+    {
+        const int     documents = StanzaDocument::liveDocuments();
+        Stanza::Error err;
+        {
+            Parser p;
+            p.appendData(QByteArray(streamOpen) + iqError);
+            QList<Parser::Event> events;
+            for (Parser::Event e = p.readNext(); !e.isNull(); e = p.readNext())
+                events += e;
+            QCOMPARE(events.size(), 2);
+            QDomElement iq = events[1].element();
+            QVERIFY(err.fromXml(iq.firstChildElement("error"), "jabber:client"));
+            QCOMPARE(StanzaDocument::liveDocuments(), documents + 1);
+        }
+        QCOMPARE(StanzaDocument::liveDocuments(), documents);
+
+        QCOMPARE(err.condition, int(Stanza::Error::FeatureNotImplemented));
+        QCOMPARE(err.appSpec.tagName(), QString("unsupported"));
+        QCOMPARE(err.appSpec.namespaceURI(), QString("urn:example:app"));
+        QCOMPARE(err.appSpec.childNodes().count(), 1);
+        QCOMPARE(err.appSpec.firstChildElement("detail").text(), QString("why"));
+        QVERIFY(!err.appSpec.ownerDocument().isNull());
+
+        // and by copies of the error
+        Stanza::Error copy = err;
+        err                = Stanza::Error();
+        QCOMPARE(copy.appSpec.attribute("feature"), QString("x"));
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(StanzaErrorTest);
+#include "stanzaerrortest.moc"
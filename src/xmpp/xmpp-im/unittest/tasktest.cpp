@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/xmpp-im/xmpp_client.h"
+#include "xmpp/xmpp-im/xmpp_task.h"
+#include "xmpp/xmpp-im/xmpp_xmlcommon.h"
+
+#include <QDomDocument>
+#include <QObject>
+#include <QtTest/QtTest>
+
+using namespace XMPP;
+
+namespace {
+// sends one iq get and takes the reply from whom it was sent to
+class RequestTask : public Task {
+public:
+    Jid to;
+    int offered = 0;
+    int taken   = 0;
+
+    RequestTask(Task *parent, const Jid &to) : Task(parent), to(to) { }
+
+    void request() { send(createIQ(doc(), "get", to.full(), id())); }
+    void finish() { setSuccess(); }
+
+    bool take(const QDomElement &x) override
+    {
+        ++offered;
+        if (taken || !iqVerify(x, to, id()))
+            return false;
+        ++taken;
+        return true;
+    }
+};
+
+// takes the stanzas with the given id, or everything if there is none
+class ListenTask : public Task {
+public:
+    QString expect;
+    int     offered = 0;
+    int     taken   = 0;
+
+    ListenTask(Task *parent, const QString &expect = QString()) : Task(parent), expect(expect) { }
+
+    using Task::registerPushHandler;
+
+    bool take(const QDomElement &x) override
+    {
+        ++offered;
+        if (!expect.isEmpty() && x.attribute("id") != expect)
+            return false;
+        ++taken;
+        return true;
+    }
+};
+} // namespace
+
+class TaskTest : public QObject {
+    Q_OBJECT
+
+    QDomDocument doc;
+
+    QDomElement iq(const QString &type, const QString &from, const QString &id, const QString &ns = QString())
+    {
+        QDomElement e = doc.createElement("iq");
+        e.setAttribute("type", type);
+        e.setAttribute("from", from);
+        e.setAttribute("id", id);
+        if (!ns.isEmpty())
+            e.appendChild(doc.createElementNS(ns, "query"));
+        return e;
+    }
+
+private slots:
+    void testReplyToSender()
+    {
+        Client       client;
+        ListenTask * first = new ListenTask(client.rootTask(), "none");
+        RequestTask *a     = new RequestTask(client.rootTask(), Jid("a@example.org/r"));
+        RequestTask *b     = new RequestTask(client.rootTask(), Jid("b@example.org/r"));
+        a->request();
+        b->request();
+
+        QVERIFY(client.rootTask()->take(iq("result", "b@example.org/r", b->id())));
+        QCOMPARE(b->taken, 1);
+        QCOMPARE(a->offered, 0);
+        QCOMPARE(first->offered, 0);
+
+        QVERIFY(client.rootTask()->take(iq("error", "a@example.org/r", a->id())));
+        QCOMPARE(a->taken, 1);
+        QCOMPARE(first->offered, 0);
+    }
+
+    void testSpoofedReply()
+    {
+        Client       client;
+        ListenTask * first = new ListenTask(client.rootTask(), "none");
+        RequestTask *a     = new RequestTask(client.rootTask(), Jid("a@example.org/r"));
+        a->request();
+
+        // declined by the task, so the tree gets it too, and the request stays pending
+        QVERIFY(!client.rootTask()->take(iq("result", "mallory@example.org/r", a->id())));
+        QCOMPARE(a->taken, 0);
+        QCOMPARE(first->offered, 1);
+
+        QVERIFY(client.rootTask()->take(iq("result", "a@example.org/r", a->id())));
+        QCOMPARE(a->taken, 1);
+        QCOMPARE(first->offered, 1);
+    }
+
+    void testTaskDestroyed()
+    {
+        Client       client;
+        ListenTask * first = new ListenTask(client.rootTask(), "none");
+        RequestTask *a     = new RequestTask(client.rootTask(), Jid("a@example.org/r"));
+        a->request();
+        const QString id = a->id();
+        delete a;
+
+        QVERIFY(!client.rootTask()->take(iq("result", "a@example.org/r", id)));
+        QCOMPARE(first->offered, 1);
+    }
+
+    void testTaskFinished()
+    {
+        Client       client;
+        ListenTask * first = new ListenTask(client.rootTask(), "none");
+        RequestTask *a     = new RequestTask(client.rootTask(), Jid("a@example.org/r"));
+        a->request();
+        a->finish();
+
+        // not waited for any more, so it is only offered along the tree
+        QVERIFY(client.rootTask()->take(iq("result", "a@example.org/r", a->id())));
+        QCOMPARE(first->offered, 1);
+        QCOMPARE(a->taken, 1);
+    }
+
+    void testPushHandler()
+    {
+        Client      client;
+        ListenTask *first = new ListenTask(client.rootTask(), "none");
+        ListenTask *push  = new ListenTask(client.rootTask());
+        push->registerPushHandler(Stanza::IQ, "urn:example:push", "query");
+
+        QVERIFY(client.rootTask()->take(iq("set", "example.org", "p1", "urn:example:push")));
+        QCOMPARE(push->taken, 1);
+        QCOMPARE(first->offered, 0);
+
+        // another namespace or stanza kind goes through the tree
+        QVERIFY(client.rootTask()->take(iq("set", "example.org", "p2", "urn:example:other")));
+        QCOMPARE(first->offered, 1);
+        QDomElement message = doc.createElement("message");
+        message.appendChild(doc.createElementNS("urn:example:push", "query"));
+        QVERIFY(client.rootTask()->take(message));
+        QCOMPARE(first->offered, 2);
+        QCOMPARE(push->taken, 3);
+
+        delete push;
+        QVERIFY(!client.rootTask()->take(iq("set", "example.org", "p3", "urn:example:push")));
+        QCOMPARE(first->offered, 3);
+    }
+
+    void testFallbackToTree()
+    {
+        Client client;
+
+        // a task which sent through the client, so nothing knows about its request
+        ListenTask *listen = new ListenTask(client.rootTask(), "own1");
+        QVERIFY(client.rootTask()->take(iq("result", "example.org", "own1")));
+        QCOMPARE(listen->taken, 1);
+        QVERIFY(!client.rootTask()->take(iq("result", "example.org", "unknown")));
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(TaskTest);
+#include "tasktest.moc"
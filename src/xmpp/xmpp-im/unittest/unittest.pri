@@ -0,0 +1,16 @@
+INCLUDEPATH *= $$PWD/.. $$PWD/../../..
+DEPENDPATH *= $$PWD/..
+
+HEADERS += \
+    $$PWD/../rosterindex_p.h
+
+SOURCES += \
+    $$PWD/capsmanagertest.cpp \
+    $$PWD/capsregistrytest.cpp \
+    $$PWD/clientstreamtest.cpp \
+    $$PWD/discoitemtest.cpp \
+    $$PWD/featurestest.cpp \
+    $$PWD/messagetest.cpp \
+    $$PWD/rosterindextest.cpp \
+    $$PWD/stanzaerrortest.cpp \
+    $$PWD/tasktest.cpp
@@ -0,0 +1,10 @@
+include(../../modules.pri)
+include($$IRIS_XMPP_QA_UNITTEST_MODULE)
+# the caps registry, the tasks and the streams need most of the library, so the checker links all of it
+include(../../../../iris.pri)
+include(unittest.pri)
+
+QT += xml
+
+# FIXME
+include(../../../../../third-party/qca/qca.pri)
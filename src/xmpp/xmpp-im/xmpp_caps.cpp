@@ -32,10 +32,13 @@
 #include "xmpp_xmlcommon.h"
 
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDebug>
 #include <QDomElement>
 #include <QFile>
+#include <QSaveFile>
 #include <QTextCodec>
+#include <QtEndian>
 
 namespace XMPP {
 QDomElement CapsInfo::toXml(QDomDocument *doc) const
@@ -58,6 +61,191 @@ CapsInfo CapsInfo::fromXml(const QDomElement &caps)
 
 // -----------------------------------------------------------------------------
 
+/*
+ * Binary storage of the registry.
+ *
+ * The file is a header followed by records. A record is a big endian quint32
+ * size and a QDataStream of the node, the last seen time and the disco#info
+ * result as XML. New registrations are appended. The file is mapped and only
+ * the record headers are read, on the first lookup. A disco item is parsed
+ * when somebody asks for it. Expired records and the ones of a node stored
+ * twice are garbage; the file is rewritten once they outweigh the rest.
+ */
+class CapsRegistry::Store {
+public:
+    static const quint32 Magic      = 0x49435253; // "ICRS"
+    static const quint8  Version    = 1;
+    static const int     HeaderSize = 5;
+
+    struct Record {
+        qint64 offset; // of the payload in the map
+        int    size;
+    };
+
+    QString                fileName;
+    QFile                  file;
+    uchar *                map     = nullptr;
+    qint64                 mapped  = 0; // the file size when it was mapped
+    qint64                 size    = 0; // up to the end of the last whole record once indexed
+    bool                   indexed = false;
+    QHash<QString, Record> index;
+    QStringList            pending; // registered but not written yet
+    qint64                 garbage = 0;
+
+    ~Store() { close(); }
+
+    bool open()
+    {
+        close();
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        if (file.size() >= HeaderSize)
+            map = file.map(0, file.size());
+        if (!map || qFromBigEndian<quint32>(map) != Magic || map[4] != Version) {
+            close();
+            return false;
+        }
+        mapped = size = file.size();
+        return true;
+    }
+
+    void close()
+    {
+        if (map)
+            file.unmap(map);
+        map    = nullptr;
+        mapped = size = 0;
+        file.close();
+        index.clear();
+        indexed = false;
+        garbage = 0;
+    }
+
+    qint64 live() const { return size - HeaderSize - garbage; }
+
+    void ensureIndex()
+    {
+        if (indexed)
+            return;
+        indexed = true;
+        if (!map)
+            return;
+
+        // keep unseen info for last 3 month. adjust if required
+        const qint64 validTime = QDateTime::currentDateTimeUtc().addMonths(-3).toMSecsSinceEpoch();
+        QDataStream  in(QByteArray::fromRawData(reinterpret_cast<const char *>(map), int(size)));
+        in.setVersion(QDataStream::Qt_5_6);
+        qint64 pos = HeaderSize;
+        while (pos + 4 <= size) {
+            const qint64 len = qFromBigEndian<quint32>(map + pos);
+            if (pos + 4 + len > size)
+                break; // torn by a crash. cut off on the next write
+            QString node;
+            qint64  seen;
+            in.device()->seek(pos + 4);
+            in >> node >> seen;
+            const Record r { pos + 4, int(len) };
+            if (in.status() != QDataStream::Ok || node.isEmpty() || seen < validTime) {
+                in.resetStatus();
+                garbage += 4 + len;
+            } else {
+                auto it = index.find(node);
+                if (it == index.end()) {
+                    index.insert(node, r);
+                } else {
+                    garbage += 4 + it->size;
+                    *it = r;
+                }
+            }
+            pos += 4 + len;
+        }
+        garbage += size - pos;
+        size = pos;
+    }
+
+    CapsInfo decode(const Record &r) const
+    {
+        QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char *>(map + r.offset), r.size));
+        in.setVersion(QDataStream::Qt_5_6);
+        QString      node;
+        qint64       seen;
+        QByteArray   xml;
+        QDomDocument doc;
+        in >> node >> seen >> xml;
+        if (in.status() != QDataStream::Ok || !doc.setContent(xml, true))
+            return CapsInfo();
+        DiscoItem item = DiscoItem::fromDiscoInfoResult(doc.documentElement());
+        return CapsInfo(item, QDateTime::fromMSecsSinceEpoch(seen, Qt::UTC));
+    }
+
+    static QByteArray encode(const QString &node, const CapsInfo &info)
+    {
+        QDomDocument doc;
+        doc.appendChild(info.disco().toDiscoInfoResult(&doc));
+
+        QByteArray record(4, '\0');
+        {
+            QByteArray  payload;
+            QDataStream out(&payload, QIODevice::WriteOnly);
+            out.setVersion(QDataStream::Qt_5_6);
+            out << node << qint64(info.lastSeen().toMSecsSinceEpoch()) << doc.toByteArray(-1);
+            qToBigEndian<quint32>(quint32(payload.size()), reinterpret_cast<uchar *>(record.data()));
+            record += payload;
+        }
+        return record;
+    }
+
+    static QByteArray header()
+    {
+        QByteArray h(HeaderSize, '\0');
+        qToBigEndian<quint32>(Magic, reinterpret_cast<uchar *>(h.data()));
+        h[4] = char(Version);
+        return h;
+    }
+
+    // appends the pending registrations, and maps the file again to see them
+    bool append(const QHash<QString, CapsInfo> &decoded)
+    {
+        QFile out(fileName);
+        if (!out.open(QIODevice::ReadWrite))
+            return false;
+        if (out.size() != mapped && !open()) // written by somebody else since
+            return false;
+        ensureIndex();
+        if (out.size() > size && !out.resize(size)) // what is past the last whole record is torn
+            return false;
+        out.seek(size);
+        for (const QString &node : qAsConst(pending))
+            out.write(encode(node, decoded.value(node)));
+        out.close();
+        if (out.error() != QFileDevice::NoError)
+            return false;
+        pending.clear();
+        return open();
+    }
+
+    // writes all the live records to a new file
+    bool rewrite(const QHash<QString, CapsInfo> &decoded)
+    {
+        ensureIndex();
+        QByteArray data = header();
+        for (auto it = decoded.constBegin(); it != decoded.constEnd(); ++it)
+            data += encode(it.key(), it.value());
+        for (auto it = index.constBegin(); it != index.constEnd(); ++it) {
+            if (!decoded.contains(it.key()))
+                data.append(reinterpret_cast<const char *>(map + it->offset - 4), it->size + 4);
+        }
+        pending.clear();
+
+        close(); // some systems can't replace a mapped file
+        QSaveFile out(fileName);
+        if (!out.open(QIODevice::WriteOnly) || out.write(data) != data.size() || !out.commit())
+            return false;
+        return open();
+    }
+};
+
 /**
  * \class CapsRegistry
  * \brief A singleton class managing the capabilities of clients.
@@ -69,6 +257,8 @@ CapsRegistry *CapsRegistry::instance_ = nullptr;
  */
 CapsRegistry::CapsRegistry(QObject *parent) : QObject(parent) { }
 
+CapsRegistry::~CapsRegistry() { }
+
 CapsRegistry *CapsRegistry::instance()
 {
     if (!instance_) {
@@ -79,11 +269,40 @@ CapsRegistry *CapsRegistry::instance()
 
 void CapsRegistry::setInstance(CapsRegistry *instance) { instance_ = instance; }
 
+void CapsRegistry::setStorageFile(const QString &fileName)
+{
+    store_.reset();
+    if (!fileName.isEmpty()) {
+        store_.reset(new Store);
+        store_->fileName = fileName;
+    }
+}
+
+QString CapsRegistry::storageFile() const { return store_ ? store_->fileName : QString(); }
+
 /**
  * \brief Convert all capabilities info to XML.
+ * With a storage file only the new registrations are appended to it, and the
+ * file is compacted when it's mostly garbage.
  */
 void CapsRegistry::save()
 {
+    if (store_) {
+        bool ok;
+        if (!store_->map && !store_->open()) {
+            ok = store_->rewrite(capsInfo_); // missing or unusable
+        } else {
+            store_->ensureIndex();
+            if (store_->garbage > store_->live() && store_->garbage > 65536)
+                ok = store_->rewrite(capsInfo_);
+            else
+                ok = store_->pending.isEmpty() || store_->append(capsInfo_);
+        }
+        if (!ok)
+            qWarning() << "CapsRegistry: Cannot write" << store_->fileName;
+        return;
+    }
+
     // Generate XML
     QDomDocument doc;
     QDomElement  capabilities = doc.createElement("capabilities");
@@ -111,7 +330,21 @@ QByteArray CapsRegistry::loadData() { return QByteArray(); }
  */
 void CapsRegistry::load()
 {
-    QByteArray data = loadData();
+    if (store_) {
+        if (store_->open())
+            return; // the records are read on first use
+
+        // nothing stored yet. take over what the old storage has
+        loadXml(loadData());
+        if (!capsInfo_.isEmpty() && !store_->rewrite(capsInfo_))
+            qWarning() << "CapsRegistry: Cannot write" << store_->fileName;
+        return;
+    }
+    loadXml(loadData());
+}
+
+void CapsRegistry::loadXml(const QByteArray &data)
+{
     if (data.isEmpty()) {
         return;
     }
@@ -166,6 +399,8 @@ void CapsRegistry::registerCaps(const CapsSpec &spec, const DiscoItem &item)
     if (!isRegistered(dnode)) {
         CapsInfo info(item);
         capsInfo_[dnode] = info;
+        if (store_)
+            store_->pending += dnode;
         emit registered(spec);
     }
 }
@@ -173,11 +408,31 @@ void CapsRegistry::registerCaps(const CapsSpec &spec, const DiscoItem &item)
 /**
  * \brief Checks if capabilities have been registered.
  */
-bool CapsRegistry::isRegistered(const QString &spec) const { return capsInfo_.contains(spec); }
+bool CapsRegistry::isRegistered(const QString &spec) const
+{
+    if (capsInfo_.contains(spec))
+        return true;
+    if (!store_)
+        return false;
+    store_->ensureIndex();
+    return store_->index.contains(spec);
+}
 
 DiscoItem CapsRegistry::disco(const QString &spec) const
 {
-    CapsInfo ci = capsInfo_.value(spec);
+    auto it = capsInfo_.constFind(spec);
+    if (it != capsInfo_.constEnd())
+        return it->disco();
+    if (!store_)
+        return DiscoItem();
+
+    store_->ensureIndex();
+    auto r = store_->index.constFind(spec);
+    if (r == store_->index.constEnd())
+        return DiscoItem();
+    CapsInfo ci = store_->decode(*r);
+    if (ci.isValid())
+        capsInfo_.insert(spec, ci);
     return ci.disco();
 }
 
@@ -222,53 +477,46 @@ void CapsManager::setEnabled(bool b) { isEnabled_ = b; }
  * retrieve the information.
  *
  * @param jid The entity's JID
- * @param node The entity's caps node
- * @param ver The entity's caps version
- * @param ext The entity's caps extensions
+ * @param c The entity's caps
  */
 void CapsManager::updateCaps(const Jid &jid, const CapsSpec &c)
 {
     if (jid.compare(client_->jid(), false))
         return;
 
-    QString fullNode = c.flatten();
-    if (capsSpecs_[jid.full()] != c) {
-        // qDebug() << QString("caps.cpp: Updating caps for %1
-        // (node=%2,ver=%3,ext=%4)").arg(QString(jid.full()).replace('%',"%%")).arg(node).arg(ver).arg(ext);
-
-        // Unregister from all old caps node
-        capsJids_[capsSpecs_[jid.full()].flatten()].removeAll(jid.full());
-
-        if (c.isValid()) {
-            // Register with all new caps nodes
-            capsSpecs_[jid.full()] = c;
-            if (!capsJids_[fullNode].contains(jid.full())) {
-                capsJids_[fullNode].push_back(jid.full());
-            }
-
-            emit capsChanged(jid);
-
-            // Register new caps and check if we need to discover features
-            if (isEnabled()) {
-                if (!CapsRegistry::instance()->isRegistered(fullNode) && capsJids_[fullNode].count() == 1) {
-                    // qDebug() << QString("caps.cpp: Sending disco request to %1,
-                    // node=%2").arg(QString(jid.full()).replace('%',"%%")).arg(node + "#" + s.extensions());
-                    JT_DiscoInfo *disco = new JT_DiscoInfo(client_->rootTask());
-                    disco->setAllowCache(false);
-                    connect(disco, SIGNAL(finished()), SLOT(discoFinished()));
-                    disco->get(jid, fullNode);
-                    disco->go(true);
-                }
-            }
-        } else {
-            // Remove all caps specifications
-            qWarning() << QString("caps.cpp: Illegal caps info from %1: node=%2, ver=%3")
-                              .arg(QString(jid.full()).replace('%', "%%"), fullNode, c.version());
-            capsSpecs_.remove(jid.full());
+    const QString full = jid.full();
+    auto          it   = caps_.find(full);
+    if (it != caps_.end() && it->spec == c)
+        return; // every presence repeats the caps
+
+    if (!c.isValid()) {
+        // Remove all caps specifications
+        qWarning() << QString("caps.cpp: Illegal caps info from %1: node=%2, ver=%3")
+                          .arg(QString(full).replace('%', "%%"), c.node(), c.version());
+        if (it != caps_.end()) {
+            unregisterJid(full, it->node);
+            caps_.erase(it);
         }
-    } else {
-        // Add to the list of jids
-        capsJids_[fullNode].push_back(jid.full());
+        return;
+    }
+
+    // qDebug() << QString("caps.cpp: Updating caps for %1
+    // (node=%2,ver=%3,ext=%4)").arg(QString(jid.full()).replace('%',"%%")).arg(node).arg(ver).arg(ext);
+    if (it != caps_.end())
+        unregisterJid(full, it->node);
+    const QString node = c.flatten();
+    caps_.insert(full, { c, node });
+    capsJids_[node].insert(full);
+
+    emit capsChanged(jid);
+
+    // Register new caps and check if we need to discover features
+    if (isEnabled() && !CapsRegistry::instance()->isRegistered(node)) {
+        auto r = requests_.constFind(node);
+        if (r == requests_.constEnd())
+            requestDisco(node, c);
+        else if (r->jid.isEmpty())
+            requestDisco(node, r->spec); // the ones asked before failed. maybe this one knows
     }
 }
 
@@ -280,36 +528,99 @@ void CapsManager::updateCaps(const Jid &jid, const CapsSpec &c)
 void CapsManager::disableCaps(const Jid &jid)
 {
     // qDebug() << QString("caps.cpp: Disabling caps for %1.").arg(QString(jid.full()).replace('%',"%%"));
-    if (capsEnabled(jid)) {
-        QString node = capsSpecs_[jid.full()].flatten();
-        if (!node.isEmpty()) {
-            capsJids_[node].removeAll(jid.full());
-        }
-        capsSpecs_.remove(jid.full());
+    auto it = caps_.find(jid.full());
+    if (it != caps_.end()) {
+        unregisterJid(it.key(), it->node);
+        caps_.erase(it);
         emit capsChanged(jid);
     }
 }
 
+void CapsManager::unregisterJid(const QString &jid, const QString &node)
+{
+    auto it = capsJids_.find(node);
+    if (it == capsJids_.end())
+        return;
+    it->remove(jid);
+    if (it->isEmpty()) {
+        capsJids_.erase(it);
+        // nobody left to ask. an answer in flight is still good though
+        auto r = requests_.find(node);
+        if (r != requests_.end() && r->jid.isEmpty())
+            requests_.erase(r);
+    }
+}
+
+/**
+ * \brief Asks one of the jids advertising \a node for its disco#info.
+ * Each jid is asked once. After a few failed attempts the node is given up
+ * on until all the jids advertising it are gone.
+ */
+void CapsManager::requestDisco(const QString &node, const CapsSpec &spec)
+{
+    static const int MaxAttempts = 3;
+    static const int Timeout     = 20; // seconds
+
+    Request &r = requests_[node];
+    r.spec     = spec;
+    r.jid.clear();
+    auto jids = capsJids_.constFind(node);
+    if (r.attempts >= MaxAttempts || jids == capsJids_.constEnd())
+        return;
+    for (const QString &j : *jids) {
+        if (!r.tried.contains(j)) {
+            r.jid = j;
+            break;
+        }
+    }
+    if (r.jid.isEmpty())
+        return;
+    r.tried.insert(r.jid);
+    ++r.attempts;
+
+    // qDebug() << QString("caps.cpp: Sending disco request to %1,
+    // node=%2").arg(QString(r.jid).replace('%',"%%")).arg(node);
+    JT_DiscoInfo *disco = new JT_DiscoInfo(client_->rootTask());
+    disco->setAllowCache(false);
+    disco->setTimeout(Timeout);
+    connect(disco, SIGNAL(finished()), SLOT(discoFinished()));
+    disco->get(Jid(r.jid), node);
+    disco->go(true);
+}
+
 /**
  * \brief Called when a reply to disco#info request was received.
  * If the result was succesful, the resulting features are recorded in the
  * features database for the requested node, and all the affected jids are
- * put in the queue for update notification.
+ * put in the queue for update notification. Otherwise another jid with the
+ * same caps is asked.
  */
 void CapsManager::discoFinished()
 {
     JT_DiscoInfo *task = static_cast<JT_DiscoInfo *>(sender());
-    updateDisco(task->jid(), task->item());
+    auto          it   = requests_.find(task->node());
+    if (it == requests_.end() || it->jid != task->jid().full())
+        return; // not waited for any more
+
+    const CapsSpec spec = it->spec;
+    if (task->success() && task->item().capsHash(spec.hashAlgorithm()) == spec.version()) {
+        requests_.erase(it);
+        CapsRegistry::instance()->registerCaps(spec, task->item());
+    } else if (CapsRegistry::instance()->isRegistered(task->node())) {
+        requests_.erase(it);
+    } else {
+        requestDisco(task->node(), spec);
+    }
 }
 
 void CapsManager::updateDisco(const Jid &jid, const DiscoItem &item)
 {
-    CapsSpec cs = capsSpecs_.value(jid.full());
-    if (!cs.isValid()) {
+    auto it = caps_.constFind(jid.full());
+    if (it == caps_.constEnd()) {
         return;
     }
-    if (item.capsHash(cs.hashAlgorithm()) == cs.version()) {
-        CapsRegistry::instance()->registerCaps(cs, item);
+    if (item.capsHash(it->spec.hashAlgorithm()) == it->spec.version()) {
+        CapsRegistry::instance()->registerCaps(it->spec, item);
     }
 }
 
@@ -319,8 +630,12 @@ void CapsManager::updateDisco(const Jid &jid, const DiscoItem &item)
  */
 void CapsManager::capsRegistered(const CapsSpec &cs)
 {
+    const QString node = cs.flatten();
+    requests_.remove(node);
+
     // Notify affected jids.
-    for (const QString &s : qAsConst(capsJids_[cs.flatten()])) {
+    const QSet<QString> jids = capsJids_.value(node);
+    for (const QString &s : jids) {
         // qDebug() << QString("caps.cpp: Notifying %1.").arg(s.replace('%',"%%"));
         emit capsChanged(s);
     }
@@ -329,7 +644,7 @@ void CapsManager::capsRegistered(const CapsSpec &cs)
 /**
  * \brief Checks whether a given JID is broadcastingn its entity capabilities.
  */
-bool CapsManager::capsEnabled(const Jid &jid) const { return capsSpecs_.contains(jid.full()); }
+bool CapsManager::capsEnabled(const Jid &jid) const { return caps_.contains(jid.full()); }
 
 /**
  * \brief Requests the list of features of a given JID.
@@ -337,13 +652,12 @@ bool CapsManager::capsEnabled(const Jid &jid) const { return capsSpecs_.contains
 XMPP::DiscoItem CapsManager::disco(const Jid &jid) const
 {
     // qDebug() << "caps.cpp: Retrieving features of " << jid.full();
-    QStringList f;
-    if (!capsEnabled(jid)) {
+    auto it = caps_.constFind(jid.full());
+    if (it == caps_.constEnd()) {
         return DiscoItem();
     }
-    QString node = capsSpecs_[jid.full()].flatten();
     // qDebug() << QString("    %1").arg(CapsRegistry::instance()->features(s).list().join("\n"));
-    return CapsRegistry::instance()->disco(node);
+    return CapsRegistry::instance()->disco(it->node);
 }
 
 /**
@@ -357,11 +671,12 @@ XMPP::Features CapsManager::features(const Jid &jid) const { return disco(jid).f
  */
 QString CapsManager::clientName(const Jid &jid) const
 {
-    if (capsEnabled(jid)) {
-        CapsSpec cs = capsSpecs_[jid.full()];
-        QString  name;
+    auto it = caps_.constFind(jid.full());
+    if (it != caps_.constEnd()) {
+        const CapsSpec &cs = it->spec;
+        QString         name;
 
-        QString cs_str = cs.flatten();
+        const QString &cs_str = it->node;
         if (CapsRegistry::instance()->isRegistered(cs_str)) {
             DiscoItem disco = CapsRegistry::instance()->disco(cs_str);
             XData     si    = disco.registeredExtension(QLatin1String("urn:xmpp:dataforms:softwareinfo"));
@@ -405,12 +720,12 @@ QString CapsManager::clientName(const Jid &jid) const
  */
 QString CapsManager::clientVersion(const Jid &jid) const
 {
-    if (!capsEnabled(jid))
+    auto it = caps_.constFind(jid.full());
+    if (it == caps_.constEnd())
         return QString();
 
-    QString         version;
-    const CapsSpec &cs     = capsSpecs_[jid.full()];
-    QString         cs_str = cs.flatten();
+    QString        version;
+    const QString &cs_str = it->node;
     if (CapsRegistry::instance()->isRegistered(cs_str)) {
         XData form = CapsRegistry::instance()->disco(cs_str).registeredExtension("urn:xmpp:dataforms:softwareinfo");
         version    = form.getField("software_version").value().value(0);
@@ -425,8 +740,9 @@ QString CapsManager::clientVersion(const Jid &jid) const
 QString CapsManager::osVersion(const Jid &jid) const
 {
     QString os_str;
-    if (capsEnabled(jid)) {
-        QString cs_str = capsSpecs_[jid.full()].flatten();
+    auto    it = caps_.constFind(jid.full());
+    if (it != caps_.constEnd()) {
+        const QString &cs_str = it->node;
         if (CapsRegistry::instance()->isRegistered(cs_str)) {
             XData form = CapsRegistry::instance()->disco(cs_str).registeredExtension("urn:xmpp:dataforms:softwareinfo");
             os_str     = form.getField("os").value().value(0).trimmed();
@@ -440,5 +756,5 @@ QString CapsManager::osVersion(const Jid &jid) const
     return os_str;
 }
 
-CapsSpec CapsManager::capsSpec(const Jid &jid) const { return capsSpecs_.value(jid.full()); }
+CapsSpec CapsManager::capsSpec(const Jid &jid) const { return caps_.value(jid.full()).spec; }
 } // namespace XMPP
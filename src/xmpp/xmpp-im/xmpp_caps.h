@@ -23,7 +23,11 @@
 #include "xmpp_features.h"
 #include "xmpp_status.h"
 
+#include <QHash>
 #include <QPointer>
+#include <QSet>
+
+#include <memory>
 
 namespace XMPP {
 class CapsInfo {
@@ -49,10 +53,17 @@ class CapsRegistry : public QObject {
 
 public:
     CapsRegistry(QObject *parent = nullptr);
+    ~CapsRegistry();
 
     static CapsRegistry *instance();
     static void          setInstance(CapsRegistry *instance);
 
+    // Keeps the registry in a binary file instead of saveData()/loadData().
+    // Set it before load(). If the file is empty, whatever loadData() returns
+    // is imported into it.
+    void    setStorageFile(const QString &fileName);
+    QString storageFile() const;
+
     void      registerCaps(const CapsSpec &, const XMPP::DiscoItem &item);
     bool      isRegistered(const QString &) const;
     DiscoItem disco(const QString &) const;
@@ -69,8 +80,13 @@ protected:
     virtual QByteArray loadData();                       // to have permanent cache
 
 private:
-    static CapsRegistry *    instance_;
-    QHash<QString, CapsInfo> capsInfo_;
+    class Store;
+
+    static CapsRegistry *            instance_;
+    mutable QHash<QString, CapsInfo> capsInfo_; // new and decoded ones
+    std::unique_ptr<Store>           store_;
+
+    void loadXml(const QByteArray &data);
 };
 
 class CapsManager : public QObject {
@@ -107,10 +123,27 @@ protected slots:
     void capsRegistered(const CapsSpec &);
 
 private:
+    struct Entry {
+        CapsSpec spec;
+        QString  node; // spec.flatten()
+    };
+
+    // disco#info of a node. one at a time, however many jids advertise the node
+    struct Request {
+        CapsSpec      spec;
+        QString       jid; // asked now. empty if nobody is
+        QSet<QString> tried;
+        int           attempts = 0;
+    };
+
+    void unregisterJid(const QString &jid, const QString &node);
+    void requestDisco(const QString &node, const CapsSpec &spec);
+
     Client *                      client_;
     bool                          isEnabled_;
-    QMap<QString, CapsSpec>       capsSpecs_;
-    QMap<QString, QList<QString>> capsJids_;
+    QHash<QString, Entry>         caps_;     // full jid -> caps
+    QHash<QString, QSet<QString>> capsJids_; // node -> full jids
+    QHash<QString, Request>       requests_; // node -> disco#info
 };
 } // namespace XMPP
 
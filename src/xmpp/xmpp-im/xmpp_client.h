@@ -228,7 +228,13 @@ private slots:
 public:
     class GroupChat;
 
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
+
 private:
+    bool isXmlTapped() const;
+    void updateXmlTap();
     void cleanup();
     void distribute(const QDomElement &);
     void importRoster(const Roster &);
@@ -21,6 +21,9 @@
 
 #include <QtXml>
 
+#include <memory>
+#include <vector>
+
 using namespace XMPP;
 
 class XMPP::DiscoItemPrivate : public QSharedData {
@@ -35,22 +38,72 @@ public:
     Features              features;
     DiscoItem::Identities identities;
     QList<XData>          exts;
+
+    // caps hashes computed so far. an empty one if the item is ill-formed. cleared by the setters of the above
+    mutable QHash<int, QString> capsHashes;
+
+    template <typename Add> bool capsInput(Add add) const;
 };
 
+/*
+ * Calls add() with each part of the XEP-0115 verification string, in order.
+ * Returns false if the item is ill-formed.
+ */
+template <typename Add> bool DiscoItemPrivate::capsInput(Add add) const
+{
+    DiscoItem::Identities idents = identities;
+    std::sort(idents.begin(), idents.end());
+    for (const DiscoItem::Identity &id : idents)
+        add(id.category + QLatin1Char('/') + id.type + QLatin1Char('/') + id.lang + QLatin1Char('/') + id.name);
+
+    QStringList fl = features.list();
+    std::sort(fl.begin(), fl.end());
+    for (const QString &f : qAsConst(fl))
+        add(f);
+
+    QMap<QString, const XData *> forms;
+    for (const XData &xd : exts) {
+        if (xd.registrarType().isEmpty()) {
+            continue;
+        }
+        if (forms.contains(xd.registrarType())) {
+            return false;
+        }
+        forms.insert(xd.registrarType(), &xd);
+    }
+    for (auto fit = forms.constBegin(); fit != forms.constEnd(); ++fit) {
+        QMap<QString, QStringList> values;
+        for (const XData::Field &f : fit.value()->fields()) {
+            if (f.var() == QLatin1String("FORM_TYPE")) {
+                continue;
+            }
+            if (values.contains(f.var())) {
+                return false;
+            }
+            QStringList v = f.value();
+            if (v.isEmpty()) {
+                continue; // maybe it's media-element but xep-115 (1.5) and xep-232 (0.3) are not clear about that.
+            }
+            std::sort(v.begin(), v.end());
+            values[f.var()] = v;
+        }
+        add(fit.key());
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+            add(it.key());
+            for (const QString &v : it.value())
+                add(v);
+        }
+    }
+    return true;
+}
+
 DiscoItem::DiscoItem() : d(new DiscoItemPrivate) { }
 
-DiscoItem::DiscoItem(const DiscoItem &from) : d(new DiscoItemPrivate) { *this = from; }
+DiscoItem::DiscoItem(const DiscoItem &from) : d(from.d) { }
 
 DiscoItem &DiscoItem::operator=(const DiscoItem &from)
 {
-    d->jid        = from.d->jid;
-    d->name       = from.d->name;
-    d->node       = from.d->node;
-    d->action     = from.d->action;
-    d->features   = from.d->features;
-    d->identities = from.d->identities;
-    d->exts       = from.d->exts;
-
+    d = from.d;
     return *this;
 }
 
@@ -93,59 +146,52 @@ void DiscoItem::fromAgentItem(const AgentItem &ai)
     setFeatures(ai.features());
 }
 
+/**
+ * \brief XEP-0115 verification string hash of the item, base64 encoded.
+ * Empty if the item is ill-formed. The result is kept until the item changes.
+ */
 QString DiscoItem::capsHash(QCryptographicHash::Algorithm algo) const
 {
-    QStringList           prep;
-    DiscoItem::Identities idents = d->identities;
-    std::sort(idents.begin(), idents.end());
+    auto it = d->capsHashes.constFind(int(algo));
+    if (it != d->capsHashes.constEnd())
+        return *it;
+    return capsHashes({ algo }).value(0);
+}
 
-    for (const DiscoItem::Identity &id : idents) {
-        prep << QString("%1/%2/%3/%4").arg(id.category, id.type, id.lang, id.name);
+/**
+ * \brief Same as capsHash() for several algorithms at once.
+ * The verification string is built once and fed to all the hashes part by
+ * part, without joining it.
+ */
+QStringList DiscoItem::capsHashes(const QList<QCryptographicHash::Algorithm> &algos) const
+{
+    std::vector<std::unique_ptr<QCryptographicHash>> hashes;
+    for (auto algo : algos) {
+        if (!d->capsHashes.contains(int(algo)))
+            hashes.emplace_back(new QCryptographicHash(algo));
     }
 
-    QStringList fl = d->features.list();
-    std::sort(fl.begin(), fl.end());
-    prep += fl;
-
-    QMap<QString, XData> forms;
-    for (const XData &xd : d->exts) {
-        if (xd.registrarType().isEmpty()) {
-            continue;
-        }
-        if (forms.contains(xd.registrarType())) {
-            return QString(); // ill-formed
-        }
-        forms.insert(xd.registrarType(), xd);
-    }
-    const auto &xds = forms.values();
-    for (const XData &xd : xds) {
-        prep << xd.registrarType();
-        QMap<QString, QStringList> values;
-        for (const XData::Field &f : xd.fields()) {
-            if (f.var() == QLatin1String("FORM_TYPE")) {
+    if (!hashes.empty()) {
+        QByteArray part;
+        bool       wellFormed = d->capsInput([&](const QString &s) {
+            part = s.toUtf8();
+            part += '<';
+            for (auto &h : hashes)
+                h->addData(part);
+        });
+        for (int i = 0, n = 0; i < algos.size(); ++i) {
+            if (d->capsHashes.contains(int(algos[i])))
                 continue;
-            }
-            if (values.contains(f.var())) {
-                return QString(); // ill-formed
-            }
-            QStringList v = f.value();
-            if (v.isEmpty()) {
-                continue; // maybe it's media-element but xep-115 (1.5) and xep-232 (0.3) are not clear about that.
-            }
-            std::sort(v.begin(), v.end());
-            values[f.var()] = v;
-        }
-        QMap<QString, QStringList>::ConstIterator it = values.constBegin();
-        for (; it != values.constEnd(); ++it) {
-            prep += it.key();
-            prep += it.value();
+            // an algorithm asked twice got in with its first occurrence
+            auto &h = hashes[size_t(n++)];
+            d->capsHashes.insert(int(algos[i]), wellFormed ? QString::fromLatin1(h->result().toBase64()) : QString());
         }
     }
 
-    QByteArray ba = QString(prep.join(QLatin1String("<")) + QLatin1Char('<')).toUtf8();
-    // qDebug() << "Server caps ver: " << (prep.join(QLatin1String("<")) + QLatin1Char('<'))
-    //         << "Hash:" << QString::fromLatin1(QCryptographicHash::hash(ba, algo).toBase64());
-    return QString::fromLatin1(QCryptographicHash::hash(ba, algo).toBase64());
+    QStringList ret;
+    for (auto algo : algos)
+        ret += d->capsHashes.value(int(algo));
+    return ret;
 }
 
 DiscoItem DiscoItem::fromDiscoInfoResult(const QDomElement &q)
@@ -237,13 +283,18 @@ void DiscoItem::setAction(Action a) { d->action = a; }
 
 const Features &DiscoItem::features() const { return d->features; }
 
-void DiscoItem::setFeatures(const Features &f) { d->features = f; }
+void DiscoItem::setFeatures(const Features &f)
+{
+    d->features = f;
+    d->capsHashes.clear();
+}
 
 const DiscoItem::Identities &DiscoItem::identities() const { return d->identities; }
 
 void DiscoItem::setIdentities(const Identities &i)
 {
     d->identities = i;
+    d->capsHashes.clear();
 
     if (name().isEmpty() && i.count())
         setName(i.first().name);
@@ -261,7 +312,11 @@ XData DiscoItem::findExtension(XData::Type xdataType, const QString &formType) c
     return XData(XData::Data_Invalid);
 }
 
-void DiscoItem::setExtensions(const QList<XData> &extlist) { d->exts = extlist; }
+void DiscoItem::setExtensions(const QList<XData> &extlist)
+{
+    d->exts = extlist;
+    d->capsHashes.clear();
+}
 
 XData DiscoItem::registeredExtension(const QString &ns) const
 {
@@ -27,6 +27,7 @@
 
 #include <QCryptographicHash>
 #include <QString>
+#include <QStringList>
 
 namespace XMPP {
 class DiscoItemPrivate;
@@ -90,7 +91,8 @@ public:
     AgentItem toAgentItem() const;
     void      fromAgentItem(const AgentItem &);
 
-    QString capsHash(QCryptographicHash::Algorithm algo) const;
+    QString     capsHash(QCryptographicHash::Algorithm algo) const;
+    QStringList capsHashes(const QList<QCryptographicHash::Algorithm> &algos) const;
 
     static DiscoItem fromDiscoInfoResult(const QDomElement &x);
     QDomElement      toDiscoInfoResult(QDomDocument *doc) const;
@@ -19,16 +19,104 @@
 
 #include "xmpp_features.h"
 
-#include "jingle-ft.h"
-#include "jingle.h"
-
 #include <QCoreApplication>
+#include <QHash>
 #include <QMap>
 #include <QString>
 #include <QStringList>
 
+#include <algorithm>
+
 using namespace XMPP;
 
+#define FID_MULTICAST "http://jabber.org/protocol/address"
+#define FID_AHCOMMAND "http://jabber.org/protocol/commands"
+#define FID_REGISTER "jabber:iq:register"
+#define FID_SEARCH "jabber:iq:search"
+#define FID_GROUPCHAT "http://jabber.org/protocol/muc"
+#define FID_VOICE "http://www.google.com/xmpp/protocol/voice/v1"
+#define FID_GATEWAY "jabber:iq:gateway"
+#define FID_QUERYVERSION "jabber:iq:version"
+#define FID_DISCO "http://jabber.org/protocol/disco"
+#define FID_CHATSTATE "http://jabber.org/protocol/chatstates"
+#define FID_VCARD "vcard-temp"
+#define FID_MESSAGECARBONS "urn:xmpp:carbons:2"
+#define FID_JINGLEICEUDP "urn:xmpp:jingle:transports:ice-udp:1"
+#define FID_JINGLEICE "urn:xmpp:jingle:transports:ice:0"
+#define NS_CAPS "http://jabber.org/protocol/caps"
+#define NS_CAPS_OPTIMIZE "http://jabber.org/protocol/caps#optimize"
+#define NS_DIRECT_MUC_INVITE "jabber:x:conference"
+#define NS_HASH_NAMES "urn:xmpp:hash-function-text-names:"
+
+// NOTE: keep this in sync with Features::WellKnown. same order!
+static const char *const wellKnownNS[] = { FID_REGISTER,
+                                           FID_SEARCH,
+                                           FID_MULTICAST,
+                                           FID_GROUPCHAT,
+                                           FID_VOICE,
+                                           FID_DISCO,
+                                           FID_DISCO "#info",
+                                           FID_DISCO "#items",
+                                           FID_CHATSTATE,
+                                           FID_AHCOMMAND,
+                                           FID_GATEWAY,
+                                           FID_QUERYVERSION,
+                                           FID_VCARD,
+                                           FID_MESSAGECARBONS,
+                                           "urn:xmpp:receipts",
+                                           "urn:xmpp:chat-markers:0",
+                                           NS_CAPS,
+                                           NS_CAPS_OPTIMIZE,
+                                           NS_DIRECT_MUC_INVITE,
+                                           "urn:xmpp:jingle:apps:file-transfer:5",
+                                           FID_JINGLEICEUDP,
+                                           FID_JINGLEICE,
+                                           "urn:xmpp:jingle:transports:s5b:1",
+                                           "urn:xmpp:jingle:transports:ibb:1",
+                                           "urn:xmpp:jingle:apps:dtls:0",
+                                           "urn:ietf:rfc:5888",
+                                           NS_HASH_NAMES "sha-1",
+                                           NS_HASH_NAMES "sha-256",
+                                           NS_HASH_NAMES "sha-512",
+                                           NS_HASH_NAMES "sha3-256",
+                                           NS_HASH_NAMES "sha3-512",
+                                           NS_HASH_NAMES "blake2b-256",
+                                           NS_HASH_NAMES "blake2b-512" };
+static_assert(sizeof(wellKnownNS) / sizeof(wellKnownNS[0]) == Features::WK_Count,
+              "every well-known feature needs a namespace");
+
+static const QHash<QString, int> &wellKnownIndex()
+{
+    static const QHash<QString, int> index = []() {
+        QHash<QString, int> h;
+        h.reserve(Features::WK_Count);
+        for (int i = 0; i < Features::WK_Count; ++i)
+            h.insert(QLatin1String(wellKnownNS[i]), i);
+        return h;
+    }();
+    return index;
+}
+
+QString Features::wellKnown(WellKnown f)
+{
+    return f >= 0 && f < WK_Count ? QLatin1String(wellKnownNS[f]) : QString();
+}
+
+Features::WellKnown Features::wellKnown(const QString &ns) { return WellKnown(wellKnownIndex().value(ns, WK_Count)); }
+
+quint64 Features::knownBit(const QString &ns)
+{
+    auto f = wellKnown(ns);
+    return f == WK_Count ? 0 : quint64(1) << f;
+}
+
+void Features::updateKnown()
+{
+    _known = 0;
+    for (const QString &ns : qAsConst(_list))
+        _known |= knownBit(ns);
+}
+
 Features::Features() { }
 
 Features::Features(const QStringList &l) { setList(l); }
@@ -61,158 +149,65 @@ void Features::setList(const QStringList &l)
 #else
     _list   = QSet<QString>::fromList(l);
 #endif
+    updateKnown();
 }
 
-void Features::setList(const QSet<QString> &l) { _list = l; }
-
-void Features::addFeature(const QString &s) { _list += s; }
-
-bool Features::test(const QStringList &ns) const
+void Features::setList(const QSet<QString> &l)
 {
-#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-    auto ss = QSet<QString>(ns.begin(), ns.end());
-#else
-    auto ss = QSet<QString>::fromList(ns);
-#endif
-    return _list.contains(ss);
+    _list = l;
+    updateKnown();
 }
 
-bool Features::test(const QSet<QString> &ns) const { return _list.contains(ns); }
-
-bool Features::test(const QString &ns) const { return _list.contains(ns); }
-
-#define FID_MULTICAST "http://jabber.org/protocol/address"
-bool Features::hasMulticast() const
+void Features::addFeature(const QString &s)
 {
-    QSet<QString> ns;
-    ns << FID_MULTICAST;
-
-    return test(ns);
+    _list += s;
+    _known |= knownBit(s);
 }
 
-#define FID_AHCOMMAND "http://jabber.org/protocol/commands"
-bool Features::hasCommand() const
-{
-    QSet<QString> ns;
-    ns << FID_AHCOMMAND;
-
-    return test(ns);
-}
-
-#define FID_REGISTER "jabber:iq:register"
-bool Features::hasRegister() const
-{
-    QSet<QString> ns;
-    ns << FID_REGISTER;
-
-    return test(ns);
-}
-
-#define FID_SEARCH "jabber:iq:search"
-bool Features::hasSearch() const
-{
-    QSet<QString> ns;
-    ns << FID_SEARCH;
-
-    return test(ns);
-}
-
-#define FID_GROUPCHAT "http://jabber.org/protocol/muc"
-bool Features::hasGroupchat() const
+bool Features::test(const QStringList &ns) const
 {
-    QSet<QString> ns;
-    ns << FID_GROUPCHAT;
-
-    return test(ns);
+    return std::all_of(ns.begin(), ns.end(), [this](const QString &s) { return _list.contains(s); });
 }
 
-#define FID_VOICE "http://www.google.com/xmpp/protocol/voice/v1"
-bool Features::hasVoice() const
-{
-    QSet<QString> ns;
-    ns << FID_VOICE;
-
-    return test(ns);
-}
+bool Features::test(const QSet<QString> &ns) const { return _list.contains(ns); }
 
-#define FID_GATEWAY "jabber:iq:gateway"
-bool Features::hasGateway() const
-{
-    QSet<QString> ns;
-    ns << FID_GATEWAY;
+bool Features::test(const QString &ns) const { return _list.contains(ns); }
 
-    return test(ns);
-}
+bool Features::hasMulticast() const { return test(WK_Multicast); }
 
-#define FID_QUERYVERSION "jabber:iq:version"
-bool Features::hasVersion() const
-{
-    QSet<QString> ns;
-    ns << FID_QUERYVERSION;
+bool Features::hasCommand() const { return test(WK_Command); }
 
-    return test(ns);
-}
+bool Features::hasRegister() const { return test(WK_Register); }
 
-#define FID_DISCO "http://jabber.org/protocol/disco"
-bool Features::hasDisco() const
-{
-    QSet<QString> ns;
-    ns << FID_DISCO;
-    ns << "http://jabber.org/protocol/disco#info";
-    ns << "http://jabber.org/protocol/disco#items";
+bool Features::hasSearch() const { return test(WK_Search); }
 
-    return test(ns);
-}
+bool Features::hasGroupchat() const { return test(WK_Groupchat); }
 
-#define FID_CHATSTATE "http://jabber.org/protocol/chatstates"
-bool Features::hasChatState() const
-{
-    QSet<QString> ns;
-    ns << FID_CHATSTATE;
+bool Features::hasVoice() const { return test(WK_Voice); }
 
-    return test(ns);
-}
+bool Features::hasGateway() const { return test(WK_Gateway); }
 
-#define FID_VCARD "vcard-temp"
-bool Features::hasVCard() const
-{
-    QSet<QString> ns;
-    ns << FID_VCARD;
+bool Features::hasVersion() const { return test(WK_Version); }
 
-    return test(ns);
-}
+bool Features::hasDisco() const { return test(WK_Disco) && test(WK_DiscoInfo) && test(WK_DiscoItems); }
 
-#define FID_MESSAGECARBONS "urn:xmpp:carbons:2"
-bool Features::hasMessageCarbons() const
-{
-    QStringList ns;
-    ns << FID_MESSAGECARBONS;
+bool Features::hasChatState() const { return test(WK_ChatState); }
 
-    return test(ns);
-}
+bool Features::hasVCard() const { return test(WK_VCard); }
 
-bool Features::hasJingleFT() const
-{
-    QStringList ns;
-    ns << Jingle::FileTransfer::NS;
+bool Features::hasMessageCarbons() const { return test(WK_MessageCarbons); }
 
-    return test(ns);
-}
+bool Features::hasJingleFT() const { return test(WK_JingleFT); }
 
-#define FID_JINGLEICEUDP "urn:xmpp:jingle:transports:ice-udp:1"
-bool Features::hasJingleIceUdp() const { return test(QStringList() << QLatin1String(FID_JINGLEICEUDP)); }
+bool Features::hasJingleIceUdp() const { return test(WK_JingleIceUdp); }
 
-#define FID_JINGLEICE "urn:xmpp:jingle:transports:ice:0"
-bool Features::hasJingleIce() const { return test(QStringList() << QLatin1String(FID_JINGLEICE)); }
+bool Features::hasJingleIce() const { return test(WK_JingleIce); }
 
-#define NS_CAPS "http://jabber.org/protocol/caps"
-bool Features::hasCaps() const { return test(QStringList() << QLatin1String(NS_CAPS)); }
+bool Features::hasCaps() const { return test(WK_Caps); }
 
-#define NS_CAPS_OPTIMIZE "http://jabber.org/protocol/caps#optimize"
-bool Features::hasCapsOptimize() const { return test(QStringList() << QLatin1String(NS_CAPS_OPTIMIZE)); }
+bool Features::hasCapsOptimize() const { return test(WK_CapsOptimize); }
 
-#define NS_DIRECT_MUC_INVITE "jabber:x:conference"
-bool Features::hasDirectMucInvite() const { return test(QStringList() << QLatin1String(NS_DIRECT_MUC_INVITE)); }
+bool Features::hasDirectMucInvite() const { return test(WK_DirectMucInvite); }
 
 // custom Psi actions
 #define FID_ADD "psi:add"
@@ -282,7 +277,7 @@ long Features::id() const
         return FID_VCard;
     else if (hasCommand())
         return FID_AHCommand;
-    else if (test(QStringList(FID_ADD)))
+    else if (test(FID_ADD))
         return FID_Add;
     else if (hasVersion())
         return FID_QueryVersion;
@@ -306,7 +301,7 @@ QString Features::feature(long id)
 
 Features &Features::operator<<(const QString &feature)
 {
-    _list << feature;
+    addFeature(feature);
     return *this;
 }
 
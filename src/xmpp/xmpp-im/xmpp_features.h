@@ -89,7 +89,54 @@ public:
         FID_Add
     };
 
+    // namespaces with a fixed bit in every Features, so testing them is a single bit check.
+    // anything else is looked up in the list.
+    // NOTE: keep in sync with the namespaces in xmpp_features.cpp. same order!
+    enum WellKnown {
+        WK_Register,
+        WK_Search,
+        WK_Multicast,
+        WK_Groupchat,
+        WK_Voice,
+        WK_Disco,
+        WK_DiscoInfo,
+        WK_DiscoItems,
+        WK_ChatState,
+        WK_Command,
+        WK_Gateway,
+        WK_Version,
+        WK_VCard,
+        WK_MessageCarbons,
+        WK_Receipts,
+        WK_ChatMarkers,
+        WK_Caps,
+        WK_CapsOptimize,
+        WK_DirectMucInvite,
+        WK_JingleFT,
+        WK_JingleIceUdp,
+        WK_JingleIce,
+        WK_JingleS5B,
+        WK_JingleIBB,
+        WK_JingleDtls,
+        WK_JingleGrouping,
+        // same order as Hash::Type
+        WK_HashSha1,
+        WK_HashSha256,
+        WK_HashSha512,
+        WK_HashSha3_256,
+        WK_HashSha3_512,
+        WK_HashBlake2b256,
+        WK_HashBlake2b512,
+
+        WK_Count
+    };
+    static_assert(WK_Count <= 64, "well-known features have to fit the mask");
+
+    static QString   wellKnown(WellKnown f);
+    static WellKnown wellKnown(const QString &ns); // WK_Count if it's not well-known
+
     // useful functions
+    inline bool test(WellKnown f) const { return _known & (quint64(1) << f); }
     inline bool test(const char *ns) const { return test(QLatin1String(ns)); }
     bool        test(const QString &) const;
     bool        test(const QStringList &) const;
@@ -108,13 +155,18 @@ public:
     Features &  operator+=(const Features &other)
     {
         _list += other._list;
+        _known |= other._known;
         return *this;
     }
 
     class FeatureName;
 
 private:
+    static quint64 knownBit(const QString &ns);
+    void           updateKnown();
+
     QSet<QString> _list;
+    quint64       _known = 0; // bits of the well-known features in _list
 };
 } // namespace XMPP
 
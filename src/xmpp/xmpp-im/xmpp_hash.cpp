@@ -269,17 +269,14 @@ Hash Hash::from(const QStringRef &str)
 
 Hash Hash::fastestHash(const Features &features)
 {
-    std::array  qcaAlgos = { "blake2b_512", "blake2b_256", "sha1", "sha512", "sha256", "sha3_256", "sha3_512" };
-    std::array  qcaMap   = { Blake2b512, Blake2b256, Sha1, Sha512, Sha256, Sha3_256, Sha3_512 };
-    QStringList priorityFeatures;
-    priorityFeatures.reserve(int(qcaAlgos.size()));
-    for (auto t : qcaMap) {
-        priorityFeatures.append(QString(QLatin1String("urn:xmpp:hash-function-text-names:"))
-                                + QLatin1String(hashTypes[int(t)].text));
-        // REVIEW modify hashTypes with priority info instead?
-    }
+    std::array qcaAlgos = { "blake2b_512", "blake2b_256", "sha1", "sha512", "sha256", "sha3_256", "sha3_512" };
+    std::array qcaMap   = { Blake2b512, Blake2b256, Sha1, Sha512, Sha256, Sha3_256, Sha3_512 };
+    // REVIEW modify hashTypes with priority info instead?
+    static_assert(Features::WK_HashBlake2b512 - Features::WK_HashSha1 == Blake2b512 - Sha1,
+                  "well-known hash features and enum are not in sync");
     for (int i = 0; i < qcaAlgos.size(); i++) {
-        if (QCA::isSupported(qcaAlgos[i]) && features.test(priorityFeatures[i])) {
+        auto feature = Features::WellKnown(Features::WK_HashSha1 + int(qcaMap[i]) - int(Sha1));
+        if (features.test(feature) && QCA::isSupported(qcaAlgos[i])) {
             return Hash(qcaMap[i]);
         }
     }
@@ -186,7 +186,7 @@ qint64 IBBConnection::writeData(const char *data, qint64 maxSize)
         return 0;
     }
 
-    ByteStream::appendWrite(QByteArray::fromRawData(data, int(maxSize)));
+    ByteStream::appendWrite(QByteArray(data, int(maxSize)));
     trySend();
     return maxSize;
 }
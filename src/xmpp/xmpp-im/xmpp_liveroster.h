@@ -38,6 +38,15 @@ public:
     LiveRoster::Iterator      find(const Jid &, bool compareRes = true);
     LiveRoster::ConstIterator find(const Jid &, bool compareRes = true) const;
 
+    // all the items matching the jid, in list order
+    QList<LiveRoster::Iterator> findAll(const Jid &, bool compareRes = true);
+
+    // modifiers which keep the jid index up to date. an item found through the non-const find() or findAll()
+    //   may also be edited in place. the jid of an item changed through QList itself is not seen by find()
+    void     addItem(const LiveRosterItem &item);
+    void     setItem(Iterator it, const LiveRosterItem &item);
+    Iterator removeItem(Iterator it);
+
     void    setGroupsDelimiter(const QString &groupsDelimiter);
     QString groupsDelimiter() const;
 
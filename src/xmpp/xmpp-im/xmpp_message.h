@@ -30,6 +30,8 @@
 
 #include <QExplicitlySharedDataPointer>
 
+#include <functional>
+
 class QDateTime;
 class QString;
 
@@ -231,6 +233,11 @@ public:
     bool   fromStanza(const Stanza &s, int tzoffset);
     bool   fromStanza(const Stanza &s, bool useTimeZoneOffset, int timeZoneOffset);
 
+    // Application specific extensions
+    using ExtensionParser = std::function<void(Message &message, const QDomElement &element)>;
+    static void registerExtensionParser(const QString &ns, const QString &localName, const ExtensionParser &parser);
+    static void unregisterExtensionParser(const QString &ns, const QString &localName);
+
 private:
     class Private;
     QExplicitlySharedDataPointer<Private> d;
@@ -19,6 +19,7 @@
 #ifndef XMPP_PUBSUBITEM_H
 #define XMPP_PUBSUBITEM_H
 
+#include <QDomDocument>
 #include <QDomElement>
 #include <QString>
 
@@ -31,8 +32,9 @@ public:
     const QDomElement &payload() const;
 
 private:
-    QString     id_;
-    QDomElement payload_;
+    QString      id_;
+    QDomDocument doc_; // payload_ outlives the stanza it came with
+    QDomElement  payload_;
 };
 } // namespace XMPP
 
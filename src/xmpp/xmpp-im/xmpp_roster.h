@@ -40,6 +40,12 @@ public:
     Roster::Iterator      find(const Jid &);
     Roster::ConstIterator find(const Jid &) const;
 
+    // modifiers which keep the jid index up to date. an item found through the non-const find() may also be
+    //   edited in place. the jid of an item changed through QList itself is not seen by find()
+    void     addItem(const RosterItem &item);
+    void     setItem(Iterator it, const RosterItem &item);
+    Iterator removeItem(Iterator it);
+
     void    setGroupsDelimiter(const QString &groupsDelimiter);
     QString groupsDelimiter() const;
 
@@ -18,16 +18,84 @@
 
 #include "xmpp_task.h"
 
+#include "xmpp_atoms.h"
 #include "xmpp_client.h"
 #include "xmpp_stanza.h"
 #include "xmpp_xmlcommon.h"
 
+#include <QHash>
+#include <QPointer>
 #include <QTimer>
 
+#include <algorithm>
+#include <memory>
+
 #define DEFAULT_TIMEOUT 120
 
 using namespace XMPP;
 
+namespace {
+struct PushKey {
+    int     kind;
+    QString ns, element;
+
+    bool operator==(const PushKey &other) const
+    {
+        return kind == other.kind && element == other.element && ns == other.ns;
+    }
+};
+
+inline uint qHash(const PushKey &k, uint seed = 0)
+{
+    return ::qHash(k.element, seed) ^ ::qHash(k.ns, seed) ^ uint(k.kind);
+}
+
+// Index of the tasks of one client which wait for something specific, so the
+// root task can hand most stanzas over without asking every task in turn
+class TaskDispatch {
+public:
+    QMultiHash<QString, Task *>   pendingIq; // id of an iq request -> the task which sent it
+    QHash<PushKey, QList<Task *>> push;
+
+    bool take(const QDomElement &x)
+    {
+        Stanza::Kind kind = Stanza::kind(x.tagName());
+        if (kind == Stanza::IQ) {
+            const QString type = x.attribute(QStringLiteral("type"));
+            if (type == QLatin1String("result") || type == QLatin1String("error")) {
+                const QString id = x.attribute(QStringLiteral("id"));
+                for (Task *t : pendingIq.values(id)) {
+                    // take() may finish tasks or start new ones
+                    QPointer<Task> guard(t);
+                    if (guard && guard->take(x)) {
+                        pendingIq.remove(id, t);
+                        return true;
+                    }
+                }
+                return false;
+            }
+        }
+
+        if (push.isEmpty())
+            return false;
+        QDomElement child = x.firstChildElement();
+        if (child.isNull())
+            return false;
+        auto it = push.constFind(PushKey { kind, child.namespaceURI(), child.tagName() });
+        if (it == push.constEnd())
+            return false;
+        QList<QPointer<Task>> handlers;
+        for (Task *t : it.value())
+            handlers += t;
+        for (const auto &t : handlers) {
+            if (t && t->take(x))
+                return true;
+        }
+        return false;
+    }
+};
+} // namespace
+
 class Task::TaskPrivate {
 public:
     TaskPrivate() = default;
@@ -43,14 +111,20 @@ public:
     bool                autoDelete = false;
     bool                done       = false;
     int                 timeout    = 0;
+
+    bool                          isRoot = false;
+    std::shared_ptr<TaskDispatch> dispatch; // shared by all the tasks of the client
+    QStringList                   pendingIds;
+    QList<PushKey>                pushKeys;
 };
 
 Task::Task(Task *parent) : QObject(parent)
 {
     init();
 
-    d->client = parent->client();
-    d->id     = client()->genUniqueId();
+    d->client   = parent->client();
+    d->id       = client()->genUniqueId();
+    d->dispatch = parent->d->dispatch;
     connect(d->client, SIGNAL(disconnected()), SLOT(clientDisconnected()));
 }
 
@@ -58,11 +132,25 @@ Task::Task(Client *parent, bool) : QObject(nullptr)
 {
     init();
 
-    d->client = parent;
+    d->client   = parent;
+    d->isRoot   = true;
+    d->dispatch = std::make_shared<TaskDispatch>();
     connect(d->client, SIGNAL(disconnected()), SLOT(clientDisconnected()));
 }
 
-Task::~Task() { delete d; }
+Task::~Task()
+{
+    forgetRequests();
+    for (const PushKey &key : qAsConst(d->pushKeys)) {
+        auto it = d->dispatch->push.find(key);
+        if (it != d->dispatch->push.end()) {
+            it->removeAll(this);
+            if (it->isEmpty())
+                d->dispatch->push.erase(it);
+        }
+    }
+    delete d;
+}
 
 void Task::init()
 {
@@ -114,17 +202,27 @@ void Task::go(bool autoDelete)
 
 bool Task::take(const QDomElement &x)
 {
+    // replies to our requests and registered pushes go straight to their task
+    if (d->isRoot && d->dispatch->take(x))
+        return true;
+
     const QObjectList p = children();
 
     // pass along the xml
-    Task *t;
     for (QObject *obj : p) {
-        if (!obj->inherits("XMPP::Task"))
+        Task *t = qobject_cast<Task *>(obj);
+        if (!t)
             continue;
 
-        t = static_cast<Task *>(obj);
-        if (t->take(x)) // don't check for done here. it will hurt server tasks
+        QPointer<Task> guard(t);
+        if (t->take(x)) { // don't check for done here. it will hurt server tasks
+            if (guard && Atom::is(x.tagName(), Atom::Iq)) {
+                const QString type = x.attribute(QStringLiteral("type"));
+                if (type == QLatin1String("result") || type == QLatin1String("error"))
+                    guard->forgetRequests(x.attribute(QStringLiteral("id")));
+            }
             return true;
+        }
     }
 
     return false;
@@ -166,7 +264,50 @@ void Task::onTimeout()
     }
 }
 
-void Task::send(const QDomElement &x) { client()->send(x); }
+void Task::send(const QDomElement &x)
+{
+    // remember our requests, so the reply can be passed to us directly
+    if (Atom::is(x.tagName(), Atom::Iq)) {
+        const QString type = x.attribute(QStringLiteral("type"));
+        const QString id   = x.attribute(QStringLiteral("id"));
+        if (!id.isEmpty() && (type == QLatin1String("get") || type == QLatin1String("set"))) {
+            if (!d->dispatch->pendingIq.contains(id, this))
+                d->dispatch->pendingIq.insert(id, this);
+            if (!d->pendingIds.contains(id)) {
+                // forget the requests which got their reply already
+                if (d->pendingIds.size() >= 16) {
+                    auto dispatch = d->dispatch;
+                    d->pendingIds.erase(std::remove_if(d->pendingIds.begin(), d->pendingIds.end(),
+                                                       [&](const QString &pending) {
+                                                           return !dispatch->pendingIq.contains(pending, this);
+                                                       }),
+                                        d->pendingIds.end());
+                }
+                d->pendingIds += id;
+            }
+        }
+    }
+    client()->send(x);
+}
+
+void Task::forgetRequests(const QString &id)
+{
+    for (int i = d->pendingIds.size() - 1; i >= 0; --i) {
+        if (id.isEmpty() || d->pendingIds.at(i) == id) {
+            d->dispatch->pendingIq.remove(d->pendingIds.at(i), this);
+            d->pendingIds.removeAt(i);
+        }
+    }
+}
+
+void Task::registerPushHandler(Stanza::Kind kind, const QString &ns, const QString &element)
+{
+    PushKey key { kind, ns, element };
+    if (d->pushKeys.contains(key))
+        return;
+    d->pushKeys += key;
+    d->dispatch->push[key] += this;
+}
 
 void Task::setSuccess(int code, const QString &str)
 {
@@ -211,6 +352,7 @@ void Task::done()
     if (d->done || d->insig)
         return;
     d->done = true;
+    forgetRequests();
 
     if (d->autoDelete)
         d->deleteme = true;
@@ -258,7 +400,7 @@ void Task::debug(const QString &str) { client()->debug(QString("%1: ").arg(metaO
 
 bool Task::iqVerify(const QDomElement &x, const Jid &to, const QString &id, const QString &xmlns)
 {
-    if (x.tagName() != QStringLiteral("iq"))
+    if (!Atom::is(x.tagName(), Atom::Iq))
         return false;
 
     Jid from(x.attribute(QStringLiteral("from")));
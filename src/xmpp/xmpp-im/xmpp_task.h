@@ -73,6 +73,10 @@ protected:
     bool         iqVerify(const QDomElement &x, const Jid &to, const QString &id, const QString &xmlns = "");
     QString      encryptionProtocol(const QDomElement &) const;
 
+    // Stanzas of this kind whose first child element has the given namespace
+    // and name are offered to take() right away, before the other tasks
+    void registerPushHandler(Stanza::Kind kind, const QString &ns, const QString &element);
+
 private slots:
     void clientDisconnected();
     void timeoutFinished();
@@ -80,6 +84,7 @@ private slots:
 
 private:
     void init();
+    void forgetRequests(const QString &id = QString()); // all of them without an id
 
     class TaskPrivate;
     TaskPrivate *d;
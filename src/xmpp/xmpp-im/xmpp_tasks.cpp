@@ -82,7 +82,7 @@ static Roster xmlReadRoster(const QDomElement &q, bool push)
             if (push)
                 item.setIsPush(true);
 
-            r += item;
+            r.addItem(item);
         }
     }
 
@@ -525,7 +525,10 @@ bool JT_Roster::take(const QDomElement &x)
 //----------------------------------------------------------------------------
 // JT_PushRoster
 //----------------------------------------------------------------------------
-JT_PushRoster::JT_PushRoster(Task *parent) : Task(parent) { }
+JT_PushRoster::JT_PushRoster(Task *parent) : Task(parent)
+{
+    registerPushHandler(Stanza::IQ, QStringLiteral("jabber:iq:roster"), QStringLiteral("query"));
+}
 
 JT_PushRoster::~JT_PushRoster() { }
 
@@ -1295,7 +1298,12 @@ int JT_EntityTime::timezoneOffset() const { return tzo; }
 //----------------------------------------------------------------------------
 // JT_ServInfo
 //----------------------------------------------------------------------------
-JT_ServInfo::JT_ServInfo(Task *parent) : Task(parent) { }
+JT_ServInfo::JT_ServInfo(Task *parent) : Task(parent)
+{
+    registerPushHandler(Stanza::IQ, QStringLiteral("jabber:iq:version"), QStringLiteral("query"));
+    registerPushHandler(Stanza::IQ, QStringLiteral("http://jabber.org/protocol/disco#info"), QStringLiteral("query"));
+    registerPushHandler(Stanza::IQ, QStringLiteral("urn:xmpp:time"), QStringLiteral("time"));
+}
 
 JT_ServInfo::~JT_ServInfo() { }
 
@@ -1696,7 +1704,10 @@ BoBData &JT_BitsOfBinary::data() { return d->data; }
  * \brief Answers XMPP Pings
  */
 
-JT_PongServer::JT_PongServer(Task *parent) : Task(parent) { }
+JT_PongServer::JT_PongServer(Task *parent) : Task(parent)
+{
+    registerPushHandler(Stanza::IQ, QStringLiteral("urn:xmpp:ping"), QStringLiteral("ping"));
+}
 
 bool JT_PongServer::take(const QDomElement &e)
 {
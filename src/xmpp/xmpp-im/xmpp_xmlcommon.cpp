@@ -159,6 +159,25 @@ XDomNodeList childElementsByTagNameNS(const QDomElement &e, const QString &nsURI
     return out;
 }
 
+/**
+ * \overload
+ *
+ * Same as above for well-known names. Received elements share their names
+ * with the atom table, so this mostly compares pointers.
+ */
+XDomNodeList childElementsByTagNameNS(const QDomElement &e, XMPP::Atom::Id nsURI, XMPP::Atom::Id localName)
+{
+    XDomNodeList out;
+    for (QDomNode n = e.firstChild(); !n.isNull(); n = n.nextSibling()) {
+        if (!n.isElement())
+            continue;
+        QDomElement i = n.toElement();
+        if (XMPP::Atom::is(i.localName(), localName) && XMPP::Atom::is(i.namespaceURI(), nsURI))
+            out.append(i);
+    }
+    return out;
+}
+
 /**
  * \brief create a new IQ stanza
  * \param doc
@@ -224,6 +243,12 @@ void getErrorFromElement(const QDomElement &e, const QString &baseNS, int *code,
 }
 
 QDomElement addCorrectNS(const QDomElement &e)
+{
+    QDomDocument doc = e.ownerDocument();
+    return addCorrectNS(e, doc);
+}
+
+QDomElement addCorrectNS(const QDomElement &e, QDomDocument &doc)
 {
     int x;
 
@@ -250,7 +275,7 @@ QDomElement addCorrectNS(const QDomElement &e)
     }
     // at this point `ns` is either detected namespace of `e` or jabber:client
     // make a new node
-    QDomElement i = e.ownerDocument().createElementNS(ns, e.tagName());
+    QDomElement i = doc.createElementNS(ns, e.tagName());
 
     // copy attributes
     QDomNamedNodeMap al = e.attributes();
@@ -265,7 +290,7 @@ QDomElement addCorrectNS(const QDomElement &e)
     for (x = 0; x < nl.count(); ++x) {
         QDomNode n = nl.item(x);
         if (n.isElement())
-            i.appendChild(addCorrectNS(n.toElement()));
+            i.appendChild(addCorrectNS(n.toElement(), doc));
         else
             i.appendChild(n.cloneNode());
     }
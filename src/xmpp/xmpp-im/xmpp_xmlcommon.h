@@ -20,6 +20,8 @@
 #ifndef XMPP_XMLCOMMON_H
 #define XMPP_XMLCOMMON_H
 
+#include "xmpp_atoms.h"
+
 #include <qdom.h>
 #include <qlist.h>
 
@@ -61,11 +63,13 @@ QDomElement  textTag(QDomDocument *doc, const QString &name, const QString &cont
 QDomElement  textTagNS(QDomDocument *doc, const QString &ns, const QString &name, const QString &content);
 QString      tagContent(const QDomElement &e);
 XDomNodeList childElementsByTagNameNS(const QDomElement &e, const QString &nsURI, const QString &localName);
+XDomNodeList childElementsByTagNameNS(const QDomElement &e, XMPP::Atom::Id nsURI, XMPP::Atom::Id localName);
 QDomElement  createIQ(QDomDocument *doc, const QString &type, const QString &to, const QString &id);
 QDomElement  queryTag(const QDomElement &e);
 QString      queryNS(const QDomElement &e);
 void         getErrorFromElement(const QDomElement &e, const QString &baseNS, int *code, QString *str);
 QDomElement  addCorrectNS(const QDomElement &e);
+QDomElement  addCorrectNS(const QDomElement &e, QDomDocument &doc); // the copy is made in doc
 
 namespace XMLHelper {
 
@@ -33,10 +33,13 @@ HEADERS += \
     $$PWD/xmpp-core/protocol.h \
     $$PWD/xmpp-core/securestream.h \
     $$PWD/xmpp-core/sm.h \
+    $$PWD/xmpp-core/stanzadocument.h \
+    $$PWD/xmpp-core/stanzatree.h \
     $$PWD/xmpp-core/td.h \
     $$PWD/xmpp-core/xmlprotocol.h \
     $$PWD/xmpp-core/xmpp_clientstream.h \
     $$PWD/xmpp-core/xmpp.h \
+    $$PWD/xmpp-core/xmpp_atoms.h \
     $$PWD/xmpp-core/xmpp_stanza.h \
     $$PWD/xmpp-core/xmpp_stream.h \
     $$PWD/xmpp-im/filetransfer.h \
@@ -51,6 +54,7 @@ HEADERS += \
     $$PWD/xmpp-im/jingle-ft.h \
     $$PWD/xmpp-im/jingle-ibb.h \
     $$PWD/xmpp-im/jingle-s5b.h \
+    $$PWD/xmpp-im/rosterindex_p.h \
     $$PWD/xmpp-im/s5b.h \
     $$PWD/xmpp-im/xmpp_address.h \
     $$PWD/xmpp-im/xmpp_agentitem.h \
@@ -99,6 +103,9 @@ SOURCES += \
     $$PWD/xmpp-core/xmlprotocol.cpp \
     $$PWD/xmpp-core/protocol.cpp \
     $$PWD/xmpp-core/sm.cpp \
+    $$PWD/xmpp-core/stanzadocument.cpp \
+    $$PWD/xmpp-core/stanzatree.cpp \
+    $$PWD/xmpp-core/xmpp_atoms.cpp \
     $$PWD/xmpp-core/compressionhandler.cpp \
     $$PWD/xmpp-core/stream.cpp \
     $$PWD/xmpp-core/simplesasl.cpp \
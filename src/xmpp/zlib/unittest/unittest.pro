@@ -0,0 +1,6 @@
+include(../../modules.pri)
+include($$IRIS_XMPP_QA_UNITTEST_MODULE)
+include($$IRIS_XMPP_ZLIB_MODULE)
+include(unittest.pri)
+
+LIBS += -lz
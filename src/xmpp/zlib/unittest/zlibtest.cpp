@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026  Iris Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qttestutil/qttestutil.h"
+#include "xmpp/zlib/zlibcompressor.h"
+#include "xmpp/zlib/zlibdecompressor.h"
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+// Stanzas of a typical client session: roster push, presence flood,
+// chat with receipts and chat states, pings and disco.
+static QList<QByteArray> sessionTraffic(int count)
+{
+    QList<QByteArray> stanzas;
+    for (int n = 0; n < count; ++n) {
+        QByteArray id   = QByteArray::number(n);
+        QByteArray peer = "contact" + QByteArray::number(n % 97) + "@example.org";
+        switch (n % 6) {
+        case 0:
+            stanzas += "<presence from='" + peer + "/phone' to='user@example.com/home' xml:lang='en'><show>away</show>"
+                "<status>Be right back</status><priority>5</priority><c xmlns='http://jabber.org/protocol/caps' "
+                "hash='sha-1' node='https://psi-plus.com' ver='7yXlA4DjT1D8x8cVYJ9fMqdCg5g='/></presence>";
+            break;
+        case 1:
+            stanzas += "<message type='chat' to='" + peer + "' id='m" + id + "'><body>Message number " + id
+                + " in this conversation</body><active xmlns='http://jabber.org/protocol/chatstates'/>"
+                  "<request xmlns='urn:xmpp:receipts'/></message>";
+            break;
+        case 2:
+            stanzas += "<message from='" + peer + "/phone' to='user@example.com/home' id='r" + id
+                + "'><received xmlns='urn:xmpp:receipts' id='m" + id + "'/></message>";
+            break;
+        case 3:
+            stanzas += "<iq type='get' to='example.com' id='ping" + id + "'><ping xmlns='urn:xmpp:ping'/></iq>";
+            break;
+        case 4:
+            stanzas += "<iq type='set' id='push" + id + "'><query xmlns='jabber:iq:roster' ver='ver" + id
+                + "'><item jid='" + peer + "' name='Contact " + id
+                + "' subscription='both'><group>Friends</group></item></query></iq>";
+            break;
+        default:
+            stanzas += "<iq type='get' to='" + peer + "/phone' id='disco" + id
+                + "'><query xmlns='http://jabber.org/protocol/disco#info' "
+                  "node='https://psi-plus.com#7yXlA4DjT1D8x8cVYJ9fMqdCg5g='/></iq>";
+            break;
+        }
+    }
+    return stanzas;
+}
+
+class ZLibTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testRoundTrip_data()
+    {
+        QTest::addColumn<int>("level");
+        QTest::addColumn<int>("windowBits");
+        QTest::addColumn<int>("memLevel");
+        QTest::newRow("default") << int(Z_DEFAULT_COMPRESSION) << int(MAX_WBITS) << 8;
+        QTest::newRow("small") << 6 << 9 << 1;
+        QTest::newRow("stored") << 0 << int(MAX_WBITS) << 8;
+    }
+
+    void testRoundTrip()
+    {
+        QFETCH(int, level);
+        QFETCH(int, windowBits);
+        QFETCH(int, memLevel);
+
+        ZLibOptions options;
+        options.level      = level;
+        options.windowBits = windowBits;
+        options.memLevel   = memLevel;
+        ZLibCompressor   compressor(options);
+        ZLibDecompressor decompressor;
+
+        // every write must be decodable on its own thanks to the sync flush
+        for (const QByteArray &stanza : sessionTraffic(200)) {
+            QByteArray compressed, plain;
+            QCOMPARE(compressor.write(stanza, &compressed), 0);
+            QVERIFY(!compressed.isEmpty());
+            QCOMPARE(int(decompressor.write(compressed, &plain)), 0);
+            QCOMPARE(plain, stanza);
+        }
+    }
+
+    void testAppend()
+    {
+        ZLibCompressor   compressor;
+        ZLibDecompressor decompressor;
+
+        QByteArray big(256 * 1024, 'x');
+        for (int n = 0; n < big.size(); n += 7)
+            big[n] = char('a' + n % 26);
+
+        QByteArray compressed("prefix"), plain("prefix");
+        QCOMPARE(compressor.write(big, &compressed), 0);
+        QVERIFY(compressed.startsWith("prefix"));
+        QCOMPARE(int(decompressor.write(compressed.mid(6), &plain)), 0);
+        QCOMPARE(plain, QByteArray("prefix") + big);
+    }
+
+    void testCorruptInput()
+    {
+        ZLibDecompressor decompressor;
+        QByteArray       plain;
+        QVERIFY(decompressor.write("this is not a zlib stream", &plain) != 0);
+    }
+
+    void testInvalidOptions()
+    {
+        ZLibOptions options;
+        options.level = 42;
+        ZLibCompressor compressor(options);
+        QByteArray     out;
+        QCOMPARE(compressor.write("<presence/>", &out), int(Z_STREAM_ERROR));
+    }
+
+    // Compression throughput over a synthesized client session, flushing
+    // after every stanza or once per batch of stanzas.
+    void benchmarkCompress_data()
+    {
+        QTest::addColumn<int>("level");
+        QTest::addColumn<int>("windowBits");
+        QTest::addColumn<int>("memLevel");
+        QTest::addColumn<int>("batch");
+        QTest::newRow("default, per stanza") << int(Z_DEFAULT_COMPRESSION) << int(MAX_WBITS) << 8 << 1;
+        QTest::newRow("default, batch 16") << int(Z_DEFAULT_COMPRESSION) << int(MAX_WBITS) << 8 << 16;
+        QTest::newRow("fast, per stanza") << 1 << int(MAX_WBITS) << 8 << 1;
+        QTest::newRow("small, per stanza") << int(Z_DEFAULT_COMPRESSION) << 12 << 5 << 1;
+        QTest::newRow("small, batch 16") << int(Z_DEFAULT_COMPRESSION) << 12 << 5 << 16;
+    }
+
+    void benchmarkCompress()
+    {
+        QFETCH(int, level);
+        QFETCH(int, windowBits);
+        QFETCH(int, memLevel);
+        QFETCH(int, batch);
+
+        QList<QByteArray> batches;
+        QByteArray        current;
+        int               plainSize = 0;
+        const auto        traffic   = sessionTraffic(6000);
+        for (int n = 0; n < traffic.size(); ++n) {
+            current += traffic[n];
+            if ((n + 1) % batch == 0 || n + 1 == traffic.size()) {
+                plainSize += current.size();
+                batches += current;
+                current.clear();
+            }
+        }
+
+        ZLibOptions options;
+        options.level      = level;
+        options.windowBits = windowBits;
+        options.memLevel   = memLevel;
+        qint64 compressedSize = 0;
+        QBENCHMARK
+        {
+            ZLibCompressor compressor(options);
+            compressedSize = 0;
+            for (const QByteArray &b : batches) {
+                QByteArray out;
+                compressor.write(b, &out);
+                compressedSize += out.size();
+            }
+        }
+        qDebug("%d bytes -> %lld bytes", plainSize, compressedSize);
+    }
+
+    void benchmarkDecompress()
+    {
+        ZLibCompressor    compressor;
+        QList<QByteArray> compressed;
+        for (const QByteArray &stanza : sessionTraffic(6000)) {
+            QByteArray out;
+            compressor.write(stanza, &out);
+            compressed += out;
+        }
+
+        QBENCHMARK
+        {
+            ZLibDecompressor decompressor;
+            QByteArray       plain;
+            for (const QByteArray &c : compressed) {
+                decompressor.write(c, &plain);
+                plain.resize(0);
+            }
+        }
+    }
+};
+
+QTTESTUTIL_REGISTER_TEST(ZLibTest);
+#include "zlibtest.moc"
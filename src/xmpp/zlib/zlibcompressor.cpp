@@ -3,86 +3,52 @@
 #include "common.h"
 #include "zlib.h"
 
-#include <QIODevice>
-#include <QObject>
 #include <QtDebug>
 
-ZLibCompressor::ZLibCompressor(QIODevice *device, int compression) : device_(device)
+ZLibCompressor::ZLibCompressor(const ZLibOptions &options)
 {
-    zlib_stream_ = (z_stream *)malloc(sizeof(z_stream));
-    initZStream(zlib_stream_);
-    int result = deflateInit(zlib_stream_, compression);
-    Q_ASSERT(result == Z_OK);
-    Q_UNUSED(result);
-    connect(device, SIGNAL(aboutToClose()), this, SLOT(flush()));
-    flushed_ = false;
+    initZStream(&zlib_stream_);
+    int result = deflateInit2(&zlib_stream_, options.level, Z_DEFLATED, options.windowBits, options.memLevel,
+                              Z_DEFAULT_STRATEGY);
+    valid_     = (result == Z_OK);
+    if (!valid_)
+        qWarning() << QString("compressor.cpp: deflateInit2 failed (%1)").arg(result);
 }
 
 ZLibCompressor::~ZLibCompressor()
 {
-    flush();
-    free(zlib_stream_);
+    if (valid_)
+        deflateEnd(&zlib_stream_);
 }
 
-void ZLibCompressor::flush()
+int ZLibCompressor::write(const QByteArray &input, QByteArray *output)
 {
-    if (flushed_)
-        return;
+    if (!valid_)
+        return Z_STREAM_ERROR;
 
-    // Flush
-    write(QByteArray(), true);
-    int result = deflateEnd(zlib_stream_);
-    if (result != Z_OK)
-        qWarning() << QString("compressor.c: deflateEnd failed (%1)").arg(result);
+    zlib_stream_.avail_in = uInt(input.size());
+    zlib_stream_.next_in  = (Bytef *)input.data();
 
-    flushed_ = true;
-}
-
-int ZLibCompressor::write(const QByteArray &input) { return write(input, false); }
-
-int ZLibCompressor::write(const QByteArray &input, bool flush)
-{
-    int result;
-    zlib_stream_->avail_in = uInt(input.size());
-    zlib_stream_->next_in  = (Bytef *)input.data();
-    QByteArray output;
-
-    // Write the data
-    int output_position = 0;
+    // Compress straight into the tail of the output. deflateBound() plus the
+    // sync marker is enough in practice, so the output is sized once
+    int output_position = output->size();
+    output->resize(output_position + int(deflateBound(&zlib_stream_, uLong(input.size()))) + 16);
     do {
-        output.resize(output_position + CHUNK_SIZE);
-        zlib_stream_->avail_out = CHUNK_SIZE;
-        zlib_stream_->next_out  = (Bytef *)(output.data() + output_position);
-        result                  = deflate(zlib_stream_, (flush ? Z_FINISH : Z_NO_FLUSH));
+        if (output_position == output->size())
+            output->resize(output_position + CHUNK_SIZE);
+        zlib_stream_.avail_out = uInt(output->size() - output_position);
+        zlib_stream_.next_out  = (Bytef *)(output->data() + output_position);
+        int result             = deflate(&zlib_stream_, Z_SYNC_FLUSH);
         if (result == Z_STREAM_ERROR) {
-            qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_->msg);
+            qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_.msg);
+            output->resize(output_position);
             return result;
         }
-        output_position += CHUNK_SIZE;
-    } while (zlib_stream_->avail_out == 0);
-    if (zlib_stream_->avail_in != 0) {
+        output_position = output->size() - int(zlib_stream_.avail_out);
+    } while (zlib_stream_.avail_out == 0);
+    if (zlib_stream_.avail_in != 0) {
         qWarning("ZLibCompressor: avail_in != 0");
     }
-    output_position -= zlib_stream_->avail_out;
-
-    // Flush the data
-    if (!flush) {
-        do {
-            output.resize(output_position + CHUNK_SIZE);
-            zlib_stream_->avail_out = CHUNK_SIZE;
-            zlib_stream_->next_out  = (Bytef *)(output.data() + output_position);
-            result                  = deflate(zlib_stream_, Z_SYNC_FLUSH);
-            if (result == Z_STREAM_ERROR) {
-                qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_->msg);
-                return result;
-            }
-            output_position += CHUNK_SIZE;
-        } while (zlib_stream_->avail_out == 0);
-        output_position -= zlib_stream_->avail_out;
-    }
-    output.resize(output_position);
-
-    // Write the compressed data
-    device_->write(output);
+    output->resize(output_position);
     return 0;
 }
@@ -3,29 +3,33 @@
 
 #include "zlib.h"
 
-#include <QObject>
-
-class QIODevice;
-
-class ZLibCompressor : public QObject {
-    Q_OBJECT
+#include <QByteArray>
+
+/**
+ * Parameters of the deflate side of a stream. The state zlib keeps per
+ * stream is about (1 << (windowBits + 2)) + (1 << (memLevel + 9)) bytes,
+ * i.e. 256 KB with the defaults; windowBits 12 and memLevel 5 cut that down
+ * to 32 KB, at some cost in ratio.
+ */
+struct ZLibOptions {
+    int level      = Z_DEFAULT_COMPRESSION; // 0..9
+    int windowBits = MAX_WBITS;             // 9..15
+    int memLevel   = 8;                     // 1..MAX_MEM_LEVEL
+};
 
+class ZLibCompressor {
 public:
-    ZLibCompressor(QIODevice *device, int compression = Z_DEFAULT_COMPRESSION);
+    ZLibCompressor(const ZLibOptions &options = ZLibOptions());
     ~ZLibCompressor();
 
-    int write(const QByteArray &);
-
-protected slots:
-    void flush();
-
-protected:
-    int write(const QByteArray &, bool flush);
+    // Compresses the input and appends it to output, followed by a sync
+    // flush so the peer can decode everything written so far. Returns 0 on
+    // success or a zlib error code.
+    int write(const QByteArray &input, QByteArray *output);
 
 private:
-    QIODevice *device_;
-    z_stream * zlib_stream_;
-    bool       flushed_;
+    z_stream zlib_stream_;
+    bool     valid_;
 };
 
 #endif // ZLIBCOMPRESSOR_H
@@ -3,89 +3,59 @@
 #include "xmpp/zlib/common.h"
 #include "zlib.h"
 
-#include <QIODevice>
-#include <QObject>
 #include <QtDebug>
 
-ZLibDecompressor::ZLibDecompressor(QIODevice *device) : device_(device)
+ZLibDecompressor::ZLibDecompressor()
 {
-    zlib_stream_ = (z_stream *)malloc(sizeof(z_stream));
-    initZStream(zlib_stream_);
-    int result = inflateInit2(zlib_stream_, 15 + 32);
-    Q_ASSERT(result == Z_OK);
-    Q_UNUSED(result);
-    connect(device, SIGNAL(aboutToClose()), this, SLOT(flush()));
-    flushed_ = false;
+    initZStream(&zlib_stream_);
+    // The window size is chosen by the peer, so always accept the largest one
+    int result = inflateInit2(&zlib_stream_, MAX_WBITS + 32);
+    valid_     = (result == Z_OK);
+    if (!valid_)
+        qWarning() << QString("compressor.cpp: inflateInit2 failed (%1)").arg(result);
 }
 
 ZLibDecompressor::~ZLibDecompressor()
 {
-    flush();
-    free(zlib_stream_);
+    if (valid_)
+        inflateEnd(&zlib_stream_);
 }
 
-void ZLibDecompressor::flush()
+qint64 ZLibDecompressor::write(const QByteArray &input, QByteArray *output)
 {
-    if (flushed_)
-        return;
-
-    // Flush
-    write(QByteArray(), true);
-    int result = inflateEnd(zlib_stream_);
-    if (result != Z_OK)
-        qWarning() << QString("compressor.c: inflateEnd failed (%1)").arg(result);
-
-    flushed_ = true;
-}
-
-qint64 ZLibDecompressor::write(const QByteArray &input) { return write(input, false); }
-
-qint64 ZLibDecompressor::write(const QByteArray &input, bool flush)
-{
-    int result;
-    zlib_stream_->avail_in = uInt(input.size());
-    zlib_stream_->next_in  = (Bytef *)input.data();
-    QByteArray output;
-
-    // Write the data
-    int output_position = 0;
+    if (!valid_)
+        return Z_STREAM_ERROR;
+
+    zlib_stream_.avail_in = uInt(input.size());
+    zlib_stream_.next_in  = (Bytef *)input.data();
+
+    // Inflate straight into the tail of the output. Whenever the space runs out
+    // it grows by a few times the input still pending, as XML compresses
+    // about that well, or by what this input gave so far if that's more, so
+    // input which compresses better still needs few rounds. What the output
+    // held before doesn't matter
+    const int start           = output->size();
+    int       output_position = start;
+    int       result;
     do {
-        output.resize(output_position + CHUNK_SIZE);
-        zlib_stream_->avail_out = CHUNK_SIZE;
-        zlib_stream_->next_out  = (Bytef *)(output.data() + output_position);
-        result                  = inflate(zlib_stream_, (flush ? Z_FINISH : Z_NO_FLUSH));
-        if (result == Z_STREAM_ERROR) {
-            qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_->msg);
-            return result;
+        output->resize(output_position
+                       + qMax(CHUNK_SIZE, qMax(int(zlib_stream_.avail_in) * 4, output_position - start)));
+        zlib_stream_.avail_out = uInt(output->size() - output_position);
+        zlib_stream_.next_out  = (Bytef *)(output->data() + output_position);
+        result                 = inflate(&zlib_stream_, Z_SYNC_FLUSH);
+        output_position        = output->size() - int(zlib_stream_.avail_out);
+        if (result == Z_STREAM_ERROR || result == Z_NEED_DICT || result == Z_DATA_ERROR || result == Z_MEM_ERROR) {
+            qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_.msg);
+            output->resize(output_position);
+            return result == Z_NEED_DICT ? Z_DATA_ERROR : result;
         }
-        output_position += CHUNK_SIZE;
-    } while (zlib_stream_->avail_out == 0);
-    // Q_ASSERT(zlib_stream_->avail_in == 0);
-    if (zlib_stream_->avail_in != 0) {
-        qWarning() << "ZLibDecompressor: Unexpected state: avail_in=" << zlib_stream_->avail_in
-                   << ",avail_out=" << zlib_stream_->avail_out << ",result=" << result;
-        return Z_STREAM_ERROR; // FIXME: Should probably return 'result'
-    }
-    output_position -= zlib_stream_->avail_out;
+    } while (zlib_stream_.avail_out == 0);
+    output->resize(output_position);
 
-    // Flush the data
-    if (!flush) {
-        do {
-            output.resize(output_position + CHUNK_SIZE);
-            zlib_stream_->avail_out = CHUNK_SIZE;
-            zlib_stream_->next_out  = (Bytef *)(output.data() + output_position);
-            result                  = inflate(zlib_stream_, Z_SYNC_FLUSH);
-            if (result == Z_STREAM_ERROR) {
-                qWarning() << QString("compressor.cpp: Error ('%1')").arg(zlib_stream_->msg);
-                return result;
-            }
-            output_position += CHUNK_SIZE;
-        } while (zlib_stream_->avail_out == 0);
-        output_position -= zlib_stream_->avail_out;
+    if (zlib_stream_.avail_in != 0) {
+        qWarning() << "ZLibDecompressor: Unexpected state: avail_in=" << zlib_stream_.avail_in
+                   << ",avail_out=" << zlib_stream_.avail_out << ",result=" << result;
+        return Z_STREAM_ERROR; // FIXME: Should probably return 'result'
     }
-    output.resize(output_position);
-
-    // Write the compressed data
-    device_->write(output);
     return 0;
 }
@@ -3,29 +3,20 @@
 
 #include "zlib.h"
 
-#include <QObject>
-
-class QIODevice;
-
-class ZLibDecompressor : public QObject {
-    Q_OBJECT
+#include <QByteArray>
 
+class ZLibDecompressor {
 public:
-    ZLibDecompressor(QIODevice *device);
+    ZLibDecompressor();
     ~ZLibDecompressor();
 
-    qint64 write(const QByteArray &);
-
-protected slots:
-    void flush();
-
-protected:
-    qint64 write(const QByteArray &, bool flush);
+    // Decompresses the input and appends it to output. Returns 0 on success
+    // or a zlib error code.
+    qint64 write(const QByteArray &input, QByteArray *output);
 
 private:
-    QIODevice *device_;
-    z_stream * zlib_stream_;
-    bool       flushed_;
+    z_stream zlib_stream_;
+    bool     valid_;
 };
 
 #endif // ZLIBDECOMPRESSOR_H
@@ -17,6 +17,7 @@
  */
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QNetworkAddressEntry>
 #include <QNetworkInterface>
 #include <QTimer>
@@ -30,6 +31,7 @@ Q_IMPORT_PLUGIN(qca_ossl)
 
 #include <iris/dtls.h>
 #include <iris/ice176.h>
+#include <iris/icelocaltransport.h>
 #include <iris/netinterface.h>
 #include <iris/netnames.h>
 #include <iris/processquit.h>
@@ -521,7 +523,7 @@ public:
             channels[componentIndex].ready = true;
         });
 
-        connect(ice, SIGNAL(readyRead(int)), SLOT(ice_readyRead(int)));
+        connect(ice, SIGNAL(readyReadBurst(int)), SLOT(ice_readyRead(int)));
         connect(ice, SIGNAL(datagramsWritten(int, int)), SLOT(ice_datagramsWritten(int, int)));
         connect(ice, &XMPP::Ice176::readyToSendMedia, this, &App::ice_readToSendMedia);
         connect(ice, &XMPP::Ice176::iceFinished, this,
@@ -769,8 +771,8 @@ private Q_SLOTS:
 
     void ice_readyRead(int componentIndex)
     {
-        while (ice->hasPendingDatagrams(componentIndex)) {
-            QByteArray buf = ice->readDatagram(componentIndex);
+        const QList<QByteArray> datagrams = ice->readDatagrams(componentIndex);
+        for (const QByteArray &buf : datagrams) {
             if (componentIndex < dtls.size()) {
                 dtls[componentIndex]->writeIncomingDatagram(buf);
             } else {
@@ -854,6 +856,7 @@ private Q_SLOTS:
         }
         Q_ASSERT(at != -1);
 
+        QList<QByteArray> plain;
         while (sock->hasPendingDatagrams()) {
             QByteArray buf;
             buf.resize(sock->pendingDatagramSize());
@@ -865,10 +868,12 @@ private Q_SLOTS:
                 if (at < dtls.size()) {
                     dtls[at]->writeDatagram(buf);
                 } else {
-                    ice->writeDatagram(at, buf);
+                    plain += buf;
                 }
             }
         }
+        if (!plain.isEmpty())
+            ice->writeDatagrams(at, plain);
     }
 
     void sock_bytesWritten(qint64 bytes)
@@ -891,11 +896,109 @@ private Q_SLOTS:
     }
 };
 
+// blasts datagrams between two local transports over loopback and reports the packet rate,
+//   first with the one-by-one api and then with the batched one
+class Bench : public QObject {
+    Q_OBJECT
+
+public:
+    int opt_count = 200000;
+    int opt_size  = 1200;
+    int opt_burst = 64;
+
+    XMPP::IceLocalTransport *tx = nullptr;
+    XMPP::IceLocalTransport *rx = nullptr;
+    QByteArray               payload;
+    QElapsedTimer            elapsed;
+    QTimer                   idle;
+    bool                     batched  = false;
+    int                      sent     = 0;
+    int                      received = 0;
+    int                      started  = 0;
+
+signals:
+    void quit();
+
+public slots:
+    void start()
+    {
+        payload = QByteArray(opt_size, 'x');
+        tx      = new XMPP::IceLocalTransport(this);
+        rx      = new XMPP::IceLocalTransport(this);
+        for (auto t : { tx, rx }) {
+            connect(t, &XMPP::IceTransport::started, this, [this]() {
+                if (++started == 2)
+                    run(false);
+            });
+            connect(t, &XMPP::IceTransport::error, this, [this](int e) {
+                printf("Error: transport failed to start (%d)\n", e);
+                emit quit();
+            });
+        }
+        connect(rx, &XMPP::IceTransport::readyRead, this, [this](int path) {
+            QList<XMPP::IceTransport::Datagram> datagrams;
+            received += rx->readDatagrams(path, datagrams);
+            idle.start();
+        });
+
+        // the receiver gave up or everything is there
+        idle.setSingleShot(true);
+        idle.setInterval(500);
+        connect(&idle, &QTimer::timeout, this, &Bench::finish);
+
+        tx->start(QHostAddress(QHostAddress::LocalHost));
+        rx->start(QHostAddress(QHostAddress::LocalHost));
+    }
+
+private:
+    void run(bool batch)
+    {
+        batched  = batch;
+        sent     = 0;
+        received = 0;
+        elapsed.start();
+        QMetaObject::invokeMethod(this, "sendBurst", Qt::QueuedConnection);
+    }
+
+    void finish()
+    {
+        double secs = (elapsed.elapsed() - idle.interval()) / 1000.0;
+        printf("%-10s sent %d, received %d in %.3fs: %.0f pps\n", batched ? "batched" : "one-by-one", sent, received,
+               secs, secs > 0 ? received / secs : 0.0);
+        if (!batched)
+            run(true);
+        else
+            emit quit();
+    }
+
+private slots:
+    void sendBurst()
+    {
+        int n = qMin(opt_burst, opt_count - sent);
+        if (batched) {
+            QList<QByteArray> bufs;
+            bufs.reserve(n);
+            for (int i = 0; i < n; ++i)
+                bufs += payload;
+            tx->writeDatagrams(0, bufs, rx->localAddress());
+        } else {
+            for (int i = 0; i < n; ++i)
+                tx->writeDatagram(0, payload, rx->localAddress());
+        }
+        sent += n;
+        idle.start();
+        // queued, so the receiver gets its turn between the bursts
+        if (sent < opt_count)
+            QMetaObject::invokeMethod(this, "sendBurst", Qt::QueuedConnection);
+    }
+};
+
 void usage()
 {
     printf("icetunnel: create a peer-to-peer UDP tunnel based on ICE\n");
     printf("usage: icetunnel initiator (options)\n");
     printf("       icetunnel responder (options)\n");
+    printf("       icetunnel bench (--count=[n]) (--size=[n]) (--burst=[n])\n");
     printf("\n");
     printf(" --localbase=[n]     local base port (default=60000)\n");
     printf(" --icebase=[n]       ICE base port (default=0 (None))\n");
@@ -909,6 +1012,11 @@ void usage()
     printf(" --relay-udp-only    only offer UDP relay candidate\n");
     printf(" --relay-tcp-only    only offer TCP relay candidate\n");
     printf("\n");
+    printf("bench sends datagrams between two loopback transports and reports packets per second:\n");
+    printf(" --count=[n]         datagrams per run (default=200000)\n");
+    printf(" --size=[n]          datagram size (default=1200)\n");
+    printf(" --burst=[n]         datagrams written per event loop pass (default=64)\n");
+    printf("\n");
 }
 
 int main(int argc, char **argv)
@@ -931,6 +1039,9 @@ int main(int argc, char **argv)
     bool                 relay_udp_only = false;
     bool                 relay_tcp_only = false;
     bool                 enable_dtls    = true;
+    int                  bench_count    = 200000;
+    int                  bench_size     = 1200;
+    int                  bench_burst    = 64;
 
     for (int n = 0; n < args.count(); ++n) {
         QString s = args[n];
@@ -985,6 +1096,12 @@ int main(int argc, char **argv)
             relay_tcp_only = true;
         else if (var == "dtls")
             enable_dtls = true;
+        else if (var == "count")
+            bench_count = val.toInt();
+        else if (var == "size")
+            bench_size = val.toInt();
+        else if (var == "burst")
+            bench_burst = val.toInt();
         else
             known = false;
 
@@ -1007,6 +1124,24 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (args[0] == "bench") {
+        if (bench_count < 1 || bench_size < 1 || bench_size > 65507 || bench_burst < 1) {
+            usage();
+            return 1;
+        }
+
+        Bench bench;
+        bench.opt_count = bench_count;
+        bench.opt_size  = bench_size;
+        bench.opt_burst = bench_burst;
+
+        QObject::connect(&bench, &Bench::quit, &qapp, &QCoreApplication::quit);
+        QTimer::singleShot(0, &bench, &Bench::start);
+        qapp.exec();
+
+        return 0;
+    }
+
     int mode = -1;
     if (args[0] == "initiator")
         mode = 0;